@@ -125,6 +125,10 @@
 #define z_addr_dict_get_data(dict) ((dict).__data)
 #define z_addr_dict_get_base(dict) ((dict).__base)
 #define z_addr_dict_get_size(dict) ((dict).__size)
+// existence bitmap (NULL for AddrDictFast)
+#define z_addr_dict_get_used(dict) ((uint64_t *)((dict).__used))
+#define z_addr_dict_get_used_n(dict) \
+    ((dict).__used ? (dict).__size / 64 + 1 : 0)
 
 #define z_addr_dict_remove(dict, addr)                      \
     do {                                                    \
@@ -0,0 +1,220 @@
+/*
+ * address_map.h
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ADDRESS_MAP_H
+#define __ADDRESS_MAP_H
+
+#include "config.h"
+#include "utils.h"
+
+// force evaluation
+#define __ADDR_MAP_NAME_2(x, y) __AddrMap_##y##_##x##_t
+#define __ADDR_MAP_NAME_1(x, y) __ADDR_MAP_NAME_2(x, y)
+#define __ADDR_MAP_NAME(x) __ADDR_MAP_NAME_1(x, __COUNTER__)
+
+/*
+ * Address map is a hash table which uses address as key. Different from
+ * AddrDict, it is designed for sparse addresses, and its memory usage only
+ * depends on the number of keys. It uses open addressing with linear probing,
+ * and the (Fibonacci) hashing is inlined. Compared with GHashTable (with
+ * g_direct_hash), there is neither indirect hash call nor pointer-chasing node.
+ *
+ * INVALID_ADDR marks an empty slot, so it cannot be used as a key. Similar to
+ * g_hash_table_lookup, z_addr_map_get returns 0 for a missing key, hence the
+ * value is better to be non-zero.
+ *
+ * Note that we use macro to simulate template in C++.
+ */
+#define AddrMap(type, name)        \
+    struct __ADDR_MAP_NAME(name) { \
+        addr_t *__keys;            \
+        type *__vals;              \
+        size_t __cap;              \
+        size_t __n;                \
+        size_t __shift;            \
+    } name
+
+#define __ADDR_MAP_INIT_CAP_POW2 6
+
+#define __addr_map_hash(map, addr) \
+    ((size_t)(((uint64_t)(addr)*0x9E3779B97F4A7C15UL) >> (map).__shift))
+
+#define __addr_map_alloc(map, cap_pow2)                                  \
+    do {                                                                 \
+        (map).__cap = (1UL << (cap_pow2));                               \
+        (map).__shift = 64 - (cap_pow2);                                 \
+        (map).__keys = z_alloc((map).__cap, sizeof(addr_t));             \
+        for (size_t __am_k = 0; __am_k < (map).__cap; __am_k++) {        \
+            (map).__keys[__am_k] = INVALID_ADDR;                         \
+        }                                                                \
+        (map).__vals = z_alloc((map).__cap, sizeof(*((map).__vals)));    \
+    } while (0)
+
+// get the slot of addr, or the empty slot where addr is going to be placed
+#define __addr_map_find(map, addr)                                 \
+    ({                                                             \
+        size_t __am_mask = (map).__cap - 1;                        \
+        size_t __am_i = __addr_map_hash(map, addr);                \
+        while ((map).__keys[__am_i] != (addr) &&                   \
+               (map).__keys[__am_i] != INVALID_ADDR) {             \
+            __am_i = (__am_i + 1) & __am_mask;                     \
+        }                                                          \
+        __am_i;                                                    \
+    })
+
+// double the capacity and re-insert all keys
+#define __addr_map_grow(map)                                              \
+    do {                                                                  \
+        addr_t *__am_old_keys = (map).__keys;                             \
+        __typeof__((map).__vals) __am_old_vals = (map).__vals;            \
+        size_t __am_old_cap = (map).__cap;                                \
+                                                                          \
+        __addr_map_alloc(map, 64 - (map).__shift + 1);                    \
+        for (size_t __am_j = 0; __am_j < __am_old_cap; __am_j++) {        \
+            addr_t __am_old_key = __am_old_keys[__am_j];                  \
+            if (__am_old_key == INVALID_ADDR) {                           \
+                continue;                                                 \
+            }                                                             \
+            size_t __am_new_slot = __addr_map_find(map, __am_old_key);    \
+            (map).__keys[__am_new_slot] = __am_old_key;                   \
+            (map).__vals[__am_new_slot] = __am_old_vals[__am_j];          \
+        }                                                                 \
+                                                                          \
+        z_free(__am_old_keys);                                            \
+        z_free(__am_old_vals);                                            \
+    } while (0)
+
+#define z_addr_map_init(map)                                 \
+    do {                                                     \
+        (map).__n = 0;                                       \
+        __addr_map_alloc(map, __ADDR_MAP_INIT_CAP_POW2);     \
+    } while (0)
+
+#define z_addr_map_exist(map, addr)                                 \
+    ({                                                              \
+        addr_t __am_key = (addr);                                   \
+        size_t __am_slot = __addr_map_find(map, __am_key);          \
+        (__am_key != INVALID_ADDR &&                                \
+         (map).__keys[__am_slot] == __am_key);                      \
+    })
+
+#define z_addr_map_get(map, addr)                                     \
+    ({                                                                \
+        addr_t __am_key = (addr);                                     \
+        size_t __am_slot = __addr_map_find(map, __am_key);            \
+        ((__am_key != INVALID_ADDR &&                                 \
+          (map).__keys[__am_slot] == __am_key)                        \
+             ? (map).__vals[__am_slot]                                \
+             : (__typeof__(*((map).__vals)))0);                       \
+    })
+
+// XXX: the load factor is kept under 3/4
+#define z_addr_map_set(map, addr, val)                           \
+    do {                                                         \
+        addr_t __am_key = (addr);                                \
+        assert(__am_key != INVALID_ADDR);                        \
+        if (z_unlikely(((map).__n + 1) * 4 > (map).__cap * 3)) { \
+            __addr_map_grow(map);                                \
+        }                                                        \
+        size_t __am_slot = __addr_map_find(map, __am_key);       \
+        if ((map).__keys[__am_slot] == INVALID_ADDR) {           \
+            (map).__keys[__am_slot] = __am_key;                  \
+            (map).__n++;                                         \
+        }                                                        \
+        (map).__vals[__am_slot] = (val);                         \
+    } while (0)
+
+// XXX: backward-shift deletion, so that no tombstone is needed
+#define z_addr_map_remove(map, addr)                                        \
+    do {                                                                    \
+        addr_t __am_key = (addr);                                           \
+        size_t __am_hole = __addr_map_find(map, __am_key);                  \
+        if (__am_key == INVALID_ADDR ||                                     \
+            (map).__keys[__am_hole] != __am_key) {                          \
+            break;                                                          \
+        }                                                                   \
+                                                                            \
+        size_t __am_rm_mask = (map).__cap - 1;                              \
+        size_t __am_next = (__am_hole + 1) & __am_rm_mask;                  \
+        while ((map).__keys[__am_next] != INVALID_ADDR) {                   \
+            size_t __am_home = __addr_map_hash(map, (map).__keys[__am_next]); \
+            /* move next into hole if hole is in [home, next) */            \
+            if (((__am_next - __am_home) & __am_rm_mask) >=                 \
+                ((__am_next - __am_hole) & __am_rm_mask)) {                 \
+                (map).__keys[__am_hole] = (map).__keys[__am_next];          \
+                (map).__vals[__am_hole] = (map).__vals[__am_next];          \
+                __am_hole = __am_next;                                      \
+            }                                                               \
+            __am_next = (__am_next + 1) & __am_rm_mask;                     \
+        }                                                                   \
+                                                                            \
+        (map).__keys[__am_hole] = INVALID_ADDR;                             \
+        (map).__vals[__am_hole] = (__typeof__(*((map).__vals)))0;           \
+        (map).__n--;                                                        \
+    } while (0)
+
+#define z_addr_map_get_size(map) ((map).__n)
+
+/*
+ * Iterate over slots instead of copying keys (e.g., g_hash_table_get_keys):
+ *      for (size_t i = 0; i < z_addr_map_get_cap(map); i++) {
+ *          if (!z_addr_map_slot_used(map, i)) continue;
+ *          ... z_addr_map_slot_key(map, i) / z_addr_map_slot_val(map, i) ...
+ *      }
+ * Note that the order of keys is unspecified.
+ */
+#define z_addr_map_get_cap(map) ((map).__cap)
+#define z_addr_map_slot_used(map, i) ((map).__keys[i] != INVALID_ADDR)
+#define z_addr_map_slot_key(map, i) ((map).__keys[i])
+#define z_addr_map_slot_val(map, i) ((map).__vals[i])
+
+/*
+ * z_addr_map_destroy should support variable numbers of arguments
+ */
+#define __addr_map_destroy_opt_0(...)
+#define __addr_map_destroy_opt_1(...)
+#define __addr_map_destroy_opt_2(map, func)               \
+    do {                                                  \
+        for (size_t __i = 0; __i < (map).__cap; __i++) {  \
+            if (z_addr_map_slot_used(map, __i)) {         \
+                (*(func))((map).__vals[__i]);             \
+            }                                             \
+        }                                                 \
+    } while (0)
+
+#define __addr_map_destroy_choose(a, b, c, f, ...) f
+
+#define __addr_map_destroy_data(...)                                 \
+    __addr_map_destroy_choose(, ##__VA_ARGS__,                       \
+                              __addr_map_destroy_opt_2(__VA_ARGS__), \
+                              __addr_map_destroy_opt_1(__VA_ARGS__), \
+                              __addr_map_destroy_opt_0(__VA_ARGS__))
+
+#define __addr_map_destroy_self(map, ...) \
+    do {                                  \
+        z_free((map).__keys);             \
+        z_free((map).__vals);             \
+    } while (0)
+
+#define z_addr_map_destroy(...)               \
+    do {                                      \
+        __addr_map_destroy_data(__VA_ARGS__); \
+        __addr_map_destroy_self(__VA_ARGS__); \
+    } while (0)
+
+#endif
@@ -0,0 +1,348 @@
+/*
+ * analysis_cache.c
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "analysis_cache.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define __FNV_OFFSET_BASIS 0xcbf29ce484222325UL
+#define __FNV_PRIME 0x100000001b3UL
+
+#define __ALIGN_UP(x) \
+    (((x) + ANALYSIS_CACHE_ALIGN - 1) & ~((size_t)ANALYSIS_CACHE_ALIGN - 1))
+
+typedef struct analysis_cache_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t section_n;
+    uint64_t key;
+    uint64_t file_size;
+} __CacheHeader;
+
+typedef struct analysis_cache_section_t {
+    uint32_t tag;
+    uint32_t owned;  // only meaningful for pending sections
+    uint64_t offset;
+    uint64_t size;
+    const void *data;  // only meaningful for pending sections
+} __CacheSection;
+
+/*
+ * Validate the header and section table of a mapped cache file
+ */
+Z_PRIVATE bool __analysis_cache_validate(AnalysisCache *c);
+
+/*
+ * Free a pending section
+ */
+Z_PRIVATE void __analysis_cache_free_section(__CacheSection *sec);
+
+DEFINE_GETTER(AnalysisCache, analysis_cache, const char *, filename);
+DEFINE_GETTER(AnalysisCache, analysis_cache, uint64_t, key);
+
+Z_PRIVATE bool __analysis_cache_validate(AnalysisCache *c) {
+    if (c->size < sizeof(__CacheHeader)) {
+        return false;
+    }
+
+    __CacheHeader *header = (__CacheHeader *)c->raw_buf;
+    if (header->magic != ANALYSIS_CACHE_MAGIC) {
+        z_trace("invalid magic of analysis cache");
+        return false;
+    }
+    if (header->version != ANALYSIS_CACHE_VERSION) {
+        z_info("analysis cache version mismatch: %d v/s %d", header->version,
+               ANALYSIS_CACHE_VERSION);
+        return false;
+    }
+    if (header->key != c->key) {
+        z_info("analysis cache is stale (key %#lx v/s %#lx)", header->key,
+               c->key);
+        return false;
+    }
+    if (header->file_size != c->size) {
+        z_info("analysis cache is truncated");
+        return false;
+    }
+
+    size_t table_end = sizeof(__CacheHeader) +
+                       (size_t)header->section_n * sizeof(__CacheSection);
+    if (table_end > c->size) {
+        return false;
+    }
+
+    __CacheSection *secs =
+        (__CacheSection *)(c->raw_buf + sizeof(__CacheHeader));
+    for (size_t i = 0; i < header->section_n; i++) {
+        if (secs[i].offset % ANALYSIS_CACHE_ALIGN ||
+            secs[i].offset < table_end || secs[i].offset > c->size ||
+            secs[i].size > c->size - secs[i].offset) {
+            z_info("analysis cache has a corrupted section: %d", secs[i].tag);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Z_PRIVATE void __analysis_cache_free_section(__CacheSection *sec) {
+    if (sec->owned) {
+        z_buffer_destroy((Buffer *)sec->data);
+    }
+    z_free(sec);
+}
+
+Z_API uint64_t z_analysis_cache_hash(uint64_t h, const void *data,
+                                     size_t size) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    if (!h) {
+        h = __FNV_OFFSET_BASIS;
+    }
+    for (size_t i = 0; i < size; i++) {
+        h ^= ptr[i];
+        h *= __FNV_PRIME;
+    }
+    return h;
+}
+
+Z_API uint64_t z_analysis_cache_hash_file(uint64_t h, const char *pathname) {
+    int fd = open(pathname, O_RDONLY);
+    if (fd == -1) {
+        EXITME("failed to open %s: %s", pathname, strerror(errno));
+    }
+
+    struct stat s;
+    if (fstat(fd, &s) == -1) {
+        EXITME("failed to stat %s: %s", pathname, strerror(errno));
+    }
+
+    size_t size = s.st_size;
+    if (size) {
+        void *raw_buf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (raw_buf == MAP_FAILED) {
+            EXITME("failed to mmap %s: %s", pathname, strerror(errno));
+        }
+        h = z_analysis_cache_hash(h, raw_buf, size);
+        munmap(raw_buf, size);
+    }
+    // mix the size as well
+    h = z_analysis_cache_hash(h, &size, sizeof(size));
+
+    close(fd);
+    return h;
+}
+
+Z_API AnalysisCache *z_analysis_cache_load(const char *pathname, uint64_t key) {
+    if (z_access(pathname, F_OK)) {
+        return NULL;
+    }
+
+    int fd = open(pathname, O_RDONLY);
+    if (fd == -1) {
+        z_warn("failed to open analysis cache %s", pathname);
+        return NULL;
+    }
+
+    struct stat s;
+    if (fstat(fd, &s) == -1 || !s.st_size) {
+        close(fd);
+        return NULL;
+    }
+
+    // XXX: MAP_PRIVATE makes sure a concurrent store (which renames a new file)
+    // does not affect the loaded cache
+    uint8_t *raw_buf = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (raw_buf == MAP_FAILED) {
+        z_warn("failed to mmap analysis cache %s", pathname);
+        return NULL;
+    }
+
+    AnalysisCache *c = STRUCT_ALLOC(AnalysisCache);
+    c->filename = z_strdup(pathname);
+    c->key = key;
+    c->raw_buf = raw_buf;
+    c->size = s.st_size;
+    c->sections = NULL;
+
+    if (!__analysis_cache_validate(c)) {
+        z_analysis_cache_destroy(c);
+        return NULL;
+    }
+
+    z_info("analysis cache loaded: %s (%#lx bytes)", pathname, c->size);
+    return c;
+}
+
+Z_API AnalysisCache *z_analysis_cache_create(const char *pathname,
+                                             uint64_t key) {
+    AnalysisCache *c = STRUCT_ALLOC(AnalysisCache);
+    c->filename = z_strdup(pathname);
+    c->key = key;
+    c->raw_buf = NULL;
+    c->size = 0;
+    c->sections = g_queue_new();
+    return c;
+}
+
+Z_API const void *z_analysis_cache_get_section(AnalysisCache *c, uint32_t tag,
+                                               size_t *size) {
+    assert(c != NULL);
+    if (!c->raw_buf) {
+        EXITME("get a section from an unloaded analysis cache");
+    }
+
+    __CacheHeader *header = (__CacheHeader *)c->raw_buf;
+    __CacheSection *secs =
+        (__CacheSection *)(c->raw_buf + sizeof(__CacheHeader));
+    for (size_t i = 0; i < header->section_n; i++) {
+        if (secs[i].tag == tag) {
+            *size = secs[i].size;
+            return c->raw_buf + secs[i].offset;
+        }
+    }
+
+    *size = 0;
+    return NULL;
+}
+
+Z_API void z_analysis_cache_add_section(AnalysisCache *c, uint32_t tag,
+                                        const void *data, size_t size) {
+    assert(c != NULL);
+    if (!c->sections) {
+        EXITME("add a section into a loaded analysis cache");
+    }
+
+    __CacheSection *sec = z_alloc(1, sizeof(__CacheSection));
+    sec->tag = tag;
+    sec->owned = false;
+    sec->size = size;
+    sec->data = data;
+    g_queue_push_tail(c->sections, (gpointer)sec);
+}
+
+Z_API void z_analysis_cache_add_buffer(AnalysisCache *c, uint32_t tag,
+                                       Buffer *buf) {
+    assert(c != NULL);
+    if (!c->sections) {
+        EXITME("add a section into a loaded analysis cache");
+    }
+
+    __CacheSection *sec = z_alloc(1, sizeof(__CacheSection));
+    sec->tag = tag;
+    sec->owned = true;
+    sec->size = z_buffer_get_size(buf);
+    sec->data = (const void *)buf;
+    g_queue_push_tail(c->sections, (gpointer)sec);
+}
+
+Z_API void z_analysis_cache_store(AnalysisCache *c) {
+    assert(c != NULL);
+    if (!c->sections) {
+        EXITME("store a loaded analysis cache");
+    }
+
+    // step (1). layout all sections
+    size_t section_n = g_queue_get_length(c->sections);
+    __CacheSection *secs = z_alloc(section_n, sizeof(__CacheSection));
+
+    size_t offset =
+        __ALIGN_UP(sizeof(__CacheHeader) + section_n * sizeof(__CacheSection));
+    GList *l = g_queue_peek_head_link(c->sections);
+    for (size_t i = 0; i < section_n; i++, l = l->next) {
+        __CacheSection *sec = (__CacheSection *)l->data;
+        secs[i].tag = sec->tag;
+        secs[i].owned = 0;
+        secs[i].offset = offset;
+        secs[i].size = sec->size;
+        secs[i].data = NULL;
+        offset = __ALIGN_UP(offset + sec->size);
+    }
+
+    __CacheHeader header = {
+        .magic = ANALYSIS_CACHE_MAGIC,
+        .version = ANALYSIS_CACHE_VERSION,
+        .section_n = section_n,
+        .key = c->key,
+        .file_size = offset,
+    };
+
+    // step (2). write into a temporary file
+    // XXX: the cache is renamed into place at the end, so that a crashed or
+    // concurrent process never observes a partially written cache
+    char *tmp_filename = z_alloc_printf("%s.%d", c->filename, getpid());
+    FILE *f = z_fopen(tmp_filename, "wb");
+
+    if (z_fwrite(&header, sizeof(__CacheHeader), 1, f) != 1 ||
+        (section_n &&
+         z_fwrite(secs, sizeof(__CacheSection), section_n, f) != section_n)) {
+        EXITME("error on writing analysis cache");
+    }
+
+    l = g_queue_peek_head_link(c->sections);
+    for (size_t i = 0; i < section_n; i++, l = l->next) {
+        __CacheSection *sec = (__CacheSection *)l->data;
+        const void *data = sec->owned
+                               ? z_buffer_get_raw_buf((Buffer *)sec->data)
+                               : sec->data;
+
+        z_fseek(f, secs[i].offset, SEEK_SET);
+        if (sec->size && z_fwrite((void *)data, sec->size, 1, f) != 1) {
+            EXITME("error on writing analysis cache section: %d", sec->tag);
+        }
+    }
+
+    // make sure the tail padding exists
+    if ((size_t)z_ftell(f) < offset) {
+        uint8_t zero = 0;
+        z_fseek(f, offset - 1, SEEK_SET);
+        if (z_fwrite(&zero, 1, 1, f) != 1) {
+            EXITME("error on writing analysis cache");
+        }
+    }
+    z_fclose(f);
+
+    // step (3). rename into place
+    if (rename(tmp_filename, c->filename)) {
+        EXITME("failed to rename %s: %s", tmp_filename, strerror(errno));
+    }
+
+    z_info("analysis cache stored: %s (%#lx bytes)", c->filename, offset);
+
+    z_free(tmp_filename);
+    z_free(secs);
+}
+
+Z_API void z_analysis_cache_destroy(AnalysisCache *c) {
+    if (c->raw_buf) {
+        munmap(c->raw_buf, c->size);
+    }
+
+    if (c->sections) {
+        g_queue_free_full(c->sections,
+                          (GDestroyNotify)(&__analysis_cache_free_section));
+    }
+
+    z_free((char *)c->filename);
+    z_free(c);
+}
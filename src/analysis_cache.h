@@ -0,0 +1,150 @@
+/*
+ * analysis_cache.h
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ANALYSIS_CACHE_H
+#define __ANALYSIS_CACHE_H
+
+#include "buffer.h"
+#include "config.h"
+
+#include <gmodule.h>
+
+/*
+ * Analysis cache is a versioned on-disk file which persists analysis results
+ * (e.g., superset disassembly, UCFG, and pdisasm) across different runs of the
+ * same binary. The file is keyed by a hash of the original ELF (mixed with any
+ * other input which affects the analysis), and its layout is:
+ *
+ *      | header | section table | section 0 | section 1 | ... |
+ *
+ * Each section is tagged and aligned to ANALYSIS_CACHE_ALIGN, so that it can be
+ * directly used from the read-only memory mapping.
+ *
+ * XXX: ANALYSIS_CACHE_VERSION must be bumped whenever the layout of any cached
+ * structure (e.g., SInst and RegState) changes.
+ */
+#define ANALYSIS_CACHE_MAGIC 0x31454843415a5453UL  // "STZACHE1"
+#define ANALYSIS_CACHE_VERSION 4
+#define ANALYSIS_CACHE_ALIGN 0x10
+
+typedef enum analysis_cache_tag_t {
+    // superset disassembly (refer to disassembler.c)
+    ACACHE_SUPERSET_INSTS = 0x100,
+    ACACHE_OCC_OFFSETS,
+    ACACHE_OCC_NEIGHBORS,
+
+    // UCFG analysis (refer to ucfg_analyzer.c)
+    ACACHE_UCFG_INSTS = 0x200,
+    ACACHE_UCFG_REG_STATES,
+    ACACHE_UCFG_DIRECT_PREDS,
+    ACACHE_UCFG_DIRECT_SUCCS,
+    ACACHE_UCFG_INTRA_PREDS,
+    ACACHE_UCFG_INTRA_SUCCS,
+    ACACHE_UCFG_ALL_PREDS,
+    ACACHE_UCFG_ALL_SUCCS,
+    ACACHE_UCFG_LIVE,
+    ACACHE_UCFG_CAN_RET,
+
+    // probabilistic disassembly (refer to prob_disasm_complete.c)
+    ACACHE_PDISASM_META = 0x300,
+    ACACHE_PDISASM_H,
+    ACACHE_PDISASM_RH,
+    ACACHE_PDISASM_P,
+    ACACHE_PDISASM_D,
+    ACACHE_PDISASM_INST_LOST,
+    ACACHE_PDISASM_DATA_HINT,
+    ACACHE_PDISASM_ADDR2SCCID,
+    ACACHE_PDISASM_DAG_SUCCS,
+    ACACHE_PDISASM_DAG_PREDS,
+    ACACHE_PDISASM_DAG_DEAD,
+    ACACHE_PDISASM_DAG_P,
+    ACACHE_PDISASM_TOPO,
+} AnalysisCacheTag;
+
+// the companion section which holds the existence bitmap of an AddrDict
+#define ACACHE_BITMAP(tag) ((tag) | 0x10000)
+
+STRUCT(AnalysisCache, {
+    const char *filename;
+    uint64_t key;
+
+    // memory mapping for a loaded cache
+    uint8_t *raw_buf;
+    size_t size;
+
+    // pending sections for a cache to be stored
+    GQueue *sections;
+});
+
+DECLARE_GETTER(AnalysisCache, analysis_cache, const char *, filename);
+DECLARE_GETTER(AnalysisCache, analysis_cache, uint64_t, key);
+
+/*
+ * Hash (FNV-1a) a chunk of memory, starting from hash value h.
+ */
+Z_API uint64_t z_analysis_cache_hash(uint64_t h, const void *data,
+                                     size_t size);
+
+/*
+ * Hash the content of a file, starting from hash value h.
+ */
+Z_API uint64_t z_analysis_cache_hash_file(uint64_t h, const char *pathname);
+
+/*
+ * Load a cache file, return NULL if the file does not exist, is corrupted, or
+ * is created for a different key or version.
+ */
+Z_API AnalysisCache *z_analysis_cache_load(const char *pathname, uint64_t key);
+
+/*
+ * Create an empty cache which will be stored into pathname.
+ */
+Z_API AnalysisCache *z_analysis_cache_create(const char *pathname,
+                                             uint64_t key);
+
+/*
+ * Get the section with the given tag from a loaded cache, return NULL if there
+ * is no such section.
+ */
+Z_API const void *z_analysis_cache_get_section(AnalysisCache *c, uint32_t tag,
+                                               size_t *size);
+
+/*
+ * Add a section into a created cache. Note that data is not copied, so it must
+ * be alive until z_analysis_cache_store returns.
+ */
+Z_API void z_analysis_cache_add_section(AnalysisCache *c, uint32_t tag,
+                                        const void *data, size_t size);
+
+/*
+ * Add a section into a created cache, which takes the ownership of buf.
+ */
+Z_API void z_analysis_cache_add_buffer(AnalysisCache *c, uint32_t tag,
+                                       Buffer *buf);
+
+/*
+ * Atomically store all added sections into the cache file.
+ */
+Z_API void z_analysis_cache_store(AnalysisCache *c);
+
+/*
+ * Destroy a cache (unmap the loaded file or drop all pending sections).
+ */
+Z_API void z_analysis_cache_destroy(AnalysisCache *c);
+
+#endif
@@ -37,6 +37,12 @@
     } while (0)
 #endif
 
+// XXX: kernels before 4.17 ignore this flag and take addr as a hint, hence the
+// returned address must always be checked
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
 #define utils_likely(x) __builtin_expect(!!(x), 1)
 #define utils_unlikely(x) __builtin_expect(!!(x), 0)
 
@@ -110,10 +116,40 @@ Z_UTILS size_t utils_strcpy(char *dst, char *src) {
 }
 
 /*
- * Load external file.
+ * Reserve [addr, addr + size) with a PROT_NONE mapping, which fails instead of
+ * silently replacing anything already mapped there.
+ */
+Z_UTILS bool utils_mmap_reserve(unsigned long addr, size_t size) {
+    int flags =
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE;
+    unsigned long res = sys_mmap(addr, size, PROT_NONE, flags, -1, 0);
+    if (res == addr) {
+        return true;
+    }
+    if (res < (unsigned long)(-4095L)) {
+        // an old kernel placed it elsewhere
+        sys_munmap(res, size);
+    }
+    return false;
+}
+
+/*
+ * Load external file. If window is larger than the file, the whole window is
+ * mapped (with MAP_NORESERVE), so that the pages appended to the file later are
+ * visible without remapping. Return the size of the mapped area.
+ *
+ * Once the daemon grows the file beyond the window, it raises
+ * ELFSTATE_SHADOW_EXTENDED (i.e., CRS_STATUS_REMMAP), and the fork server
+ * unmaps the old window and calls this function again, where the file size is
+ * used instead (the window no longer helps).
+ *
+ * The target range must be free (after unmapping it if remmap is set). It is
+ * checked by a reservation first, and we fail loudly on any collision (e.g.,
+ * with the heap or a library), as MAP_FIXED would silently replace them.
  */
 Z_UTILS size_t utils_mmap_external_file(const char *filename, bool remmap,
-                                        unsigned long addr, int prot) {
+                                        unsigned long addr, size_t window,
+                                        int prot) {
     // Step (0): prepare error string
 #ifdef DEBUG
     char s_[16];
@@ -154,20 +190,34 @@ Z_UTILS size_t utils_mmap_external_file(const char *filename, bool remmap,
         utils_puts(s, false);
         utils_error(s_, true);
     }
+    size_t map_size = fd_size;
+    int flags = MAP_FIXED;
+    if (window > fd_size) {
+        map_size = window;
+        flags |= MAP_NORESERVE;
+    }
 
     // Step (3). remmap if needed
     if (remmap) {
-        if (sys_munmap(addr, fd_size)) {
+        if (sys_munmap(addr, map_size)) {
             utils_error(s_, true);
         }
     }
 
-    // Step (4): mmap file
+    // Step (4): make sure nothing else lives in the target range, after which
+    // MAP_FIXED only replaces our own reservation
+    if (!utils_mmap_reserve(addr, map_size)) {
+        utils_puts(filename, false);
+        utils_puts(s_ + 13, false);
+        utils_error(s_, true);
+    }
+
+    // Step (5): mmap file
 #ifdef BINARY_SEARCH_INVALID_CRASH
     // make gdb able to set breakpoints at mmapped pages
-    if (sys_mmap(addr, fd_size, prot, MAP_PRIVATE | MAP_FIXED, fd, 0) != addr) {
+    if (sys_mmap(addr, map_size, prot, MAP_PRIVATE | flags, fd, 0) != addr) {
 #else
-    if (sys_mmap(addr, fd_size, prot, MAP_SHARED | MAP_FIXED, fd, 0) != addr) {
+    if (sys_mmap(addr, map_size, prot, MAP_SHARED | flags, fd, 0) != addr) {
 #endif
         utils_error(s_, true);
     }
@@ -175,5 +225,5 @@ Z_UTILS size_t utils_mmap_external_file(const char *filename, bool remmap,
         utils_error(s_, true);
     }
 
-    return fd_size;
+    return map_size;
 }
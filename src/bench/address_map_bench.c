@@ -0,0 +1,131 @@
+/*
+ * address_map_bench.c
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compare the lookup throughput of AddrMap with GHashTable (g_direct_hash),
+ * which is how the rewriter/patcher/disassembler tables used to be built.
+ *
+ * Keys simulate basic-block addresses: increasing addresses in .text with
+ * small random gaps, looked up in a random order.
+ */
+
+#include "../address_map.h"
+
+#include <gmodule.h>
+#include <time.h>
+
+#define BENCH_TEXT_ADDR 0x400000UL
+#define BENCH_LOOKUP_N (1UL << 24)
+
+static uint64_t bench_rand_state = 0x2545F4914F6CDD1DUL;
+
+// xorshift64
+static inline uint64_t bench_rand() {
+    bench_rand_state ^= bench_rand_state << 13;
+    bench_rand_state ^= bench_rand_state >> 7;
+    bench_rand_state ^= bench_rand_state << 17;
+    return bench_rand_state;
+}
+
+static inline double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_run(size_t key_n) {
+    // step (1). generate keys (addresses of basic blocks) and lookup queries,
+    // where misses are the addresses right after the keys
+    addr_t *keys = z_alloc(key_n, sizeof(addr_t));
+    addr_t addr = BENCH_TEXT_ADDR;
+    for (size_t i = 0; i < key_n; i++) {
+        addr += 2 + bench_rand() % 31;
+        keys[i] = addr;
+    }
+    addr_t *hits = z_alloc(BENCH_LOOKUP_N, sizeof(addr_t));
+    addr_t *misses = z_alloc(BENCH_LOOKUP_N, sizeof(addr_t));
+    for (size_t i = 0; i < BENCH_LOOKUP_N; i++) {
+        hits[i] = keys[bench_rand() % key_n];
+        misses[i] = keys[bench_rand() % key_n] + 1;
+    }
+
+    // step (2). build both tables
+    AddrMap(addr_t, map);
+    z_addr_map_init(map);
+    GHashTable *table = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    double t0 = bench_now();
+    for (size_t i = 0; i < key_n; i++) {
+        z_addr_map_set(map, keys[i], keys[i] + 0x1000);
+    }
+    double t1 = bench_now();
+    for (size_t i = 0; i < key_n; i++) {
+        g_hash_table_insert(table, GSIZE_TO_POINTER(keys[i]),
+                            GSIZE_TO_POINTER(keys[i] + 0x1000));
+    }
+    double t2 = bench_now();
+
+    // step (3). lookup
+    addr_t sum_map = 0, sum_table = 0;
+    double t3 = bench_now();
+    for (size_t i = 0; i < BENCH_LOOKUP_N; i++) {
+        sum_map += z_addr_map_get(map, hits[i]);
+    }
+    double t4 = bench_now();
+    for (size_t i = 0; i < BENCH_LOOKUP_N; i++) {
+        sum_table += (addr_t)g_hash_table_lookup(table,
+                                                 GSIZE_TO_POINTER(hits[i]));
+    }
+    double t5 = bench_now();
+    for (size_t i = 0; i < BENCH_LOOKUP_N; i++) {
+        sum_map += z_addr_map_get(map, misses[i]);
+    }
+    double t6 = bench_now();
+    for (size_t i = 0; i < BENCH_LOOKUP_N; i++) {
+        sum_table += (addr_t)g_hash_table_lookup(table,
+                                                 GSIZE_TO_POINTER(misses[i]));
+    }
+    double t7 = bench_now();
+
+    if (sum_map != sum_table) {
+        EXITME("AddrMap and GHashTable disagree: %#lx v/s %#lx", sum_map,
+               sum_table);
+    }
+
+#define __MOPS(n, t) ((n) / (t) / 1e6)
+    printf("%9lu keys | insert %7.1f v/s %7.1f | hit %7.1f v/s %7.1f | miss "
+           "%7.1f v/s %7.1f\n",
+           key_n, __MOPS(key_n, t1 - t0), __MOPS(key_n, t2 - t1),
+           __MOPS(BENCH_LOOKUP_N, t4 - t3), __MOPS(BENCH_LOOKUP_N, t5 - t4),
+           __MOPS(BENCH_LOOKUP_N, t6 - t5), __MOPS(BENCH_LOOKUP_N, t7 - t6));
+#undef __MOPS
+
+    g_hash_table_destroy(table);
+    z_addr_map_destroy(map);
+    z_free(misses);
+    z_free(hits);
+    z_free(keys);
+}
+
+int main(int argc, const char **argv) {
+    printf("throughput in Mops/s, AddrMap v/s GHashTable\n");
+    for (size_t key_n = 1UL << 10; key_n <= 1UL << 22; key_n <<= 3) {
+        bench_run(key_n);
+    }
+    return 0;
+}
@@ -312,6 +312,12 @@ Z_PRIVATE void __binary_setup_tp_zone(Binary *b) {
     z_elf_write(b->elf, b->trampolines_addr, sizeof(Trampoline),
                 (void *)null_buf);
     b->trampolines_addr += sizeof(Trampoline);
+
+    // shadow code is directly written by default
+    b->shadow_staging = false;
+    b->staged_shadow_addr = INVALID_ADDR;
+    b->staged_shadow_code = z_buffer_create(NULL, 0);
+    b->staged_lookup_cells = z_buffer_create(NULL, 0);
 }
 
 Z_API Binary *z_binary_open(const char *pathname, bool prior_fork_server) {
@@ -351,6 +357,12 @@ Z_API void z_binary_destroy(Binary *b) {
 
     g_hash_table_destroy(b->mmapped_pages);
 
+    if (b->shadow_staging) {
+        z_warn("destroy binary with unpublished shadow code");
+    }
+    z_buffer_destroy(b->staged_shadow_code);
+    z_buffer_destroy(b->staged_lookup_cells);
+
     z_free(b);
 }
 
@@ -375,6 +387,9 @@ Z_API void z_binary_insert_utp(Binary *b, addr_t utp_addr, const uint8_t *utp,
     if (utp_size > PAGE_SIZE) {
         EXITME("utp size is too large [%#lx]", utp_size);
     }
+    if (b->shadow_staging) {
+        EXITME("cannot insert utp when shadow code is staged");
+    }
 
     Snode *snode = z_snode_create(utp_addr, utp_size, NULL, NULL);
     addr_t mmap_addr = 0;
@@ -414,12 +429,89 @@ Z_API addr_t z_binary_insert_shadow_code(Binary *b, const uint8_t *sc,
                                          const size_t sc_size) {
     addr_t cur_shadow_addr = b->trampolines_addr;
 
-    z_elf_write(b->elf, b->trampolines_addr, sc_size, sc);
+    if (b->shadow_staging) {
+        z_buffer_append_raw(b->staged_shadow_code, sc, sc_size);
+    } else {
+        z_elf_write(b->elf, b->trampolines_addr, sc_size, sc);
+    }
     b->trampolines_addr += sc_size;
 
     return cur_shadow_addr;
 }
 
+Z_API void z_binary_write_shadow_code(Binary *b, addr_t addr, const uint8_t *sc,
+                                      const size_t sc_size) {
+    uint8_t *staged = z_binary_get_staged_shadow_code(b, addr, sc_size);
+    if (staged) {
+        memcpy(staged, sc, sc_size);
+    } else {
+        z_elf_write(b->elf, addr, sc_size, sc);
+    }
+}
+
+Z_API uint8_t *z_binary_get_staged_shadow_code(Binary *b, addr_t addr,
+                                               size_t size) {
+    if (!b->shadow_staging || addr < b->staged_shadow_addr ||
+        addr + size > b->trampolines_addr) {
+        return NULL;
+    }
+
+    return z_buffer_get_raw_buf(b->staged_shadow_code) +
+           (addr - b->staged_shadow_addr);
+}
+
+Z_API void z_binary_stage_shadow_code(Binary *b) {
+    if (b->shadow_staging) {
+        EXITME("shadow code is already staged");
+    }
+
+    b->shadow_staging = true;
+    b->staged_shadow_addr = b->trampolines_addr;
+    assert(!z_buffer_get_size(b->staged_shadow_code));
+    assert(!z_buffer_get_size(b->staged_lookup_cells));
+}
+
+Z_API void z_binary_publish_shadow_code(Binary *b) {
+    if (!b->shadow_staging) {
+        EXITME("no shadow code is staged");
+    }
+
+    b->shadow_staging = false;
+
+    // step (1). write all shadow code at once, so that the underlying file is
+    // extended at most once
+    size_t sc_size = z_buffer_get_size(b->staged_shadow_code);
+    if (sc_size) {
+        assert(b->staged_shadow_addr + sc_size == b->trampolines_addr);
+        z_elf_write(b->elf, b->staged_shadow_addr, sc_size,
+                    z_buffer_get_raw_buf(b->staged_shadow_code));
+        z_buffer_truncate(b->staged_shadow_code, 0);
+    }
+    b->staged_shadow_addr = INVALID_ADDR;
+
+    // step (2). apply lookup table updates through a single pointer
+    size_t cell_n =
+        z_buffer_get_size(b->staged_lookup_cells) / (sizeof(addr_t) * 2);
+    if (cell_n) {
+        addr_t *cells = (addr_t *)z_buffer_get_raw_buf(b->staged_lookup_cells);
+        Rptr *table = z_elf_vaddr2ptr(b->elf, b->lookup_table_addr);
+        if (z_rptr_is_null(table) ||
+            z_rptr_get_size(table) < LOOKUP_TABLE_SIZE) {
+            EXITME("invalid lookup table at %#lx", b->lookup_table_addr);
+        }
+
+        for (size_t i = 0; i < cell_n; i++) {
+            addr_t cell_addr = cells[i * 2];
+            addr_t shadow_addr = cells[i * 2 + 1];
+            memcpy(table->raw_ptr + (cell_addr - b->lookup_table_addr),
+                   (uint8_t *)(&shadow_addr), LOOKUP_TABLE_CELL_SIZE);
+        }
+
+        z_rptr_destroy(table);
+        z_buffer_truncate(b->staged_lookup_cells, 0);
+    }
+}
+
 Z_API void z_binary_update_lookup_table(Binary *b, addr_t ori_addr,
                                         addr_t shadow_addr) {
     Elf64_Shdr *text = z_elf_get_shdr_text(b->elf);
@@ -438,6 +530,13 @@ Z_API void z_binary_update_lookup_table(Binary *b, addr_t ori_addr,
     if (shadow_addr > LOOKUP_TABLE_CELL_MASK)
         EXITME("too big shadow address (%#lx)", shadow_addr);
 
+    if (b->shadow_staging) {
+        addr_t cell[2] = {cell_addr, shadow_addr};
+        z_buffer_append_raw(b->staged_lookup_cells, (uint8_t *)cell,
+                            sizeof(cell));
+        return;
+    }
+
     z_elf_write(b->elf, cell_addr, LOOKUP_TABLE_CELL_SIZE,
                 (uint8_t *)(&shadow_addr));
 }
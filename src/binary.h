@@ -63,6 +63,12 @@ STRUCT(Binary, {
     // Shadow Code and Trampolines
     addr_t trampolines_addr;  // Next avaiable address of trampolines
     addr_t last_tp_addr;
+
+    // Staged shadow code and lookup table cells, which are published together
+    bool shadow_staging;          // Whether shadow code is being staged
+    addr_t staged_shadow_addr;    // Address of the first staged byte
+    Buffer *staged_shadow_code;   // Staged shadow code
+    Buffer *staged_lookup_cells;  // Staged (ori_addr, shadow_addr) pairs
 });
 
 DECLARE_GETTER(Binary, binary, ELF *, elf);
@@ -110,6 +116,32 @@ Z_API void z_binary_insert_utp(Binary *b, addr_t utp_addr, const uint8_t *utp,
 Z_API addr_t z_binary_insert_shadow_code(Binary *b, const uint8_t *sc,
                                          const size_t sc_size);
 
+/*
+ * Overwrite a piece of inserted shadow code (staged or not)
+ */
+Z_API void z_binary_write_shadow_code(Binary *b, addr_t addr, const uint8_t *sc,
+                                      const size_t sc_size);
+
+/*
+ * Start staging shadow code: following inserted shadow code and lookup table
+ * updates are kept in memory until z_binary_publish_shadow_code is called.
+ * Note that the address of each piece of shadow code does not change.
+ */
+Z_API void z_binary_stage_shadow_code(Binary *b);
+
+/*
+ * Publish all staged shadow code by a single write, and apply all staged
+ * lookup table updates
+ */
+Z_API void z_binary_publish_shadow_code(Binary *b);
+
+/*
+ * Get the raw pointer of staged shadow code [addr, addr + size), or NULL if
+ * the given range is not staged
+ */
+Z_API uint8_t *z_binary_get_staged_shadow_code(Binary *b, addr_t addr,
+                                               size_t size);
+
 /*
  * Notify binary that all shadow code has been inserted
  */
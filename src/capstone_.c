@@ -65,6 +65,173 @@ Z_PRIVATE GPRState __capstone_mapping_pgr(x86_reg reg_id);
  */
 Z_PRIVATE GPRState __capstone_filter_pgr(x86_reg reg_id);
 
+/*
+ * Memory hooks of capstone
+ */
+Z_PRIVATE void *__capstone_mem_malloc(size_t size);
+Z_PRIVATE void *__capstone_mem_calloc(size_t nmemb, size_t size);
+Z_PRIVATE void *__capstone_mem_realloc(void *ptr, size_t size);
+Z_PRIVATE void __capstone_mem_free(void *ptr);
+
+/*
+ * Bump allocation from an arena (16-byte aligned)
+ */
+Z_PRIVATE void *__capstone_arena_alloc(CSArena *arena, size_t size);
+
+// XXX: every block returned by the memory hooks is prefixed by this header, so
+// that cs_free knows where the block comes from (16 bytes to keep alignment)
+typedef struct cs_mem_header_t {
+    size_t size;
+    CSArena *arena;  // NULL for the heap
+} __CSMemHeader;
+
+// the first 16 bytes of each chunk link to the previous chunk
+#define __CS_ARENA_CHUNK_HEADER_SIZE 0x10
+
+// current arena of each thread
+static __thread CSArena *__capstone_cur_arena = NULL;
+
+Z_PRIVATE void *__capstone_arena_alloc(CSArena *arena, size_t size) {
+    size = BITS_ALIGN_CELL(size, 4);
+
+    if (z_unlikely((size_t)(arena->end - arena->cur) < size)) {
+        // the remaining of current chunk is simply wasted
+        size_t chunk_size = arena->chunk_size;
+        if (chunk_size < size + __CS_ARENA_CHUNK_HEADER_SIZE) {
+            chunk_size = size + __CS_ARENA_CHUNK_HEADER_SIZE;
+        }
+
+        uint8_t *chunk = z_alloc(chunk_size, sizeof(uint8_t));
+        *(uint8_t **)chunk = arena->chunk;
+        arena->chunk = chunk;
+        arena->cur = chunk + __CS_ARENA_CHUNK_HEADER_SIZE;
+        arena->end = chunk + chunk_size;
+    }
+
+    void *ptr = arena->cur;
+    arena->cur += size;
+    return ptr;
+}
+
+Z_PRIVATE void *__capstone_mem_malloc(size_t size) {
+    CSArena *arena = __capstone_cur_arena;
+
+    __CSMemHeader *header = NULL;
+    if (arena) {
+        header = __capstone_arena_alloc(arena, sizeof(__CSMemHeader) + size);
+    } else {
+        header = z_alloc(1, sizeof(__CSMemHeader) + size);
+    }
+    header->size = size;
+    header->arena = arena;
+
+    return header + 1;
+}
+
+Z_PRIVATE void *__capstone_mem_calloc(size_t nmemb, size_t size) {
+    void *ptr = __capstone_mem_malloc(nmemb * size);
+    memset(ptr, 0, nmemb * size);
+    return ptr;
+}
+
+Z_PRIVATE void *__capstone_mem_realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return __capstone_mem_malloc(size);
+    }
+
+    __CSMemHeader *header = (__CSMemHeader *)ptr - 1;
+    if (!header->arena) {
+        header = z_realloc(header, sizeof(__CSMemHeader) + size);
+        header->size = size;
+        return header + 1;
+    }
+
+    // XXX: cs_disasm always shrinks its instruction cache at last, which can
+    // be done in place
+    if (size <= header->size) {
+        return ptr;
+    }
+
+    void *new_ptr = __capstone_mem_malloc(size);
+    memcpy(new_ptr, ptr, header->size);
+    return new_ptr;
+}
+
+Z_PRIVATE void __capstone_mem_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    // blocks of arenas are released along with their arenas
+    __CSMemHeader *header = (__CSMemHeader *)ptr - 1;
+    if (!header->arena) {
+        z_free(header);
+    }
+}
+
+Z_API void z_capstone_install_mem_hooks() {
+    cs_opt_mem mem = {
+        .malloc = &__capstone_mem_malloc,
+        .calloc = &__capstone_mem_calloc,
+        .realloc = &__capstone_mem_realloc,
+        .free = &__capstone_mem_free,
+        .vsnprintf = &vsnprintf,
+    };
+
+    if (cs_option(0, CS_OPT_MEM, (size_t)&mem) != CS_ERR_OK) {
+        EXITME("fail on cs_option()");
+    }
+}
+
+Z_API CSArena *z_capstone_arena_create(size_t chunk_size) {
+    assert(chunk_size > __CS_ARENA_CHUNK_HEADER_SIZE);
+
+    CSArena *arena = STRUCT_ALLOC(CSArena);
+    arena->chunk = NULL;
+    arena->cur = NULL;
+    arena->end = NULL;
+    arena->chunk_size = chunk_size;
+
+    return arena;
+}
+
+Z_API void z_capstone_arena_destroy(CSArena *arena) {
+    assert(arena != __capstone_cur_arena);
+
+    uint8_t *chunk = arena->chunk;
+    while (chunk) {
+        uint8_t *prev_chunk = *(uint8_t **)chunk;
+        z_free(chunk);
+        chunk = prev_chunk;
+    }
+
+    z_free(arena);
+}
+
+Z_API void z_capstone_arena_reset(CSArena *arena) {
+    uint8_t *chunk = arena->chunk;
+    if (!chunk) {
+        return;
+    }
+
+    // only keep the first chunk
+    uint8_t *prev_chunk = NULL;
+    while ((prev_chunk = *(uint8_t **)chunk)) {
+        z_free(chunk);
+        chunk = prev_chunk;
+    }
+
+    arena->chunk = chunk;
+    arena->cur = chunk + __CS_ARENA_CHUNK_HEADER_SIZE;
+    arena->end = chunk + arena->chunk_size;
+}
+
+Z_API CSArena *z_capstone_arena_switch(CSArena *arena) {
+    CSArena *prev_arena = __capstone_cur_arena;
+    __capstone_cur_arena = arena;
+    return prev_arena;
+}
+
 Z_PRIVATE FLGState __capstone_mapping_flg_write(uint64_t flg_state) {
 #define __FLG_MAPPING_WRITE(fs, F)         \
     do {                                   \
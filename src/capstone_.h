@@ -163,6 +163,45 @@ STRUCT(RegState, {
     ZMMState zmm_write;
 });
 
+/*
+ * Arena for capstone's allocations. Once the memory hooks are installed (via
+ * CS_OPT_MEM), all allocations of a thread go into its current arena, or into
+ * the heap if there is no current arena. cs_free on an arena-allocated
+ * instruction is a no-op, and the whole arena is released at once.
+ */
+STRUCT(CSArena, {
+    uint8_t *chunk;  // the latest chunk, whose first 8 bytes link to the prev
+    uint8_t *cur;
+    uint8_t *end;
+    size_t chunk_size;
+});
+
+/*
+ * Install the memory hooks, which must be done before any cs_open
+ */
+Z_API void z_capstone_install_mem_hooks();
+
+/*
+ * Create an arena
+ */
+Z_API CSArena *z_capstone_arena_create(size_t chunk_size);
+
+/*
+ * Destroy an arena, with all instructions allocated from it
+ */
+Z_API void z_capstone_arena_destroy(CSArena *arena);
+
+/*
+ * Release all instructions allocated from the arena, but keep its first chunk
+ */
+Z_API void z_capstone_arena_reset(CSArena *arena);
+
+/*
+ * Set the current arena of the calling thread (NULL means the heap), and
+ * return the previous one
+ */
+Z_API CSArena *z_capstone_arena_switch(CSArena *arena);
+
 Z_API bool z_capstone_is_call(const cs_insn *inst);
 
 Z_API bool z_capstone_is_jmp(const cs_insn *inst);
@@ -96,6 +96,18 @@ typedef long double double128_t;
 
 #define RETADDR_MAPPING_ADDR (SIGNAL_STACK_ADDR + SIGNAL_STACK_SIZE)
 
+/*
+ * XXX: the client reserves (MAP_NORESERVE) a fixed window for the shadow code
+ * and the retaddr mapping, and the daemon grows the underlying files within
+ * these windows. Hence the client only needs to remap them (CRS_STATUS_REMMAP)
+ * when a file outgrows its window. Note that, for non-PIE binaries, the shadow
+ * code window must end before LOOKUP_TABLE_ADDR. Other collisions (e.g., with
+ * the heap of a PIE binary) are only known at runtime, where the loader checks
+ * the whole window and fails on any collision (see utils_mmap_external_file).
+ */
+#define SHADOW_CODE_WINDOW_SIZE 0x40000000
+#define RETADDR_MAPPING_WINDOW_SIZE 0x10000000
+
 /*
  * [RW_PAGE_ADDR] The meta information needed during loading
  */
@@ -148,6 +160,8 @@ typedef struct __loading_info_t {
 #define CRASHPOINT_LOG_PREFIX ".crashpoint."
 #define PIPE_FILENAME_PREFIX ".pipe."
 #define PDISASM_FILENAME_PREFIX ".pdisasm."
+#define ANALYSIS_CACHE_PREFIX ".analysis."
+#define PDISASM_CACHE_PREFIX ".pdisasm_cache."
 #define CODE_SEGMENT_FILE_SUFFIX ".code.segments"
 #define BACKUP_FILE_SUFFIX ".bak"
 #define PATCHED_FILE_SUFFIX ".patch"
@@ -174,6 +188,9 @@ extern uint64_t z_lookup_table_get_cell_num();
 
 #define LOOKUP_TABLE_ADDR ((1UL << 31) - LOOKUP_TABLE_MAX_SIZE)
 
+_Static_assert(SHADOW_CODE_ADDR + SHADOW_CODE_WINDOW_SIZE <= LOOKUP_TABLE_ADDR,
+               "shadow code window overlaps the lookup table");
+
 /*
  * Crash check
  */
@@ -626,7 +626,7 @@ Z_API CRSStatus z_diagnoser_new_crashpoint(Diagnoser *g, int status,
 
     // step (6). check remmap
     if (z_binary_check_state(g->binary, ELFSTATE_SHADOW_EXTENDED)) {
-        z_info("underlying shadow file is extended");
+        z_info("underlying shadow file outgrows the reserved window");
 
         // do not forget to disable the shadow_extened flag
         z_binary_set_elf_state(g->binary,
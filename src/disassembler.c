@@ -17,8 +17,10 @@
  */
 
 #include "disassembler.h"
+#include "analysis_cache.h"
 #include "capstone_.h"
 #include "elf_.h"
+#include "fast_decoder.h"
 #include "interval_splay.h"
 #include "restricted_ptr.h"
 #include "utils.h"
@@ -30,7 +32,9 @@
 #include "prob_disasm/prob_disasm_complete.c"
 #include "prob_disasm/prob_disasm_simple.c"
 
-#define SUPERSET_DISASM_THRESHOLD 0x400000
+#define SUPERSET_DISASM_BATCH_SIZE 0x400000
+#define SUPERSET_DISASM_MIN_CHUNK 0x10000
+#define CS_ARENA_CHUNK_SIZE 0x100000
 
 /*
  * Runtime binding for probabilistic disassembly
@@ -39,14 +43,55 @@
     ({ (d->enable_pdisasm ? func(__args) : func##_S(__args)); })
 
 /*
- * Function Pointer: destroy a cs_insn
+ * Superset disassembly (on multiple threads, batch by batch)
  */
-Z_PRIVATE void __disassembler_free_cs_insn(cs_insn *inst);
+Z_PRIVATE void __disassembler_superset_disasm(Disassembler *d);
 
 /*
- * Superset disassembly
+ * Fill the compact record of a superset-disassembled instruction. Note that
+ * the instruction must be already added into UCFG_Analyzer.
  */
-Z_PRIVATE void __disassembler_superset_disasm(Disassembler *d);
+Z_PRIVATE void __disassembler_fill_superset_inst(Disassembler *d, addr_t addr,
+                                                 const cs_insn *inst);
+
+/*
+ * Collect occluded instructions of (text_addr + off) into buf (if buf is not
+ * NULL), and return the number of them
+ */
+Z_PRIVATE size_t __disassembler_collect_occluded_offs(Disassembler *d,
+                                                      size_t off,
+                                                      uint32_t *buf);
+
+/*
+ * Build CSR-encoded index of occluded addresses
+ */
+Z_PRIVATE void __disassembler_build_occluded_index(Disassembler *d);
+
+/*
+ * Update the occluded index after the size of (text_addr + off) changes. Only
+ * the instructions at most 14 bytes away are affected.
+ */
+Z_PRIVATE void __disassembler_update_occluded_index(Disassembler *d,
+                                                   size_t off);
+
+/*
+ * Check the content of cached superset disassembly and occluded index, which
+ * are used as indices without any further bounds checking
+ */
+Z_PRIVATE bool __disassembler_validate_cache(size_t text_size,
+                                             const SInst *insts,
+                                             const uint32_t *offsets,
+                                             const uint32_t *neighbors);
+
+/*
+ * Restore superset disassembly and UCFG analysis from the analysis cache
+ */
+Z_PRIVATE bool __disassembler_load_cache(Disassembler *d);
+
+/*
+ * Persist superset disassembly and UCFG analysis into the analysis cache
+ */
+Z_PRIVATE void __disassembler_store_cache(Disassembler *d);
 
 /*
  * Check whether underlying binary has inlined data (potentially)
@@ -70,8 +115,6 @@ DEFINE_GETTER(Disassembler, disassembler, Binary *, binary);
 DEFINE_GETTER(Disassembler, disassembler, UCFG_Analyzer *, ucfg_analyzer);
 DEFINE_GETTER(Disassembler, disassembler, bool, enable_pdisasm);
 
-Z_PRIVATE void __disassembler_free_cs_insn(cs_insn *inst) { cs_free(inst, 1); }
-
 /*
  * XXX: This function is out of date. Hence, there is no guarantee to use it.
  */
@@ -144,8 +187,7 @@ Z_RESERVED Z_PRIVATE void __disassembler_pre_disasm(Disassembler *d) {
                 break;
             }
 
-            g_hash_table_insert(d->recursive_disasm, GSIZE_TO_POINTER(cur_addr),
-                                (gpointer)inst);
+            z_addr_map_set(d->recursive_disasm, cur_addr, inst);
 
             if (z_capstone_is_jmp(inst) || z_capstone_is_cjmp(inst) ||
                 z_capstone_is_loop(inst) || z_capstone_is_xbegin(inst)) {
@@ -163,7 +205,7 @@ Z_RESERVED Z_PRIVATE void __disassembler_pre_disasm(Disassembler *d) {
 
     z_info("disassemble .init/.fini done");
     z_info("we have %ld correct instructions disassemblied",
-           g_hash_table_size(d->recursive_disasm));
+           z_addr_map_get_size(d->recursive_disasm));
 }
 
 // XXX: here we simply check whether linear disassembly can decode all
@@ -175,11 +217,11 @@ Z_PRIVATE bool __disassembler_has_inlined_data(Disassembler *d) {
 
     addr_t cur_addr = d->text_addr;
     do {
-        cs_insn *cur_inst = z_disassembler_get_superset_disasm(d, cur_addr);
-        if (!cur_inst) {
+        const SInst *cur_sinst = z_disassembler_get_superset_inst(d, cur_addr);
+        if (!cur_sinst) {
             return true;
         }
-        cur_addr += cur_inst->size;
+        cur_addr += cur_sinst->size;
     } while (cur_addr < d->text_addr + d->text_size);
 
     return false;
@@ -215,6 +257,214 @@ Z_PRIVATE bool __disassembler_analyze_inst(cs_insn *inst, addr_t *targets) {
     return !z_capstone_is_terminator(inst);
 }
 
+Z_PRIVATE void __disassembler_fill_superset_inst(Disassembler *d, addr_t addr,
+                                                 const cs_insn *inst) {
+    SInst *sinst = d->superset_insts + (addr - d->text_addr);
+
+    sinst->id = inst->id;
+    sinst->size = inst->size;
+    sinst->target = 0;
+
+    // step (1). instruction class
+    uint16_t cls = SINST_DECODED;
+    if (z_capstone_is_call(inst)) {
+        cls |= SINST_CALL;
+    }
+    if (z_capstone_is_jmp(inst)) {
+        cls |= SINST_JMP;
+    }
+    if (z_capstone_is_cjmp(inst)) {
+        cls |= SINST_CJMP;
+    }
+    if (z_capstone_is_loop(inst)) {
+        cls |= SINST_LOOP;
+    }
+    if (z_capstone_is_xbegin(inst)) {
+        cls |= SINST_XBEGIN;
+    }
+    if (z_capstone_is_ret(inst)) {
+        cls |= SINST_RET;
+    }
+    if (z_capstone_is_terminator(inst)) {
+        cls |= SINST_TERMINATOR;
+    }
+    if (z_capstone_is_rare(inst)) {
+        cls |= SINST_RARE;
+    }
+
+    // step (2). direct target
+    if (cls & (SINST_CALL | SINST_JMP | SINST_CJMP | SINST_LOOP |
+               SINST_XBEGIN)) {
+        cs_detail *detail = inst->detail;
+        if ((detail->x86.op_count == 1) &&
+            (detail->x86.operands[0].type == X86_OP_IMM)) {
+            cls |= SINST_DIRECT;
+            sinst->target = (int32_t)(detail->x86.operands[0].imm - addr);
+        }
+    }
+    sinst->cls = cls;
+
+    // step (3). register states (calculated by UCFG_Analyzer)
+    RegState rs;
+    if (!z_ucfg_analyzer_get_register_state(d->ucfg_analyzer, addr, &rs)) {
+        EXITME("missing register state: %#lx", addr);
+    }
+    sinst->gpr_read = rs.gpr_read;
+    sinst->gpr_write = rs.gpr_write;
+    sinst->flg_read = rs.flg_read;
+    sinst->flg_write = rs.flg_write;
+}
+
+/*
+ * Context of parallel superset disassembly. Each task decodes a disjoint chunk
+ * of the current batch with its own capstone handle, and stores the results
+ * into insts (indexed by offset to the batch), so that no synchronization is
+ * required.
+ */
+STRUCT(__SupersetDisasmCtx, {
+    const uint8_t *code;
+    size_t code_size;
+    addr_t text_addr;
+    size_t batch_off;
+    size_t batch_end;
+    size_t chunk_size;
+    cs_insn **insts;
+    CSArena **arenas;  // one arena per chunk, as arenas are not thread-safe
+
+    // statistics (updated atomically)
+    size_t skipped_n;
+#ifdef VALIDATE_FAST_DECODER
+    size_t benign_n;    // fast decoder is valid but capstone is not
+    size_t mismatch_n;  // length or class mismatches
+#endif
+});
+
+#ifdef VALIDATE_FAST_DECODER
+/*
+ * Cross-check the result of fast decoder against capstone
+ */
+Z_PRIVATE void __disassembler_validate_fast_decoder(__SupersetDisasmCtx *ctx,
+                                                    size_t off,
+                                                    FDecStatus status,
+                                                    const FastInst *finst,
+                                                    const cs_insn *inst);
+#endif
+
+#ifdef VALIDATE_FAST_DECODER
+Z_PRIVATE void __disassembler_validate_fast_decoder(__SupersetDisasmCtx *ctx,
+                                                    size_t off,
+                                                    FDecStatus status,
+                                                    const FastInst *finst,
+                                                    const cs_insn *inst) {
+    addr_t addr = ctx->text_addr + off;
+
+    if (status == FDEC_UNKNOWN) {
+        return;
+    }
+
+    if (!inst) {
+        if (status == FDEC_VALID) {
+            __atomic_fetch_add(&ctx->benign_n, 1, __ATOMIC_RELAXED);
+        }
+        return;
+    }
+
+    if (status == FDEC_INVALID) {
+        EXITME("fast decoder rejects a valid instruction " CS_SHOW_INST(inst));
+    }
+
+    FInstClass cls = FINST_NORMAL;
+    if (z_capstone_is_call(inst)) {
+        cls = FINST_CALL;
+    } else if (z_capstone_is_jmp(inst)) {
+        cls = FINST_JMP;
+    } else if (z_capstone_is_cjmp(inst)) {
+        cls = FINST_CJMP;
+    } else if (z_capstone_is_loop(inst)) {
+        cls = FINST_LOOP;
+    } else if (z_capstone_is_ret(inst)) {
+        cls = FINST_RET;
+    } else if (z_capstone_is_xbegin(inst)) {
+        cls = FINST_XBEGIN;
+    } else if (inst->id == X86_INS_HLT) {
+        cls = FINST_HLT;
+    }
+
+    if (finst->size != inst->size || finst->cls != cls) {
+        z_warn("fast decoder mismatch at %#lx: size %d v/s %d, class %d v/s %d",
+               addr, finst->size, inst->size, finst->cls, cls);
+        __atomic_fetch_add(&ctx->mismatch_n, 1, __ATOMIC_RELAXED);
+    }
+}
+#endif
+
+Z_PRIVATE void __disassembler_superset_disasm_chunk(void *ctx_,
+                                                    size_t task_id) {
+    __SupersetDisasmCtx *ctx = (__SupersetDisasmCtx *)ctx_;
+
+    size_t off = ctx->batch_off + task_id * ctx->chunk_size;
+    size_t end_off = off + ctx->chunk_size;
+    if (end_off > ctx->batch_end) {
+        end_off = ctx->batch_end;
+    }
+    cs_insn **insts = ctx->insts - ctx->batch_off;
+
+    // XXX: the global capstone handle (cs) is not thread-safe
+    csh handle = CS_INVALID_CSH;
+    if (cs_open(CS_ARCH_X86, CS_MODE_64, &handle) != CS_ERR_OK) {
+        EXITME("fail on cs_open()");
+    }
+    if (cs_option(handle, CS_OPT_DETAIL, CS_OPT_ON) != CS_ERR_OK) {
+        EXITME("fail on cs_option()");
+    }
+
+    // the handle itself must not be allocated from the arena
+    CSArena *arena = z_capstone_arena_create(CS_ARENA_CHUNK_SIZE);
+    ctx->arenas[task_id] = arena;
+    CSArena *prev_arena = z_capstone_arena_switch(arena);
+
+    size_t skipped_n = 0;
+    for (; off < end_off; off++) {
+        // tier 1: skip offsets which capstone is definitely going to reject
+        FastInst finst;
+        FDecStatus status = z_fast_decoder_decode(
+            ctx->code + off, ctx->code_size - off, &finst);
+#ifdef FAST_DECODER_SKIP_INVALID
+        // XXX: only enabled on request (FAST_DECODER=skip), until validated by
+        // `make validate_decoder` on the benchmarks with zero mismatches
+        if (status == FDEC_INVALID) {
+            insts[off] = NULL;
+            skipped_n++;
+            continue;
+        }
+#endif
+
+        // tier 2: full decoding with details
+        cs_insn *inst = NULL;
+        // XXX: keep the same code size as the serial version, so that an
+        // instruction crossing chunks is decoded identically
+        if (cs_disasm(handle, ctx->code + off, ctx->code_size - off,
+                      ctx->text_addr + off, 1, &inst) == 1) {
+            insts[off] = inst;
+        } else {
+            insts[off] = NULL;
+        }
+
+#ifdef VALIDATE_FAST_DECODER
+        __disassembler_validate_fast_decoder(ctx, off, status, &finst,
+                                             insts[off]);
+#endif
+#ifndef FAST_DECODER_SKIP_INVALID
+        skipped_n += (status == FDEC_INVALID);
+#endif
+    }
+
+    z_capstone_arena_switch(prev_arena);
+    cs_close(&handle);
+
+    __atomic_fetch_add(&ctx->skipped_n, skipped_n, __ATOMIC_RELAXED);
+}
+
 Z_PRIVATE void __disassembler_superset_disasm(Disassembler *d) {
     assert(d);
 
@@ -229,56 +479,308 @@ Z_PRIVATE void __disassembler_superset_disasm(Disassembler *d) {
     // step (1). get code buf
     Rptr *buf = z_elf_vaddr2ptr(e, text_addr);
 
-    // step (2). disassembly
-    for (addr_t cur_addr = text_addr; cur_addr < text_addr + text_size;
-         cur_addr++) {
-        CS_DISASM(buf, cur_addr, 1);
-        if (cs_count == 1) {
-            z_ucfg_analyzer_add_inst(d->ucfg_analyzer, cur_addr, cs_inst,
-                                     false);
-            g_hash_table_insert(d->superset_disasm, GSIZE_TO_POINTER(cur_addr),
-                                (gpointer)cs_inst);
-            z_addr_dict_set(d->occ_addrs, cur_addr, z_buffer_create(NULL, 0));
+    // step (2). split .text into batches. The full instructions of a batch are
+    // kept until they are merged, so that the batch size (instead of the size
+    // of .text) bounds the peak memory.
+    size_t batch_size = text_size;
+    if (batch_size > SUPERSET_DISASM_BATCH_SIZE) {
+        batch_size = SUPERSET_DISASM_BATCH_SIZE;
+    }
+    size_t task_n = z_parallel_get_worker_n();
+    size_t chunk_size = (batch_size + task_n - 1) / task_n;
+    if (chunk_size < SUPERSET_DISASM_MIN_CHUNK) {
+        chunk_size = SUPERSET_DISASM_MIN_CHUNK;
+    }
+    task_n = (batch_size + chunk_size - 1) / chunk_size;
+
+    cs_insn **insts = z_alloc(batch_size, sizeof(cs_insn *));
+    CSArena **arenas = z_alloc(task_n, sizeof(CSArena *));
+
+    __SupersetDisasmCtx ctx = {
+        .code = (const uint8_t *)buf->raw_ptr,
+        .code_size = buf->size,
+        .text_addr = text_addr,
+        .chunk_size = chunk_size,
+        .insts = insts,
+        .arenas = arenas,
+        .skipped_n = 0,
+#ifdef VALIDATE_FAST_DECODER
+        .benign_n = 0,
+        .mismatch_n = 0,
+#endif
+    };
+
+    z_info("superset disassembly: %ld batches of %ld chunks (%#lx bytes each)",
+           (text_size + batch_size - 1) / batch_size, task_n, chunk_size);
+
+    size_t inst_n = 0;
+    for (size_t batch_off = 0; batch_off < text_size; batch_off += batch_size) {
+        size_t batch_end = batch_off + batch_size;
+        if (batch_end > text_size) {
+            batch_end = text_size;
+        }
+        size_t batch_task_n =
+            (batch_end - batch_off + chunk_size - 1) / chunk_size;
+
+        // step (2.1). disassembly on multiple threads
+        ctx.batch_off = batch_off;
+        ctx.batch_end = batch_end;
+        z_parallel_run(batch_task_n, &__disassembler_superset_disasm_chunk,
+                       &ctx);
+
+        // step (2.2). merge results in address order, which is exactly the
+        // order of the serial version. Note that only the compact records are
+        // kept, and full instructions will be materialized on demand.
+        for (size_t off = batch_off; off < batch_end; off++) {
+            SInst *sinst = d->superset_insts + off;
+            cs_insn *inst = insts[off - batch_off];
+            if (!inst) {
+                sinst->cls = SINST_DECODED;
+                continue;
+            }
+
+            addr_t cur_addr = text_addr + off;
+            z_ucfg_analyzer_add_inst(d->ucfg_analyzer, cur_addr, inst, NULL);
+            __disassembler_fill_superset_inst(d, cur_addr, inst);
 
-            z_trace("superset disassembly " CS_SHOW_INST(cs_inst));
+            z_trace("superset disassembly " CS_SHOW_INST(inst));
 
-            cs_inst = NULL;  // avoid double free
+            inst_n++;
+        }
+
+        // step (2.3). the full instructions of this batch are released at once
+        for (size_t i = 0; i < batch_task_n; i++) {
+            z_capstone_arena_destroy(arenas[i]);
         }
-        z_rptr_inc(buf, uint8_t, 1);
     }
 
-    z_info("superset disassembly done, found %ld instructions",
-           g_hash_table_size(d->superset_disasm));
+    z_free(insts);
+    z_free(arenas);
+
+    z_info("fast decoder rejects %ld of %ld offsets", ctx.skipped_n,
+           text_size);
+#ifdef VALIDATE_FAST_DECODER
+    z_info("fast decoder validation: %ld benign, %ld mismatches", ctx.benign_n,
+           ctx.mismatch_n);
+    if (ctx.mismatch_n) {
+        EXITME("fast decoder validation fails with %ld mismatches",
+               ctx.mismatch_n);
+    }
+#endif
+    z_info("superset disassembly done, found %ld instructions", inst_n);
 
     // step (3). remember to free code buffer
     z_rptr_destroy(buf);
 
     // step (4). calculate occluded address
-    for (addr_t cur_addr = text_addr; cur_addr < text_addr + text_size;
-         cur_addr++) {
-        // validation
-        cs_insn *inst = (cs_insn *)g_hash_table_lookup(
-            d->superset_disasm, GSIZE_TO_POINTER(cur_addr));
-        if (!inst) {
+    __disassembler_build_occluded_index(d);
+}
+
+Z_PRIVATE size_t __disassembler_collect_occluded_offs(Disassembler *d,
+                                                      size_t off,
+                                                      uint32_t *buf) {
+    const SInst *insts = d->superset_insts;
+    size_t size = insts[off].size;
+    if (!size) {
+        return 0;
+    }
+
+    // note that the longest x86/64 instruction is 15-bytes
+    size_t n = 0;
+    size_t occ_off = (off >= 14 ? off - 14 : 0);
+    size_t end_off = off + size;
+    if (end_off > d->text_size) {
+        end_off = d->text_size;
+    }
+
+    for (; occ_off < end_off; occ_off++) {
+        size_t occ_size = insts[occ_off].size;
+        if (!occ_size) {
             continue;
         }
 
-        // find all possible occluded instructions
-        for (addr_t occ_addr = cur_addr + 1; occ_addr < cur_addr + inst->size;
-             occ_addr++) {
-            cs_insn *occ_inst = (cs_insn *)g_hash_table_lookup(
-                d->superset_disasm, GSIZE_TO_POINTER(occ_addr));
-            if (!occ_inst) {
-                continue;
+        if ((occ_off < off && occ_off + occ_size > off) || (occ_off > off)) {
+            if (buf) {
+                buf[n] = (uint32_t)occ_off;
             }
+            n++;
+        }
+    }
+
+    return n;
+}
+
+Z_PRIVATE void __disassembler_build_occluded_index(Disassembler *d) {
+    assert(!d->occ_offsets && !d->occ_neighbors);
+
+    size_t text_size = d->text_size;
+
+    if (text_size >= UINT32_MAX) {
+        EXITME("too large .text section: %#lx", text_size);
+    }
 
-            // update both
-            z_buffer_append_raw(z_addr_dict_get(d->occ_addrs, cur_addr),
-                                (uint8_t *)&occ_addr, sizeof(occ_addr));
-            z_buffer_append_raw(z_addr_dict_get(d->occ_addrs, occ_addr),
-                                (uint8_t *)&cur_addr, sizeof(cur_addr));
+    // step (1). first pass: count occluded instructions
+    uint32_t *offsets = z_alloc(text_size + 1, sizeof(uint32_t));
+    size_t total_n = 0;
+    for (size_t off = 0; off < text_size; off++) {
+        offsets[off] = (uint32_t)total_n;
+        total_n += __disassembler_collect_occluded_offs(d, off, NULL);
+        if (total_n >= UINT32_MAX) {
+            EXITME("too many occluded instructions");
         }
     }
+    offsets[text_size] = (uint32_t)total_n;
+
+    // step (2). second pass: fill the neighbors
+    uint32_t *neighbors = z_alloc(total_n + 1, sizeof(uint32_t));
+    for (size_t off = 0; off < text_size; off++) {
+        __disassembler_collect_occluded_offs(d, off, neighbors + offsets[off]);
+    }
+
+    d->occ_offsets = offsets;
+    d->occ_neighbors = neighbors;
+
+    z_info("occluded index built: %ld pairs", total_n);
+}
+
+Z_PRIVATE void __disassembler_update_occluded_index(Disassembler *d,
+                                                   size_t off) {
+    size_t text_size = d->text_size;
+    size_t lo = (off >= 14 ? off - 14 : 0);
+    size_t hi = (off + 15 < text_size ? off + 15 : text_size);
+
+    // the full index is immutable, so the affected entries are recomputed
+    // into occ_patches, which overrides the index
+    for (size_t i = lo; i < hi; i++) {
+        Buffer *buf = z_addr_map_get(d->occ_patches, i);
+        if (!buf) {
+            buf = z_buffer_create(NULL, 0);
+            z_addr_map_set(d->occ_patches, i, buf);
+        }
+
+        size_t n = __disassembler_collect_occluded_offs(d, i, NULL);
+        z_buffer_truncate(buf, 0);
+        z_buffer_fill(buf, 0, n * sizeof(uint32_t));
+        __disassembler_collect_occluded_offs(
+            d, i, (uint32_t *)z_buffer_get_raw_buf(buf));
+    }
+}
+
+Z_PRIVATE bool __disassembler_validate_cache(size_t text_size,
+                                             const SInst *insts,
+                                             const uint32_t *offsets,
+                                             const uint32_t *neighbors) {
+    // XXX: the analysis cache only checks its key and layout, so a corrupted
+    // (or truncated-then-rewritten) file may still carry well-sized sections
+    if (offsets[0] != 0) {
+        return false;
+    }
+
+    for (size_t off = 0; off < text_size; off++) {
+        // an instruction never crosses the end of .text
+        if (insts[off].size > text_size - off) {
+            return false;
+        }
+
+        // offsets must be non-decreasing and neighbors must be inside .text
+        if (offsets[off] > offsets[off + 1]) {
+            return false;
+        }
+        for (uint32_t i = offsets[off]; i < offsets[off + 1]; i++) {
+            if (neighbors[i] >= text_size) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+Z_PRIVATE bool __disassembler_load_cache(Disassembler *d) {
+#ifdef VALIDATE_FAST_DECODER
+    // always run superset disassembly to validate the fast decoder
+    return false;
+#endif
+
+    const char *original_filename = z_binary_get_original_filename(d->binary);
+    char *cache_filename = z_strcat(ANALYSIS_CACHE_PREFIX, original_filename);
+    AnalysisCache *c = z_analysis_cache_load(cache_filename, d->cache_key);
+    z_free(cache_filename);
+
+    if (!c) {
+        return false;
+    }
+
+    size_t text_size = d->text_size;
+
+    // step (1). validate all sections of superset disassembly
+    size_t insts_size = 0, offsets_size = 0, neighbors_size = 0;
+    const SInst *insts =
+        z_analysis_cache_get_section(c, ACACHE_SUPERSET_INSTS, &insts_size);
+    const uint32_t *offsets =
+        z_analysis_cache_get_section(c, ACACHE_OCC_OFFSETS, &offsets_size);
+    const uint32_t *neighbors =
+        z_analysis_cache_get_section(c, ACACHE_OCC_NEIGHBORS, &neighbors_size);
+
+    if (!insts || insts_size != text_size * sizeof(SInst) || !offsets ||
+        offsets_size != (text_size + 1) * sizeof(uint32_t) || !neighbors ||
+        neighbors_size != offsets[text_size] * sizeof(uint32_t)) {
+        z_info("incomplete superset disassembly cache");
+        z_analysis_cache_destroy(c);
+        return false;
+    }
+
+    if (!__disassembler_validate_cache(text_size, insts, offsets, neighbors)) {
+        z_warn("corrupted superset disassembly cache, rebuild it");
+        z_analysis_cache_destroy(c);
+        return false;
+    }
+
+    // step (2). restore UCFG analysis
+    if (!z_ucfg_analyzer_load_cache(d->ucfg_analyzer, c)) {
+        // drop the partially restored state
+        z_ucfg_analyzer_destroy(d->ucfg_analyzer);
+        d->ucfg_analyzer = z_ucfg_analyzer_create(d->binary, d->opts);
+        z_analysis_cache_destroy(c);
+        return false;
+    }
+
+    // step (3). restore superset disassembly and occluded index
+    memcpy(d->superset_insts, insts, insts_size);
+
+    d->occ_offsets = z_alloc(text_size + 1, sizeof(uint32_t));
+    memcpy(d->occ_offsets, offsets, offsets_size);
+    d->occ_neighbors = z_alloc(offsets[text_size] + 1, sizeof(uint32_t));
+    memcpy(d->occ_neighbors, neighbors, neighbors_size);
+
+    z_analysis_cache_destroy(c);
+
+    z_info("superset disassembly restored from analysis cache");
+    return true;
+}
+
+Z_PRIVATE void __disassembler_store_cache(Disassembler *d) {
+    size_t text_size = d->text_size;
+
+    if (!d->occ_offsets) {
+        __disassembler_build_occluded_index(d);
+    }
+
+    const char *original_filename = z_binary_get_original_filename(d->binary);
+    char *cache_filename = z_strcat(ANALYSIS_CACHE_PREFIX, original_filename);
+    AnalysisCache *c = z_analysis_cache_create(cache_filename, d->cache_key);
+    z_free(cache_filename);
+
+    z_analysis_cache_add_section(c, ACACHE_SUPERSET_INSTS, d->superset_insts,
+                                 text_size * sizeof(SInst));
+    z_analysis_cache_add_section(c, ACACHE_OCC_OFFSETS, d->occ_offsets,
+                                 (text_size + 1) * sizeof(uint32_t));
+    z_analysis_cache_add_section(c, ACACHE_OCC_NEIGHBORS, d->occ_neighbors,
+                                 d->occ_offsets[text_size] * sizeof(uint32_t));
+    z_ucfg_analyzer_store_cache(d->ucfg_analyzer, c);
+
+    z_analysis_cache_store(c);
+    z_analysis_cache_destroy(c);
 }
 
 Z_API Disassembler *z_disassembler_create(Binary *b, SysOptArgs *opts) {
@@ -288,14 +790,14 @@ Z_API Disassembler *z_disassembler_create(Binary *b, SysOptArgs *opts) {
 
     d->binary = b;
 
+    // superset_disasm only caches materialized instructions, which are
+    // allocated from (and released along with) cs_arena
+    d->cs_arena = z_capstone_arena_create(CS_ARENA_CHUNK_SIZE);
     d->superset_disasm =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
-                              (GDestroyNotify)(&__disassembler_free_cs_insn));
-    d->recursive_disasm =
         g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    z_addr_map_init(d->recursive_disasm);
     // recursive_disasm does not free cs_insn, freed by superset_disasm
-    d->linear_disasm =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    z_addr_map_init(d->linear_disasm);
     // linear_disasm does not free cs_insn, freed by superset_disasm
     d->prob_disasm = NULL;
 
@@ -312,27 +814,36 @@ Z_API Disassembler *z_disassembler_create(Binary *b, SysOptArgs *opts) {
     d->text_addr = text->sh_addr;
     d->text_size = text->sh_size;
 
-    // get occluded address
-    z_addr_dict_init(d->occ_addrs, d->text_addr, d->text_size);
-
-    if (d->text_size <= SUPERSET_DISASM_THRESHOLD) {
-        z_info(".text section (%#lx bytes) is suitable for pre-disasm",
-               d->text_size);
-
-        // do not backup .text
-        d->text_backup = NULL;
-
-        __disassembler_superset_disasm(d);
-    } else {
-        z_info(".text section (%#lx bytes) is not suitable for pre-disasm",
-               d->text_size);
+    // occluded address (built lazily)
+    d->occ_offsets = NULL;
+    d->occ_neighbors = NULL;
+    z_addr_map_init(d->occ_patches);
 
-        d->text_backup = z_alloc(d->text_size, sizeof(uint8_t));
+    // backup .text, from which we materialize cs_insn
+    d->text_backup = z_alloc(d->text_size, sizeof(uint8_t));
+    {
         Rptr *ptr = z_elf_vaddr2ptr(e, d->text_addr);
         z_rptr_memcpy(d->text_backup, ptr, d->text_size);
         z_rptr_destroy(ptr);
     }
 
+    // compact records of superset disassembly (all zeros means undecoded)
+    d->superset_insts = z_alloc(d->text_size, sizeof(SInst));
+
+    // the whole .text is superset disassembled in advance
+    // the analysis cache is keyed by the original ELF and the options
+    // which affect UCFG analysis
+    const char *original_filename = z_binary_get_original_filename(b);
+    bool key_opts[] = {opts->disable_callthrough, opts->disable_opt};
+    d->cache_key = z_analysis_cache_hash_file(0, original_filename);
+    d->cache_key =
+        z_analysis_cache_hash(d->cache_key, key_opts, sizeof(key_opts));
+
+    if (!__disassembler_load_cache(d)) {
+        __disassembler_superset_disasm(d);
+        __disassembler_store_cache(d);
+    }
+
     d->enable_pdisasm =
         (!d->opts->force_linear) &&
         (d->opts->force_pdisasm || __disassembler_has_inlined_data(d));
@@ -347,17 +858,21 @@ Z_API void z_disassembler_destroy(Disassembler *d) {
     __disassembler_invoke_prob_disasm(d, __disassembler_pdisasm_destroy, d);
 
     g_hash_table_destroy(d->superset_disasm);
-    g_hash_table_destroy(d->recursive_disasm);
-    g_hash_table_destroy(d->linear_disasm);
+    z_addr_map_destroy(d->recursive_disasm);
+    z_addr_map_destroy(d->linear_disasm);
+    z_capstone_arena_destroy(d->cs_arena);
 
-    if (d->text_backup) {
-        z_free(d->text_backup);
-    }
+    z_free(d->superset_insts);
+    z_free(d->text_backup);
 
     g_hash_table_destroy(d->potential_insts);
     g_hash_table_destroy(d->potential_blocks);
 
-    z_addr_dict_destroy(d->occ_addrs, &z_buffer_destroy);
+    if (d->occ_offsets) {
+        z_free(d->occ_offsets);
+        z_free(d->occ_neighbors);
+    }
+    z_addr_map_destroy(d->occ_patches, &z_buffer_destroy);
 
     z_ucfg_analyzer_destroy(d->ucfg_analyzer);
 
@@ -481,9 +996,7 @@ Z_API GQueue *z_disassembler_linear_disasm(Disassembler *d) {
                 cs_insn *inst =
                     z_disassembler_get_superset_disasm(d, inst_addr);
                 assert(inst);
-                g_hash_table_insert(d->linear_disasm,
-                                    GSIZE_TO_POINTER(inst_addr),
-                                    (gpointer)inst);
+                z_addr_map_set(d->linear_disasm, inst_addr, inst);
                 g_hash_table_insert(d->potential_insts,
                                     GSIZE_TO_POINTER(inst_addr),
                                     (gpointer)inst);
@@ -501,7 +1014,7 @@ Z_API GQueue *z_disassembler_linear_disasm(Disassembler *d) {
     g_queue_free(tmp_insts);
 
     z_info("we have %ld instruction linearly disassemblied",
-           g_hash_table_size(d->linear_disasm));
+           z_addr_map_get_size(d->linear_disasm));
 
     z_info("with %ld basic block entrys", g_queue_get_length(bbs));
 
@@ -568,8 +1081,7 @@ Z_API GQueue *z_disassembler_recursive_disasm(Disassembler *d, addr_t addr) {
             // [4]. add into recursive_disasm and update potential instruction
             inst = tmp;
             z_trace("recursive disassembly " CS_SHOW_INST(inst));
-            g_hash_table_insert(d->recursive_disasm, GSIZE_TO_POINTER(cur_addr),
-                                (gpointer)inst);
+            z_addr_map_set(d->recursive_disasm, cur_addr, inst);
             g_hash_table_insert(d->potential_insts, GSIZE_TO_POINTER(cur_addr),
                                 (gpointer)inst);
 
@@ -617,7 +1129,7 @@ Z_API GQueue *z_disassembler_recursive_disasm(Disassembler *d, addr_t addr) {
     z_info("number of new basic blocks      : %ld",
            g_queue_get_length(new_bbs));
     z_info("number of rewritten instructions: %ld",
-           g_hash_table_size(d->recursive_disasm));
+           z_addr_map_get_size(d->recursive_disasm));
 
     return new_bbs;
 }
@@ -637,25 +1149,53 @@ Z_API const cs_insn *z_disassembler_update_superset_disasm(Disassembler *d,
         EXITME("try to re-disasm a validated address: %#lx", addr);
     }
 
+    // the original instruction is necessary for UCFG_Analyzer to check
+    // consistency
+    const cs_insn *ori_inst = NULL;
+    size_t ori_size = 0;
+    if (z_sinst_is(d->superset_insts + (addr - text_addr), DECODED)) {
+        ori_inst = z_disassembler_get_superset_disasm(d, addr);
+        ori_size = d->superset_insts[addr - text_addr].size;
+    }
+
+    // XXX: text_backup will be updated, so we need to materialize all decoded
+    // instructions overlapping with addr first. Otherwise, they may be
+    // re-decoded from the updated bytes, which conflicts their records.
+    for (addr_t occ_addr = (addr - text_addr >= 14 ? addr - 14 : text_addr);
+         occ_addr < addr + 15 && occ_addr < text_addr + text_size;
+         occ_addr++) {
+        const SInst *occ_inst = d->superset_insts + (occ_addr - text_addr);
+        if (occ_addr != addr && occ_inst->size &&
+            occ_addr + occ_inst->size > addr) {
+            z_disassembler_get_superset_disasm(d, occ_addr);
+        }
+    }
+
     ELF *e = z_binary_get_elf(d->binary);
     Rptr *ptr = z_elf_vaddr2ptr(e, addr);
+    CSArena *prev_arena = z_capstone_arena_switch(d->cs_arena);
     CS_DISASM(ptr, addr, 1);
+    z_capstone_arena_switch(prev_arena);
     if (cs_count == 1) {
         // update superset disassembly
         // XXX: the z_ucfg_analyzer_add_inst must be placed before
-        // g_hash_table_insert, as the g_hash_table_insert may free the original
-        // instruction
-        z_ucfg_analyzer_add_inst(d->ucfg_analyzer, addr, cs_inst, true);
+        // g_hash_table_insert, as the g_hash_table_insert will replace the
+        // original instruction
+        z_ucfg_analyzer_add_inst(d->ucfg_analyzer, addr, cs_inst, ori_inst);
+        __disassembler_fill_superset_inst(d, addr, cs_inst);
         g_hash_table_insert(d->superset_disasm, GSIZE_TO_POINTER(addr),
                             (gpointer)cs_inst);
         res = cs_inst;
 
-        // update backup
-        if (d->text_backup) {
-            size_t off = addr - text_addr;
-            memcpy(d->text_backup + off, res->bytes, res->size);
+        // the occluded index is out of date if the size changes
+        if (ori_size != res->size) {
+            __disassembler_update_occluded_index(d, addr - text_addr);
         }
 
+        // update backup
+        size_t off = addr - text_addr;
+        memcpy(d->text_backup + off, res->bytes, res->size);
+
         cs_inst = NULL;  // avoid double free
     } else {
         EXITME("invalid instruction at %#lx", addr);
@@ -666,48 +1206,57 @@ Z_API const cs_insn *z_disassembler_update_superset_disasm(Disassembler *d,
     return res;
 }
 
+Z_API const SInst *z_disassembler_get_superset_inst(Disassembler *d,
+                                                   addr_t addr) {
+    // we only consider code in .text
+    if (addr < d->text_addr || addr >= d->text_addr + d->text_size) {
+        return NULL;
+    }
+
+    // XXX: the whole .text is superset disassembled in advance
+    SInst *sinst = d->superset_insts + (addr - d->text_addr);
+    assert(z_sinst_is(sinst, DECODED));
+
+    return sinst->size ? sinst : NULL;
+}
+
 Z_API cs_insn *z_disassembler_get_superset_disasm(Disassembler *d,
                                                   addr_t addr) {
+    const SInst *sinst = z_disassembler_get_superset_inst(d, addr);
+    if (!sinst) {
+        return NULL;
+    }
+
     cs_insn *inst = (cs_insn *)g_hash_table_lookup(d->superset_disasm,
                                                    GSIZE_TO_POINTER(addr));
+    if (inst) {
+        return inst;
+    }
 
-    // check whether we need to update superset disasm
-    if (d->text_backup && (!inst)) {
-        // step(1). check addr in .text (we only consider code in .text)
-        addr_t text_addr = d->text_addr;
-        size_t text_size = d->text_size;
-        if (addr < text_addr || addr >= text_addr + text_size) {
-            return NULL;
-        }
-
-        // step(2). disasm non-disassembled instruction
-        size_t off1 = addr - text_addr;
-        size_t off2 = text_size - off1;
-        CS_DISASM_RAW(d->text_backup + off1, off2, addr, 1);
-        if (cs_count == 1) {
-            z_ucfg_analyzer_add_inst(d->ucfg_analyzer, addr, cs_inst, false);
-            g_hash_table_insert(d->superset_disasm, GSIZE_TO_POINTER(addr),
-                                (gpointer)cs_inst);
-
-            z_trace("superset disassembly " CS_SHOW_INST(cs_inst));
-
-            inst = (cs_insn *)cs_inst;
-            cs_inst = NULL;  // avoid double free
-        }
+    // materialize the full instruction from the unpatched .text
+    size_t off = addr - d->text_addr;
+    CSArena *prev_arena = z_capstone_arena_switch(d->cs_arena);
+    CS_DISASM_RAW(d->text_backup + off, sinst->size, addr, 1);
+    z_capstone_arena_switch(prev_arena);
+    if (cs_count != 1 || cs_inst->size != sinst->size) {
+        EXITME("inconsistent superset disassembly at %#lx", addr);
     }
 
+    inst = (cs_insn *)cs_inst;
+    cs_inst = NULL;  // avoid double free
+    g_hash_table_insert(d->superset_disasm, GSIZE_TO_POINTER(addr),
+                        (gpointer)inst);
+
     return inst;
 }
 
 Z_API cs_insn *z_disassembler_get_recursive_disasm(Disassembler *d,
                                                    addr_t addr) {
-    return (cs_insn *)g_hash_table_lookup(d->recursive_disasm,
-                                          GSIZE_TO_POINTER(addr));
+    return z_addr_map_get(d->recursive_disasm, addr);
 }
 
 Z_API cs_insn *z_disassembler_get_linear_disasm(Disassembler *d, addr_t addr) {
-    return (cs_insn *)g_hash_table_lookup(d->linear_disasm,
-                                          GSIZE_TO_POINTER(addr));
+    return z_addr_map_get(d->linear_disasm, addr);
 }
 
 Z_API bool z_disassembler_is_potential_block_entrypoint(Disassembler *d,
@@ -724,39 +1273,31 @@ Z_API bool z_disassembler_is_within_disasm_range(Disassembler *d, addr_t addr) {
     return !!(addr >= d->text_addr && addr < (d->text_addr + d->text_size));
 }
 
-Z_API Buffer *z_disassembler_get_occluded_addrs(Disassembler *d, addr_t addr) {
-    cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
-    if (!inst) {
-        return NULL;
+Z_API bool z_disassembler_get_occluded_addrs(Disassembler *d, addr_t addr,
+                                             const uint32_t **occ_offs,
+                                             size_t *occ_n) {
+    if (!z_disassembler_get_superset_inst(d, addr)) {
+        *occ_offs = NULL;
+        *occ_n = 0;
+        return false;
     }
 
-    if (!z_addr_dict_exist(d->occ_addrs, addr)) {
-        // occluded address hasn't been analyzed
-        z_addr_dict_set(d->occ_addrs, addr, z_buffer_create(NULL, 0));
-
-        // note that the longest x86/64 instruction is 15-bytes
-        for (addr_t occ_addr = addr - 14; occ_addr < addr + inst->size;
-             occ_addr++) {
-            cs_insn *occ_inst = z_disassembler_get_superset_disasm(d, occ_addr);
-            if (!occ_inst) {
-                continue;
-            }
+    size_t off = addr - d->text_addr;
 
-            if (occ_addr < addr && occ_addr + occ_inst->size > addr) {
-                goto SUCC;
-            }
-            if (occ_addr > addr && addr + inst->size > occ_addr) {
-                goto SUCC;
-            }
-            continue;
+    assert(d->occ_offsets);
 
-        SUCC:
-            z_buffer_append_raw(z_addr_dict_get(d->occ_addrs, addr),
-                                (uint8_t *)&occ_addr, sizeof(occ_addr));
+    if (z_unlikely(z_addr_map_get_size(d->occ_patches))) {
+        Buffer *buf = z_addr_map_get(d->occ_patches, off);
+        if (buf) {
+            *occ_offs = (const uint32_t *)z_buffer_get_raw_buf(buf);
+            *occ_n = z_buffer_get_size(buf) / sizeof(uint32_t);
+            return true;
         }
     }
 
-    return z_addr_dict_get(d->occ_addrs, addr);
+    *occ_offs = d->occ_neighbors + d->occ_offsets[off];
+    *occ_n = d->occ_offsets[off + 1] - d->occ_offsets[off];
+    return true;
 }
 
 Z_API bool z_disassembler_fully_support_prob_disasm(Disassembler *d) {
@@ -766,11 +1307,6 @@ Z_API bool z_disassembler_fully_support_prob_disasm(Disassembler *d) {
 #define __DISASSEMBLER_DECLARE_SUCC_AND_PRED(etype, rtype)                    \
     Z_API Buffer *z_disassembler_get_##etype##_##rtype(Disassembler *d,       \
                                                        addr_t addr) {         \
-        /* force superset disasm */                                           \
-        if (d->text_backup) {                                                 \
-            z_disassembler_get_superset_disasm(d, addr);                      \
-        }                                                                     \
-                                                                              \
         return z_ucfg_analyzer_get_##etype##_##rtype(d->ucfg_analyzer, addr); \
     }
 
@@ -782,3 +1318,18 @@ __DISASSEMBLER_DECLARE_SUCC_AND_PRED(all, predecessors);
 __DISASSEMBLER_DECLARE_SUCC_AND_PRED(all, successors);
 
 #undef __DISASSEMBLER_DECLARE_SUCC_AND_PRED
+
+#define __DISASSEMBLER_DECLARE_PEEK(etype, rtype)                              \
+    Z_API UEdgeSpan z_disassembler_peek_##etype##_##rtype(Disassembler *d,     \
+                                                          addr_t addr) {       \
+        return z_ucfg_analyzer_peek_##etype##_##rtype(d->ucfg_analyzer, addr); \
+    }
+
+__DISASSEMBLER_DECLARE_PEEK(direct, predecessors);
+__DISASSEMBLER_DECLARE_PEEK(direct, successors);
+__DISASSEMBLER_DECLARE_PEEK(intra, predecessors);
+__DISASSEMBLER_DECLARE_PEEK(intra, successors);
+__DISASSEMBLER_DECLARE_PEEK(all, predecessors);
+__DISASSEMBLER_DECLARE_PEEK(all, successors);
+
+#undef __DISASSEMBLER_DECLARE_PEEK
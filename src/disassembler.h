@@ -20,8 +20,10 @@
 #define __DISASSEMBLER_H
 
 #include "address_dictionary.h"
+#include "address_map.h"
 #include "binary.h"
 #include "buffer.h"
+#include "capstone_.h"
 #include "config.h"
 #include "interval_splay.h"
 #include "sys_optarg.h"
@@ -30,6 +32,42 @@
 #include <capstone/capstone.h>
 #include <gmodule.h>
 
+/*
+ * Class of superset-disassembled instructions
+ */
+typedef enum superset_inst_class_t {
+    SINST_DECODED = (1UL << 0),  // address is already superset-disassembled
+    SINST_CALL = (1UL << 1),
+    SINST_JMP = (1UL << 2),
+    SINST_CJMP = (1UL << 3),
+    SINST_LOOP = (1UL << 4),
+    SINST_XBEGIN = (1UL << 5),
+    SINST_RET = (1UL << 6),
+    SINST_TERMINATOR = (1UL << 7),
+    SINST_RARE = (1UL << 8),
+    SINST_DIRECT = (1UL << 9),  // control flow transfer with an imm target
+} SInstClass;
+
+/*
+ * Compact record of superset disassembly, which is stored in a dense array
+ * indexed by (addr - text_addr). The full cs_insn is only materialized when
+ * z_disassembler_get_superset_disasm is called.
+ */
+typedef struct superset_inst_t {
+    uint16_t id;         // x86_insn
+    uint16_t cls;        // SInstClass
+    uint16_t gpr_read;   // GPRState
+    uint16_t gpr_write;  // GPRState
+    uint8_t size;        // 0 means an invalid instruction
+    uint8_t flg_read;    // FLGState
+    uint8_t flg_write;   // FLGState
+    int32_t target;      // direct target (relative to the address)
+} SInst;
+
+#define z_sinst_is(sinst, type) (!!((sinst)->cls & SINST_##type))
+
+#define z_sinst_get_target(sinst, addr) ((addr_t)((addr) + (sinst)->target))
+
 STRUCT(Disassembler, {
     // Binary which needs disassembly
     Binary *binary;
@@ -37,20 +75,31 @@ STRUCT(Disassembler, {
     // .text info
     addr_t text_addr;
     size_t text_size;
-    uint8_t *text_backup;
+    uint8_t *text_backup;  // unpatched .text, used to materialize cs_insn
 
     // Disassembly
-    GHashTable *superset_disasm;
-    GHashTable *recursive_disasm;
-    GHashTable *linear_disasm;
+    SInst *superset_insts;
+    GHashTable *superset_disasm;  // materialized cs_insn of superset_insts
+    CSArena *cs_arena;            // where superset_disasm's cs_insn live
+    AddrMap(cs_insn *, recursive_disasm);
+    AddrMap(cs_insn *, linear_disasm);
     PhantomType *prob_disasm;
 
-    // Occluded address
-    AddrDictFast(Buffer *, occ_addrs);
+    // Occluded address, which is encoded as CSR: the occluded instructions of
+    // (text_addr + off) are occ_neighbors[occ_offsets[off]:occ_offsets[off+1]]
+    // (as offsets to .text).
+    uint32_t *occ_offsets;
+    uint32_t *occ_neighbors;
+    // Entries updated by re-disassembly (offset -> Buffer of uint32_t), which
+    // override the full index
+    AddrMap(Buffer *, occ_patches);
 
     // Pdisasm enable?
     bool enable_pdisasm;
 
+    // Key of the analysis cache (0 means the cache is disabled)
+    uint64_t cache_key;
+
     /*
      * Potential information.
      * These information is collected by linear and recursive disassembly. But
@@ -127,9 +176,13 @@ Z_API const cs_insn *z_disassembler_update_superset_disasm(Disassembler *d,
                                                            addr_t addr);
 
 /*
- * Show the occludeds addresses of a given address
+ * Show the occludeds addresses of a given address. *occ_offs is set as a
+ * packed array of *occ_n offsets (to .text), and false is returned if addr is
+ * not a valid instruction.
  */
-Z_API Buffer *z_disassembler_get_occluded_addrs(Disassembler *d, addr_t addr);
+Z_API bool z_disassembler_get_occluded_addrs(Disassembler *d, addr_t addr,
+                                             const uint32_t **occ_offs,
+                                             size_t *occ_n);
 
 /*
  * Recursive disassemble from given address
@@ -161,6 +214,13 @@ Z_API cs_insn *z_disassembler_get_recursive_disasm(Disassembler *d,
  */
 Z_API cs_insn *z_disassembler_get_superset_disasm(Disassembler *d, addr_t addr);
 
+/*
+ * Get the compact record of superset disasm (NULL if addr is not a valid
+ * instruction). It is much cheaper than z_disassembler_get_superset_disasm.
+ */
+Z_API const SInst *z_disassembler_get_superset_inst(Disassembler *d,
+                                                   addr_t addr);
+
 /*
  * Check whether address is a potential potential entrypoint
  */
@@ -191,4 +251,20 @@ __DISASSEMBLER_DEFINE_SUCC_AND_PRED(all, successors);
 
 #undef __DISASSEMBLER_DEFINE_SUCC_AND_PRED
 
+/*
+ * Zero-copy versions of above getters (refer to ucfg_analyzer.h)
+ */
+#define __DISASSEMBLER_DEFINE_PEEK(etype, rtype)                           \
+    Z_API UEdgeSpan z_disassembler_peek_##etype##_##rtype(Disassembler *d, \
+                                                          addr_t addr)
+
+__DISASSEMBLER_DEFINE_PEEK(direct, predecessors);
+__DISASSEMBLER_DEFINE_PEEK(direct, successors);
+__DISASSEMBLER_DEFINE_PEEK(intra, predecessors);
+__DISASSEMBLER_DEFINE_PEEK(intra, successors);
+__DISASSEMBLER_DEFINE_PEEK(all, predecessors);
+__DISASSEMBLER_DEFINE_PEEK(all, successors);
+
+#undef __DISASSEMBLER_DEFINE_PEEK
+
 #endif
@@ -227,6 +227,17 @@ Z_PRIVATE void __elf_setup_shared_text(ELF *e, const char *filename);
  */
 Z_PRIVATE void __elf_setup_pipe(ELF *e, const char *filename);
 
+/*
+ * Get the size of the window which the client reserves for an extendable
+ * stream
+ */
+Z_PRIVATE size_t __elf_get_stream_window_size(ELF *e, _MEM_FILE *stream);
+
+/*
+ * Extend an extendable stream to at least min_size, geometrically
+ */
+Z_PRIVATE void __elf_extend_stream(ELF *e, _MEM_FILE *stream, size_t min_size);
+
 // TODO: raw pointer might lead to overflow, but we need effecience.
 // In the furture, we need a better trade-off.
 // Currently, we have checked the access will not be out of boundary in advance.
@@ -648,6 +659,41 @@ Z_PRIVATE void __elf_extend_zones(ELF *e) {
     z_mem_file_pwrite(e->stream, "", 1, offset - 1);
 }
 
+Z_PRIVATE size_t __elf_get_stream_window_size(ELF *e, _MEM_FILE *stream) {
+    if (stream == e->trampolines_stream) {
+        return SHADOW_CODE_WINDOW_SIZE;
+    } else if (stream == e->retaddr_mapping_stream) {
+        return RETADDR_MAPPING_WINDOW_SIZE;
+    } else {
+        EXITME("unknown extendable stream: %s",
+               z_mem_file_get_filename(stream));
+        return 0;
+    }
+}
+
+Z_PRIVATE void __elf_extend_stream(ELF *e, _MEM_FILE *stream, size_t min_size) {
+    size_t window_size = __elf_get_stream_window_size(e, stream);
+    size_t new_size = z_mem_file_get_size(stream);
+    if (new_size >= min_size) {
+        return;
+    }
+
+    // step (1). double the size, so that the stream is extended only
+    // logarithmic times
+    while (new_size < min_size) {
+        new_size <<= 1;
+    }
+
+    // step (2). do not go beyond the window unless we have to, otherwise the
+    // client needs an unnecessary remapping
+    if (new_size > window_size && min_size <= window_size) {
+        new_size = window_size;
+    }
+
+    // step (3). extend the stream (the new pages are sparse)
+    z_mem_file_pwrite(stream, "", 1, new_size - 1);
+}
+
 Z_PRIVATE Snode *__elf_find_segment_by_vaddr(ELF *e, addr_t vaddr) {
     Snode *segment = z_splay_search(e->vmapping, vaddr);
     if (segment == NULL) {
@@ -1765,20 +1811,20 @@ Z_API size_t z_elf_write(ELF *e, addr_t addr, size_t n, const void *buf) {
         // get old size
         size_t old_size = z_mem_file_get_size(underlying_stream) - tp_off;
 
+        if (write_off + n >= z_mem_file_get_size(underlying_stream)) {
+            // XXX: if the underlying stream is (going to be) fully written, we
+            // need to extend it. For example, if the original address range is
+            // [0x1000, 0x1100) and we wrote all the 0x100 bytes, next time we
+            // want to write on address 0x1100. It sould be valid because the
+            // underlying stream is extendable.
+            __elf_extend_stream(e, underlying_stream, write_off + n + 1);
+            assert(write_off + n < z_mem_file_get_size(underlying_stream));
+        }
+
         // We cannot directly use __elf_stream_vaddr2off here, as addr may not
         // in current virtual memroy.
         z_mem_file_pwrite(underlying_stream, buf, n, write_off);
 
-        if (write_off + n == z_mem_file_get_size(underlying_stream)) {
-            // XXX: if the underlying stream is fully written, we need to extend
-            // it. For example, if the original address range is [0x1000,
-            // 0x1100) and we wrote all the 0x100 bytes, next time we want to
-            // write on address 0x1100. It sould be valid because the underlying
-            // stream is extendable.
-            z_mem_file_pwrite(underlying_stream, "", 1, write_off + n);
-            assert(write_off + n < z_mem_file_get_size(underlying_stream));
-        }
-
         // calculate new node
         size_t new_size = z_mem_file_get_size(underlying_stream) - tp_off;
 
@@ -1807,8 +1853,11 @@ Z_API size_t z_elf_write(ELF *e, addr_t addr, size_t n, const void *buf) {
                 EXITME("extend writing");
             }
 
-            // update state
-            z_elf_set_state(e, ELFSTATE_SHADOW_EXTENDED);
+            // update state (only if the client needs to remap it)
+            if (tp_off + new_size >
+                __elf_get_stream_window_size(e, underlying_stream)) {
+                z_elf_set_state(e, ELFSTATE_SHADOW_EXTENDED);
+            }
         }
     } else {
         // other range
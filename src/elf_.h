@@ -34,7 +34,7 @@
 typedef enum elf_state_t {
     ELFSTATE_NONE = 0x0,             // none
     ELFSTATE_CONNECTED = 0x1,        // disconnect ELF from underlying file
-    ELFSTATE_SHADOW_EXTENDED = 0x2,  // shadow file is extended
+    ELFSTATE_SHADOW_EXTENDED = 0x2,  // shadow file outgrows its window
     ELFSTATE_DISABLE = 0x100,        // flag for disable state
     ELFSTATE_MASK = 0xffff,          // mask
 } ELFState;
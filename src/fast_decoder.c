@@ -0,0 +1,355 @@
+/*
+ * fast_decoder.c
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fast_decoder.h"
+#include "utils.h"
+
+/*
+ * Opcode flags
+ */
+#define __F_MODRM (1 << 0)    // has ModRM (and optional SIB/displacement)
+#define __F_IMM8 (1 << 1)     // 8-bit immediate
+#define __F_IMM16 (1 << 2)    // 16-bit immediate
+#define __F_IMMZ (1 << 3)     // 16/32-bit immediate (by operand size)
+#define __F_IMMV (1 << 4)     // 16/32/64-bit immediate (by operand size)
+#define __F_MOFFS (1 << 5)    // 32/64-bit memory offset (by address size)
+#define __F_PREFIX (1 << 6)   // legacy prefix
+#define __F_INVALID (1 << 7)  // invalid in 64-bit mode
+#define __F_UNKNOWN (1 << 8)  // left to capstone
+#define __F_REL (1 << 9)      // relative branch (operand size matters)
+
+#define N 0
+#define M __F_MODRM
+#define I8 __F_IMM8
+#define I16 __F_IMM16
+#define IZ __F_IMMZ
+#define IV __F_IMMV
+#define MO __F_MOFFS
+#define P __F_PREFIX
+#define X __F_INVALID
+#define U __F_UNKNOWN
+#define R __F_REL
+
+// XXX: 0x0f (escape), 0x40-0x4f (REX), 0x62/0xc4/0xc5 (EVEX/VEX), and 0x8f
+// (XOP) are handled separately
+static const uint16_t __one_byte_table[256] = {
+    /* 0x00 */ M, M, M, M, I8, IZ, X, X, M, M, M, M, I8, IZ, X, N,
+    /* 0x10 */ M, M, M, M, I8, IZ, X, X, M, M, M, M, I8, IZ, X, X,
+    /* 0x20 */ M, M, M, M, I8, IZ, P, X, M, M, M, M, I8, IZ, P, X,
+    /* 0x30 */ M, M, M, M, I8, IZ, P, X, M, M, M, M, I8, IZ, P, X,
+    /* 0x40 */ N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+    /* 0x50 */ N, N, N, N, N, N, N, N, N, N, N, N, N, N, N, N,
+    /* 0x60 */ X, X, U, M, P, P, P, P, IZ, M | IZ, I8, M | I8, N, N, N, N,
+    /* 0x70 */ I8 | R, I8 | R, I8 | R, I8 | R, I8 | R, I8 | R, I8 | R,
+    I8 | R, I8 | R, I8 | R, I8 | R, I8 | R, I8 | R, I8 | R, I8 | R, I8 | R,
+    /* 0x80 */ M | I8, M | IZ, X, M | I8, M, M, M, M, M, M, M, M, M, M, M, M,
+    /* 0x90 */ N, N, N, N, N, N, N, N, N, N, X, N, N, N, N, N,
+    /* 0xa0 */ MO, MO, MO, MO, N, N, N, N, I8, IZ, N, N, N, N, N, N,
+    /* 0xb0 */ I8, I8, I8, I8, I8, I8, I8, I8, IV, IV, IV, IV, IV, IV, IV, IV,
+    /* 0xc0 */ M | I8, M | I8, I16, N, U, U, M | I8, M | IZ, I16 | I8, N, I16,
+    N, N, I8, X, N,
+    /* 0xd0 */ M, M, M, M, X, X, X, N, M, M, M, M, M, M, M, M,
+    /* 0xe0 */ I8 | R, I8 | R, I8 | R, I8 | R, I8, I8, I8, I8, IZ | R, IZ | R,
+    X, I8 | R, N, N, N, N,
+    /* 0xf0 */ P, N, P, P, N, N, M, M, N, N, N, N, N, N, M, M,
+};
+
+// XXX: 0x0f 0x38 and 0x0f 0x3a (three-byte opcodes) are handled separately
+static const uint16_t __two_byte_table[256] = {
+    /* 0x00 */ M, M, M, M, U, N, N, N, N, N, U, N, U, M, N, M | I8,
+    /* 0x10 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+    /* 0x20 */ M, M, M, M, U, U, U, U, M, M, M, M, M, M, M, M,
+    /* 0x30 */ N, N, N, N, N, N, U, N, N, U, N, U, U, U, U, U,
+    /* 0x40 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+    /* 0x50 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+    /* 0x60 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+    /* 0x70 */ M | I8, M | I8, M | I8, M | I8, M, M, M, N, M, M, U, U, M, M,
+    M, M,
+    /* 0x80 */ IZ | R, IZ | R, IZ | R, IZ | R, IZ | R, IZ | R, IZ | R, IZ | R,
+    IZ | R, IZ | R, IZ | R, IZ | R, IZ | R, IZ | R, IZ | R, IZ | R,
+    /* 0x90 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+    /* 0xa0 */ N, N, N, M, M | I8, M, U, U, N, N, N, M, M | I8, M, M, M,
+    /* 0xb0 */ M, M, M, M, M, M, M, M, M, M, M | I8, M, M, M, M, M,
+    /* 0xc0 */ M, M, M | I8, M, M | I8, M | I8, M | I8, M, N, N, N, N, N, N,
+    N, N,
+    /* 0xd0 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+    /* 0xe0 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+    /* 0xf0 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, U,
+};
+
+#undef N
+#undef M
+#undef I8
+#undef I16
+#undef IZ
+#undef IV
+#undef MO
+#undef P
+#undef X
+#undef U
+#undef R
+
+/*
+ * Check the opcode extension (ModRM.reg) of one-byte opcodes, return false if
+ * it is invalid
+ */
+Z_PRIVATE bool __fast_decoder_check_group(uint8_t opcode, uint8_t modrm);
+
+/*
+ * Get the class of a one-byte opcode
+ */
+Z_PRIVATE FInstClass __fast_decoder_get_class(uint8_t opcode, uint8_t modrm);
+
+Z_PRIVATE bool __fast_decoder_check_group(uint8_t opcode, uint8_t modrm) {
+    uint8_t mod = modrm >> 6;
+    uint8_t reg = (modrm >> 3) & 7;
+
+    switch (opcode) {
+        case 0x8d:
+            // lea requires a memory operand
+            return mod != 3;
+        case 0xc6:
+        case 0xc7:
+            // mov /0, and xabort/xbegin /7
+            return reg == 0 || reg == 7;
+        case 0xfe:
+            // inc/dec only
+            return reg < 2;
+        case 0xff:
+            // far call/jmp require a memory operand
+            if (reg == 3 || reg == 5) {
+                return mod != 3;
+            }
+            return reg != 7;
+        default:
+            return true;
+    }
+}
+
+Z_PRIVATE FInstClass __fast_decoder_get_class(uint8_t opcode, uint8_t modrm) {
+    if (opcode >= 0x70 && opcode <= 0x7f) {
+        return FINST_CJMP;
+    }
+
+    switch (opcode) {
+        case 0xe0:
+        case 0xe1:
+        case 0xe2:
+            return FINST_LOOP;
+        case 0xe3:
+            return FINST_CJMP;
+        case 0xe8:
+            return FINST_CALL;
+        case 0xe9:
+        case 0xeb:
+            return FINST_JMP;
+        case 0xc2:
+        case 0xc3:
+            return FINST_RET;
+        case 0xf4:
+            return FINST_HLT;
+        case 0xc7:
+            return (modrm == 0xf8 ? FINST_XBEGIN : FINST_NORMAL);
+        case 0xff:
+            switch ((modrm >> 3) & 7) {
+                case 2:
+                case 3:
+                    return FINST_CALL;
+                case 4:
+                case 5:
+                    return FINST_JMP;
+                default:
+                    return FINST_NORMAL;
+            }
+        default:
+            return FINST_NORMAL;
+    }
+}
+
+Z_API FDecStatus z_fast_decoder_decode(const uint8_t *code, size_t size,
+                                       FastInst *inst) {
+    if (size > FDEC_MAX_INST_LEN) {
+        size = FDEC_MAX_INST_LEN;
+    }
+
+    size_t cur = 0;
+    bool has_prefix = false;
+    bool opsize = false;   // 0x66
+    bool adsize = false;   // 0x67
+    bool repne = false;    // 0xf2
+    uint8_t rex = 0;
+
+    /*
+     * step (1). legacy prefixes and REX
+     */
+    while (true) {
+        if (cur >= size) {
+            return FDEC_UNKNOWN;
+        }
+
+        uint8_t b = code[cur];
+        if (__one_byte_table[b] & __F_PREFIX) {
+            if (rex) {
+                // XXX: a REX followed by legacy prefixes is ignored by CPU,
+                // but we leave such rare cases to capstone
+                return FDEC_UNKNOWN;
+            }
+            has_prefix = true;
+            opsize |= (b == 0x66);
+            adsize |= (b == 0x67);
+            repne |= (b == 0xf2);
+            cur++;
+        } else if ((b & 0xf0) == 0x40) {
+            if (rex) {
+                return FDEC_UNKNOWN;
+            }
+            rex = b;
+            cur++;
+        } else {
+            break;
+        }
+    }
+    bool rex_w = !!(rex & 0x08);
+
+    /*
+     * step (2). opcode
+     */
+    bool one_byte = false;
+    uint8_t opcode = code[cur++];
+    uint16_t flags = 0;
+
+    if (opcode == 0x0f) {
+        if (cur >= size) {
+            return FDEC_UNKNOWN;
+        }
+        uint8_t opcode2 = code[cur++];
+
+        if (opcode2 == 0x38 || opcode2 == 0x3a) {
+            // three-byte opcodes always have ModRM (and imm8 for 0x3a)
+            if (cur >= size) {
+                return FDEC_UNKNOWN;
+            }
+            cur++;
+            flags = __F_MODRM | (opcode2 == 0x3a ? __F_IMM8 : 0);
+        } else {
+            flags = __two_byte_table[opcode2];
+            if ((opcode2 == 0x78 || opcode2 == 0x79) && (opsize || repne)) {
+                // SSE4a extrq/insertq
+                return FDEC_UNKNOWN;
+            }
+        }
+    } else if (opcode == 0x62 || opcode == 0xc4 || opcode == 0xc5) {
+        // EVEX/VEX
+        return FDEC_UNKNOWN;
+    } else if (opcode == 0x8f && (cur >= size || (code[cur] & 0x38))) {
+        // XOP
+        return FDEC_UNKNOWN;
+    } else {
+        one_byte = true;
+        flags = __one_byte_table[opcode];
+    }
+
+    if (flags & __F_UNKNOWN) {
+        return FDEC_UNKNOWN;
+    }
+    if (flags & __F_INVALID) {
+        // XXX: prefixed invalid opcodes are left to capstone, as capstone may
+        // handle prefixes in a different way
+        return (has_prefix || rex) ? FDEC_UNKNOWN : FDEC_INVALID;
+    }
+    if ((flags & __F_REL) && opsize) {
+        // the operand size of near branches differs among implementations
+        return FDEC_UNKNOWN;
+    }
+
+    /*
+     * step (3). ModRM, SIB and displacement
+     */
+    uint8_t modrm = 0;
+    if (flags & __F_MODRM) {
+        if (cur >= size) {
+            return FDEC_UNKNOWN;
+        }
+        modrm = code[cur++];
+
+        uint8_t mod = modrm >> 6;
+        uint8_t rm = modrm & 7;
+
+        if (one_byte && !__fast_decoder_check_group(opcode, modrm)) {
+            return (has_prefix || rex) ? FDEC_UNKNOWN : FDEC_INVALID;
+        }
+
+        if (mod != 3) {
+            uint8_t base = rm;
+            if (rm == 4) {
+                if (cur >= size) {
+                    return FDEC_UNKNOWN;
+                }
+                base = code[cur++] & 7;
+            }
+
+            if (mod == 1) {
+                cur += 1;
+            } else if (mod == 2 || base == 5) {
+                // XXX: for mod == 0, rm == 5 is RIP-relative and SIB.base == 5
+                // means no base, both of which come with disp32
+                cur += 4;
+            }
+        }
+
+        // test (f6/f7 /0 and /1) has an immediate
+        if (one_byte && (opcode == 0xf6 || opcode == 0xf7) &&
+            ((modrm >> 3) & 7) < 2) {
+            flags |= (opcode == 0xf6 ? __F_IMM8 : __F_IMMZ);
+        }
+    }
+
+    /*
+     * step (4). immediate
+     */
+    if (flags & __F_IMM8) {
+        cur += 1;
+    }
+    if (flags & __F_IMM16) {
+        cur += 2;
+    }
+    if (flags & __F_IMMZ) {
+        cur += ((opsize && !rex_w) ? 2 : 4);
+    }
+    if (flags & __F_IMMV) {
+        cur += (rex_w ? 8 : (opsize ? 2 : 4));
+    }
+    if (flags & __F_MOFFS) {
+        cur += (adsize ? 4 : 8);
+    }
+
+    // truncated or too long
+    if (cur > size) {
+        return FDEC_UNKNOWN;
+    }
+
+    inst->size = (uint8_t)cur;
+    inst->cls = (one_byte ? __fast_decoder_get_class(opcode, modrm)
+                          : FINST_NORMAL);
+    if (!one_byte && (flags & __F_REL)) {
+        // 0x0f 0x80 - 0x0f 0x8f
+        inst->cls = FINST_CJMP;
+    }
+
+    return FDEC_VALID;
+}
@@ -0,0 +1,67 @@
+/*
+ * fast_decoder.h
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FAST_DECODER_H
+#define __FAST_DECODER_H
+
+#include "config.h"
+
+/*
+ * Fast decoder is a table-driven x86-64 length and opcode-class decoder, which
+ * is the first tier of superset disassembly. It never replaces capstone: it
+ * only tells whether capstone is definitely going to reject an offset, so that
+ * the expensive decoding (with details) can be skipped.
+ *
+ * The decoder is conservative. Anything it is not sure about (e.g., VEX/EVEX/
+ * XOP encodings, unusual prefix combinations, and truncated bytes) is reported
+ * as FDEC_UNKNOWN, and is left to capstone.
+ *
+ * Build with FAST_DECODER=validate to cross-check it against capstone.
+ */
+#define FDEC_MAX_INST_LEN 15
+
+typedef enum fast_decode_status_t {
+    FDEC_UNKNOWN = 0,  // not sure, fall back to capstone
+    FDEC_VALID,        // length and class are decoded
+    FDEC_INVALID,      // capstone will reject it
+} FDecStatus;
+
+typedef enum fast_inst_class_t {
+    FINST_NORMAL = 0,
+    FINST_CALL,    // call / lcall
+    FINST_JMP,     // jmp / ljmp
+    FINST_CJMP,    // jcc / jrcxz / jecxz
+    FINST_LOOP,    // loop / loope / loopne
+    FINST_RET,     // ret
+    FINST_XBEGIN,  // xbegin
+    FINST_HLT,     // hlt
+} FInstClass;
+
+typedef struct fast_inst_t {
+    uint8_t size;
+    FInstClass cls;
+} FastInst;
+
+/*
+ * Decode the instruction at the beginning of code (whose size is size).
+ * FastInst is only filled when FDEC_VALID is returned.
+ */
+Z_API FDecStatus z_fast_decoder_decode(const uint8_t *code, size_t size,
+                                       FastInst *inst);
+
+#endif
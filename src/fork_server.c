@@ -612,6 +612,8 @@ NO_INLINE void fork_server_start(char **envp) {
                 crs_status != CRS_STATUS_NORMAL) {
                 // check remmap
                 if (crs_status == CRS_STATUS_REMMAP) {
+                    // XXX: it only happens when the shadow file (or the
+                    // retaddr mapping) outgrows its reserved window
                     // munmap current shadow file (due to the different size)
                     if (sys_munmap(RW_PAGE_INFO(shadow_base),
                                    RW_PAGE_INFO(shadow_size))) {
@@ -620,7 +622,8 @@ NO_INLINE void fork_server_start(char **envp) {
                     // remmap it
                     RW_PAGE_INFO(shadow_size) = utils_mmap_external_file(
                         RW_PAGE_INFO(shadow_path), false,
-                        RW_PAGE_INFO(shadow_base), PROT_READ | PROT_EXEC);
+                        RW_PAGE_INFO(shadow_base), SHADOW_CODE_WINDOW_SIZE,
+                        PROT_READ | PROT_EXEC);
 
                     if (RW_PAGE_INFO(retaddr_mapping_used)) {
                         // munmap current retaddr mapping
@@ -632,7 +635,8 @@ NO_INLINE void fork_server_start(char **envp) {
                         RW_PAGE_INFO(retaddr_mapping_size) =
                             utils_mmap_external_file(
                                 RW_PAGE_INFO(retaddr_mapping_path), false,
-                                RW_PAGE_INFO(retaddr_mapping_base), PROT_READ);
+                                RW_PAGE_INFO(retaddr_mapping_base),
+                                RETADDR_MAPPING_WINDOW_SIZE, PROT_READ);
                     }
                 }
 
@@ -94,6 +94,11 @@ static void usage(const char *argv0, int ret_status) {
         "execution\n"
         "                  set it as zero to ignore the timeout "
         "(default: %lu ms)\n"
+        "  -m rounds     - set the maximum number of probabilistic disassembly "
+        "rounds (default: %u)\n"
+        "  -a delta      - stop probabilistic disassembly rounds once no "
+        "probability changes\n"
+        "                  more than delta (default: %g)\n"
 #ifdef DEBUG
         "  -l level      - set the log level, including TRACE, DEBUG, INFO, "
         "WARN, ERROR, and FATAL (default: INFO)\n\n",
@@ -102,7 +107,8 @@ static void usage(const char *argv0, int ret_status) {
         "FATAL (default: INFO)\n\n",
 #endif
 
-        argv0, SYS_CHECK_EXECS, SYS_TIMEOUT);
+        argv0, SYS_CHECK_EXECS, SYS_TIMEOUT, SYS_PDISASM_ROUNDS,
+        SYS_PDISASM_TOLERANCE);
 
     exit(ret_status);
 }
@@ -114,10 +120,12 @@ static int parse_args(int argc, const char **argv) {
     bool timeout_given = false;
     bool log_level_given = false;
     bool check_execs_given = false;
+    bool pdisasm_rounds_given = false;
+    bool pdisasm_tolerance_given = false;
 
     int opt = 0;
-    while ((opt = getopt(argc, (char *const *)argv, "+SRPDVgceidrfnht:l:x:")) >
-           0) {
+    while ((opt = getopt(argc, (char *const *)argv,
+                         "+SRPDVgceidrfnht:l:x:m:a:")) > 0) {
         switch (opt) {
 #define __MODE_CASE(c, m)                                   \
     case c:                                                 \
@@ -199,6 +207,33 @@ static int parse_args(int argc, const char **argv) {
                 }
                 break;
 
+            case 'm':
+                if (pdisasm_rounds_given) {
+                    EXITME("multiple -m options not supported");
+                }
+                pdisasm_rounds_given = true;
+                if (z_sscanf(optarg, "%u", &sys_optargs.pdisasm_rounds) < 1) {
+                    EXITME("bad syntax used for -m");
+                }
+                if (!sys_optargs.pdisasm_rounds) {
+                    EXITME("at least one round is required for -m");
+                }
+                break;
+
+            case 'a':
+                if (pdisasm_tolerance_given) {
+                    EXITME("multiple -a options not supported");
+                }
+                pdisasm_tolerance_given = true;
+                if (z_sscanf(optarg, "%lf", &sys_optargs.pdisasm_tolerance) <
+                    1) {
+                    EXITME("bad syntax used for -a");
+                }
+                if (sys_optargs.pdisasm_tolerance < 0.0) {
+                    EXITME("negative tolerance used for -a");
+                }
+                break;
+
             case 'h':
                 usage(argv[0], 0);
                 break;
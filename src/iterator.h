@@ -54,6 +54,14 @@
                     z_buffer_get_size(buf) / sizeof(*((iter).__ptr))); \
     } while (0)
 
+// XXX: different from z_iter_init, an empty span may have a NULL pointer
+#define z_iter_init_from_span(iter, span)                  \
+    do {                                                   \
+        (iter).__ptr = (typeof((iter).__ptr))((span).ptr); \
+        (iter).__i = 0;                                    \
+        (iter).__n = (span).n;                             \
+    } while (0)
+
 #define z_iter_next(iter)                      \
     ({                                         \
         typeof((iter).__ptr) __res = NULL;     \
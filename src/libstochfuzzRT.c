@@ -29,6 +29,11 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 
+// XXX: it is missing in glibc before 2.28
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
 #define IP_OFFSET_IN_CURSOR 3
 
 typedef int (*unw_step_fn_type)(unw_cursor_t*);
@@ -65,8 +70,13 @@ static void __runtime_mremap(const char* filename, void* addr, size_t length,
         exit(MY_ERR_CODE);
     }
 
-    // mmap file
-    if (mmap(addr, length, prot, MAP_SHARED | MAP_FIXED, fd, 0) != addr) {
+    // mmap file (length may cover the reserved window beyond the file). Note
+    // that MAP_FIXED_NOREPLACE makes sure we never replace anything mapped
+    // there in the meantime (e.g., by other threads), and old kernels which
+    // ignore it return another address.
+    if (mmap(addr, length, prot,
+             MAP_SHARED | MAP_FIXED_NOREPLACE | MAP_NORESERVE, fd,
+             0) != addr) {
         fprintf(stderr, "mmap failed: %s\n", strerror(errno));
         exit(MY_ERR_CODE);
     }
@@ -458,15 +458,16 @@ NO_INLINE void loader_load(Trampoline *tp, void *shared_text_base,
     utils_strcpy(RW_PAGE_INFO(shadow_path), fullpath);
     utils_puts(RW_PAGE_INFO(shadow_path), true);
     RW_PAGE_INFO(shadow_size) = utils_mmap_external_file(
-        fullpath, false, (unsigned long)tp, PROT_READ | PROT_EXEC);
+        fullpath, false, (unsigned long)tp, SHADOW_CODE_WINDOW_SIZE,
+        PROT_READ | PROT_EXEC);
     RW_PAGE_INFO(shadow_base) = (addr_t)tp;
 
     // lookup table file
     __PARSE_FILENAME(cur_, name);
     utils_strcpy(RW_PAGE_INFO(lookup_tab_path), fullpath);
     utils_puts(RW_PAGE_INFO(lookup_tab_path), true);
-    RW_PAGE_INFO(lookup_tab_size) =
-        utils_mmap_external_file(fullpath, false, LOOKUP_TABLE_ADDR, PROT_READ);
+    RW_PAGE_INFO(lookup_tab_size) = utils_mmap_external_file(
+        fullpath, false, LOOKUP_TABLE_ADDR, 0, PROT_READ);
 
     // pipe file
     __PARSE_FILENAME(cur_, name);
@@ -478,7 +479,8 @@ NO_INLINE void loader_load(Trampoline *tp, void *shared_text_base,
     utils_strcpy(RW_PAGE_INFO(shared_text_path), fullpath);
     utils_puts(RW_PAGE_INFO(shared_text_path), true);
     RW_PAGE_INFO(shared_text_size) = utils_mmap_external_file(
-        fullpath, true, (unsigned long)shared_text_base, PROT_READ | PROT_EXEC);
+        fullpath, true, (unsigned long)shared_text_base, 0,
+        PROT_READ | PROT_EXEC);
     RW_PAGE_INFO(shared_text_base) = (addr_t)shared_text_base;
 
     // retaddr mapping file
@@ -488,7 +490,8 @@ NO_INLINE void loader_load(Trampoline *tp, void *shared_text_base,
     addr_t retaddr_mapping_addr = rip_base + RETADDR_MAPPING_ADDR;
     RW_PAGE_INFO(retaddr_mapping_base) = retaddr_mapping_addr;
     RW_PAGE_INFO(retaddr_mapping_size) = utils_mmap_external_file(
-        fullpath, false, retaddr_mapping_addr, PROT_READ | PROT_WRITE);
+        fullpath, false, retaddr_mapping_addr, RETADDR_MAPPING_WINDOW_SIZE,
+        PROT_READ | PROT_WRITE);
     if (*((int64_t *)retaddr_mapping_addr) == -1) {
         // retaddr mapping is useless
         uint64_t ori_size = RW_PAGE_INFO(retaddr_mapping_size);
@@ -503,7 +506,7 @@ NO_INLINE void loader_load(Trampoline *tp, void *shared_text_base,
         *((void **)retaddr_mapping_addr + 1) = NULL;
         // remap the page as read only
         utils_mmap_external_file(fullpath, true, retaddr_mapping_addr,
-                                 PROT_READ);
+                                 RETADDR_MAPPING_WINDOW_SIZE, PROT_READ);
     }
 
 #undef __PARSE_FILENAME
@@ -88,13 +88,10 @@ Z_PRIVATE int __mem_file_stretch_to_size(_MEM_FILE *stream, size_t size) {
     }
 
     // step (1). update the size of underlying file
-    // XXX: avoid write on existing data
+    // XXX: avoid write on existing data, and ftruncate keeps the new pages
+    // sparse (hence a large stretch is cheap)
     if (size > stream->size) {
-        if (lseek(stream->fd, size - 1, SEEK_SET) == -1) {
-            return -1;
-        }
-
-        if (write(stream->fd, "", 1) == -1) {
+        if (ftruncate(stream->fd, size) == -1) {
             return -1;
         }
     }
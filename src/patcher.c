@@ -216,8 +216,8 @@ Z_PRIVATE void __patcher_bfs_certain_addresses(Patcher *p, addr_t addr) {
 
         // step (3.3). check successors
         Iter(addr_t, succ_addrs);
-        z_iter_init_from_buf(succ_addrs,
-                             z_disassembler_get_all_successors(d, cur_addr));
+        z_iter_init_from_span(succ_addrs,
+                              z_disassembler_peek_all_successors(d, cur_addr));
         while (!z_iter_is_empty(succ_addrs)) {
             addr_t succ_addr = *(z_iter_next(succ_addrs));
 
@@ -276,9 +276,9 @@ Z_PRIVATE void __patcher_patch_all_F(Patcher *p) {
         // guarantee at least 5 bytes
         while (end_addr - cur_addr < 5) {
             Iter(addr_t, pred_addrs);
-            z_iter_init_from_buf(
+            z_iter_init_from_span(
                 pred_addrs,
-                z_disassembler_get_direct_predecessors(d, cur_addr));
+                z_disassembler_peek_direct_predecessors(d, cur_addr));
 
             bool found = false;
             addr_t pred_addr = INVALID_ADDR;
@@ -400,9 +400,9 @@ Z_PRIVATE void __patcher_patch_all_F(Patcher *p) {
                 }
 
                 Iter(addr_t, succ_addrs);
-                z_iter_init_from_buf(
+                z_iter_init_from_span(
                     succ_addrs,
-                    z_disassembler_get_direct_successors(d, cur_addr));
+                    z_disassembler_peek_direct_successors(d, cur_addr));
 
                 while (!z_iter_is_empty(succ_addrs)) {
                     addr_t succ_addr = *(z_iter_next(succ_addrs));
@@ -463,7 +463,7 @@ Z_PRIVATE void __patcher_patch_all_F(Patcher *p) {
 
                 // TODO: leverage non-return analysis to improve here
                 addr_t ret_addr = addr + inst->size;
-                if (z_disassembler_get_superset_disasm(d, ret_addr)) {
+                if (z_disassembler_get_superset_inst(d, ret_addr)) {
                     // XXX: we use -ret_addr to indicate it is a return address
                     addr_t negative_addr = (addr_t)(-(int64_t)ret_addr);
                     p->potential_uncertain_addresses =
@@ -605,8 +605,8 @@ Z_API void z_patcher_describe(Patcher *p) {
             z_sayf("%-60s%-5d", inst_str, inst->size);
             z_free((void *)inst_str);
             Iter(addr_t, succ_addrs);
-            z_iter_init_from_buf(succ_addrs,
-                                 z_disassembler_get_all_successors(d, addr));
+            z_iter_init_from_span(succ_addrs,
+                                  z_disassembler_peek_all_successors(d, addr));
             while (!z_iter_is_empty(succ_addrs)) {
                 z_sayf(" {%#lx}", *(z_iter_next(succ_addrs)));
             }
@@ -641,8 +641,7 @@ Z_API Patcher *z_patcher_create(Disassembler *d, SysOptArgs *opts) {
 
     z_addr_dict_init(p->certain_patches, p->text_addr, p->text_size);
     p->uncertain_patches = g_sequence_new(NULL);
-    p->bridges = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
-                                       (GDestroyNotify)(&z_free));
+    z_addr_map_init(p->bridges);
 
     p->potential_uncertain_addresses = NULL;
 
@@ -662,7 +661,7 @@ Z_API void z_patcher_destroy(Patcher *p) {
     z_addr_dict_destroy(p->certain_patches);
     g_sequence_free(p->uncertain_patches);
 
-    g_hash_table_destroy(p->bridges);
+    z_addr_map_destroy(p->bridges, &z_free);
 
     z_rptr_destroy(p->text_ptr);
 
@@ -734,7 +733,7 @@ Z_API PPType z_patcher_check_patchpoint(Patcher *p, addr_t addr) {
     }
 
     // step (3). check bridge
-    if (g_hash_table_lookup(p->bridges, GSIZE_TO_POINTER(addr))) {
+    if (z_addr_map_exist(p->bridges, addr)) {
         return PP_BRIDGE;
     }
 
@@ -796,8 +795,7 @@ Z_API void z_patcher_build_bridge(Patcher *p, addr_t ori_addr,
     __patcher_bfs_certain_addresses(p, ori_addr);
 
     // step (2). check whether there is a bridge already built on current addr
-    BridgePoint *ori_bp = (BridgePoint *)g_hash_table_lookup(
-        p->bridges, GSIZE_TO_POINTER(ori_addr));
+    BridgePoint *ori_bp = z_addr_map_get(p->bridges, ori_addr);
     if (ori_bp) {
         // It is possible when the address is regarded as external crashpoint
         // and then regarded as retaddr.
@@ -1062,8 +1060,7 @@ TRY_TO_PATCH_DONE:
 
         for (addr_t cur_addr = ori_addr; cur_addr <= bridge_max_addr;
              cur_addr++) {
-            assert(
-                !g_hash_table_lookup(p->bridges, GSIZE_TO_POINTER(cur_addr)));
+            assert(!z_addr_map_exist(p->bridges, cur_addr));
             size_t off = cur_addr - ori_addr;
 
             // XXX: remember to revoke certain_patches
@@ -1079,8 +1076,7 @@ TRY_TO_PATCH_DONE:
                 bp->source_addr = bridge_sources[off];
                 bp->max_addr = bridge_max_addr;
 
-                g_hash_table_insert(p->bridges, GSIZE_TO_POINTER(cur_addr),
-                                    (gpointer)bp);
+                z_addr_map_set(p->bridges, cur_addr, bp);
                 continue;
             }
 
@@ -1098,8 +1094,7 @@ TRY_TO_PATCH_DONE:
                 bp->source_addr = cur_addr;
                 bp->max_addr = bridge_max_addr;
 
-                g_hash_table_insert(p->bridges, GSIZE_TO_POINTER(cur_addr),
-                                    (gpointer)bp);
+                z_addr_map_set(p->bridges, cur_addr, bp);
                 continue;
             }
         }
@@ -1145,8 +1140,8 @@ TRY_TO_PATCH_DONE:
 
             // get predecessors
             Iter(addr_t, pred_addrs);
-            z_iter_init_from_buf(
-                pred_addrs, z_disassembler_get_all_predecessors(d, cur_addr));
+            z_iter_init_from_span(
+                pred_addrs, z_disassembler_peek_all_predecessors(d, cur_addr));
 
             while (!z_iter_is_empty(pred_addrs)) {
                 // pred_addr must in .text (it may be incomplete when
@@ -1241,7 +1236,7 @@ Z_API addr_t z_patcher_adjust_bridge_address(Patcher *p, addr_t addr) {
         EXITME("cannot adjust bridge in delta debugging mode");
     }
 
-    BridgePoint *bp = g_hash_table_lookup(p->bridges, GSIZE_TO_POINTER(addr));
+    BridgePoint *bp = z_addr_map_get(p->bridges, addr);
 
     // case (1). this is not a bridge point, and we do nothing.
     if (!bp) {
@@ -1297,7 +1292,8 @@ Z_API addr_t z_patcher_adjust_bridge_address(Patcher *p, addr_t addr) {
                 z_addr_dict_set(p->certain_patches, cur_addr, true);
             }
 
-            g_hash_table_remove(p->bridges, GSIZE_TO_POINTER(cur_addr));
+            z_free(z_addr_map_get(p->bridges, cur_addr));
+            z_addr_map_remove(p->bridges, cur_addr);
         }
     }
 
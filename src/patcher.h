@@ -20,6 +20,7 @@
 #define __PATCHER_H
 
 #include "address_dictionary.h"
+#include "address_map.h"
 #include "binary.h"
 #include "buffer.h"
 #include "config.h"
@@ -99,7 +100,7 @@ STRUCT(Patcher, {
     // patch information
     GSequence *uncertain_patches;
     AddrDictFast(bool, certain_patches);
-    GHashTable *bridges;  // bridges detection points
+    AddrMap(struct bridge_point_t *, bridges);  // bridges detection points
 
     // potential addresses for uncertain patches (only used when pdisasm is
     // enable and CONSERVATIVE_PATCH is disable)
@@ -23,6 +23,7 @@
 
 #include <ctype.h>
 #include <math.h>
+#include <time.h>
 
 typedef enum dynamic_hint_type_t {
     DHINT_NONE = 0,
@@ -35,6 +36,19 @@ typedef struct dynamic_hint_t {
     DHintType type;
 } DHint;
 
+/*
+ * All hints and losts, as well as the intermediate results built upon them
+ * (i.e., H, RH, D, inst_lost, and data_hint), are kept in the log domain. Hence
+ * multiplying two of them is an addition, and the very long products of hints
+ * never underflow/overflow a double. Note that log(0.0) = -inf and log(+inf) =
+ * +inf, so that 100% instructions and 100% data keep their meanings (e.g.,
+ * -inf + +inf is still NaN).
+ *
+ * P is averaged across rounds instead of being multiplied, hence it is kept as
+ * a plain probability.
+ */
+typedef double logprob_t;
+
 ///////////////////////////////////
 // ProbDisassembler
 ///////////////////////////////////
@@ -44,13 +58,13 @@ STRUCT(ProbDisassembler, {
     // Disassembler (it looks like inheritance but not really)
     Disassembler *base;
 
-    AddrDict(double128_t, H);
-    AddrDict(double128_t, RH);
-    AddrDict(double128_t, P);
-    AddrDict(double128_t, D);
+    AddrDict(logprob_t, H);
+    AddrDict(logprob_t, RH);
+    AddrDict(double, P);
+    AddrDict(logprob_t, D);
 
-    AddrDict(double128_t, inst_lost);
-    AddrDict(double128_t, data_hint);
+    AddrDict(logprob_t, inst_lost);
+    AddrDict(logprob_t, data_hint);
 
     // basic information
     Binary *binary;
@@ -66,15 +80,59 @@ STRUCT(ProbDisassembler, {
     // TODO: we should do this for other address-keyed hash table.
     uint32_t scc_n;
     AddrDict(uint32_t, addr2sccid);
-    AddrDictFast(GHashTable *, dag_succs);
-    AddrDictFast(GHashTable *, dag_preds);
     AddrDictFast(bool, dag_dead);
-    GQueue *topo;
 
-    AddrDict(double128_t, dag_P);
+    // edges of the DAG in CSR form: successors of an SCC are
+    // dag_succs[dag_succ_offs[scc_id] .. dag_succ_offs[scc_id + 1]), and the
+    // same for predecessors (each offsets array is allocated together with
+    // its neighbors)
+    uint32_t *dag_succ_offs;
+    uint32_t *dag_succs;
+    uint32_t *dag_pred_offs;
+    uint32_t *dag_preds;
+    uint32_t *topo;
+
+    // topological levels of the DAG in CSR form: SCCs of level l are
+    // level_sccs[level_offs[l] .. level_offs[l + 1]), and all predecessors of
+    // an SCC are in lower levels
+    size_t level_n;
+    size_t *level_offs;
+    uint32_t *level_sccs;
+    uint32_t *scc_levels;
+
+    // addresses of each SCC in CSR form (as offsets to .text), which is only
+    // built when needed by incremental rounds
+    size_t *scc_addr_offs;
+    uint32_t *scc_addrs;
+
+    AddrDict(double, dag_P);
+
+    // per-SCC states of the latest round: propagated hints, and the local and
+    // restrained D/P (refer to prob_disasm_complete/incremental.c)
+    logprob_t *scc_hints;
+    bool *scc_has_hints;
+    bool *scc_invalid;
+    logprob_t *dag_local_D;
+    logprob_t *dag_better_D;
+    double *dag_local_P;
+    double *dag_better_P;
+
+    // addresses and SCCs updated since the latest round, and whether the
+    // per-SCC states are ready for an incremental round
+    GHashTable *pending_addrs;
+    GHashTable *pending_sccs;
+    bool incremental_ready;
 
     // how many round we have played
     size_t round_n;
+
+    // key of the analysis cache (0 means the cache is disabled), and whether
+    // the current results are restored from the cache
+    uint64_t cache_key;
+    bool cache_restored;
+
+    // per-byte kernels picked for the running CPU
+    const struct pdisasm_kernels_t *kernels;
 });
 
 #define __GET_PDISASM(d) ((ProbDisassembler *)((d)->prob_disasm))
@@ -83,9 +141,8 @@ STRUCT(ProbDisassembler, {
         (d)->prob_disasm = (PhantomType *)(v); \
     } while (0)
 
-#define INIT_ROUND_N 3
 #define PROPAGATE_P 0.1
-#define STRONG_DATA_HINT 1e52
+#define LOG_STRONG_DATA_HINT (52 * M_LN10)  // log(1e52)
 
 ///////////////////////////////////
 // All hints and losts value
@@ -98,14 +155,14 @@ STRUCT(ProbDisassembler, {
 #define __BASE_PRINTABLE_CHAR (256.0 / 95.0)
 #define __BASE_VALUE (256.0)
 
-#define BASE_CF(INST) \
-    (__pow_in_4(__BASE_CF, (INST)->detail->x86.encoding.imm_size))
-#define BASE_CF_RAW(N) (__pow_in_4(__BASE_CF, (N)))
-#define BASE_REG (__BASE_REG)
-#define BASE_INS (__BASE_INS)
-#define BASE_STRING(N) (__pow_in_n(__BASE_PRINTABLE_CHAR, (N)))
-#define BASE_VALUE(L, R, N) \
-    (__pow_in_n(__pow_in_n(__BASE_VALUE, (L)) / (R), (N)))
+// XXX: all following bases are in the log domain, where pow(x, n) is simply
+// n * log(x), and log(x) of a constant x is folded at compile time
+#define BASE_CF(INST) (__log_base_cf((INST)->detail->x86.encoding.imm_size))
+#define BASE_CF_RAW(N) (__log_base_cf((N)))
+#define BASE_REG (log(__BASE_REG))
+#define BASE_INS (log(__BASE_INS))
+#define BASE_STRING(N) ((N) * log(__BASE_PRINTABLE_CHAR))
+#define BASE_VALUE(L, R, N) ((N) * ((L)*log(__BASE_VALUE) - log(R)))
 
 // hint weights: bigger weight means higher confidence
 #define __HINT_PLT_CALL_WEIGHT (100000.0)
@@ -125,7 +182,7 @@ STRUCT(ProbDisassembler, {
 #define __HINT_VALUE_WEIGHT (1.0)
 
 // hint functions
-#define HINT(TYPE, BASE) ((1.0 / (__HINT_##TYPE##_WEIGHT)) * (BASE))
+#define HINT(TYPE, BASE) ((BASE)-log(__HINT_##TYPE##_WEIGHT))
 
 // lost weights: bigger weight means higher confidence
 #define __LOST_OUTSIDE_CALL_WEIGHT (+INFINITY)
@@ -134,94 +191,112 @@ STRUCT(ProbDisassembler, {
 #define __LOST_KILLED_SSE_WEIGHT (2.0)
 
 // lost functions
-#define LOST(TYPE, BASE) ((__LOST_##TYPE##_WEIGHT) * (1.0 / (BASE)))
+#define LOST(TYPE, BASE) (log(__LOST_##TYPE##_WEIGHT) - (BASE))
 
 ///////////////////////////////////
 // Useful functions
 ///////////////////////////////////
 
 /*
- * Securely check whether two double128_t variables are equal
+ * Lookup tables for powers with fixed bases
+ */
+// log(__BASE_CF ^ n), where n is the immediate size of a control flow transfer
+static const logprob_t __log_base_cf_lut[] = {
+    0.0, -8 * M_LN2, -16 * M_LN2, -24 * M_LN2, -32 * M_LN2,
+};
+
+// 0x100 ^ n, where n is the bit offset of the size of a numerical value
+static const double __value_threshold_lut[] = {
+    1.0,
+    256.0,
+    65536.0,
+    16777216.0,
+};
+
+/*
+ * Securely check whether two double variables are equal
  */
-Z_PRIVATE bool __double128_equal(double128_t a, double128_t b) {
-    double128_t max_val = (fabsl(a) > fabsl(b) ? fabsl(a) : fabsl(b));
-    return (fabsl(a - b) <= max_val * LDBL_EPSILON);
+Z_PRIVATE bool __double_equal(double a, double b) {
+    double max_val = (fabs(a) > fabs(b) ? fabs(a) : fabs(b));
+    return (fabs(a - b) <= max_val * DBL_EPSILON);
 }
 
 /*
- * simple function to calculate pow
+ * Check whether a log-domain value stands for 1.0
  */
-Z_PRIVATE double128_t __pow_in_4(double128_t base, size_t n) {
-    double128_t res = base;
-    switch (n) {
-        case 4:
-            res = res * res;
-        case 2:
-            res = res * res;
-            break;
-        case 3:
-            res = res * res * res;
-        case 1:
-            break;
-        case 0:
-            if (__double128_equal(base, 0.0)) {
-                res = NAN;
-            } else {
-                res = 1.0;
-            }
-            break;
-        default:
-            EXITME("invalid pow: %d", n);
+Z_PRIVATE bool __logprob_is_one(logprob_t a) { return fabs(a) <= DBL_EPSILON; }
+
+/*
+ * Check whether a log-domain value stands for 0.0
+ *
+ * XXX: it requires -fno-finite-math-only (see Makefile), otherwise isinf() is
+ * folded as false under -ffast-math.
+ */
+Z_PRIVATE bool __logprob_is_zero(logprob_t a) { return isinf(a) && a < 0.0; }
+
+/*
+ * Calculate log(exp(a) + exp(b)) without leaving the log domain
+ */
+Z_PRIVATE logprob_t __logprob_add(logprob_t a, logprob_t b) {
+    if (a < b) {
+        logprob_t t = a;
+        a = b;
+        b = t;
+    }
+    if (a == b) {
+        // it also avoids -inf - -inf and +inf - +inf
+        return a + M_LN2;
     }
-    return res;
+    return a + log1p(exp(b - a));
 }
 
 /*
- * fast function to calculate pow when n is integer
+ * Convert a log-domain value back into the linear domain
  */
-Z_PRIVATE double128_t __pow_in_n(double128_t base, size_t n) {
-    double128_t res = 1.0;
-    double128_t cur = base;
-    while (n > 0) {
-        if (n & 1) {
-            res *= cur;
-        }
-        cur = cur * cur;
-        n >>= 1;
-    }
+Z_PRIVATE double128_t __logprob_exp(logprob_t a) {
+    return expl((double128_t)a);
+}
 
-    return res;
+/*
+ * log(__BASE_CF ^ n)
+ */
+Z_PRIVATE logprob_t __log_base_cf(size_t n) {
+    if (n >= sizeof(__log_base_cf_lut) / sizeof(__log_base_cf_lut[0])) {
+        EXITME("invalid pow: %d", n);
+    }
+    return __log_base_cf_lut[n];
 }
 
 ///////////////////////////////////
 // Getter and Setter
 ///////////////////////////////////
 
+// XXX: the setter multiplies the existing value in the log domain
 #define PROB_DISASSEMBLER_DEFINE_PRIVATE_SETTER(T)                          \
     Z_PRIVATE void __prob_disassembler_update_##T(                          \
-        ProbDisassembler *pd, addr_t addr, double128_t T) {                 \
+        ProbDisassembler *pd, addr_t addr, logprob_t T) {                   \
         if (!z_addr_dict_exist(pd->T, addr)) {                              \
             z_addr_dict_set(pd->T, addr, T);                                \
         } else {                                                            \
-            z_addr_dict_set(pd->T, addr, z_addr_dict_get(pd->T, addr) * T); \
+            z_addr_dict_set(pd->T, addr, z_addr_dict_get(pd->T, addr) + T); \
         }                                                                   \
     }
 
-#define PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(T)                            \
-    Z_PRIVATE bool __prob_disassembler_get_##T(ProbDisassembler *pd,          \
-                                               addr_t addr, double128_t *T) { \
-        if (!z_addr_dict_exist(pd->T, addr)) {                                \
-            return false;                                                     \
-        } else {                                                              \
-            *T = z_addr_dict_get(pd->T, addr);                                \
-            return true;                                                      \
-        }                                                                     \
+#define PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(T, type)               \
+    Z_PRIVATE bool __prob_disassembler_get_##T(ProbDisassembler *pd,   \
+                                               addr_t addr, type *T) { \
+        if (!z_addr_dict_exist(pd->T, addr)) {                         \
+            return false;                                              \
+        } else {                                                       \
+            *T = z_addr_dict_get(pd->T, addr);                         \
+            return true;                                               \
+        }                                                              \
     }
 
-#define PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(T)                           \
-    Z_PRIVATE void __prob_disassembler_reset_##T(ProbDisassembler *pd,         \
-                                                 addr_t addr, double128_t T) { \
-        z_addr_dict_set(pd->T, addr, T);                                       \
+#define PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(T, type)              \
+    Z_PRIVATE void __prob_disassembler_reset_##T(ProbDisassembler *pd,  \
+                                                 addr_t addr, type T) { \
+        z_addr_dict_set(pd->T, addr, T);                                \
     }
 
 PROB_DISASSEMBLER_DEFINE_PRIVATE_SETTER(H);
@@ -230,19 +305,19 @@ PROB_DISASSEMBLER_DEFINE_PRIVATE_SETTER(D);
 PROB_DISASSEMBLER_DEFINE_PRIVATE_SETTER(inst_lost);
 PROB_DISASSEMBLER_DEFINE_PRIVATE_SETTER(data_hint);
 
-PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(H);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(RH);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(D);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(inst_lost);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(data_hint);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(P);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(H, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(RH, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(D, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(inst_lost, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(data_hint, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_RESETTER(P, double);
 
-PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(H);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(RH);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(D);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(inst_lost);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(data_hint);
-PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(P);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(H, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(RH, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(D, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(inst_lost, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(data_hint, logprob_t);
+PROB_DISASSEMBLER_DEFINE_PRIVATE_GETTER(P, double);
 
 #define __prob_disassembler_update_inst_hint __prob_disassembler_update_H
 #define __prob_disassembler_get_inst_hint __prob_disassembler_get_H
@@ -266,16 +341,34 @@ Z_PRIVATE bool __prob_disassembler_get_propogate_successors(
  */
 Z_PRIVATE void __prob_disassembler_refresh_playground(ProbDisassembler *pd);
 
+/*
+ * Measure how far P moved away from prev_P in the latest round, and count the
+ * SCCs whose invalid status (dag_P < PROPAGATE_P) will flip in the next round
+ */
+Z_PRIVATE void __prob_disassembler_measure_round(ProbDisassembler *pd,
+                                                 const double *prev_P,
+                                                 double *max_delta,
+                                                 double *mean_delta,
+                                                 size_t *flip_n);
+
+/*
+ * Get the monotonic time in seconds
+ */
+Z_PRIVATE double __prob_disassembler_get_time();
+
 ///////////////////////////////////
 // Components
 ///////////////////////////////////
 
 // XXX: note that we should import following components here, as they might use
 // above local functions.
+#include "prob_disasm_complete/kernels.c"
 #include "prob_disasm_complete/dag.c"
 #include "prob_disasm_complete/hints.c"
 #include "prob_disasm_complete/propagation.c"
 #include "prob_disasm_complete/solving.c"
+#include "prob_disasm_complete/incremental.c"
+#include "prob_disasm_complete/cache.c"
 
 ///////////////////////////////////
 // Test Code
@@ -284,7 +377,7 @@ Z_PRIVATE void __prob_disassembler_refresh_playground(ProbDisassembler *pd);
 #ifdef DEBUG
 
 Z_RESERVED Z_PRIVATE bool __prob_disassembler_path_dfs(
-    ProbDisassembler *pd, Buffer *(*get_next)(UCFG_Analyzer *, addr_t),
+    ProbDisassembler *pd, UEdgeSpan (*get_next)(UCFG_Analyzer *, addr_t),
     GQueue *stack, GHashTable *seen, addr_t cur_addr, addr_t target) {
     Disassembler *d = pd->base;
 
@@ -300,7 +393,7 @@ Z_RESERVED Z_PRIVATE bool __prob_disassembler_path_dfs(
     }
 
     Iter(addr_t, next_addrs);
-    z_iter_init_from_buf(next_addrs, (*get_next)(d->ucfg_analyzer, cur_addr));
+    z_iter_init_from_span(next_addrs, (*get_next)(d->ucfg_analyzer, cur_addr));
 
     while (!z_iter_is_empty(next_addrs)) {
         addr_t next_addr = *(z_iter_next(next_addrs));
@@ -329,7 +422,7 @@ Z_RESERVED Z_PRIVATE void __prob_disassembler_search_path(ProbDisassembler *pd,
         g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
     GQueue *stack = g_queue_new();
 
-    if (!__prob_disassembler_path_dfs(pd, &z_ucfg_analyzer_get_all_successors,
+    if (!__prob_disassembler_path_dfs(pd, &z_ucfg_analyzer_peek_all_successors,
                                       stack, seen, src, dst)) {
         EXITME("cannot reach %#lx from %#lx", dst, src);
     } else {
@@ -345,6 +438,54 @@ Z_RESERVED Z_PRIVATE void __prob_disassembler_search_path(ProbDisassembler *pd,
 
 #endif
 
+Z_PRIVATE double __prob_disassembler_get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+Z_PRIVATE void __prob_disassembler_measure_round(ProbDisassembler *pd,
+                                                 const double *prev_P,
+                                                 double *max_delta,
+                                                 double *mean_delta,
+                                                 size_t *flip_n) {
+    addr_t text_addr = pd->text_addr;
+    size_t text_size = pd->text_size;
+    const double *P = z_addr_dict_get_data(pd->P);
+
+    // step [1]. delta of P (note that all addresses have P after a round)
+    double max = 0.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < text_size; i++) {
+        double delta = fabs(P[i] - prev_P[i]);
+        if (delta > max) {
+            max = delta;
+        }
+        sum += delta;
+    }
+    *max_delta = max;
+    *mean_delta = text_size ? sum / text_size : 0.0;
+
+    // step [2]. SCCs whose invalid status flips (all addresses of an SCC share
+    // the same P, so the first one is enough)
+    bool *seen = z_alloc(pd->scc_n, sizeof(bool));
+    size_t n = 0;
+    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
+        uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);
+        if (!scc_id || seen[scc_id]) {
+            continue;
+        }
+        seen[scc_id] = true;
+
+        bool invalid = P[addr - text_addr] < PROPAGATE_P;
+        if (invalid != pd->scc_invalid[scc_id]) {
+            n++;
+        }
+    }
+    z_free(seen);
+    *flip_n = n;
+}
+
 Z_PRIVATE void __prob_disassembler_refresh_playground(ProbDisassembler *pd) {
     addr_t text_addr = pd->text_addr;
     size_t text_size = pd->text_size;
@@ -357,33 +498,32 @@ Z_PRIVATE void __prob_disassembler_refresh_playground(ProbDisassembler *pd) {
     }
 #endif
 
-    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        // step [1]. apply inst_lost into RH
-        double128_t inst_lost = NAN;
-        if (__prob_disassembler_get_inst_lost(pd, addr, &inst_lost)) {
-            __prob_disassembler_reset_RH(pd, addr, inst_lost);
-        } else {
-            z_addr_dict_remove(pd->RH, addr);
-            assert(!z_addr_dict_exist(pd->RH, addr));
-        }
+    // step [1]. apply inst_lost into RH
+    // step [2]. apply data_hint into D
+    // XXX: AddrDict always zeros the data of a non-existing address, so that
+    // applying a whole AddrDict is exactly copying both data and the bitmap
+#define __APPLY_ADDR_DICT(dst, src)                                   \
+    do {                                                              \
+        memcpy(z_addr_dict_get_data(dst), z_addr_dict_get_data(src),  \
+               text_size * sizeof(*z_addr_dict_get_data(src)));       \
+        memcpy(z_addr_dict_get_used(dst), z_addr_dict_get_used(src),  \
+               z_addr_dict_get_used_n(src) * sizeof(uint64_t));       \
+    } while (0)
 
-        // step [2]. apply data_hint into D
-        double128_t data_hint = NAN;
-        if (__prob_disassembler_get_data_hint(pd, addr, &data_hint)) {
-            __prob_disassembler_reset_D(pd, addr, data_hint);
-        } else {
-            z_addr_dict_remove(pd->D, addr);
-            assert(!z_addr_dict_exist(pd->D, addr));
-        }
+    __APPLY_ADDR_DICT(pd->RH, pd->inst_lost);
+    __APPLY_ADDR_DICT(pd->D, pd->data_hint);
 
+#undef __APPLY_ADDR_DICT
+
+    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
         // step [3]. update dag P
-        double128_t P = NAN;
+        double P = NAN;
         if (__prob_disassembler_get_P(pd, addr, &P)) {
             uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);
 #ifdef DEBUG
             if (z_addr_dict_exist(pd->dag_P, scc_id) &&
                 z_addr_dict_get(pd->dag_P, scc_id) != P) {
-                EXITME("inconsistent dag P: %#lx (%Le) v/s %d (%Le)", addr, P,
+                EXITME("inconsistent dag P: %#lx (%e) v/s %d (%e)", addr, P,
                        scc_id, z_addr_dict_get(pd->dag_P, scc_id));
             }
 #endif
@@ -400,14 +540,13 @@ Z_PRIVATE bool __prob_disassembler_get_propogate_successors(
     ProbDisassembler *pd, addr_t addr, size_t *n, addr_t **succs) {
     Disassembler *d = pd->base;
 
-    cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
+    const SInst *inst = z_disassembler_get_superset_inst(d, addr);
     if (!inst) {
         return false;
     }
 
-    Buffer *succs_buf =
-        z_ucfg_analyzer_get_all_successors(d->ucfg_analyzer, addr);
-    assert(succs_buf);
+    UEdgeSpan succs_span =
+        z_ucfg_analyzer_peek_all_successors(d->ucfg_analyzer, addr);
 
     // XXX:  option one: propogate hints through fall-through edges for calls
     // ------
@@ -418,8 +557,8 @@ Z_PRIVATE bool __prob_disassembler_get_propogate_successors(
     // }
     // ------
 
-    *n = z_buffer_get_size(succs_buf) / sizeof(addr_t);
-    *succs = (addr_t *)z_buffer_get_raw_buf(succs_buf);
+    *n = succs_span.n;
+    *succs = (addr_t *)succs_span.ptr;
 
     return true;
 }
@@ -434,18 +573,18 @@ Z_PRIVATE double128_t z_prob_disassembler_get_inst_prob(ProbDisassembler *pd,
         return 0.0;
     }
 
-    double128_t P = NAN;
+    double P = NAN;
     __prob_disassembler_get_P(pd, addr, &P);
     assert(!isnan(P));
 
-    if (!__double128_equal(P, 0.0)) {
+    if (!__double_equal(P, 0.0)) {
         return P;
     }
 
     // additionally check dag_dead and very huge data hint
-    double128_t data_hint = NAN;
+    logprob_t data_hint = NAN;
     if (__prob_disassembler_get_data_hint(pd, addr, &data_hint)) {
-        if (data_hint > STRONG_DATA_HINT) {
+        if (data_hint > LOG_STRONG_DATA_HINT) {
             return -0.0;
         }
     }
@@ -467,10 +606,22 @@ Z_PRIVATE void z_prob_disassembler_get_internal(
     *inst = z_disassembler_get_superset_disasm(d, addr);
     *scc_id = z_addr_dict_get(pd->addr2sccid, addr);
 
-    __prob_disassembler_get_inst_hint(pd, addr, inst_hint);
-    __prob_disassembler_get_inst_lost(pd, addr, inst_lost);
-    __prob_disassembler_get_data_hint(pd, addr, data_hint);
-    __prob_disassembler_get_D(pd, addr, D);
+    // XXX: internal values are converted back into the linear domain, where
+    // a missing value is still NAN
+    logprob_t v = NAN;
+#define __EXPORT_LOGPROB(T, ptr)                         \
+    do {                                                 \
+        if (__prob_disassembler_get_##T(pd, addr, &v)) { \
+            *(ptr) = __logprob_exp(v);                   \
+        }                                                \
+    } while (0)
+
+    __EXPORT_LOGPROB(inst_hint, inst_hint);
+    __EXPORT_LOGPROB(inst_lost, inst_lost);
+    __EXPORT_LOGPROB(data_hint, data_hint);
+    __EXPORT_LOGPROB(D, D);
+
+#undef __EXPORT_LOGPROB
 
     *P = z_prob_disassembler_get_inst_prob(pd, addr);
 }
@@ -479,7 +630,7 @@ Z_PRIVATE void z_prob_disassembler_update(ProbDisassembler *pd, addr_t addr,
                                           bool is_inst, bool need_log) {
     if (is_inst) {
         // we have known for sure this addr is an instruction boundary
-        __prob_disassembler_reset_inst_hint(pd, addr, 0.0);
+        __prob_disassembler_reset_inst_hint(pd, addr, -INFINITY);  // log(0.0)
         z_addr_dict_remove(pd->inst_lost, addr);
         z_addr_dict_remove(pd->data_hint, addr);
     } else {
@@ -492,6 +643,9 @@ Z_PRIVATE void z_prob_disassembler_update(ProbDisassembler *pd, addr_t addr,
         __prob_disassembler_reset_data_hint(pd, addr, +INFINITY);
     }
 
+    // the address is recomputed by the next incremental round
+    g_hash_table_add(pd->pending_addrs, GSIZE_TO_POINTER(addr));
+
     if (need_log) {
         // log the hint
         DHintType type = (is_inst ? DHINT_CODE : DHINT_DATA);
@@ -510,19 +664,36 @@ Z_PRIVATE void z_prob_disassembler_update(ProbDisassembler *pd, addr_t addr,
 }
 
 Z_PRIVATE void z_prob_disassembler_start(ProbDisassembler *pd) {
+    /*
+     * step [0]. the initial rounds are restored from the analysis cache
+     */
+    if (pd->cache_restored) {
+        pd->cache_restored = false;
+        z_info("probabilistic disassembly round %d restored", pd->round_n);
+        return;
+    }
+    bool is_initial = !pd->round_n;
+
+#ifndef NINCREMENTAL_PDISASM
+    /*
+     * step [0']. after the initial rounds, only recompute what is affected by
+     * the updates: refer to *prob_disasm_complete/incremental.c*
+     */
+    if (!is_initial && __prob_disassembler_incremental_round(pd)) {
+        pd->round_n += 1;
+        z_info("probabilistic disassembly round %d done (incremental)",
+               pd->round_n);
+        return;
+    }
+#endif
+
     /*
      * step [1]. collect hints if we haven't: please refer to
      * *prob_disasm_complete/hints.c*
      */
     if (!pd->round_n) {
         // calculate static hints
-        __prob_disassembler_collect_cf_hints(pd);
-        __prob_disassembler_collect_reg_hints(pd);
-        __prob_disassembler_collect_pop_ret_hints(pd);
-        __prob_disassembler_collect_cmp_cjmp_hints(pd);
-        __prob_disassembler_collect_arg_call_hints(pd);
-        __prob_disassembler_collect_str_hints(pd);
-        __prob_disassembler_collect_value_hints(pd);
+        __prob_disassembler_collect_static_hints(pd);
 
         // apply logged dynamic hint
         {
@@ -541,16 +712,32 @@ Z_PRIVATE void z_prob_disassembler_start(ProbDisassembler *pd) {
     }
 
     /*
-     * step [2]. play several rounds to calculate probabilities
+     * step [2]. play rounds to calculate probabilities until they converge
      */
-    do {
+    // XXX: the only feedback from a round to the next one is which SCCs stop
+    // the propagation (i.e., dag_P < PROPAGATE_P). Once no SCC flips this
+    // status, the next round sees exactly the same evidence and merely
+    // re-averages P. Hence, the initial rounds stop at that point, or when the
+    // maximum change of P is within the tolerance, or at the round cap. A
+    // non-initial round (i.e., an incremental round falling back) is played
+    // only once.
+    SysOptArgs *opts = pd->base->opts;
+    double *prev_P = z_alloc(pd->text_size, sizeof(double));
+    while (true) {
+        double start_time = __prob_disassembler_get_time();
+        bool has_prev = !!pd->round_n;
+        memcpy(prev_P, z_addr_dict_get_data(pd->P),
+               pd->text_size * sizeof(double));
+
         /*
          * step [2.1]. refresh playground
          */
         __prob_disassembler_refresh_playground(pd);
+        g_hash_table_remove_all(pd->pending_addrs);
+        g_hash_table_remove_all(pd->pending_sccs);
 
         /*
-         * step [2]. propogate hints:
+         * step [2.2]. propogate hints:
          *      refer to *prob_disasm_complete/propagation.c*
          */
         __prob_disassembler_propogate_inst_hints(pd);
@@ -558,28 +745,71 @@ Z_PRIVATE void z_prob_disassembler_start(ProbDisassembler *pd) {
         z_trace("probabilistic disassembly: hints propagation done");
 
         /*
-         * step [3]. spread hints: refer to *prob_disasm_complete/solving.c*
+         * step [2.3]. spread hints: refer to *prob_disasm_complete/solving.c*
          */
         __prob_disassembler_spread_hints(pd);
         z_trace("probabilistic disassembly: hints spreading done");
 
         /*
-         * step [4]. restrain probabilities:
+         * step [2.4]. restrain probabilities:
          *      refer to *prob_disasm_complete/solving.c*
          */
         __prob_disassembler_restrain_prob(pd);
         z_trace("probabilistic disassembly: probability restraint done");
 
         /*
-         * step [5]. normalized probabilities:
+         * step [2.5]. normalized probabilities:
          *      refer to *prob_disasm_complete/solving.c*
          */
         __prob_disassembler_normalize_prob(pd);
         z_trace("probabilistic disassembly: probability normalization done");
 
         pd->round_n += 1;
-        z_info("probabilistic disassembly round %d done", pd->round_n);
-    } while (pd->round_n < INIT_ROUND_N);
+
+        /*
+         * step [2.6]. report the round and check convergence
+         */
+        double max_delta = 0.0;
+        double mean_delta = 0.0;
+        size_t flip_n = 0;
+        __prob_disassembler_measure_round(pd, prev_P, &max_delta, &mean_delta,
+                                          &flip_n);
+        double elapsed = __prob_disassembler_get_time() - start_time;
+
+        if (has_prev) {
+            z_info(
+                "probabilistic disassembly round %lu done: %.3fs, max |dP| "
+                "%.3e, mean |dP| %.3e, %lu SCCs flipped",
+                pd->round_n, elapsed, max_delta, mean_delta, flip_n);
+        } else {
+            z_info(
+                "probabilistic disassembly round %lu done: %.3fs, %lu SCCs "
+                "flipped",
+                pd->round_n, elapsed, flip_n);
+        }
+
+        if (!is_initial || !flip_n) {
+            break;
+        }
+        if (has_prev && max_delta <= opts->pdisasm_tolerance) {
+            break;
+        }
+        if (pd->round_n >= opts->pdisasm_rounds) {
+            break;
+        }
+    }
+    z_free(prev_P);
+    pd->incremental_ready = true;
+
+    /*
+     * step [3]. persist the results of initial rounds
+     */
+    // XXX: note that the initial rounds are always played before any
+    // rewriting-driven update, so the results only depend on the binary and
+    // the logged dynamic hints
+    if (is_initial) {
+        __prob_disassembler_store_cache(pd);
+    }
 }
 
 Z_PRIVATE ProbDisassembler *z_prob_disassembler_create(Disassembler *d) {
@@ -593,6 +823,8 @@ Z_PRIVATE ProbDisassembler *z_prob_disassembler_create(Disassembler *d) {
 
     pd->round_n = 0;
 
+    pd->kernels = __pdisasm_kernels_select();
+
     // read p-disasm file
     pd->dynamic_hints =
         g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
@@ -620,6 +852,31 @@ Z_PRIVATE ProbDisassembler *z_prob_disassembler_create(Disassembler *d) {
         }
     }
 
+    // the analysis cache additionally depends on the logged dynamic hints
+    pd->cache_key = d->cache_key;
+    pd->cache_restored = false;
+    if (pd->cache_key) {
+        // XXX: a missing hint file is hashed as an empty one, as both mean no
+        // hint. Note that every run writes the hint file when it exits, so
+        // otherwise the first run would never share the cache with others.
+        if (!z_access(pd->dhint_filename, F_OK)) {
+            pd->cache_key =
+                z_analysis_cache_hash_file(pd->cache_key, pd->dhint_filename);
+        } else {
+            size_t size = 0;
+            pd->cache_key =
+                z_analysis_cache_hash(pd->cache_key, &size, sizeof(size));
+        }
+
+        // ... and the convergence settings of the initial rounds
+        pd->cache_key =
+            z_analysis_cache_hash(pd->cache_key, &d->opts->pdisasm_rounds,
+                                  sizeof(d->opts->pdisasm_rounds));
+        pd->cache_key =
+            z_analysis_cache_hash(pd->cache_key, &d->opts->pdisasm_tolerance,
+                                  sizeof(d->opts->pdisasm_tolerance));
+    }
+
     /*
      * H: instruction hint source for each address, which is also the
      * update point for all *instruction hints*.
@@ -650,8 +907,35 @@ Z_PRIVATE ProbDisassembler *z_prob_disassembler_create(Disassembler *d) {
 
     /*
      * dag building: please refer to: *prob_disasm_complete/dag.c*
+     *
+     * XXX: if the analysis cache is available, both DAG and the results of
+     * initial rounds are restored (refer to *prob_disasm_complete/cache.c*)
      */
-    __prob_disassembler_build_dag(pd);
+    if (__prob_disassembler_load_cache(pd)) {
+        pd->cache_restored = true;
+    } else {
+        __prob_disassembler_build_dag(pd);
+    }
+    __prob_disassembler_build_levels(pd);
+
+    pd->scc_addr_offs = NULL;
+    pd->scc_addrs = NULL;
+
+    pd->scc_hints = z_alloc(pd->scc_n, sizeof(logprob_t));
+    pd->scc_has_hints = z_alloc(pd->scc_n, sizeof(bool));
+    pd->scc_invalid = z_alloc(pd->scc_n, sizeof(bool));
+    pd->dag_local_D = z_alloc(pd->scc_n, sizeof(logprob_t));
+    pd->dag_better_D = z_alloc(pd->scc_n, sizeof(logprob_t));
+    pd->dag_local_P = z_alloc(pd->scc_n, sizeof(double));
+    pd->dag_better_P = z_alloc(pd->scc_n, sizeof(double));
+
+    pd->pending_addrs =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    pd->pending_sccs =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    // XXX: the per-SCC states are not cached, so that the first round after
+    // restoring from the analysis cache is always a full one
+    pd->incremental_ready = false;
 
     return pd;
 }
@@ -667,13 +951,31 @@ Z_PRIVATE void z_prob_disassembler_destroy(ProbDisassembler *pd) {
     z_addr_dict_destroy(pd->data_hint);
 
     z_addr_dict_destroy(pd->addr2sccid);
-    z_addr_dict_destroy(pd->dag_succs, &g_hash_table_destroy);
-    z_addr_dict_destroy(pd->dag_preds, &g_hash_table_destroy);
+    z_free(pd->dag_succ_offs);
+    z_free(pd->dag_pred_offs);
     z_addr_dict_destroy(pd->dag_dead);
-    g_queue_free(pd->topo);
+    z_free(pd->topo);
+    z_free(pd->level_offs);
+    z_free(pd->level_sccs);
+    z_free(pd->scc_levels);
+    if (pd->scc_addr_offs) {
+        z_free(pd->scc_addr_offs);
+        z_free(pd->scc_addrs);
+    }
 
     z_addr_dict_destroy(pd->dag_P);
 
+    z_free(pd->scc_hints);
+    z_free(pd->scc_has_hints);
+    z_free(pd->scc_invalid);
+    z_free(pd->dag_local_D);
+    z_free(pd->dag_better_D);
+    z_free(pd->dag_local_P);
+    z_free(pd->dag_better_P);
+
+    g_hash_table_destroy(pd->pending_addrs);
+    g_hash_table_destroy(pd->pending_sccs);
+
     // write down dynamic hints
     {
         FILE *f = z_fopen(pd->dhint_filename, "wb");
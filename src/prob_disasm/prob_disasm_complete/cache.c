@@ -0,0 +1,298 @@
+/*
+ * cache.c
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Meta information of cached pdisasm
+ */
+typedef struct pdisasm_cache_meta_t {
+    uint64_t scc_n;
+    uint64_t round_n;
+} PDisasmCacheMeta;
+
+/*
+ * Check whether a cached AddrDict (and its existence bitmap if has_used) with
+ * n elements exists
+ */
+Z_PRIVATE bool __prob_disassembler_check_cached_dict(AnalysisCache *c,
+                                                     uint32_t tag, size_t n,
+                                                     size_t elem_size,
+                                                     bool has_used);
+
+/*
+ * Copy a cached AddrDict into data (and used)
+ */
+Z_PRIVATE void __prob_disassembler_copy_cached_dict(AnalysisCache *c,
+                                                    uint32_t tag, void *data,
+                                                    uint64_t *used);
+
+/*
+ * Validate CSR-encoded DAG edges (dag_succs or dag_preds) and copy them into a
+ * newly allocated array, return NULL if the encoding is corrupted
+ */
+Z_PRIVATE uint32_t *__prob_disassembler_restore_dag_edges(ProbDisassembler *pd,
+                                                          const uint32_t *csr,
+                                                          size_t size);
+
+/*
+ * Restore DAG and probabilities from the analysis cache
+ */
+Z_PRIVATE bool __prob_disassembler_load_cache(ProbDisassembler *pd);
+
+/*
+ * Persist DAG and probabilities into the analysis cache
+ */
+Z_PRIVATE void __prob_disassembler_store_cache(ProbDisassembler *pd);
+
+#define __PDISASM_CACHE_ADD_DICT(c, tag, dict)                    \
+    do {                                                          \
+        z_analysis_cache_add_section(                             \
+            c, ACACHE_PDISASM_##tag, z_addr_dict_get_data(dict),  \
+            z_addr_dict_get_size(dict) *                          \
+                sizeof(*z_addr_dict_get_data(dict)));             \
+        if (z_addr_dict_get_used(dict)) {                         \
+            z_analysis_cache_add_section(                         \
+                c, ACACHE_BITMAP(ACACHE_PDISASM_##tag),           \
+                z_addr_dict_get_used(dict),                       \
+                z_addr_dict_get_used_n(dict) * sizeof(uint64_t)); \
+        }                                                         \
+    } while (0)
+
+#define __PDISASM_CACHE_CHECK_DICT(c, tag, dict, n, has_used)            \
+    __prob_disassembler_check_cached_dict(                               \
+        c, ACACHE_PDISASM_##tag, n, sizeof(*z_addr_dict_get_data(dict)), \
+        has_used)
+
+#define __PDISASM_CACHE_COPY_DICT(c, tag, dict)                      \
+    __prob_disassembler_copy_cached_dict(c, ACACHE_PDISASM_##tag,    \
+                                         z_addr_dict_get_data(dict), \
+                                         z_addr_dict_get_used(dict))
+
+Z_PRIVATE bool __prob_disassembler_check_cached_dict(AnalysisCache *c,
+                                                     uint32_t tag, size_t n,
+                                                     size_t elem_size,
+                                                     bool has_used) {
+    size_t size = 0;
+    if (!z_analysis_cache_get_section(c, tag, &size) ||
+        size != n * elem_size) {
+        return false;
+    }
+
+    if (has_used) {
+        if (!z_analysis_cache_get_section(c, ACACHE_BITMAP(tag), &size) ||
+            size != (n / 64 + 1) * sizeof(uint64_t)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Z_PRIVATE void __prob_disassembler_copy_cached_dict(AnalysisCache *c,
+                                                    uint32_t tag, void *data,
+                                                    uint64_t *used) {
+    size_t size = 0;
+    const void *ptr = z_analysis_cache_get_section(c, tag, &size);
+    assert(ptr);
+    memcpy(data, ptr, size);
+
+    if (used) {
+        ptr = z_analysis_cache_get_section(c, ACACHE_BITMAP(tag), &size);
+        assert(ptr);
+        memcpy(used, ptr, size);
+    }
+}
+
+Z_PRIVATE uint32_t *__prob_disassembler_restore_dag_edges(ProbDisassembler *pd,
+                                                          const uint32_t *csr,
+                                                          size_t size) {
+    // layout: | offsets (scc_n + 1) | neighbors |
+    uint32_t scc_n = pd->scc_n;
+
+    if (size < (scc_n + 1) * sizeof(uint32_t) ||
+        size != (scc_n + 1 + (size_t)csr[scc_n]) * sizeof(uint32_t)) {
+        return NULL;
+    }
+
+    const uint32_t *neighbors = csr + scc_n + 1;
+    for (uint32_t scc_id = 0; scc_id < scc_n; scc_id++) {
+        if (csr[scc_id] > csr[scc_id + 1]) {
+            return NULL;
+        }
+        for (uint32_t i = csr[scc_id]; i < csr[scc_id + 1]; i++) {
+            if (neighbors[i] >= scc_n) {
+                return NULL;
+            }
+        }
+    }
+
+    // XXX: the in-memory layout is exactly the same as the cached one
+    uint32_t *offs = z_alloc(size, sizeof(uint8_t));
+    memcpy(offs, csr, size);
+    return offs;
+}
+
+Z_PRIVATE bool __prob_disassembler_load_cache(ProbDisassembler *pd) {
+    if (!pd->cache_key) {
+        return false;
+    }
+
+    const char *original_filename = z_binary_get_original_filename(pd->binary);
+    char *cache_filename = z_strcat(PDISASM_CACHE_PREFIX, original_filename);
+    AnalysisCache *c = z_analysis_cache_load(cache_filename, pd->cache_key);
+    z_free(cache_filename);
+
+    if (!c) {
+        return false;
+    }
+
+    /*
+     * step [1]. validate all sections before touching pd
+     */
+    size_t size = 0;
+    const PDisasmCacheMeta *meta =
+        z_analysis_cache_get_section(c, ACACHE_PDISASM_META, &size);
+    if (!meta || size != sizeof(PDisasmCacheMeta) || !meta->scc_n ||
+        meta->scc_n >= UINT32_MAX) {
+        goto INCOMPLETE;
+    }
+
+    uint32_t scc_n = (uint32_t)meta->scc_n;
+    size_t text_size = pd->text_size;
+
+    if (!__PDISASM_CACHE_CHECK_DICT(c, H, pd->H, text_size, true) ||
+        !__PDISASM_CACHE_CHECK_DICT(c, RH, pd->RH, text_size, true) ||
+        !__PDISASM_CACHE_CHECK_DICT(c, P, pd->P, text_size, true) ||
+        !__PDISASM_CACHE_CHECK_DICT(c, D, pd->D, text_size, true) ||
+        !__PDISASM_CACHE_CHECK_DICT(c, INST_LOST, pd->inst_lost, text_size,
+                                    true) ||
+        !__PDISASM_CACHE_CHECK_DICT(c, DATA_HINT, pd->data_hint, text_size,
+                                    true) ||
+        !__PDISASM_CACHE_CHECK_DICT(c, ADDR2SCCID, pd->addr2sccid, text_size,
+                                    true) ||
+        !__PDISASM_CACHE_CHECK_DICT(c, DAG_P, pd->dag_P, scc_n, true) ||
+        !__PDISASM_CACHE_CHECK_DICT(c, DAG_DEAD, pd->dag_dead, scc_n,
+                                    false)) {
+        goto INCOMPLETE;
+    }
+
+    size_t succs_size = 0, preds_size = 0, topo_size = 0;
+    const uint32_t *succs =
+        z_analysis_cache_get_section(c, ACACHE_PDISASM_DAG_SUCCS, &succs_size);
+    const uint32_t *preds =
+        z_analysis_cache_get_section(c, ACACHE_PDISASM_DAG_PREDS, &preds_size);
+    const uint32_t *topo =
+        z_analysis_cache_get_section(c, ACACHE_PDISASM_TOPO, &topo_size);
+    if (!succs || !preds || !topo || topo_size != scc_n * sizeof(uint32_t)) {
+        goto INCOMPLETE;
+    }
+
+    /*
+     * step [2]. restore DAG
+     */
+    pd->scc_n = scc_n;
+    z_addr_dict_init(pd->addr2sccid, pd->text_addr, pd->text_size);
+    z_addr_dict_init(pd->dag_dead, 0, pd->scc_n);
+    z_addr_dict_init(pd->dag_P, 0, pd->scc_n);
+
+    // XXX: the encoding of DAG edges is checked with the restoring, and an
+    // inconsistent cache here means the cache file is broken by others
+    pd->dag_succ_offs =
+        __prob_disassembler_restore_dag_edges(pd, succs, succs_size);
+    pd->dag_pred_offs =
+        __prob_disassembler_restore_dag_edges(pd, preds, preds_size);
+    if (!pd->dag_succ_offs || !pd->dag_pred_offs) {
+        EXITME("corrupted DAG in analysis cache");
+    }
+    pd->dag_succs = pd->dag_succ_offs + scc_n + 1;
+    pd->dag_preds = pd->dag_pred_offs + scc_n + 1;
+
+    pd->topo = z_alloc(scc_n, sizeof(uint32_t));
+    memcpy(pd->topo, topo, topo_size);
+
+    __PDISASM_CACHE_COPY_DICT(c, ADDR2SCCID, pd->addr2sccid);
+    __PDISASM_CACHE_COPY_DICT(c, DAG_P, pd->dag_P);
+    __PDISASM_CACHE_COPY_DICT(c, DAG_DEAD, pd->dag_dead);
+
+    /*
+     * step [3]. restore hints and probabilities
+     */
+    __PDISASM_CACHE_COPY_DICT(c, H, pd->H);
+    __PDISASM_CACHE_COPY_DICT(c, RH, pd->RH);
+    __PDISASM_CACHE_COPY_DICT(c, P, pd->P);
+    __PDISASM_CACHE_COPY_DICT(c, D, pd->D);
+    __PDISASM_CACHE_COPY_DICT(c, INST_LOST, pd->inst_lost);
+    __PDISASM_CACHE_COPY_DICT(c, DATA_HINT, pd->data_hint);
+
+    pd->round_n = meta->round_n;
+
+    z_analysis_cache_destroy(c);
+
+    z_info("probabilistic disassembly restored from analysis cache");
+    return true;
+
+INCOMPLETE:
+    z_info("incomplete probabilistic disassembly cache");
+    z_analysis_cache_destroy(c);
+    return false;
+}
+
+Z_PRIVATE void __prob_disassembler_store_cache(ProbDisassembler *pd) {
+    if (!pd->cache_key) {
+        return;
+    }
+
+    const char *original_filename = z_binary_get_original_filename(pd->binary);
+    char *cache_filename = z_strcat(PDISASM_CACHE_PREFIX, original_filename);
+    AnalysisCache *c = z_analysis_cache_create(cache_filename, pd->cache_key);
+    z_free(cache_filename);
+
+    // meta
+    PDisasmCacheMeta meta = {
+        .scc_n = pd->scc_n,
+        .round_n = pd->round_n,
+    };
+    z_analysis_cache_add_section(c, ACACHE_PDISASM_META, &meta, sizeof(meta));
+
+    // hints and probabilities
+    __PDISASM_CACHE_ADD_DICT(c, H, pd->H);
+    __PDISASM_CACHE_ADD_DICT(c, RH, pd->RH);
+    __PDISASM_CACHE_ADD_DICT(c, P, pd->P);
+    __PDISASM_CACHE_ADD_DICT(c, D, pd->D);
+    __PDISASM_CACHE_ADD_DICT(c, INST_LOST, pd->inst_lost);
+    __PDISASM_CACHE_ADD_DICT(c, DATA_HINT, pd->data_hint);
+
+    // DAG
+    __PDISASM_CACHE_ADD_DICT(c, ADDR2SCCID, pd->addr2sccid);
+    __PDISASM_CACHE_ADD_DICT(c, DAG_P, pd->dag_P);
+    __PDISASM_CACHE_ADD_DICT(c, DAG_DEAD, pd->dag_dead);
+    z_analysis_cache_add_section(
+        c, ACACHE_PDISASM_DAG_SUCCS, pd->dag_succ_offs,
+        (pd->scc_n + 1 + pd->dag_succ_offs[pd->scc_n]) * sizeof(uint32_t));
+    z_analysis_cache_add_section(
+        c, ACACHE_PDISASM_DAG_PREDS, pd->dag_pred_offs,
+        (pd->scc_n + 1 + pd->dag_pred_offs[pd->scc_n]) * sizeof(uint32_t));
+    z_analysis_cache_add_section(c, ACACHE_PDISASM_TOPO, pd->topo,
+                                 pd->scc_n * sizeof(uint32_t));
+
+    z_analysis_cache_store(c);
+    z_analysis_cache_destroy(c);
+}
+
+#undef __PDISASM_CACHE_ADD_DICT
+#undef __PDISASM_CACHE_CHECK_DICT
+#undef __PDISASM_CACHE_COPY_DICT
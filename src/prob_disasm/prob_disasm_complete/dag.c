@@ -17,94 +17,146 @@
  */
 
 /*
- * Tarjan data
+ * Frame of the explicit DFS stack of Tarjan algorithm
+ */
+typedef struct tarjan_frame_t {
+    addr_t addr;
+    size_t i;  // index of the next successor to visit
+    size_t n;
+    addr_t *succs;
+} TarjanFrame;
+
+/*
+ * Tarjan data, where all arrays are indexed by the offset to .text
  */
 typedef struct tarjan_info_t {
-    AddrDict(uint32_t, low);
-    AddrDict(uint32_t, dfn);
+    uint32_t *low;
+    uint32_t *dfn;  // 0 means not visited
     uint32_t addr_n;
+
+    // stack of addresses which are not assigned to any SCC yet
+    uint32_t *stack;
+    size_t stack_n;
+    bool *in_stack;
+
+    // explicit DFS stack
+    TarjanFrame *frames;
+    size_t frame_n;
+    size_t frame_cap;
 } TarjanInfo;
 
 /*
- * Tarjan algorithm to calculate SCC (return low[cur_addr])
+ * Visit an address in Tarjan algorithm (i.e., push it into both stacks)
+ */
+Z_PRIVATE void __prob_disassembler_tarjan_visit(ProbDisassembler *pd,
+                                                TarjanInfo *info,
+                                                addr_t cur_addr);
+
+/*
+ * Tarjan algorithm to calculate SCCs reachable from root_addr, which uses an
+ * explicit stack instead of recursion
  */
 Z_PRIVATE void __prob_disassembler_tarjan(ProbDisassembler *pd,
-                                          TarjanInfo *info, GQueue *stack,
-                                          GHashTable *in_stack,
-                                          addr_t cur_addr);
+                                          TarjanInfo *info, addr_t root_addr);
 
 /*
  * Bulid DAG using Tarjan algorithm
  */
 Z_PRIVATE void __prob_disassembler_build_dag(ProbDisassembler *pd);
 
-Z_PRIVATE void __prob_disassembler_tarjan(ProbDisassembler *pd,
-                                          TarjanInfo *info, GQueue *stack,
-                                          GHashTable *in_stack,
-                                          addr_t cur_addr) {
-    // step [0]. basic info
-    Disassembler *d = pd->base;
+/*
+ * Partition the DAG into topological levels, so that SCCs of the same level
+ * are independent of each other
+ */
+Z_PRIVATE void __prob_disassembler_build_levels(ProbDisassembler *pd);
+
+Z_PRIVATE void __prob_disassembler_tarjan_visit(ProbDisassembler *pd,
+                                                TarjanInfo *info,
+                                                addr_t cur_addr) {
+    size_t cur_off = cur_addr - pd->text_addr;
 
     // step [1]. update low and dfn
-    z_addr_dict_set(info->low, cur_addr, info->addr_n);
-    z_addr_dict_set(info->dfn, cur_addr, info->addr_n);
     info->addr_n++;
+    info->low[cur_off] = info->addr_n;
+    info->dfn[cur_off] = info->addr_n;
 
     // step [2]. push into stack
-    g_queue_push_tail(stack, GSIZE_TO_POINTER(cur_addr));
-    g_hash_table_insert(in_stack, GSIZE_TO_POINTER(cur_addr),
-                        GSIZE_TO_POINTER(1));
-
-    // step [3]. get nexts
-    size_t n = 0;
-    addr_t *next_addrs = NULL;
-    if (!__prob_disassembler_get_propogate_successors(pd, cur_addr, &n,
-                                                      &next_addrs)) {
+    info->stack[info->stack_n++] = (uint32_t)cur_off;
+    info->in_stack[cur_off] = true;
+
+    // step [3]. push a new frame with nexts
+    if (info->frame_n == info->frame_cap) {
+        info->frame_cap = (info->frame_cap ? info->frame_cap * 2 : 0x1000);
+        info->frames = z_realloc(info->frames,
+                                 info->frame_cap * sizeof(TarjanFrame));
+    }
+
+    TarjanFrame *frame = &info->frames[info->frame_n++];
+    frame->addr = cur_addr;
+    frame->i = 0;
+    if (!__prob_disassembler_get_propogate_successors(pd, cur_addr, &frame->n,
+                                                      &frame->succs)) {
         EXITME("invalid successors");
     }
+}
 
-    // step [5]. main loop
-    for (size_t i = 0; i < n; i++) {
-        addr_t next_addr = next_addrs[i];
+Z_PRIVATE void __prob_disassembler_tarjan(ProbDisassembler *pd,
+                                          TarjanInfo *info, addr_t root_addr) {
+    // step [0]. basic info
+    Disassembler *d = pd->base;
+    addr_t text_addr = pd->text_addr;
 
-        // step [5.1]. check whether next_addr is valid instruction
-        if (!z_disassembler_get_superset_disasm(d, next_addr)) {
-            continue;
-        }
+    __prob_disassembler_tarjan_visit(pd, info, root_addr);
 
-        // step [5.2]. for non-visited next_addr
-        if (!z_addr_dict_exist(info->low, next_addr)) {
-            assert(!z_addr_dict_exist(info->dfn, next_addr));
-            __prob_disassembler_tarjan(pd, info, stack, in_stack, next_addr);
+    while (info->frame_n) {
+        TarjanFrame *frame = &info->frames[info->frame_n - 1];
+        size_t cur_off = frame->addr - text_addr;
 
-            uint32_t cur_low = z_addr_dict_get(info->low, cur_addr);
-            uint32_t next_low = z_addr_dict_get(info->low, next_addr);
+        // step [4]. visit the next successor
+        if (frame->i < frame->n) {
+            addr_t next_addr = frame->succs[frame->i++];
 
-            if (next_low < cur_low) {
-                z_addr_dict_set(info->low, cur_addr, next_low);
+            // step [4.1]. check whether next_addr is valid instruction
+            if (!z_disassembler_get_superset_inst(d, next_addr)) {
+                continue;
             }
-        } else if (g_hash_table_lookup(in_stack, GSIZE_TO_POINTER(next_addr))) {
-            uint32_t cur_low = z_addr_dict_get(info->low, cur_addr);
-            uint32_t next_dfn = z_addr_dict_get(info->dfn, next_addr);
-
-            if (next_dfn < cur_low) {
-                z_addr_dict_set(info->low, cur_addr, next_dfn);
+            size_t next_off = next_addr - text_addr;
+
+            if (!info->dfn[next_off]) {
+                // step [4.2]. for non-visited next_addr, go deeper (note that
+                // frame may be invalidated by the new frame)
+                __prob_disassembler_tarjan_visit(pd, info, next_addr);
+            } else if (info->in_stack[next_off]) {
+                // step [4.3]. for next_addr in stack
+                if (info->dfn[next_off] < info->low[cur_off]) {
+                    info->low[cur_off] = info->dfn[next_off];
+                }
             }
+            continue;
         }
-    }
 
-    // step [6]. get SCC
-    if (z_addr_dict_get(info->dfn, cur_addr) ==
-        z_addr_dict_get(info->low, cur_addr)) {
-        uint32_t scc_id = pd->scc_n++;
-        while (!g_queue_is_empty(stack)) {
-            addr_t poped_addr = (addr_t)g_queue_pop_tail(stack);
-            g_hash_table_remove(in_stack, GSIZE_TO_POINTER(poped_addr));
+        // step [5]. get SCC
+        if (info->dfn[cur_off] == info->low[cur_off]) {
+            uint32_t scc_id = pd->scc_n++;
+            while (info->stack_n) {
+                uint32_t poped_off = info->stack[--info->stack_n];
+                info->in_stack[poped_off] = false;
 
-            z_addr_dict_set(pd->addr2sccid, poped_addr, scc_id);
+                z_addr_dict_set(pd->addr2sccid, text_addr + poped_off, scc_id);
+
+                if (poped_off == cur_off) {
+                    break;
+                }
+            }
+        }
 
-            if (poped_addr == cur_addr) {
-                break;
+        // step [6]. return to the parent
+        info->frame_n--;
+        if (info->frame_n) {
+            size_t parent_off =
+                info->frames[info->frame_n - 1].addr - text_addr;
+            if (info->low[cur_off] < info->low[parent_off]) {
+                info->low[parent_off] = info->low[cur_off];
             }
         }
     }
@@ -130,154 +182,193 @@ Z_PRIVATE void __prob_disassembler_build_dag(ProbDisassembler *pd) {
     {
         TarjanInfo *info = z_alloc(1, sizeof(TarjanInfo));
         info->addr_n = 0;
-        z_addr_dict_init(info->low, text_addr, text_size);
-        z_addr_dict_init(info->dfn, text_addr, text_size);
-
-        GQueue *stack = g_queue_new(); /* stack */
-        GHashTable *in_stack =         /* whehter addr is in stack */
-            g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+        info->low = z_alloc(text_size, sizeof(uint32_t));
+        info->dfn = z_alloc(text_size, sizeof(uint32_t));
+        info->stack = z_alloc(text_size, sizeof(uint32_t));
+        info->stack_n = 0;
+        info->in_stack = z_alloc(text_size, sizeof(bool));
+        info->frames = NULL;
+        info->frame_n = 0;
+        info->frame_cap = 0;
 
         for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
             // check whether addr is handled
             if (z_addr_dict_exist(pd->addr2sccid, addr)) {
-                assert(z_addr_dict_exist(info->low, addr));
-                assert(z_addr_dict_exist(info->dfn, addr));
+                assert(info->dfn[addr - text_addr]);
                 continue;
             }
 
             // check cur_addr is valid
-            if (!z_disassembler_get_superset_disasm(d, addr)) {
+            if (!z_disassembler_get_superset_inst(d, addr)) {
                 z_addr_dict_set(pd->addr2sccid, addr, 0);
                 continue;
             }
 
             // do tarjan
-            __prob_disassembler_tarjan(pd, info, stack, in_stack, addr);
+            __prob_disassembler_tarjan(pd, info, addr);
 
-            assert(g_queue_is_empty(stack));
-            assert(!g_hash_table_size(in_stack));
+            assert(!info->stack_n);
+            assert(!info->frame_n);
         }
 
         z_info("we found %d SCCs in the superset control flow graph",
                pd->scc_n);
 
         // free memory
-        g_hash_table_destroy(in_stack);
-        g_queue_free(stack);
-        z_addr_dict_destroy(info->low);
-        z_addr_dict_destroy(info->dfn);
+        z_free(info->low);
+        z_free(info->dfn);
+        z_free(info->stack);
+        z_free(info->in_stack);
+        z_free(info->frames);
         z_free(info);
     }
 
     /*
      * step [3]. build DAG
      */
-    z_addr_dict_init(pd->dag_succs, 0, pd->scc_n);
-    z_addr_dict_init(pd->dag_preds, 0, pd->scc_n);
     z_addr_dict_init(pd->dag_dead, 0, pd->scc_n);
-
     z_addr_dict_init(pd->dag_P, 0, pd->scc_n);
 
-    AddrDict(uint32_t, dag_preds_n); /* used for toposord */
-    z_addr_dict_init(dag_preds_n, 0, pd->scc_n);
-
     {
-        // step [3.1]. init all necessary members
+        // step [3.1]. count edges (with duplicates) of each SCC
+        uint32_t *raw_offs = z_alloc(pd->scc_n + 1, sizeof(uint32_t));
+
+#define __FOREACH_DAG_EDGE(scc_id, succ_scc_id, ...)                          \
+    do {                                                                      \
+        for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) { \
+            /* ignore invalid instructions */                                 \
+            assert(z_addr_dict_exist(pd->addr2sccid, addr));                  \
+            uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);          \
+            if (!scc_id) {                                                    \
+                continue;                                                     \
+            }                                                                 \
+                                                                              \
+            size_t n = 0;                                                     \
+            addr_t *succ_addrs = NULL;                                        \
+            if (!__prob_disassembler_get_propogate_successors(pd, addr, &n,   \
+                                                              &succ_addrs)) { \
+                EXITME("invalid successors");                                 \
+            }                                                                 \
+                                                                              \
+            for (size_t i = 0; i < n; i++) {                                  \
+                addr_t succ_addr = succ_addrs[i];                             \
+                                                                              \
+                /* check succ_addr is in .text (we cannot know the outside    \
+                 * info) */                                                   \
+                /* XXX: OUTSIDE LOST already handles this */                  \
+                if (succ_addr < text_addr ||                                  \
+                    succ_addr >= text_addr + text_size) {                     \
+                    continue;                                                 \
+                }                                                             \
+                                                                              \
+                /* and not equal to scc_id */                                 \
+                uint32_t succ_scc_id =                                        \
+                    z_addr_dict_get(pd->addr2sccid, succ_addr);               \
+                if (succ_scc_id == scc_id) {                                  \
+                    continue;                                                 \
+                }                                                             \
+                                                                              \
+                __VA_ARGS__;                                                  \
+            }                                                                 \
+        }                                                                     \
+    } while (0)
+
+        size_t raw_n = 0;
+        __FOREACH_DAG_EDGE(scc_id, succ_scc_id, {
+            raw_offs[scc_id + 1]++;
+            raw_n++;
+        });
+        if (raw_n >= UINT32_MAX) {
+            EXITME("too many edges in DAG");
+        }
         for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
-            z_addr_dict_set(dag_preds_n, scc_id, 0);
-            z_addr_dict_set(pd->dag_succs, scc_id,
-                            g_hash_table_new_full(g_direct_hash, g_direct_equal,
-                                                  NULL, NULL));
-            z_addr_dict_set(pd->dag_preds, scc_id,
-                            g_hash_table_new_full(g_direct_hash, g_direct_equal,
-                                                  NULL, NULL));
+            raw_offs[scc_id + 1] += raw_offs[scc_id];
         }
 
-        // step [3.2]. construct DAG based on each address's information
-        for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-            // ignore invalid instructions
-            assert(z_addr_dict_exist(pd->addr2sccid, addr));
-            uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);
-            if (!scc_id) {
-                continue;
-            }
+        // step [3.2]. collect edges
+        uint32_t *raw_succs = z_alloc(raw_n, sizeof(uint32_t));
+        uint32_t *cursors = z_alloc(pd->scc_n, sizeof(uint32_t));
+        memcpy(cursors, raw_offs, pd->scc_n * sizeof(uint32_t));
+        __FOREACH_DAG_EDGE(scc_id, succ_scc_id,
+                           { raw_succs[cursors[scc_id]++] = succ_scc_id; });
 
-            // get dag_succs
-            GHashTable *dag_succs = z_addr_dict_get(pd->dag_succs, scc_id);
+#undef __FOREACH_DAG_EDGE
 
-            // get succ_addrs
-            size_t n = 0;
-            addr_t *succ_addrs = NULL;
-            if (!__prob_disassembler_get_propogate_successors(pd, addr, &n,
-                                                              &succ_addrs)) {
-                EXITME("invalid successors");
-            }
-
-            for (int i = 0; i < n; i++) {
-                addr_t succ_addr = succ_addrs[i];
+        // step [3.3]. remove duplicated edges (keeping the first occurrence)
+        // into successors in CSR form
+        uint32_t *marks = cursors; /* the last SCC (plus one) visiting it */
+        memset(marks, 0, pd->scc_n * sizeof(uint32_t));
 
-                // check succ_addr is in .text (we cannot know the outside info)
-                // XXX: OUTSIDE LOST already handles this
-                uint32_t succ_scc_id;
-                if (succ_addr < text_addr ||
-                    succ_addr >= text_addr + text_size) {
-                    continue;
+        uint32_t edge_n = 0;
+        for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
+            for (uint32_t i = raw_offs[scc_id]; i < raw_offs[scc_id + 1]; i++) {
+                uint32_t succ_scc_id = raw_succs[i];
+                if (marks[succ_scc_id] != scc_id + 1) {
+                    marks[succ_scc_id] = scc_id + 1;
+                    edge_n++;
                 }
+            }
+        }
 
-                assert(z_addr_dict_exist(pd->addr2sccid, succ_addr));
-                succ_scc_id = z_addr_dict_get(pd->addr2sccid, succ_addr);
+        // XXX: offsets and neighbors are allocated together, which is exactly
+        // the layout stored in the analysis cache
+        pd->dag_succ_offs = z_alloc(pd->scc_n + 1 + edge_n, sizeof(uint32_t));
+        pd->dag_succs = pd->dag_succ_offs + pd->scc_n + 1;
+        pd->dag_pred_offs = z_alloc(pd->scc_n + 1 + edge_n, sizeof(uint32_t));
+        pd->dag_preds = pd->dag_pred_offs + pd->scc_n + 1;
 
-                // and not equal to scc_id
-                if (succ_scc_id == scc_id) {
-                    continue;
+        memset(marks, 0, pd->scc_n * sizeof(uint32_t));
+        edge_n = 0;
+        for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
+            pd->dag_succ_offs[scc_id] = edge_n;
+            for (uint32_t i = raw_offs[scc_id]; i < raw_offs[scc_id + 1]; i++) {
+                uint32_t succ_scc_id = raw_succs[i];
+                if (marks[succ_scc_id] != scc_id + 1) {
+                    marks[succ_scc_id] = scc_id + 1;
+                    pd->dag_succs[edge_n++] = succ_scc_id;
+                    pd->dag_pred_offs[succ_scc_id + 1]++;
                 }
+            }
+        }
+        pd->dag_succ_offs[pd->scc_n] = edge_n;
 
-                // check whether succ_scc is in dag_succs and insert if not
-                if (!g_hash_table_lookup(dag_succs,
-                                         GSIZE_TO_POINTER(succ_scc_id))) {
-                    // update dag_succs
-                    g_hash_table_insert(dag_succs,
-                                        GSIZE_TO_POINTER(succ_scc_id),
-                                        GSIZE_TO_POINTER(1));
-
-                    // update dag_preds_n
-                    z_addr_dict_set(
-                        dag_preds_n, succ_scc_id,
-                        z_addr_dict_get(dag_preds_n, succ_scc_id) + 1);
-
-                    // update dag_preds
-                    g_hash_table_insert(
-                        z_addr_dict_get(pd->dag_preds, succ_scc_id),
-                        GSIZE_TO_POINTER(scc_id), GSIZE_TO_POINTER(1));
-                }
+        z_free(raw_succs);
+        z_free(raw_offs);
+
+        // step [3.4]. transpose successors into predecessors
+        for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
+            pd->dag_pred_offs[scc_id + 1] += pd->dag_pred_offs[scc_id];
+        }
+        memcpy(cursors, pd->dag_pred_offs, pd->scc_n * sizeof(uint32_t));
+        for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
+            for (uint32_t i = pd->dag_succ_offs[scc_id];
+                 i < pd->dag_succ_offs[scc_id + 1]; i++) {
+                pd->dag_preds[cursors[pd->dag_succs[i]]++] = scc_id;
             }
         }
+        z_free(cursors);
 
 #ifdef DEBUG
         /*
-         * step [3.3]. check the correctness of DAG
+         * step [3.5]. check the correctness of DAG
          */
-        size_t edge_n = 0;
+        assert(pd->dag_pred_offs[pd->scc_n] == edge_n);
         for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
-            assert(z_addr_dict_exist(dag_preds_n, scc_id));
-            assert(z_addr_dict_exist(pd->dag_succs, scc_id));
-            assert(z_addr_dict_exist(pd->dag_preds, scc_id));
-
-            GHashTable *dag_succs = z_addr_dict_get(pd->dag_succs, scc_id);
-            GHashTable *dag_preds = z_addr_dict_get(pd->dag_preds, scc_id);
-
-            assert(z_addr_dict_get(dag_preds_n, scc_id) ==
-                   g_hash_table_size(dag_preds));
-
-            GList *list_dag_succs = g_hash_table_get_keys(dag_succs);
-            for (GList *l = list_dag_succs; l != NULL; l = l->next) {
-                edge_n++;
-                uint32_t succ_scc_id = (uint32_t)l->data;
-                assert(g_hash_table_lookup(
-                    z_addr_dict_get(pd->dag_preds, succ_scc_id),
-                    GSIZE_TO_POINTER(scc_id)));
+            for (uint32_t i = pd->dag_succ_offs[scc_id];
+                 i < pd->dag_succ_offs[scc_id + 1]; i++) {
+                uint32_t succ_scc_id = pd->dag_succs[i];
+                assert(succ_scc_id != scc_id);
+
+                bool found = false;
+                for (uint32_t j = pd->dag_pred_offs[succ_scc_id];
+                     j < pd->dag_pred_offs[succ_scc_id + 1]; j++) {
+                    if (pd->dag_preds[j] == scc_id) {
+                        found = true;
+                        break;
+                    }
+                }
+                assert(found);
             }
-            g_list_free(list_dag_succs);
         }
         assert(edge_n);
         z_info("there are %d edges in contructed DAG", edge_n);
@@ -287,41 +378,85 @@ Z_PRIVATE void __prob_disassembler_build_dag(ProbDisassembler *pd) {
     /*
      * step [4]. topo-sort
      */
-    pd->topo = g_queue_new();
+    // XXX: pd->topo itself is used as the queue of Kahn's algorithm
+    pd->topo = z_alloc(pd->scc_n, sizeof(uint32_t));
     {
-        GQueue *queue = g_queue_new();
+        uint32_t *preds_n = z_alloc(pd->scc_n, sizeof(uint32_t));
+        size_t head = 0, tail = 0;
 
         // first find all nodes without preds
         for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
-            if (!z_addr_dict_get(dag_preds_n, scc_id)) {
-                g_queue_push_tail(queue, GSIZE_TO_POINTER(scc_id));
+            preds_n[scc_id] =
+                pd->dag_pred_offs[scc_id + 1] - pd->dag_pred_offs[scc_id];
+            if (!preds_n[scc_id]) {
+                pd->topo[tail++] = scc_id;
             }
         }
 
         // get topo
-        while (!g_queue_is_empty(queue)) {
-            uint32_t scc_id = (uint32_t)g_queue_pop_head(queue);
-            g_queue_push_tail(pd->topo, GSIZE_TO_POINTER(scc_id));
+        while (head < tail) {
+            uint32_t scc_id = pd->topo[head++];
 
-            GHashTable *dag_succs = z_addr_dict_get(pd->dag_succs, scc_id);
+            for (uint32_t i = pd->dag_succ_offs[scc_id];
+                 i < pd->dag_succ_offs[scc_id + 1]; i++) {
+                uint32_t succ_scc_id = pd->dag_succs[i];
 
-            GList *list_dag_succs = g_hash_table_get_keys(dag_succs);
-            for (GList *l = list_dag_succs; l != NULL; l = l->next) {
-                uint32_t succ_scc_id = (uint32_t)l->data;
+                assert(preds_n[succ_scc_id]);
+                if (!--preds_n[succ_scc_id]) {
+                    pd->topo[tail++] = succ_scc_id;
+                }
+            }
+        }
+        assert(tail == pd->scc_n);
 
-                assert(z_addr_dict_exist(dag_preds_n, succ_scc_id));
-                z_addr_dict_set(dag_preds_n, succ_scc_id,
-                                z_addr_dict_get(dag_preds_n, succ_scc_id) - 1);
+        z_free(preds_n);
+    }
+}
 
-                if (!z_addr_dict_get(dag_preds_n, succ_scc_id)) {
-                    g_queue_push_tail(queue, GSIZE_TO_POINTER(succ_scc_id));
-                }
+Z_PRIVATE void __prob_disassembler_build_levels(ProbDisassembler *pd) {
+    // XXX: levels are derived from the DAG, so they are never cached
+    uint32_t *levels = z_alloc(pd->scc_n, sizeof(uint32_t));
+
+    // step [1]. the level of an SCC is the longest distance from a source
+    pd->level_n = 0;
+    for (uint32_t i = 0; i < pd->scc_n; i++) {
+        uint32_t scc_id = pd->topo[i];
+
+        uint32_t level = 0;
+        for (uint32_t j = pd->dag_pred_offs[scc_id];
+             j < pd->dag_pred_offs[scc_id + 1]; j++) {
+            uint32_t pred_level = levels[pd->dag_preds[j]];
+            if (pred_level + 1 > level) {
+                level = pred_level + 1;
             }
-            g_list_free(list_dag_succs);
         }
-        assert(g_queue_get_length(pd->topo) == pd->scc_n);
 
-        g_queue_free(queue);
+        levels[scc_id] = level;
+        if (level + 1 > pd->level_n) {
+            pd->level_n = level + 1;
+        }
     }
-    z_addr_dict_destroy(dag_preds_n);
+
+    // step [2]. counting sort SCCs by their levels
+    pd->level_offs = z_alloc(pd->level_n + 1, sizeof(size_t));
+    pd->level_sccs = z_alloc(pd->scc_n, sizeof(uint32_t));
+
+    for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
+        pd->level_offs[levels[scc_id] + 1]++;
+    }
+    for (size_t i = 0; i < pd->level_n; i++) {
+        pd->level_offs[i + 1] += pd->level_offs[i];
+    }
+
+    size_t *cursors = z_alloc(pd->level_n, sizeof(size_t));
+    memcpy(cursors, pd->level_offs, pd->level_n * sizeof(size_t));
+    for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
+        pd->level_sccs[cursors[levels[scc_id]]++] = scc_id;
+    }
+    assert(pd->level_offs[pd->level_n] == pd->scc_n);
+
+    z_info("the DAG has %d topological levels", pd->level_n);
+
+    z_free(cursors);
+    pd->scc_levels = levels;
 }
@@ -28,14 +28,56 @@ typedef struct reg_info_t {
     ZMMState zmm;
 } RegInfo;
 
+/*
+ * Kinds of hint records
+ */
+typedef enum hint_record_kind_t {
+    HINT_RECORD_INST_HINT,
+    HINT_RECORD_INST_LOST,
+    HINT_RECORD_DATA_HINT,
+} HintRecordKind;
+
+/*
+ * Hint record, which applies the same value to n continuous addresses
+ * starting from addr. Collectors running on different threads append records
+ * into their own buffers instead of updating pd directly.
+ */
+typedef struct hint_record_t {
+    addr_t addr;
+    uint32_t n;
+    HintRecordKind kind;
+    logprob_t val;
+} HintRecord;
+
+/*
+ * Append a hint record into hints
+ */
+Z_PRIVATE void __prob_disassembler_record_hints(Buffer *hints,
+                                                HintRecordKind kind,
+                                                addr_t addr, size_t n,
+                                                logprob_t val);
+
+#define __prob_disassembler_record_inst_hint(hints, addr, val) \
+    __prob_disassembler_record_hints(hints, HINT_RECORD_INST_HINT, addr, 1, val)
+#define __prob_disassembler_record_inst_lost(hints, addr, val) \
+    __prob_disassembler_record_hints(hints, HINT_RECORD_INST_LOST, addr, 1, val)
+#define __prob_disassembler_record_data_hints(hints, addr, n, val) \
+    __prob_disassembler_record_hints(hints, HINT_RECORD_DATA_HINT, addr, n, val)
+
+/*
+ * Apply hint records into pd, in the order of recording
+ */
+Z_PRIVATE void __prob_disassembler_apply_hint_records(ProbDisassembler *pd,
+                                                      Buffer *hints);
+
 /*
  * Coolect hints from registers' use-def
  */
 Z_PRIVATE void __prob_disassembler_reg_hints_dfs(
-    ProbDisassembler *pd, GHashTable *seen,
-    Buffer *(*get_next)(UCFG_Analyzer *, addr_t),
-    void (*update_info)(ProbDisassembler *, addr_t, RegInfo *), addr_t cur_addr,
-    RegInfo *info, bool is_first_addr);
+    ProbDisassembler *pd, Buffer *hints, GHashTable *seen,
+    UEdgeSpan (*get_next)(UCFG_Analyzer *, addr_t),
+    void (*update_info)(ProbDisassembler *, Buffer *, addr_t, RegInfo *),
+    addr_t cur_addr, RegInfo *info, bool is_first_addr);
 
 /*
  * Data length threshold
@@ -44,6 +86,12 @@ Z_PRIVATE void __prob_disassembler_reg_hints_dfs(
 #define VALUE_LENGTH_THRESHOLD 4
 #define CONFIDENT_LENGTH_THRESHOLD 100
 
+/*
+ * Number of bytes (or numerical values) classified at a time by the scanners
+ * of data hints (a multiple of 64)
+ */
+#define DATA_HINT_CHUNK_SIZE 0x1000
+
 /*
  * Code pattern distance
  */
@@ -53,43 +101,140 @@ Z_PRIVATE void __prob_disassembler_reg_hints_dfs(
 /*
  * Collect control-flow-related hints
  */
-Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd);
+Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd,
+                                                    Buffer *hints);
 
 /*
  * Collect pop-ret hints
  */
-Z_PRIVATE void __prob_disassembler_collect_pop_ret_hints(ProbDisassembler *pd);
+Z_PRIVATE void __prob_disassembler_collect_pop_ret_hints(ProbDisassembler *pd,
+                                                         Buffer *hints);
 
 /*
  * Collect cmp/test-cjmp hints
  */
-Z_PRIVATE void __prob_disassembler_collect_cmp_cjmp_hints(ProbDisassembler *pd);
+Z_PRIVATE void __prob_disassembler_collect_cmp_cjmp_hints(ProbDisassembler *pd,
+                                                          Buffer *hints);
 
 /*
  * Collect arg-call hints
  */
-Z_PRIVATE void __prob_disassembler_collect_arg_call_hints(ProbDisassembler *pd);
+Z_PRIVATE void __prob_disassembler_collect_arg_call_hints(ProbDisassembler *pd,
+                                                          Buffer *hints);
 
 /*
  * Collect register-related hints
  */
-Z_PRIVATE void __prob_disassembler_collect_reg_hints(ProbDisassembler *pd);
+Z_PRIVATE void __prob_disassembler_collect_reg_hints(ProbDisassembler *pd,
+                                                     Buffer *hints);
+
+/*
+ * Find the first set bit in matched within [i, n), return n if none
+ */
+Z_PRIVATE size_t __prob_disassembler_next_matched(const uint64_t *matched,
+                                                 size_t i, size_t n);
 
 /*
  * Collect string hints
  */
-Z_PRIVATE void __prob_disassembler_collect_str_hints(ProbDisassembler *pd);
+Z_PRIVATE void __prob_disassembler_collect_str_hints(ProbDisassembler *pd,
+                                                     Buffer *hints);
 
 /*
  * Collect value hints
  */
-Z_PRIVATE void __prob_disassembler_collect_value_hints(ProbDisassembler *pd);
+Z_PRIVATE void __prob_disassembler_collect_value_hints(ProbDisassembler *pd,
+                                                       Buffer *hints);
+
+/*
+ * Static hint collectors, in the order of applying their records (i.e., the
+ * order of the serial version). Collectors of the same task run one after
+ * another on the same thread. Note that materializing full instructions
+ * (capstone) and KS_ASM (keystone) are not thread-safe, so all collectors using
+ * them share task 0.
+ */
+static const struct {
+    void (*fcn)(ProbDisassembler *, Buffer *);
+    size_t task_id;
+} __hint_collectors[] = {
+    {&__prob_disassembler_collect_cf_hints, 0},
+    {&__prob_disassembler_collect_reg_hints, 1},
+    {&__prob_disassembler_collect_pop_ret_hints, 2},
+    {&__prob_disassembler_collect_cmp_cjmp_hints, 3},
+    {&__prob_disassembler_collect_arg_call_hints, 0},
+    {&__prob_disassembler_collect_str_hints, 4},
+    {&__prob_disassembler_collect_value_hints, 5},
+};
+
+#define HINT_COLLECTOR_N \
+    (sizeof(__hint_collectors) / sizeof(__hint_collectors[0]))
+#define HINT_COLLECTOR_TASK_N 6
+
+/*
+ * Context of concurrent hint collection
+ */
+STRUCT(__HintCollectCtx, {
+    ProbDisassembler *pd;
+    Buffer *records[HINT_COLLECTOR_N];
+});
+
+/*
+ * Run all static hint collectors of a task
+ */
+Z_PRIVATE void __prob_disassembler_collect_hints_task(void *ctx_,
+                                                      size_t task_id);
+
+/*
+ * Collect all static hints concurrently
+ */
+Z_PRIVATE void __prob_disassembler_collect_static_hints(ProbDisassembler *pd);
+
+Z_PRIVATE void __prob_disassembler_record_hints(Buffer *hints,
+                                                HintRecordKind kind,
+                                                addr_t addr, size_t n,
+                                                logprob_t val) {
+    assert(n && n <= UINT32_MAX);
+
+    HintRecord record = {
+        .addr = addr,
+        .n = (uint32_t)n,
+        .kind = kind,
+        .val = val,
+    };
+    z_buffer_append_raw(hints, (uint8_t *)&record, sizeof(HintRecord));
+}
+
+Z_PRIVATE void __prob_disassembler_apply_hint_records(ProbDisassembler *pd,
+                                                      Buffer *hints) {
+    const HintRecord *records = (HintRecord *)z_buffer_get_raw_buf(hints);
+    size_t record_n = z_buffer_get_size(hints) / sizeof(HintRecord);
+
+    for (size_t i = 0; i < record_n; i++) {
+        const HintRecord *record = records + i;
+        for (addr_t addr = record->addr; addr < record->addr + record->n;
+             addr++) {
+            switch (record->kind) {
+                case HINT_RECORD_INST_HINT:
+                    __prob_disassembler_update_inst_hint(pd, addr, record->val);
+                    break;
+                case HINT_RECORD_INST_LOST:
+                    __prob_disassembler_update_inst_lost(pd, addr, record->val);
+                    break;
+                case HINT_RECORD_DATA_HINT:
+                    __prob_disassembler_update_data_hint(pd, addr, record->val);
+                    break;
+                default:
+                    EXITME("invalid hint record: %d", record->kind);
+            }
+        }
+    }
+}
 
 Z_PRIVATE void __prob_disassembler_reg_hints_dfs(
-    ProbDisassembler *pd, GHashTable *seen,
-    Buffer *(*get_next)(UCFG_Analyzer *, addr_t),
-    void (*update_info)(ProbDisassembler *, addr_t, RegInfo *), addr_t cur_addr,
-    RegInfo *info, bool is_first_addr) {
+    ProbDisassembler *pd, Buffer *hints, GHashTable *seen,
+    UEdgeSpan (*get_next)(UCFG_Analyzer *, addr_t),
+    void (*update_info)(ProbDisassembler *, Buffer *, addr_t, RegInfo *),
+    addr_t cur_addr, RegInfo *info, bool is_first_addr) {
     Disassembler *d = pd->base;
 
     // step [0]. if info in zero, we do not need to go deeper
@@ -98,18 +243,18 @@ Z_PRIVATE void __prob_disassembler_reg_hints_dfs(
     }
 
     // step [1]. check cur_addr is valid
-    if (!z_disassembler_get_superset_disasm(d, cur_addr)) {
+    if (!z_disassembler_get_superset_inst(d, cur_addr)) {
         return;
     }
 
     // step [2]. get all necessary information
     Iter(addr_t, next_addrs);
-    z_iter_init_from_buf(next_addrs, (*get_next)(d->ucfg_analyzer, cur_addr));
+    z_iter_init_from_span(next_addrs, (*get_next)(d->ucfg_analyzer, cur_addr));
 
     // step [3]. collect hints and update next info
     RegInfo backup_info = *info;
     if (!is_first_addr) {
-        (*update_info)(pd, cur_addr, info);
+        (*update_info)(pd, hints, cur_addr, info);
     }
 
     // step [4]. go deep
@@ -123,15 +268,16 @@ Z_PRIVATE void __prob_disassembler_reg_hints_dfs(
                             GSIZE_TO_POINTER(1));
 
         // deep search
-        __prob_disassembler_reg_hints_dfs(pd, seen, get_next, update_info,
-                                          next_addr, info, false);
+        __prob_disassembler_reg_hints_dfs(pd, hints, seen, get_next,
+                                          update_info, next_addr, info, false);
     }
 
     // step [5]. restore info
     *info = backup_info;
 }
 
-Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd) {
+Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd,
+                                                    Buffer *hints) {
     // step [0]. create call_/jmp_ targets and other basic information
     GHashTable *call_targets =
         g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
@@ -171,21 +317,23 @@ Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd) {
 
     // step [2]. main loop to check all instruction
     for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        // step [2.1]. get corresponding instruction
-        cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
-        if (!inst) {
+        // step [2.1]. check the instruction is a direct call/jmp/cjmp, which
+        // has only one imm operand
+        const SInst *sinst = z_disassembler_get_superset_inst(d, addr);
+        if (!sinst || !z_sinst_is(sinst, DIRECT)) {
             continue;
         }
-
-        // step [2.2]. check the instruction only has one imm operand
-        cs_detail *detail = inst->detail;
-        if ((detail->x86.op_count != 1) ||
-            (detail->x86.operands[0].type != X86_OP_IMM)) {
+        if (!z_sinst_is(sinst, CALL) && !z_sinst_is(sinst, JMP) &&
+            !z_sinst_is(sinst, CJMP)) {
             continue;
         }
 
+        // step [2.2]. get corresponding instruction
+        cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
+        assert(inst);
+
         // step [2.3]. handle different cf transfer instruction
-        addr_t target = detail->x86.operands[0].imm;
+        addr_t target = z_sinst_get_target(sinst, addr);
 
 #define __COLLECT_CF_TARGET(TYPE, plt_check, targets)                       \
     do {                                                                    \
@@ -207,8 +355,9 @@ Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd) {
             /* for PLT transfer, we have further check */                   \
             if (plt_check) {                                                \
                 z_trace("find PLT " #TYPE ": " CS_SHOW_INST(inst));         \
-                __prob_disassembler_update_inst_hint(                       \
-                    pd, addr, HINT(PLT_##TYPE, BASE_CF(inst) * plt_n));     \
+                __prob_disassembler_record_inst_hint(                       \
+                    hints, addr,                                            \
+                    HINT(PLT_##TYPE, BASE_CF(inst) + log(plt_n)));          \
             }                                                               \
             continue;                                                       \
         }                                                                   \
@@ -218,13 +367,14 @@ Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd) {
             (target < init_addr || target >= init_addr + init_size) &&      \
             (target < fini_addr || target >= fini_addr + fini_size)) {      \
             z_trace("find outside " #TYPE ": " CS_SHOW_INST(inst));         \
-            __prob_disassembler_update_inst_lost(                           \
-                pd, addr, LOST(OUTSIDE_##TYPE, BASE_CF(inst) * text_size)); \
+            __prob_disassembler_record_inst_lost(                           \
+                hints, addr,                                                \
+                LOST(OUTSIDE_##TYPE, BASE_CF(inst) + log(text_size)));      \
             continue;                                                       \
         }                                                                   \
                                                                             \
         /* check target is valid */                                         \
-        if (!z_disassembler_get_superset_disasm(d, target)) {               \
+        if (!z_disassembler_get_superset_inst(d, target)) {                 \
             continue;                                                       \
         }                                                                   \
                                                                             \
@@ -275,10 +425,10 @@ Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd) {
             cs_insn *caller_inst =
                 z_disassembler_get_superset_disasm(d, caller);
             assert(caller_inst);
-            __prob_disassembler_update_inst_hint(
-                pd, caller,
-                HINT(CONVERGED_CALL,
-                     BASE_CF(caller_inst) / (z_iter_get_size(callers) - 1)));
+            __prob_disassembler_record_inst_hint(
+                hints, caller,
+                HINT(CONVERGED_CALL, BASE_CF(caller_inst) -
+                                         log(z_iter_get_size(callers) - 1)));
         }
     }
     g_hash_table_destroy(call_targets);
@@ -304,10 +454,10 @@ Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd) {
                 cs_insn *jmp_source_inst =
                     z_disassembler_get_superset_disasm(d, jmp_source);
                 assert(jmp_source_inst);
-                __prob_disassembler_update_inst_hint(
-                    pd, jmp_source,
+                __prob_disassembler_record_inst_hint(
+                    hints, jmp_source,
                     HINT(CONVERGED_JMP,
-                         BASE_CF(jmp_source_inst) / (jmp_sources_n - 1)));
+                         BASE_CF(jmp_source_inst) - log(jmp_sources_n - 1)));
             }
         }
 
@@ -334,21 +484,23 @@ Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd) {
 
             // check pred's succs are valid
             Iter(addr_t, pred_succs);
-            z_iter_init_from_buf(
+            z_iter_init_from_span(
                 pred_succs,
-                z_ucfg_analyzer_get_direct_successors(d->ucfg_analyzer, pred));
+                z_ucfg_analyzer_peek_direct_successors(d->ucfg_analyzer,
+                                                       pred));
 
             while (!z_iter_is_empty(pred_succs)) {
                 addr_t pred_succ = *(z_iter_next(pred_succs));
-                if (!z_disassembler_get_superset_disasm(d, pred_succ)) {
+                if (!z_disassembler_get_superset_inst(d, pred_succ)) {
                     goto NEXT_PRED;
                 }
             }
 
             // collect hints for pred, where we assume most crossed jump is only
             // 1-byte
-            __prob_disassembler_update_inst_hint(
-                pd, pred, HINT(CROSSED_JMP, BASE_CF_RAW(1) / jmp_sources_n));
+            __prob_disassembler_record_inst_hint(
+                hints, pred,
+                HINT(CROSSED_JMP, BASE_CF_RAW(1) - log(jmp_sources_n)));
 
             // collect hints for jump sources
             z_iter_reset(jmp_sources);
@@ -359,10 +511,10 @@ Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd) {
                 cs_insn *jmp_source_inst =
                     z_disassembler_get_superset_disasm(d, jmp_source);
                 assert(jmp_source_inst);
-                __prob_disassembler_update_inst_hint(
-                    pd, jmp_source,
+                __prob_disassembler_record_inst_hint(
+                    hints, jmp_source,
                     HINT(CROSSED_JMP,
-                         BASE_CF(jmp_source_inst) / jmp_sources_n));
+                         BASE_CF(jmp_source_inst) - log(jmp_sources_n)));
             }
 
         NEXT_PRED:;
@@ -376,14 +528,18 @@ Z_PRIVATE void __prob_disassembler_collect_cf_hints(ProbDisassembler *pd) {
  * Note that following two functions will only be used during dfs
  */
 Z_PRIVATE void __update_info_for_usedef_reg_hint(ProbDisassembler *pd,
-                                                 addr_t addr, RegInfo *info) {
+                                                 Buffer *hints, addr_t addr,
+                                                 RegInfo *info) {
     Disassembler *d = pd->base;
 
-    RegState *rs = z_ucfg_analyzer_get_register_state(d->ucfg_analyzer, addr);
-    assert(rs);
+    RegState state;
+    if (!z_ucfg_analyzer_get_register_state(d->ucfg_analyzer, addr, &state)) {
+        EXITME("missing register state: %#lx", addr);
+    }
+    const RegState *rs = &state;
 
     if (rs->gpr_write_32_64 & info->gpr) {
-        __prob_disassembler_update_inst_hint(pd, addr,
+        __prob_disassembler_record_inst_hint(hints, addr,
                                              HINT(USEDEF_GPR, BASE_REG));
         info->gpr &= (~rs->gpr_write_32_64);
     }
@@ -391,8 +547,8 @@ Z_PRIVATE void __update_info_for_usedef_reg_hint(ProbDisassembler *pd,
 #define __SSE_TEMPLATE(T)                                                     \
     do {                                                                      \
         if (rs->T##_write & info->T) {                                        \
-            __prob_disassembler_update_inst_hint(pd, addr,                    \
-                                                 HINT(USEDEF_SSE, BASE_REG)); \
+            __prob_disassembler_record_inst_hint(                             \
+                hints, addr, HINT(USEDEF_SSE, BASE_REG));                     \
             info->T &= (~rs->T##_write);                                      \
         }                                                                     \
     } while (0)
@@ -405,14 +561,18 @@ Z_PRIVATE void __update_info_for_usedef_reg_hint(ProbDisassembler *pd,
 }
 
 Z_PRIVATE void __update_info_for_killed_reg_hint(ProbDisassembler *pd,
-                                                 addr_t addr, RegInfo *info) {
+                                                 Buffer *hints, addr_t addr,
+                                                 RegInfo *info) {
     Disassembler *d = pd->base;
 
-    RegState *rs = z_ucfg_analyzer_get_register_state(d->ucfg_analyzer, addr);
-    assert(rs);
+    RegState state;
+    if (!z_ucfg_analyzer_get_register_state(d->ucfg_analyzer, addr, &state)) {
+        EXITME("missing register state: %#lx", addr);
+    }
+    const RegState *rs = &state;
 
     if (rs->gpr_write_32_64 & info->gpr) {
-        __prob_disassembler_update_inst_lost(pd, addr,
+        __prob_disassembler_record_inst_lost(hints, addr,
                                              LOST(KILLED_GPR, BASE_REG));
         info->gpr &= (~rs->gpr_write_32_64);
     }
@@ -423,8 +583,8 @@ Z_PRIVATE void __update_info_for_killed_reg_hint(ProbDisassembler *pd,
 #define __SSE_TEMPLATE(T)                                                     \
     do {                                                                      \
         if (rs->T##_write & info->T) {                                        \
-            __prob_disassembler_update_inst_lost(pd, addr,                    \
-                                                 LOST(KILLED_SSE, BASE_REG)); \
+            __prob_disassembler_record_inst_lost(                             \
+                hints, addr, LOST(KILLED_SSE, BASE_REG));                     \
             info->T &= (~rs->T##_write);                                      \
         }                                                                     \
         if (rs->T##_read & info->T) {                                         \
@@ -439,7 +599,8 @@ Z_PRIVATE void __update_info_for_killed_reg_hint(ProbDisassembler *pd,
 #undef __SSE_TEMPLATE
 }
 
-Z_PRIVATE void __prob_disassembler_collect_reg_hints(ProbDisassembler *pd) {
+Z_PRIVATE void __prob_disassembler_collect_reg_hints(ProbDisassembler *pd,
+                                                     Buffer *hints) {
     Disassembler *d = pd->base;
     addr_t text_addr = pd->text_addr;
     size_t text_size = pd->text_size;
@@ -449,11 +610,12 @@ Z_PRIVATE void __prob_disassembler_collect_reg_hints(ProbDisassembler *pd) {
     RegInfo info = {};
 
     for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        RegState *rs =
-            z_ucfg_analyzer_get_register_state(d->ucfg_analyzer, addr);
-        if (!rs) {
+        RegState state;
+        if (!z_ucfg_analyzer_get_register_state(d->ucfg_analyzer, addr,
+                                                &state)) {
             continue;
         }
+        const RegState *rs = &state;
 
         /*
          * step [1]. get use-def hints
@@ -467,7 +629,7 @@ Z_PRIVATE void __prob_disassembler_collect_reg_hints(ProbDisassembler *pd) {
         g_hash_table_insert(seen, GSIZE_TO_POINTER(addr), GSIZE_TO_POINTER(1));
 
         __prob_disassembler_reg_hints_dfs(
-            pd, seen, &z_ucfg_analyzer_get_direct_predecessors,
+            pd, hints, seen, &z_ucfg_analyzer_peek_direct_predecessors,
             &__update_info_for_usedef_reg_hint, addr, &info, true);
 
         /*
@@ -482,18 +644,19 @@ Z_PRIVATE void __prob_disassembler_collect_reg_hints(ProbDisassembler *pd) {
         g_hash_table_insert(seen, GSIZE_TO_POINTER(addr), GSIZE_TO_POINTER(1));
 
         __prob_disassembler_reg_hints_dfs(
-            pd, seen, &z_ucfg_analyzer_get_direct_predecessors,
+            pd, hints, seen, &z_ucfg_analyzer_peek_direct_predecessors,
             &__update_info_for_killed_reg_hint, addr, &info, true);
     }
 }
 
-Z_PRIVATE void __prob_disassembler_collect_pop_ret_hints(ProbDisassembler *pd) {
+Z_PRIVATE void __prob_disassembler_collect_pop_ret_hints(ProbDisassembler *pd,
+                                                         Buffer *hints) {
     Disassembler *d = pd->base;
     addr_t text_addr = pd->text_addr;
     size_t text_size = pd->text_size;
 
     for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
+        const SInst *inst = z_disassembler_get_superset_inst(d, addr);
         if (!inst) {
             continue;
         }
@@ -504,13 +667,13 @@ Z_PRIVATE void __prob_disassembler_collect_pop_ret_hints(ProbDisassembler *pd) {
 
         size_t pop_n = 0;
         addr_t cur_addr = addr;
-        cs_insn *cur_inst = inst;
+        const SInst *cur_inst = inst;
         bool pop_ret = false;
 
         while (true) {
             pop_n += 1;
             cur_addr += cur_inst->size;
-            cur_inst = z_disassembler_get_superset_disasm(d, cur_addr);
+            cur_inst = z_disassembler_get_superset_inst(d, cur_addr);
 
             if (!cur_inst) {
                 break;
@@ -529,139 +692,226 @@ Z_PRIVATE void __prob_disassembler_collect_pop_ret_hints(ProbDisassembler *pd) {
         }
 
         z_trace("find %d pop at %#lx", pop_n, addr);
-        __prob_disassembler_update_inst_hint(pd, addr,
-                                             HINT(POP_RET, BASE_REG / pop_n));
+        __prob_disassembler_record_inst_hint(
+            hints, addr, HINT(POP_RET, BASE_REG - log(pop_n)));
+    }
+}
+
+Z_PRIVATE size_t __prob_disassembler_next_matched(const uint64_t *matched,
+                                                 size_t i, size_t n) {
+    while (i < n) {
+        uint64_t bits = matched[i / 64] >> (i % 64);
+        if (bits) {
+            i += __builtin_ctzl(bits);
+            return (i < n ? i : n);
+        }
+        i = (i / 64 + 1) * 64;
     }
+    return n;
 }
 
-Z_PRIVATE void __prob_disassembler_collect_str_hints(ProbDisassembler *pd) {
+Z_PRIVATE void __prob_disassembler_collect_str_hints(ProbDisassembler *pd,
+                                                     Buffer *hints) {
     addr_t text_addr = pd->text_addr;
     size_t text_size = pd->text_size;
 
     ELF *e = z_binary_get_elf(pd->binary);
     Rptr *text_ptr = z_elf_vaddr2ptr(e, text_addr);
+    const uint8_t *code =
+        (const uint8_t *)z_rptr_safe_raw_ptr(text_ptr, text_size);
+
+    // collect all string-like hints, where bytes are classified chunk by chunk
+    // (refer to kernels.c). A string can only be ended by a byte which is
+    // neither printable nor null, so that we go through bytes between two such
+    // bytes (i.e., a segment) at once.
+    uint64_t printable[DATA_HINT_CHUNK_SIZE / 64];
+    uint64_t nul[DATA_HINT_CHUNK_SIZE / 64];
 
-    // collect all string-like hints
     addr_t prev_string = INVALID_ADDR;
     addr_t prev_null = INVALID_ADDR;
-    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        uint8_t c = *(z_rptr_get_ptr(text_ptr, uint8_t));
-        if (!c) {
-            if (prev_string != INVALID_ADDR) {
-                // we ignore null during string scanning
-                prev_null = addr;
-            }
-        } else if (isprint(c)) {
-            if (prev_string == INVALID_ADDR) {
-                prev_string = addr;
-                prev_null = INVALID_ADDR;
-            }
-        } else {
-            if (prev_string != INVALID_ADDR && prev_null != INVALID_ADDR) {
-                assert(prev_null > prev_string);
-                size_t n = prev_null - prev_string;
-                if (n > STRING_LENGTH_THRESHOLD) {
-                    z_trace("find string starting from %#lx with %d bytes",
-                            prev_string, n);
-                    double128_t hint;
-                    if (n < CONFIDENT_LENGTH_THRESHOLD) {
-                        hint = HINT(STRING, BASE_STRING(n));
-                    } else {
-                        hint = +INFINITY;
+    for (size_t chunk_off = 0; chunk_off < text_size;
+         chunk_off += DATA_HINT_CHUNK_SIZE) {
+        size_t chunk_n = text_size - chunk_off;
+        if (chunk_n > DATA_HINT_CHUNK_SIZE) {
+            chunk_n = DATA_HINT_CHUNK_SIZE;
+        }
+        __pdisasm_kernels_classify(pd->kernels, printable, nul,
+                                   code + chunk_off, chunk_n);
+
+        for (size_t w = 0; w * 64 < chunk_n; w++) {
+            addr_t base_addr = text_addr + chunk_off + w * 64;
+            size_t bit_n = chunk_n - w * 64;
+            uint64_t rest = (bit_n >= 64 ? ~0UL : (1UL << bit_n) - 1);
+            uint64_t ends = ~(printable[w] | nul[w]) & rest;
+
+            while (rest) {
+                // step [1]. get the segment before the next end
+                uint64_t end = ends & rest & -(ends & rest);
+                uint64_t segment = (end ? end - 1 : ~0UL) & rest;
+
+                // step [2]. the first printable byte starts a string, and we
+                // ignore null during string scanning
+                if (prev_string == INVALID_ADDR) {
+                    uint64_t bits = printable[w] & segment;
+                    if (bits) {
+                        prev_string = base_addr + __builtin_ctzl(bits);
+                        prev_null = INVALID_ADDR;
                     }
-                    for (addr_t cur_addr = prev_string; cur_addr <= prev_null;
-                         cur_addr++) {
-                        __prob_disassembler_update_data_hint(pd, cur_addr,
-                                                             hint);
+                    segment &= ~((bits & -bits) - 1);
+                }
+                uint64_t bits = nul[w] & segment;
+                if (prev_string != INVALID_ADDR && bits) {
+                    prev_null = base_addr + 63 - __builtin_clzl(bits);
+                }
+
+                if (!end) {
+                    break;
+                }
+
+                // step [3]. the end byte
+                if (prev_string != INVALID_ADDR && prev_null != INVALID_ADDR) {
+                    assert(prev_null > prev_string);
+                    size_t n = prev_null - prev_string;
+                    if (n > STRING_LENGTH_THRESHOLD) {
+                        z_trace("find string starting from %#lx with %d bytes",
+                                prev_string, n);
+                        logprob_t hint;
+                        if (n < CONFIDENT_LENGTH_THRESHOLD) {
+                            hint = HINT(STRING, BASE_STRING(n));
+                        } else {
+                            hint = +INFINITY;
+                        }
+                        __prob_disassembler_record_data_hints(
+                            hints, prev_string, prev_null - prev_string + 1,
+                            hint);
                     }
                 }
+                prev_string = INVALID_ADDR;
+                prev_null = INVALID_ADDR;
+
+                rest &= ~(end | (end - 1));
             }
-            prev_string = INVALID_ADDR;
-            prev_null = INVALID_ADDR;
         }
-
-        z_rptr_inc(text_ptr, uint8_t, 1);
     }
 
     z_rptr_destroy(text_ptr);
 }
 
-Z_PRIVATE void __prob_disassembler_collect_value_hints(ProbDisassembler *pd) {
+Z_PRIVATE void __prob_disassembler_collect_value_hints(ProbDisassembler *pd,
+                                                       Buffer *hints) {
+    uint64_t matched[DATA_HINT_CHUNK_SIZE / 64];
+
 /*
  * Macro to collect continuous numerical number:
  *      T: type (int16_t, int32_t, int64_t)
  *      B: bit offset of size (1, 2, 3)
  *      L: length threshold
  *      C: count zero and 0xff
+ *
+ * Values are matched with their previous ones chunk by chunk (refer to
+ * kernels.c). As a numerical array with only one value is always ended by a
+ * not-matched value, without any hint (as 1 <= L), such values are skipped
+ * at once.
  */
-#define __COLLECT_VALUE_HINTS(T, B, L, C)                                    \
-    do {                                                                     \
-        assert(sizeof(T) == (1 << B));                                       \
-                                                                             \
-        addr_t text_addr = pd->text_addr;                                    \
-        size_t text_size = pd->text_size;                                    \
-        double128_t threshold = __pow_in_4(0x100, (B));                      \
-        z_trace("threshold: %Lf", threshold);                                \
-                                                                             \
-        /* alignment */                                                      \
-        text_size = BITS_ALIGN_FLOOR(text_addr + text_size, (B));            \
-        text_addr = BITS_ALIGN_CELL(text_addr, (B));                         \
-        text_size -= text_addr;                                              \
-        z_trace("aligned range: [%#lx, %#lx]", text_addr,                    \
-                text_addr + text_size - 1);                                  \
-        assert(!(text_addr % sizeof(T)));                                    \
-        assert(!(text_size % sizeof(T)));                                    \
-                                                                             \
-        ELF *e = z_binary_get_elf(pd->binary);                               \
-        Rptr *text_ptr = z_elf_vaddr2ptr(e, text_addr);                      \
-                                                                             \
-        /* collect continued likely numerical value */                       \
-        addr_t numerical_addr = INVALID_ADDR;                                \
-        double128_t numerical_val = 0.0;                                     \
-        for (addr_t addr = text_addr; addr < text_addr + text_size;          \
-             addr += sizeof(T)) {                                            \
-            T val = *(z_rptr_get_ptr(text_ptr, T));                          \
-            double128_t val_f = (double128_t)val;                            \
-            size_t n = (addr - numerical_addr) >> (B);                       \
-                                                                             \
-            if (numerical_addr == INVALID_ADDR) {                            \
-                /* the first value */                                        \
-                numerical_addr = addr;                                       \
-                numerical_val = val_f;                                       \
-            } else if ((!(C)) && (val == 0 || val == -1)) {                  \
-                /* we ignore 0 and 0xfff..ff. Hence, do nothing. */          \
-            } else if (fabsl(numerical_val - val_f) < threshold) {           \
-                /* valid numerical number */                                 \
-                numerical_val =                                              \
-                    (numerical_val / (n + 1)) * n + (val_f / (n + 1));       \
-            } else {                                                         \
-                if (n > (L)) {                                               \
-                    z_trace(                                                 \
-                        "find %d-byte numerical array from %#lx with %d "    \
-                        "elements (mean: %.2Lf)",                            \
-                        sizeof(T), numerical_addr, n, numerical_val);        \
-                    double128_t hint;                                        \
-                    if (n < CONFIDENT_LENGTH_THRESHOLD) {                    \
-                        hint = HINT(VALUE,                                   \
-                                    BASE_VALUE(1 << (B), threshold * 2, n)); \
-                    } else {                                                 \
-                        hint = +INFINITY;                                    \
-                    }                                                        \
-                    for (addr_t cur_addr = numerical_addr; cur_addr < addr;  \
-                         cur_addr++) {                                       \
-                        __prob_disassembler_update_data_hint(pd, cur_addr,   \
-                                                             hint);          \
-                    }                                                        \
-                }                                                            \
-                                                                             \
-                numerical_addr = addr;                                       \
-                numerical_val = val_f;                                       \
-            }                                                                \
-                                                                             \
-            z_rptr_inc(text_ptr, T, 1);                                      \
-        }                                                                    \
-                                                                             \
-        z_rptr_destroy(text_ptr);                                            \
+#define __COLLECT_VALUE_HINTS(T, B, L, C)                                     \
+    do {                                                                      \
+        assert(sizeof(T) == (1 << B));                                        \
+                                                                              \
+        addr_t text_addr = pd->text_addr;                                     \
+        size_t text_size = pd->text_size;                                     \
+        double128_t threshold = __value_threshold_lut[(B)];                   \
+        z_trace("threshold: %Lf", threshold);                                 \
+                                                                              \
+        /* alignment */                                                       \
+        text_size = BITS_ALIGN_FLOOR(text_addr + text_size, (B));             \
+        text_addr = BITS_ALIGN_CELL(text_addr, (B));                          \
+        text_size -= text_addr;                                               \
+        z_trace("aligned range: [%#lx, %#lx]", text_addr,                     \
+                text_addr + text_size - 1);                                   \
+        assert(!(text_addr % sizeof(T)));                                     \
+        assert(!(text_size % sizeof(T)));                                     \
+                                                                              \
+        ELF *e = z_binary_get_elf(pd->binary);                                \
+        Rptr *text_ptr = z_elf_vaddr2ptr(e, text_addr);                       \
+        const uint8_t *code =                                                 \
+            (const uint8_t *)z_rptr_safe_raw_ptr(text_ptr, text_size);        \
+        size_t val_n = text_size >> (B);                                      \
+                                                                              \
+        /* XXX: as threshold is a small integer, |val_f - numerical_val| <    \
+         * threshold never holds for a not-matched value, even if rounding    \
+         * happens */                                                         \
+        uint64_t max_diff = (uint64_t)ceill(threshold) - 1;                   \
+                                                                              \
+        /* collect continued likely numerical value */                        \
+        addr_t numerical_addr = INVALID_ADDR;                                 \
+        double128_t numerical_val = 0.0;                                      \
+        for (size_t chunk_idx = 0; chunk_idx < val_n;                         \
+             chunk_idx += DATA_HINT_CHUNK_SIZE) {                             \
+            const T *vals = (const T *)(code + (chunk_idx << (B)));           \
+            size_t chunk_n = val_n - chunk_idx;                               \
+            if (chunk_n > DATA_HINT_CHUNK_SIZE) {                             \
+                chunk_n = DATA_HINT_CHUNK_SIZE;                               \
+            }                                                                 \
+            __pdisasm_kernels_match(pd->kernels, matched,                     \
+                                    (const uint8_t *)vals, (B), (C),          \
+                                    max_diff, chunk_n);                       \
+                                                                              \
+            for (size_t i = 0; i < chunk_n; i++) {                            \
+                addr_t addr = text_addr + ((chunk_idx + i) << (B));           \
+                                                                              \
+                /* skip not-matched values following a single value */        \
+                if (numerical_addr + sizeof(T) == addr &&                     \
+                    !(matched[i / 64] & (1UL << (i % 64)))) {                 \
+                    i = __prob_disassembler_next_matched(matched, i + 1,      \
+                                                         chunk_n);            \
+                    numerical_addr =                                          \
+                        text_addr + ((chunk_idx + i - 1) << (B));             \
+                    numerical_val = (double128_t)vals[i - 1];                 \
+                    if (i == chunk_n) {                                       \
+                        break;                                                \
+                    }                                                         \
+                    addr = text_addr + ((chunk_idx + i) << (B));              \
+                }                                                             \
+                                                                              \
+                T val = vals[i];                                              \
+                double128_t val_f = (double128_t)val;                         \
+                size_t n = (addr - numerical_addr) >> (B);                    \
+                                                                              \
+                if (numerical_addr == INVALID_ADDR) {                         \
+                    /* the first value */                                     \
+                    numerical_addr = addr;                                    \
+                    numerical_val = val_f;                                    \
+                } else if ((!(C)) && (val == 0 || val == -1)) {               \
+                    /* we ignore 0 and 0xfff..ff. Hence, do nothing. */       \
+                } else if (fabsl(numerical_val - val_f) < threshold) {        \
+                    /* valid numerical number */                              \
+                    numerical_val =                                           \
+                        (numerical_val / (n + 1)) * n + (val_f / (n + 1));    \
+                } else {                                                      \
+                    if (n > (L)) {                                            \
+                        z_trace(                                              \
+                            "find %d-byte numerical array from %#lx with "    \
+                            "%d elements (mean: %.2Lf)",                      \
+                            sizeof(T), numerical_addr, n, numerical_val);     \
+                        logprob_t hint;                                       \
+                        if (n < CONFIDENT_LENGTH_THRESHOLD) {                 \
+                            hint = HINT(VALUE, BASE_VALUE(1 << (B),           \
+                                                          threshold * 2, n)); \
+                        } else {                                              \
+                            hint = +INFINITY;                                 \
+                        }                                                     \
+                        __prob_disassembler_record_data_hints(                \
+                            hints, numerical_addr, addr - numerical_addr,     \
+                            hint);                                            \
+                    }                                                         \
+                                                                              \
+                    numerical_addr = addr;                                    \
+                    numerical_val = val_f;                                    \
+                }                                                             \
+            }                                                                 \
+        }                                                                     \
+                                                                              \
+        z_rptr_destroy(text_ptr);                                             \
     } while (0)
 
     __COLLECT_VALUE_HINTS(int8_t, 0, VALUE_LENGTH_THRESHOLD << 2, true);
@@ -672,14 +922,14 @@ Z_PRIVATE void __prob_disassembler_collect_value_hints(ProbDisassembler *pd) {
 #undef __COLLECT_VALUE_HINTS
 }
 
-Z_PRIVATE void __prob_disassembler_collect_cmp_cjmp_hints(
-    ProbDisassembler *pd) {
+Z_PRIVATE void __prob_disassembler_collect_cmp_cjmp_hints(ProbDisassembler *pd,
+                                                          Buffer *hints) {
     Disassembler *d = pd->base;
     addr_t text_addr = pd->text_addr;
     size_t text_size = pd->text_size;
 
     for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
+        const SInst *inst = z_disassembler_get_superset_inst(d, addr);
 
         // check valid
         if (!inst) {
@@ -694,12 +944,13 @@ Z_PRIVATE void __prob_disassembler_collect_cmp_cjmp_hints(
         // try to find a cjmp within CMP_CJMP_DISTANCE
         bool found_cjmp = false;
         addr_t cur_addr = addr;
-        cs_insn *cur_inst = inst;
+        const SInst *cur_inst = inst;
         Iter(addr_t, succ_addrs);
 
         for (size_t i = 0; i < CMP_CJMP_DISTANCE; i++) {
-            z_iter_init_from_buf(
-                succ_addrs, z_disassembler_get_direct_successors(d, cur_addr));
+            z_iter_init_from_span(
+                succ_addrs,
+                z_disassembler_peek_direct_successors(d, cur_addr));
             if (z_iter_get_size(succ_addrs) != 1) {
                 break;
             }
@@ -711,13 +962,13 @@ Z_PRIVATE void __prob_disassembler_collect_cmp_cjmp_hints(
 
             // switch into next address
             cur_addr = succ_addr;
-            cur_inst = z_disassembler_get_superset_disasm(d, cur_addr);
+            cur_inst = z_disassembler_get_superset_inst(d, cur_addr);
 
             if (!cur_inst) {
                 break;
             }
 
-            if (z_capstone_is_cjmp(cur_inst)) {
+            if (z_sinst_is(cur_inst, CJMP)) {
                 found_cjmp = true;
                 break;
             }
@@ -725,32 +976,33 @@ Z_PRIVATE void __prob_disassembler_collect_cmp_cjmp_hints(
 
         if (found_cjmp) {
             z_trace("find cmp-cjmp pattern at %#lx - %#lx", addr, cur_addr);
-            __prob_disassembler_update_inst_hint(
-                pd, addr, HINT(CMP_CJMP, __pow_in_4(BASE_INS, 2)));
+            __prob_disassembler_record_inst_hint(
+                hints, addr, HINT(CMP_CJMP, BASE_INS * 2));
         }
     }
 }
 
-Z_PRIVATE void __prob_disassembler_collect_arg_call_hints(
-    ProbDisassembler *pd) {
+Z_PRIVATE void __prob_disassembler_collect_arg_call_hints(ProbDisassembler *pd,
+                                                          Buffer *hints) {
     Disassembler *d = pd->base;
     addr_t text_addr = pd->text_addr;
     size_t text_size = pd->text_size;
 
     for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
+        const SInst *sinst = z_disassembler_get_superset_inst(d, addr);
 
         // check valid
-        if (!inst) {
+        if (!sinst) {
             continue;
         }
 
         // check mov
-        if (inst->id != X86_INS_MOV) {
+        if (sinst->id != X86_INS_MOV) {
             continue;
         }
 
         // check the rdi and rsi
+        cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
         cs_detail *detail = inst->detail;
         if (detail->x86.operands[0].type != X86_OP_REG) {
             continue;
@@ -763,12 +1015,13 @@ Z_PRIVATE void __prob_disassembler_collect_arg_call_hints(
         // try to find a call within ARG_CALL_DISTANCE
         bool found_call = false;
         addr_t cur_addr = addr;
-        cs_insn *cur_inst = inst;
+        const SInst *cur_inst = sinst;
         Iter(addr_t, succ_addrs);
 
         for (size_t i = 0; i < ARG_CALL_DISTANCE; i++) {
-            z_iter_init_from_buf(
-                succ_addrs, z_disassembler_get_direct_successors(d, cur_addr));
+            z_iter_init_from_span(
+                succ_addrs,
+                z_disassembler_peek_direct_successors(d, cur_addr));
             if (z_iter_get_size(succ_addrs) != 1) {
                 break;
             }
@@ -780,13 +1033,13 @@ Z_PRIVATE void __prob_disassembler_collect_arg_call_hints(
 
             // switch into next address
             cur_addr = succ_addr;
-            cur_inst = z_disassembler_get_superset_disasm(d, cur_addr);
+            cur_inst = z_disassembler_get_superset_inst(d, cur_addr);
 
             if (!cur_inst) {
                 break;
             }
 
-            if (z_capstone_is_call(cur_inst)) {
+            if (z_sinst_is(cur_inst, CALL)) {
                 found_call = true;
                 break;
             }
@@ -794,8 +1047,41 @@ Z_PRIVATE void __prob_disassembler_collect_arg_call_hints(
 
         if (found_call) {
             z_trace("find arg-call pattern at %#lx - %#lx", addr, cur_addr);
-            __prob_disassembler_update_inst_hint(
-                pd, addr, HINT(ARG_CALL, __pow_in_4(BASE_INS, 2)));
+            __prob_disassembler_record_inst_hint(
+                hints, addr, HINT(ARG_CALL, BASE_INS * 2));
         }
     }
 }
+
+Z_PRIVATE void __prob_disassembler_collect_hints_task(void *ctx_,
+                                                      size_t task_id) {
+    __HintCollectCtx *ctx = (__HintCollectCtx *)ctx_;
+
+    for (size_t i = 0; i < HINT_COLLECTOR_N; i++) {
+        if (__hint_collectors[i].task_id == task_id) {
+            (*__hint_collectors[i].fcn)(ctx->pd, ctx->records[i]);
+        }
+    }
+}
+
+Z_PRIVATE void __prob_disassembler_collect_static_hints(ProbDisassembler *pd) {
+    // step [1]. run collectors concurrently. Note that the whole .text is
+    // already superset disassembled, so that collectors only do read-only
+    // lookups (e.g., peeking UCFG edges) on shared structures
+    __HintCollectCtx ctx = {.pd = pd};
+    for (size_t i = 0; i < HINT_COLLECTOR_N; i++) {
+        ctx.records[i] = z_buffer_create(NULL, 0);
+    }
+    z_parallel_run(HINT_COLLECTOR_TASK_N,
+                   &__prob_disassembler_collect_hints_task, &ctx);
+
+    // step [2]. apply records in the serial order, so that the floating-point
+    // results are exactly the same as the serial version
+    for (size_t i = 0; i < HINT_COLLECTOR_N; i++) {
+        __prob_disassembler_apply_hint_records(pd, ctx.records[i]);
+        z_buffer_destroy(ctx.records[i]);
+    }
+}
+
+#undef HINT_COLLECTOR_N
+#undef HINT_COLLECTOR_TASK_N
@@ -0,0 +1,540 @@
+/*
+ * incremental.c
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * After the initial rounds, an update (refer to z_prob_disassembler_update)
+ * only affects a small part of the DAG. Instead of replaying a whole round, an
+ * incremental round recomputes:
+ *      1. hints of the SCCs reachable from the updated ones (the DAG cone);
+ *      2. local D of the cone and of the SCCs occluded with it, and the
+ *         restrained D of their ancestors which is changed accordingly;
+ *      3. local P of the SCCs whose D (or D of their occluded instructions)
+ *         is changed, and the restrained P of their ancestors likewise.
+ * All other SCCs reuse their per-SCC states of the latest round.
+ */
+
+/*
+ * Group addresses by their SCCs (pd->scc_addr_offs and pd->scc_addrs)
+ */
+Z_PRIVATE void __prob_disassembler_build_scc_addrs(ProbDisassembler *pd);
+
+/*
+ * Get D of addr before spreading it into occluded instructions (refer to
+ * __pdisasm_kernel_spread_scalar)
+ */
+Z_PRIVATE bool __prob_disassembler_get_raw_D(ProbDisassembler *pd, addr_t addr,
+                                             logprob_t *D);
+
+/*
+ * Get D of addr before restraint (refer to __prob_disassembler_spread_hints)
+ */
+Z_PRIVATE logprob_t __prob_disassembler_get_spread_D(ProbDisassembler *pd,
+                                                     addr_t addr);
+
+/*
+ * Reset RH of addr as its inst_lost plus the hint of its SCC
+ */
+Z_PRIVATE void __prob_disassembler_refresh_RH(ProbDisassembler *pd,
+                                              addr_t addr);
+
+/*
+ * Insert SCCs of the instructions occluded with addr into sccs
+ */
+Z_PRIVATE void __prob_disassembler_collect_occluded_sccs(ProbDisassembler *pd,
+                                                         addr_t addr,
+                                                         GHashTable *sccs);
+
+/*
+ * Compare SCCs by their topological levels
+ */
+Z_PRIVATE gint __prob_disassembler_compare_scc_levels(gconstpointer a,
+                                                      gconstpointer b,
+                                                      gpointer pd);
+
+/*
+ * Play an incremental round, return false if the per-SCC states of the latest
+ * round are not available
+ */
+Z_PRIVATE bool __prob_disassembler_incremental_round(ProbDisassembler *pd);
+
+#define __FOREACH_SCC_ADDR(pd, scc_id, addr)                      \
+    for (size_t __i = (pd)->scc_addr_offs[(scc_id)];              \
+         __i < (pd)->scc_addr_offs[(scc_id) + 1] &&               \
+         ((addr) = (pd)->text_addr + (pd)->scc_addrs[__i], true); \
+         __i++)
+
+/*
+ * Restrain T of the ancestors of seeds (whose local T are already updated),
+ * and collect SCCs whose restrained T are changed into changed. SCCs are
+ * pulled in the reversed topological order by a bucket of each level, and the
+ * predecessors of an SCC are only revisited when its restrained T changes.
+ */
+#define __DECLARE_INCREMENTAL_RESTRAIN(T, type, op)                           \
+    Z_PRIVATE void __prob_disassembler_incremental_restrain_##T(              \
+        ProbDisassembler *pd, GHashTable *seeds, GHashTable *changed) {       \
+        GQueue **buckets = z_alloc(pd->level_n, sizeof(GQueue *));            \
+        GHashTable *queued =                                                  \
+            g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL); \
+        size_t max_level = 0;                                                 \
+                                                                              \
+        GHashTableIter iter;                                                  \
+        gpointer key, value;                                                  \
+        g_hash_table_iter_init(&iter, seeds);                                 \
+        while (g_hash_table_iter_next(&iter, &key, &value)) {                 \
+            uint32_t level = pd->scc_levels[(uint32_t)key];                   \
+            if (!buckets[level]) {                                            \
+                buckets[level] = g_queue_new();                               \
+            }                                                                 \
+            g_queue_push_tail(buckets[level], key);                           \
+            g_hash_table_add(queued, key);                                    \
+            if (level > max_level) {                                          \
+                max_level = level;                                            \
+            }                                                                 \
+        }                                                                     \
+                                                                              \
+        for (size_t l = max_level + 1; l-- > 0;) {                            \
+            if (!buckets[l]) {                                                \
+                continue;                                                     \
+            }                                                                 \
+                                                                              \
+            while (!g_queue_is_empty(buckets[l])) {                           \
+                uint32_t scc_id = (uint32_t)g_queue_pop_head(buckets[l]);     \
+                                                                              \
+                type T = pd->dag_local_##T[scc_id];                           \
+                for (uint32_t i = pd->dag_succ_offs[scc_id];                  \
+                     i < pd->dag_succ_offs[scc_id + 1]; i++) {                \
+                    type succ_##T = pd->dag_better_##T[pd->dag_succs[i]];     \
+                    if (succ_##T op T) {                                      \
+                        T = succ_##T;                                         \
+                    }                                                         \
+                }                                                             \
+                                                                              \
+                if (T == pd->dag_better_##T[scc_id]) {                        \
+                    continue;                                                 \
+                }                                                             \
+                pd->dag_better_##T[scc_id] = T;                               \
+                g_hash_table_add(changed, GSIZE_TO_POINTER(scc_id));          \
+                                                                              \
+                /* predecessors are always in lower levels */                 \
+                for (uint32_t i = pd->dag_pred_offs[scc_id];                  \
+                     i < pd->dag_pred_offs[scc_id + 1]; i++) {                \
+                    uint32_t pred_scc_id = pd->dag_preds[i];                  \
+                    gpointer pred_key = GSIZE_TO_POINTER(pred_scc_id);        \
+                    if (g_hash_table_contains(queued, pred_key)) {            \
+                        continue;                                             \
+                    }                                                         \
+                    uint32_t level = pd->scc_levels[pred_scc_id];             \
+                    assert(level < l);                                        \
+                    if (!buckets[level]) {                                    \
+                        buckets[level] = g_queue_new();                       \
+                    }                                                         \
+                    g_queue_push_tail(buckets[level], pred_key);              \
+                    g_hash_table_add(queued, pred_key);                       \
+                }                                                             \
+            }                                                                 \
+                                                                              \
+            g_queue_free(buckets[l]);                                         \
+        }                                                                     \
+                                                                              \
+        g_hash_table_destroy(queued);                                         \
+        z_free(buckets);                                                      \
+    }
+
+__DECLARE_INCREMENTAL_RESTRAIN(D, logprob_t, >);
+__DECLARE_INCREMENTAL_RESTRAIN(P, double, <);
+
+#undef __DECLARE_INCREMENTAL_RESTRAIN
+
+Z_PRIVATE void __prob_disassembler_build_scc_addrs(ProbDisassembler *pd) {
+    addr_t text_addr = pd->text_addr;
+    size_t text_size = pd->text_size;
+
+    // counting sort addresses by their SCCs
+    pd->scc_addr_offs = z_alloc(pd->scc_n + 1, sizeof(size_t));
+    pd->scc_addrs = z_alloc(text_size, sizeof(uint32_t));
+
+    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
+        pd->scc_addr_offs[z_addr_dict_get(pd->addr2sccid, addr) + 1]++;
+    }
+    for (uint32_t scc_id = 0; scc_id < pd->scc_n; scc_id++) {
+        pd->scc_addr_offs[scc_id + 1] += pd->scc_addr_offs[scc_id];
+    }
+
+    size_t *cursors = z_alloc(pd->scc_n, sizeof(size_t));
+    memcpy(cursors, pd->scc_addr_offs, pd->scc_n * sizeof(size_t));
+    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
+        uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);
+        pd->scc_addrs[cursors[scc_id]++] = (uint32_t)(addr - text_addr);
+    }
+    assert(pd->scc_addr_offs[pd->scc_n] == text_size);
+
+    z_free(cursors);
+}
+
+Z_PRIVATE bool __prob_disassembler_get_raw_D(ProbDisassembler *pd, addr_t addr,
+                                             logprob_t *D) {
+    // invalid instruction is always data
+    if (!z_addr_dict_get(pd->addr2sccid, addr)) {
+        *D = 0.0;  // log(1.0)
+        return true;
+    }
+
+    logprob_t v = NAN;
+    bool exist = __prob_disassembler_get_data_hint(pd, addr, &v);
+
+    logprob_t RH = NAN;
+    if (__prob_disassembler_get_RH(pd, addr, &RH)) {
+        v = (exist ? v + RH : RH);
+        exist = true;
+    }
+
+    if (!exist) {
+        return false;
+    }
+
+    // reset any D bigger than 1.0 (or being NaN) as 1.0
+    if (__pdisasm_kernel_isnan(v) || v > 0.0) {
+        v = 0.0;
+    }
+
+    *D = v;
+    return true;
+}
+
+Z_PRIVATE logprob_t __prob_disassembler_get_spread_D(ProbDisassembler *pd,
+                                                     addr_t addr) {
+    logprob_t min_D = NAN;
+    if (__prob_disassembler_get_raw_D(pd, addr, &min_D)) {
+        return min_D;
+    }
+
+    // XXX: a full round visits addresses in order, where an address may read
+    // the spread D of a preceding occluded instruction. Here we only read the
+    // raw D of occluded instructions, so that the result does not depend on
+    // the visiting order.
+    const uint32_t *occ_offs = NULL;
+    size_t occ_n = 0;
+    if (!z_disassembler_get_occluded_addrs(pd->base, addr, &occ_offs,
+                                           &occ_n)) {
+        EXITME("invalid instruction without D: %#lx", addr);
+    }
+
+    bool found = false;
+    for (size_t i = 0; i < occ_n; i++) {
+        logprob_t D = NAN;
+        if (__prob_disassembler_get_raw_D(pd, pd->text_addr + occ_offs[i],
+                                          &D)) {
+            if (!found || D < min_D) {
+                min_D = D;
+                found = true;
+            }
+        }
+    }
+
+    if (!found || __logprob_is_one(min_D)) {
+        return 0.0;  // log(1.0)
+    } else {
+        return log1p(-exp(min_D));  // log(1.0 - D)
+    }
+}
+
+Z_PRIVATE void __prob_disassembler_refresh_RH(ProbDisassembler *pd,
+                                              addr_t addr) {
+    logprob_t inst_lost = NAN;
+    if (__prob_disassembler_get_inst_lost(pd, addr, &inst_lost)) {
+        __prob_disassembler_reset_RH(pd, addr, inst_lost);
+    } else {
+        z_addr_dict_remove(pd->RH, addr);
+    }
+
+    uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);
+    if (scc_id && pd->scc_has_hints[scc_id]) {
+        __prob_disassembler_update_RH(pd, addr, pd->scc_hints[scc_id]);
+    }
+}
+
+Z_PRIVATE void __prob_disassembler_collect_occluded_sccs(ProbDisassembler *pd,
+                                                         addr_t addr,
+                                                         GHashTable *sccs) {
+    const uint32_t *occ_offs = NULL;
+    size_t occ_n = 0;
+    if (!z_disassembler_get_occluded_addrs(pd->base, addr, &occ_offs,
+                                           &occ_n)) {
+        return;
+    }
+
+    for (size_t i = 0; i < occ_n; i++) {
+        uint32_t scc_id =
+            z_addr_dict_get(pd->addr2sccid, pd->text_addr + occ_offs[i]);
+        if (scc_id) {
+            g_hash_table_add(sccs, GSIZE_TO_POINTER(scc_id));
+        }
+    }
+}
+
+Z_PRIVATE gint __prob_disassembler_compare_scc_levels(gconstpointer a,
+                                                      gconstpointer b,
+                                                      gpointer pd) {
+    const uint32_t *scc_levels = ((ProbDisassembler *)pd)->scc_levels;
+    uint32_t scc_a = (uint32_t)a;
+    uint32_t scc_b = (uint32_t)b;
+
+    if (scc_levels[scc_a] != scc_levels[scc_b]) {
+        return scc_levels[scc_a] < scc_levels[scc_b] ? -1 : 1;
+    }
+    return scc_a < scc_b ? -1 : (scc_a > scc_b);
+}
+
+Z_PRIVATE bool __prob_disassembler_incremental_round(ProbDisassembler *pd) {
+    if (!pd->incremental_ready) {
+        return false;
+    }
+
+    /*
+     * step [0]. basic information
+     */
+    if (!pd->scc_addr_offs) {
+        __prob_disassembler_build_scc_addrs(pd);
+    }
+
+    GHashTableIter iter;
+    gpointer key, value;
+    addr_t addr = INVALID_ADDR;
+
+    /*
+     * step [1]. collect updated SCCs and refresh their invalid status
+     */
+    // XXX: SCC 0 (invalid instructions) is always data, so it is ignored
+    GHashTable *seeds =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+
+    g_hash_table_iter_init(&iter, pd->pending_addrs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, (addr_t)key);
+        if (scc_id) {
+            g_hash_table_add(seeds, GSIZE_TO_POINTER(scc_id));
+        }
+    }
+
+    g_hash_table_iter_init(&iter, pd->pending_sccs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        g_hash_table_add(seeds, key);
+    }
+
+    g_hash_table_iter_init(&iter, seeds);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        uint32_t scc_id = (uint32_t)key;
+        pd->scc_invalid[scc_id] =
+            __prob_disassembler_is_invalid_scc(pd, scc_id);
+    }
+
+    /*
+     * step [2]. find the DAG cone, where the propagation stops at invalid SCCs
+     * (except the updated ones, whose invalid status may change)
+     */
+    GQueue *cone = g_queue_new();
+    {
+        GHashTable *seen =
+            g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+        GQueue *queue = g_queue_new();
+
+        g_hash_table_iter_init(&iter, seeds);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            g_hash_table_add(seen, key);
+            g_queue_push_tail(queue, key);
+        }
+
+        while (!g_queue_is_empty(queue)) {
+            uint32_t scc_id = (uint32_t)g_queue_pop_head(queue);
+            g_queue_push_tail(cone, GSIZE_TO_POINTER(scc_id));
+
+            if (pd->scc_invalid[scc_id] &&
+                !g_hash_table_contains(seeds, GSIZE_TO_POINTER(scc_id))) {
+                continue;
+            }
+
+            for (uint32_t i = pd->dag_succ_offs[scc_id];
+                 i < pd->dag_succ_offs[scc_id + 1]; i++) {
+                gpointer succ_key = GSIZE_TO_POINTER(pd->dag_succs[i]);
+                if (!pd->dag_succs[i] ||
+                    g_hash_table_contains(seen, succ_key)) {
+                    continue;
+                }
+                g_hash_table_add(seen, succ_key);
+                g_queue_push_tail(queue, succ_key);
+            }
+        }
+
+        g_queue_free(queue);
+        g_hash_table_destroy(seen);
+
+        g_queue_sort(cone, &__prob_disassembler_compare_scc_levels, pd);
+    }
+
+    /*
+     * step [3]. recompute hints of the cone in the topological order, and
+     * refresh RH of the cone and the updated addresses
+     */
+    for (GList *l = cone->head; l != NULL; l = l->next) {
+        uint32_t scc_id = (uint32_t)l->data;
+
+        pd->scc_hints[scc_id] = 0.0;  // log(1.0)
+        pd->scc_has_hints[scc_id] = pd->scc_invalid[scc_id];
+
+        if (!pd->scc_invalid[scc_id]) {
+            __FOREACH_SCC_ADDR(pd, scc_id, addr) {
+                logprob_t addr_hint = NAN;
+                if (__prob_disassembler_get_source_hint(pd, addr,
+                                                        &addr_hint)) {
+                    pd->scc_hints[scc_id] += addr_hint;
+                    pd->scc_has_hints[scc_id] = true;
+                }
+            }
+        }
+
+        __prob_disassembler_pull_hints(pd, scc_id);
+
+        __FOREACH_SCC_ADDR(pd, scc_id, addr) {
+            __prob_disassembler_refresh_RH(pd, addr);
+        }
+    }
+
+    g_hash_table_iter_init(&iter, pd->pending_addrs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        __prob_disassembler_refresh_RH(pd, (addr_t)key);
+    }
+
+    /*
+     * step [4]. recompute local D of the cone, the updated addresses, and the
+     * SCCs occluded with them, and then restrain D
+     */
+    GHashTable *D_seeds =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    for (GList *l = cone->head; l != NULL; l = l->next) {
+        uint32_t scc_id = (uint32_t)l->data;
+        g_hash_table_add(D_seeds, GSIZE_TO_POINTER(scc_id));
+
+        __FOREACH_SCC_ADDR(pd, scc_id, addr) {
+            __prob_disassembler_collect_occluded_sccs(pd, addr, D_seeds);
+        }
+    }
+
+    g_hash_table_iter_init(&iter, pd->pending_addrs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        __prob_disassembler_collect_occluded_sccs(pd, (addr_t)key, D_seeds);
+    }
+
+    g_hash_table_iter_init(&iter, D_seeds);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        uint32_t scc_id = (uint32_t)key;
+
+        bool first = true;
+        __FOREACH_SCC_ADDR(pd, scc_id, addr) {
+            logprob_t D = __prob_disassembler_get_spread_D(pd, addr);
+            if (first || D > pd->dag_local_D[scc_id]) {
+                pd->dag_local_D[scc_id] = D;
+                first = false;
+            }
+        }
+    }
+
+    GHashTable *D_changed =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    __prob_disassembler_incremental_restrain_D(pd, D_seeds, D_changed);
+
+    g_hash_table_iter_init(&iter, D_changed);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        uint32_t scc_id = (uint32_t)key;
+        __FOREACH_SCC_ADDR(pd, scc_id, addr) {
+            __prob_disassembler_reset_D(pd, addr, pd->dag_better_D[scc_id]);
+        }
+    }
+
+    /*
+     * step [5]. recompute local P of the SCCs whose D (or D of their occluded
+     * instructions) is changed, and then restrain P
+     */
+    GHashTable *P_seeds =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    g_hash_table_iter_init(&iter, D_changed);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        uint32_t scc_id = (uint32_t)key;
+        g_hash_table_add(P_seeds, key);
+
+        __FOREACH_SCC_ADDR(pd, scc_id, addr) {
+            __prob_disassembler_collect_occluded_sccs(pd, addr, P_seeds);
+        }
+    }
+
+    g_hash_table_iter_init(&iter, P_seeds);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        uint32_t scc_id = (uint32_t)key;
+
+        bool first = true;
+        __FOREACH_SCC_ADDR(pd, scc_id, addr) {
+            double P = __prob_disassembler_normalize_addr(pd, addr);
+            if (first || P < pd->dag_local_P[scc_id]) {
+                pd->dag_local_P[scc_id] = P;
+                first = false;
+            }
+        }
+    }
+
+    GHashTable *P_changed =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    __prob_disassembler_incremental_restrain_P(pd, P_seeds, P_changed);
+
+    /*
+     * step [6]. write back P, and refresh dag_P. SCCs whose invalid status
+     * changes are recomputed in the next round.
+     */
+    g_hash_table_remove_all(pd->pending_addrs);
+    g_hash_table_remove_all(pd->pending_sccs);
+
+    g_hash_table_iter_init(&iter, P_changed);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        uint32_t scc_id = (uint32_t)key;
+        double P = pd->dag_better_P[scc_id];
+
+        __FOREACH_SCC_ADDR(pd, scc_id, addr) {
+            __prob_disassembler_reset_P(pd, addr, P);
+        }
+
+        z_addr_dict_set(pd->dag_P, scc_id, P);
+        if (__prob_disassembler_is_invalid_scc(pd, scc_id) !=
+            pd->scc_invalid[scc_id]) {
+            g_hash_table_add(pd->pending_sccs, key);
+        }
+    }
+
+    z_info(
+        "incremental round: %d SCCs in the cone, %d/%d SCCs with changed D/P",
+        g_queue_get_length(cone), g_hash_table_size(D_changed),
+        g_hash_table_size(P_changed));
+
+    g_hash_table_destroy(P_changed);
+    g_hash_table_destroy(P_seeds);
+    g_hash_table_destroy(D_changed);
+    g_hash_table_destroy(D_seeds);
+    g_queue_free(cone);
+    g_hash_table_destroy(seeds);
+
+    return true;
+}
+
+#undef __FOREACH_SCC_ADDR
@@ -0,0 +1,818 @@
+/*
+ * kernels.c
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Per-byte sweeps over .text, which are vectorized by AVX2 / AVX-512 and
+ * picked at runtime. Each kernel works on the raw arrays of AddrDict (i.e., the
+ * data and the existence bitmap), where n is the number of elements.
+ * Besides, the scanners of data hints classify the raw bytes of .text into
+ * bitmaps, 32 or 64 bytes at a time.
+ *
+ * XXX: kernels only involve exact IEEE-754 operations (addition, comparison,
+ * and selection), so that all versions produce bit-identical results. Sweeps
+ * with transcendental functions (e.g., normalization) are left scalar.
+ */
+
+#include <immintrin.h>
+
+/*
+ * Spread RH into D (refer to __prob_disassembler_spread_hints), where sccid
+ * is used to tell invalid instructions (whose SCC id is 0)
+ */
+typedef void (*PDisasmSpreadKernel)(logprob_t *D, uint64_t *D_used,
+                                    const logprob_t *RH,
+                                    const uint64_t *RH_used,
+                                    const uint32_t *sccid, size_t n);
+
+/*
+ * Reassign T of each address by the T of its SCC (refer to
+ * __DECLARE_RESTRAIN)
+ */
+typedef void (*PDisasmReassignKernel)(double *T, uint64_t *T_used,
+                                      const double *scc_T,
+                                      const uint32_t *sccid, size_t n);
+
+/*
+ * Classify n bytes of code (refer to __prob_disassembler_collect_str_hints):
+ * a printable bit is set if isprint() holds for the byte in the C locale (i.e.,
+ * 0x20 - 0x7e), and a nul bit is set if the byte is zero
+ */
+typedef void (*PDisasmClassifyKernel)(uint64_t *printable, uint64_t *nul,
+                                      const uint8_t *code, size_t n);
+
+/*
+ * Match n numerical values of (1 << B) bytes with their previous values (refer
+ * to __prob_disassembler_collect_value_hints). A matched bit is set if the
+ * value may continue a numerical array which only has the previous value, i.e.,
+ * |v[i] - v[i - 1]| <= max_diff (wrapping around in the value size), or it is
+ * 0 / -1 which is not counted. The first bit is always set.
+ *
+ * XXX: false positives are allowed, as matched values are re-checked by the
+ * scalar scanner.
+ */
+typedef void (*PDisasmMatchKernel)(uint64_t *matched, const uint8_t *code,
+                                   size_t B, bool count_zero,
+                                   uint64_t max_diff, size_t n);
+
+typedef struct pdisasm_kernels_t {
+    const char *name;
+    PDisasmSpreadKernel spread;
+    PDisasmReassignKernel reassign;
+    PDisasmClassifyKernel classify;
+    PDisasmMatchKernel match;
+} PDisasmKernels;
+
+/*
+ * Check NaN by bits, as isnan() may be folded under -ffast-math
+ */
+Z_PRIVATE bool __pdisasm_kernel_isnan(double x);
+
+/*
+ * Scalar kernels
+ */
+Z_PRIVATE void __pdisasm_kernel_spread_scalar(logprob_t *D, uint64_t *D_used,
+                                              const logprob_t *RH,
+                                              const uint64_t *RH_used,
+                                              const uint32_t *sccid, size_t n);
+Z_PRIVATE void __pdisasm_kernel_reassign_scalar(double *T, uint64_t *T_used,
+                                                const double *scc_T,
+                                                const uint32_t *sccid,
+                                                size_t n);
+Z_PRIVATE void __pdisasm_kernel_classify_scalar(uint64_t *printable,
+                                                uint64_t *nul,
+                                                const uint8_t *code, size_t n);
+Z_PRIVATE bool __pdisasm_kernel_match_one(const uint8_t *code, size_t B,
+                                          bool count_zero, uint64_t max_diff,
+                                          size_t i);
+Z_PRIVATE void __pdisasm_kernel_match_scalar(uint64_t *matched,
+                                             const uint8_t *code, size_t B,
+                                             bool count_zero,
+                                             uint64_t max_diff, size_t n);
+
+/*
+ * AVX2 kernels
+ */
+__attribute__((target("avx2"))) Z_PRIVATE void __pdisasm_kernel_spread_avx2(
+    logprob_t *D, uint64_t *D_used, const logprob_t *RH,
+    const uint64_t *RH_used, const uint32_t *sccid, size_t n);
+__attribute__((target("avx2"))) Z_PRIVATE void __pdisasm_kernel_reassign_avx2(
+    double *T, uint64_t *T_used, const double *scc_T, const uint32_t *sccid,
+    size_t n);
+__attribute__((target("avx2"))) Z_PRIVATE void __pdisasm_kernel_classify_avx2(
+    uint64_t *printable, uint64_t *nul, const uint8_t *code, size_t n);
+__attribute__((target("avx2"))) Z_PRIVATE uint32_t
+__pdisasm_kernel_match_vec_avx2(const uint8_t *code, size_t B, bool count_zero,
+                                uint64_t max_diff);
+__attribute__((target("avx2"))) Z_PRIVATE void __pdisasm_kernel_match_avx2(
+    uint64_t *matched, const uint8_t *code, size_t B, bool count_zero,
+    uint64_t max_diff, size_t n);
+
+/*
+ * AVX-512 kernels
+ */
+__attribute__((target("avx512f"))) Z_PRIVATE void
+__pdisasm_kernel_spread_avx512(logprob_t *D, uint64_t *D_used,
+                               const logprob_t *RH, const uint64_t *RH_used,
+                               const uint32_t *sccid, size_t n);
+__attribute__((target("avx512f"))) Z_PRIVATE void
+__pdisasm_kernel_reassign_avx512(double *T, uint64_t *T_used,
+                                 const double *scc_T, const uint32_t *sccid,
+                                 size_t n);
+__attribute__((target("avx512f,avx512bw"))) Z_PRIVATE void
+__pdisasm_kernel_classify_avx512(uint64_t *printable, uint64_t *nul,
+                                 const uint8_t *code, size_t n);
+__attribute__((target("avx512f,avx512bw"))) Z_PRIVATE uint64_t
+__pdisasm_kernel_match_vec_avx512(const uint8_t *code, size_t B,
+                                  bool count_zero, uint64_t max_diff);
+__attribute__((target("avx512f,avx512bw"))) Z_PRIVATE void
+__pdisasm_kernel_match_avx512(uint64_t *matched, const uint8_t *code, size_t B,
+                              bool count_zero, uint64_t max_diff, size_t n);
+
+/*
+ * Pick kernels based on the running CPU
+ */
+Z_PRIVATE const PDisasmKernels *__pdisasm_kernels_select();
+
+/*
+ * Invoke kernels, which are cross-checked with the scalar version under DEBUG
+ * mode
+ */
+Z_PRIVATE void __pdisasm_kernels_spread(const PDisasmKernels *kernels,
+                                        logprob_t *D, uint64_t *D_used,
+                                        const logprob_t *RH,
+                                        const uint64_t *RH_used,
+                                        const uint32_t *sccid, size_t n);
+Z_PRIVATE void __pdisasm_kernels_reassign(const PDisasmKernels *kernels,
+                                          double *T, uint64_t *T_used,
+                                          const double *scc_T,
+                                          const uint32_t *sccid, size_t n);
+Z_PRIVATE void __pdisasm_kernels_classify(const PDisasmKernels *kernels,
+                                          uint64_t *printable, uint64_t *nul,
+                                          const uint8_t *code, size_t n);
+Z_PRIVATE void __pdisasm_kernels_match(const PDisasmKernels *kernels,
+                                       uint64_t *matched, const uint8_t *code,
+                                       size_t B, bool count_zero,
+                                       uint64_t max_diff, size_t n);
+
+static const PDisasmKernels __pdisasm_kernels_scalar = {
+    .name = "scalar",
+    .spread = &__pdisasm_kernel_spread_scalar,
+    .reassign = &__pdisasm_kernel_reassign_scalar,
+    .classify = &__pdisasm_kernel_classify_scalar,
+    .match = &__pdisasm_kernel_match_scalar,
+};
+
+static const PDisasmKernels __pdisasm_kernels_avx2 = {
+    .name = "avx2",
+    .spread = &__pdisasm_kernel_spread_avx2,
+    .reassign = &__pdisasm_kernel_reassign_avx2,
+    .classify = &__pdisasm_kernel_classify_avx2,
+    .match = &__pdisasm_kernel_match_avx2,
+};
+
+static const PDisasmKernels __pdisasm_kernels_avx512 = {
+    .name = "avx512",
+    .spread = &__pdisasm_kernel_spread_avx512,
+    .reassign = &__pdisasm_kernel_reassign_avx512,
+    .classify = &__pdisasm_kernel_classify_avx512,
+    .match = &__pdisasm_kernel_match_avx512,
+};
+
+Z_PRIVATE bool __pdisasm_kernel_isnan(double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return (bits & 0x7fffffffffffffffUL) > 0x7ff0000000000000UL;
+}
+
+Z_PRIVATE void __pdisasm_kernel_spread_scalar(logprob_t *D, uint64_t *D_used,
+                                              const logprob_t *RH,
+                                              const uint64_t *RH_used,
+                                              const uint32_t *sccid,
+                                              size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint64_t bit = 1UL << (i % 64);
+        bool D_exist = !!(D_used[i / 64] & bit);
+        bool RH_exist = !!(RH_used[i / 64] & bit);
+
+        logprob_t v = D[i];
+
+        // use RH to update D
+        if (RH_exist) {
+            v = (D_exist ? v + RH[i] : RH[i]);
+            D_exist = true;
+        }
+
+        // invalid instruction
+        if (!sccid[i]) {
+            v = 0.0;  // log(1.0)
+            D_exist = true;
+        }
+
+        // reset any D bigger than 1.0 (or being NaN) as 1.0
+        if (D_exist && (__pdisasm_kernel_isnan(v) || v > 0.0)) {
+            v = 0.0;
+        }
+
+        D[i] = v;
+        if (D_exist) {
+            D_used[i / 64] |= bit;
+        }
+    }
+}
+
+Z_PRIVATE void __pdisasm_kernel_reassign_scalar(double *T, uint64_t *T_used,
+                                                const double *scc_T,
+                                                const uint32_t *sccid,
+                                                size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        T[i] = scc_T[sccid[i]];
+        T_used[i / 64] |= (1UL << (i % 64));
+    }
+}
+
+Z_PRIVATE void __pdisasm_kernel_classify_scalar(uint64_t *printable,
+                                                uint64_t *nul,
+                                                const uint8_t *code, size_t n) {
+    memset(printable, 0, (n + 63) / 64 * sizeof(uint64_t));
+    memset(nul, 0, (n + 63) / 64 * sizeof(uint64_t));
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t c = code[i];
+        if (c >= 0x20 && c <= 0x7e) {
+            printable[i / 64] |= (1UL << (i % 64));
+        }
+        if (!c) {
+            nul[i / 64] |= (1UL << (i % 64));
+        }
+    }
+}
+
+Z_PRIVATE bool __pdisasm_kernel_match_one(const uint8_t *code, size_t B,
+                                          bool count_zero, uint64_t max_diff,
+                                          size_t i) {
+    if (!i) {
+        return true;
+    }
+
+    int64_t val, prev;
+    switch (B) {
+#define __LOAD_VALUES(T)                                       \
+    do {                                                       \
+        T val_, prev_;                                         \
+        memcpy(&val_, code + i * sizeof(T), sizeof(T));        \
+        memcpy(&prev_, code + (i - 1) * sizeof(T), sizeof(T)); \
+        val = val_;                                            \
+        prev = prev_;                                          \
+    } while (0)
+
+        case 0:
+            __LOAD_VALUES(int8_t);
+            break;
+        case 1:
+            __LOAD_VALUES(int16_t);
+            break;
+        case 2:
+            __LOAD_VALUES(int32_t);
+            break;
+        case 3:
+            __LOAD_VALUES(int64_t);
+            break;
+        default:
+            EXITME("invalid value size: %d", 1 << B);
+
+#undef __LOAD_VALUES
+    }
+
+    if (!count_zero && (val == 0 || val == -1)) {
+        return true;
+    }
+
+    uint64_t size_mask = (B == 3 ? ~0UL : (1UL << (8 << B)) - 1);
+    return ((((uint64_t)val - (uint64_t)prev + max_diff) & size_mask) <=
+            max_diff * 2);
+}
+
+Z_PRIVATE void __pdisasm_kernel_match_scalar(uint64_t *matched,
+                                             const uint8_t *code, size_t B,
+                                             bool count_zero,
+                                             uint64_t max_diff, size_t n) {
+    memset(matched, 0, (n + 63) / 64 * sizeof(uint64_t));
+
+    for (size_t i = 0; i < n; i++) {
+        if (__pdisasm_kernel_match_one(code, B, count_zero, max_diff, i)) {
+            matched[i / 64] |= (1UL << (i % 64));
+        }
+    }
+}
+
+__attribute__((target("avx2"))) Z_PRIVATE void __pdisasm_kernel_spread_avx2(
+    logprob_t *D, uint64_t *D_used, const logprob_t *RH,
+    const uint64_t *RH_used, const uint32_t *sccid, size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256i zero_i = _mm256_setzero_si256();
+    const __m256i lanes = _mm256_setr_epi64x(1, 2, 4, 8);
+
+    // expand 4 bits into a lane mask
+#define __BITS_TO_MASK(bits)                                                  \
+    _mm256_castsi256_pd(_mm256_cmpeq_epi64(                                   \
+        _mm256_and_si256(_mm256_set1_epi64x((int64_t)(bits)), lanes), lanes))
+
+    size_t word_n = n / 64;
+    for (size_t w = 0; w < word_n; w++) {
+        uint64_t D_bits = D_used[w];
+        uint64_t RH_bits = RH_used[w];
+        uint64_t res_bits = 0;
+
+        for (size_t k = 0; k < 64; k += 4) {
+            size_t i = w * 64 + k;
+
+            __m256d D_mask = __BITS_TO_MASK((D_bits >> k) & 0xf);
+            __m256d RH_mask = __BITS_TO_MASK((RH_bits >> k) & 0xf);
+            __m256d invalid_mask = _mm256_castsi256_pd(_mm256_cmpeq_epi64(
+                _mm256_cvtepu32_epi64(
+                    _mm_loadu_si128((const __m128i *)(sccid + i))),
+                zero_i));
+
+            __m256d v = _mm256_loadu_pd(D + i);
+            __m256d rh = _mm256_loadu_pd(RH + i);
+
+            // use RH to update D
+            __m256d sum = _mm256_add_pd(v, rh);
+            v = _mm256_blendv_pd(v, rh, RH_mask);
+            v = _mm256_blendv_pd(v, sum, _mm256_and_pd(D_mask, RH_mask));
+            __m256d exist = _mm256_or_pd(D_mask, RH_mask);
+
+            // invalid instruction
+            v = _mm256_blendv_pd(v, zero, invalid_mask);
+            exist = _mm256_or_pd(exist, invalid_mask);
+
+            // reset any D bigger than 1.0 (or being NaN) as 1.0
+            __m256d bad = _mm256_or_pd(_mm256_cmp_pd(v, v, _CMP_UNORD_Q),
+                                       _mm256_cmp_pd(v, zero, _CMP_GT_OQ));
+            v = _mm256_blendv_pd(v, zero, _mm256_and_pd(bad, exist));
+
+            _mm256_storeu_pd(D + i, v);
+            res_bits |= ((uint64_t)_mm256_movemask_pd(exist)) << k;
+        }
+
+        D_used[w] = res_bits;
+    }
+
+#undef __BITS_TO_MASK
+
+    __pdisasm_kernel_spread_scalar(D + word_n * 64, D_used + word_n,
+                                   RH + word_n * 64, RH_used + word_n,
+                                   sccid + word_n * 64, n - word_n * 64);
+}
+
+__attribute__((target("avx2"))) Z_PRIVATE void __pdisasm_kernel_reassign_avx2(
+    double *T, uint64_t *T_used, const double *scc_T, const uint32_t *sccid,
+    size_t n) {
+    size_t word_n = n / 64;
+    for (size_t w = 0; w < word_n; w++) {
+        for (size_t k = 0; k < 64; k += 4) {
+            size_t i = w * 64 + k;
+            __m128i idx = _mm_loadu_si128((const __m128i *)(sccid + i));
+            _mm256_storeu_pd(T + i, _mm256_i32gather_pd(scc_T, idx, 8));
+        }
+        T_used[w] = ~0UL;
+    }
+
+    __pdisasm_kernel_reassign_scalar(T + word_n * 64, T_used + word_n, scc_T,
+                                     sccid + word_n * 64, n - word_n * 64);
+}
+
+__attribute__((target("avx2"))) Z_PRIVATE void __pdisasm_kernel_classify_avx2(
+    uint64_t *printable, uint64_t *nul, const uint8_t *code, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lower = _mm256_set1_epi8(0x1f);
+    const __m256i upper = _mm256_set1_epi8(0x7f);
+
+    size_t word_n = n / 64;
+    for (size_t w = 0; w < word_n; w++) {
+        uint64_t printable_bits = 0;
+        uint64_t nul_bits = 0;
+
+        for (size_t k = 0; k < 64; k += 32) {
+            __m256i c =
+                _mm256_loadu_si256((const __m256i *)(code + w * 64 + k));
+
+            // XXX: bytes not less than 0x80 are negative in signed comparison
+            __m256i is_printable = _mm256_and_si256(
+                _mm256_cmpgt_epi8(c, lower), _mm256_cmpgt_epi8(upper, c));
+            __m256i is_nul = _mm256_cmpeq_epi8(c, zero);
+
+            printable_bits |=
+                ((uint64_t)(uint32_t)_mm256_movemask_epi8(is_printable)) << k;
+            nul_bits |= ((uint64_t)(uint32_t)_mm256_movemask_epi8(is_nul))
+                        << k;
+        }
+
+        printable[w] = printable_bits;
+        nul[w] = nul_bits;
+    }
+
+    __pdisasm_kernel_classify_scalar(printable + word_n, nul + word_n,
+                                     code + word_n * 64, n - word_n * 64);
+}
+
+__attribute__((target("avx2"))) Z_PRIVATE uint32_t
+__pdisasm_kernel_match_vec_avx2(const uint8_t *code, size_t B, bool count_zero,
+                                uint64_t max_diff) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8(-1);
+
+    __m256i cur = _mm256_loadu_si256((const __m256i *)code);
+    __m256i prev = _mm256_loadu_si256((const __m256i *)(code - (1 << B)));
+
+    // (cur - prev + max_diff) <= max_diff * 2, as unsigned values
+    __m256i matched, ignored;
+    switch (B) {
+#define __MATCH_TEMPLATE(bits)                                                \
+    do {                                                                      \
+        __m256i t = _mm256_add_epi##bits(                                     \
+            _mm256_sub_epi##bits(cur, prev),                                  \
+            _mm256_set1_epi##bits(max_diff));                                 \
+        matched = _mm256_cmpeq_epi##bits(                                     \
+            _mm256_min_epu##bits(t, _mm256_set1_epi##bits(max_diff * 2)), t); \
+        ignored = _mm256_or_si256(_mm256_cmpeq_epi##bits(cur, zero),          \
+                                  _mm256_cmpeq_epi##bits(cur, ones));         \
+    } while (0)
+
+        case 0:
+            __MATCH_TEMPLATE(8);
+            break;
+        case 1:
+            __MATCH_TEMPLATE(16);
+            break;
+        case 2:
+            __MATCH_TEMPLATE(32);
+            break;
+
+#undef __MATCH_TEMPLATE
+
+        case 3: {
+            // there is no unsigned 64-bit comparison in AVX2
+            const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+            __m256i t = _mm256_add_epi64(_mm256_sub_epi64(cur, prev),
+                                         _mm256_set1_epi64x(max_diff));
+            matched = _mm256_xor_si256(
+                _mm256_cmpgt_epi64(
+                    _mm256_xor_si256(t, sign),
+                    _mm256_xor_si256(_mm256_set1_epi64x(max_diff * 2), sign)),
+                ones);
+            ignored = _mm256_or_si256(_mm256_cmpeq_epi64(cur, zero),
+                                      _mm256_cmpeq_epi64(cur, ones));
+            break;
+        }
+        default:
+            EXITME("invalid value size: %d", 1 << B);
+    }
+
+    if (!count_zero) {
+        matched = _mm256_or_si256(matched, ignored);
+    }
+
+    switch (B) {
+        case 0:
+            return (uint32_t)_mm256_movemask_epi8(matched);
+        case 1:
+            // pack 16-bit lanes into bytes, and fix the order of 64-bit lanes
+            return (uint32_t)_mm256_movemask_epi8(_mm256_permute4x64_epi64(
+                _mm256_packs_epi16(matched, zero), 0xd8));
+        case 2:
+            return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(matched));
+        default:
+            return (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(matched));
+    }
+}
+
+__attribute__((target("avx2"))) Z_PRIVATE void __pdisasm_kernel_match_avx2(
+    uint64_t *matched, const uint8_t *code, size_t B, bool count_zero,
+    uint64_t max_diff, size_t n) {
+    // XXX: the first word is matched by the scalar version, so that the
+    // previous value is always available for vectors
+    size_t word_n = n / 64;
+    if (!word_n) {
+        __pdisasm_kernel_match_scalar(matched, code, B, count_zero, max_diff,
+                                      n);
+        return;
+    }
+    __pdisasm_kernel_match_scalar(matched, code, B, count_zero, max_diff, 64);
+
+    size_t lane_n = 32 >> B;
+    for (size_t w = 1; w < word_n; w++) {
+        uint64_t bits = 0;
+        for (size_t k = 0; k < 64; k += lane_n) {
+            bits |= ((uint64_t)__pdisasm_kernel_match_vec_avx2(
+                        code + ((w * 64 + k) << B), B, count_zero, max_diff))
+                    << k;
+        }
+        matched[w] = bits;
+    }
+
+    if (n % 64) {
+        matched[word_n] = 0;
+        for (size_t i = word_n * 64; i < n; i++) {
+            if (__pdisasm_kernel_match_one(code, B, count_zero, max_diff, i)) {
+                matched[word_n] |= (1UL << (i % 64));
+            }
+        }
+    }
+}
+
+__attribute__((target("avx512f"))) Z_PRIVATE void
+__pdisasm_kernel_spread_avx512(logprob_t *D, uint64_t *D_used,
+                               const logprob_t *RH, const uint64_t *RH_used,
+                               const uint32_t *sccid, size_t n) {
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512i zero_i = _mm512_setzero_si512();
+
+    size_t word_n = n / 64;
+    for (size_t w = 0; w < word_n; w++) {
+        uint64_t D_bits = D_used[w];
+        uint64_t RH_bits = RH_used[w];
+        uint64_t res_bits = 0;
+
+        for (size_t k = 0; k < 64; k += 8) {
+            size_t i = w * 64 + k;
+
+            __mmask8 D_mask = (__mmask8)(D_bits >> k);
+            __mmask8 RH_mask = (__mmask8)(RH_bits >> k);
+            __mmask8 invalid_mask = _mm512_cmpeq_epi64_mask(
+                _mm512_cvtepu32_epi64(
+                    _mm256_loadu_si256((const __m256i *)(sccid + i))),
+                zero_i);
+
+            __m512d v = _mm512_loadu_pd(D + i);
+            __m512d rh = _mm512_loadu_pd(RH + i);
+
+            // use RH to update D
+            __m512d sum = _mm512_add_pd(v, rh);
+            v = _mm512_mask_mov_pd(v, RH_mask, rh);
+            v = _mm512_mask_mov_pd(v, D_mask & RH_mask, sum);
+            __mmask8 exist = D_mask | RH_mask;
+
+            // invalid instruction
+            v = _mm512_mask_mov_pd(v, invalid_mask, zero);
+            exist |= invalid_mask;
+
+            // reset any D bigger than 1.0 (or being NaN) as 1.0
+            __mmask8 bad = _mm512_cmp_pd_mask(v, v, _CMP_UNORD_Q) |
+                           _mm512_cmp_pd_mask(v, zero, _CMP_GT_OQ);
+            v = _mm512_mask_mov_pd(v, bad & exist, zero);
+
+            _mm512_storeu_pd(D + i, v);
+            res_bits |= ((uint64_t)exist) << k;
+        }
+
+        D_used[w] = res_bits;
+    }
+
+    __pdisasm_kernel_spread_scalar(D + word_n * 64, D_used + word_n,
+                                   RH + word_n * 64, RH_used + word_n,
+                                   sccid + word_n * 64, n - word_n * 64);
+}
+
+__attribute__((target("avx512f"))) Z_PRIVATE void
+__pdisasm_kernel_reassign_avx512(double *T, uint64_t *T_used,
+                                 const double *scc_T, const uint32_t *sccid,
+                                 size_t n) {
+    size_t word_n = n / 64;
+    for (size_t w = 0; w < word_n; w++) {
+        for (size_t k = 0; k < 64; k += 8) {
+            size_t i = w * 64 + k;
+            __m256i idx = _mm256_loadu_si256((const __m256i *)(sccid + i));
+            _mm512_storeu_pd(T + i, _mm512_i32gather_pd(idx, scc_T, 8));
+        }
+        T_used[w] = ~0UL;
+    }
+
+    __pdisasm_kernel_reassign_scalar(T + word_n * 64, T_used + word_n, scc_T,
+                                     sccid + word_n * 64, n - word_n * 64);
+}
+
+__attribute__((target("avx512f,avx512bw"))) Z_PRIVATE void
+__pdisasm_kernel_classify_avx512(uint64_t *printable, uint64_t *nul,
+                                 const uint8_t *code, size_t n) {
+    const __m512i lower = _mm512_set1_epi8(0x1f);
+    const __m512i upper = _mm512_set1_epi8(0x7f);
+
+    size_t word_n = n / 64;
+    for (size_t w = 0; w < word_n; w++) {
+        __m512i c = _mm512_loadu_si512((const void *)(code + w * 64));
+
+        // XXX: bytes not less than 0x80 are negative in signed comparison
+        printable[w] =
+            _mm512_cmpgt_epi8_mask(c, lower) & _mm512_cmpgt_epi8_mask(upper, c);
+        nul[w] = _mm512_testn_epi8_mask(c, c);
+    }
+
+    __pdisasm_kernel_classify_scalar(printable + word_n, nul + word_n,
+                                     code + word_n * 64, n - word_n * 64);
+}
+
+__attribute__((target("avx512f,avx512bw"))) Z_PRIVATE uint64_t
+__pdisasm_kernel_match_vec_avx512(const uint8_t *code, size_t B,
+                                  bool count_zero, uint64_t max_diff) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i ones = _mm512_set1_epi8(-1);
+
+    __m512i cur = _mm512_loadu_si512((const void *)code);
+    __m512i prev = _mm512_loadu_si512((const void *)(code - (1 << B)));
+
+    // (cur - prev + max_diff) <= max_diff * 2, as unsigned values
+    uint64_t matched, ignored;
+    switch (B) {
+#define __MATCH_TEMPLATE(bits)                                             \
+    do {                                                                   \
+        __m512i t = _mm512_add_epi##bits(_mm512_sub_epi##bits(cur, prev),  \
+                                         _mm512_set1_epi##bits(max_diff)); \
+        matched = _mm512_cmple_epu##bits##_mask(                           \
+            t, _mm512_set1_epi##bits(max_diff * 2));                       \
+        ignored = _mm512_cmpeq_epi##bits##_mask(cur, zero) |               \
+                  _mm512_cmpeq_epi##bits##_mask(cur, ones);                \
+    } while (0)
+
+        case 0:
+            __MATCH_TEMPLATE(8);
+            break;
+        case 1:
+            __MATCH_TEMPLATE(16);
+            break;
+        case 2:
+            __MATCH_TEMPLATE(32);
+            break;
+        case 3:
+            __MATCH_TEMPLATE(64);
+            break;
+        default:
+            EXITME("invalid value size: %d", 1 << B);
+
+#undef __MATCH_TEMPLATE
+    }
+
+    if (!count_zero) {
+        matched |= ignored;
+    }
+    return matched;
+}
+
+__attribute__((target("avx512f,avx512bw"))) Z_PRIVATE void
+__pdisasm_kernel_match_avx512(uint64_t *matched, const uint8_t *code, size_t B,
+                              bool count_zero, uint64_t max_diff, size_t n) {
+    // XXX: the first word is matched by the scalar version, so that the
+    // previous value is always available for vectors
+    size_t word_n = n / 64;
+    if (!word_n) {
+        __pdisasm_kernel_match_scalar(matched, code, B, count_zero, max_diff,
+                                      n);
+        return;
+    }
+    __pdisasm_kernel_match_scalar(matched, code, B, count_zero, max_diff, 64);
+
+    size_t lane_n = 64 >> B;
+    for (size_t w = 1; w < word_n; w++) {
+        uint64_t bits = 0;
+        for (size_t k = 0; k < 64; k += lane_n) {
+            bits |= __pdisasm_kernel_match_vec_avx512(
+                        code + ((w * 64 + k) << B), B, count_zero, max_diff)
+                    << k;
+        }
+        matched[w] = bits;
+    }
+
+    if (n % 64) {
+        matched[word_n] = 0;
+        for (size_t i = word_n * 64; i < n; i++) {
+            if (__pdisasm_kernel_match_one(code, B, count_zero, max_diff, i)) {
+                matched[word_n] |= (1UL << (i % 64));
+            }
+        }
+    }
+}
+
+Z_PRIVATE const PDisasmKernels *__pdisasm_kernels_select() {
+    const PDisasmKernels *kernels = &__pdisasm_kernels_scalar;
+
+    __builtin_cpu_init();
+    // XXX: AVX-512 kernels of data hints additionally need AVX512BW
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw")) {
+        kernels = &__pdisasm_kernels_avx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        kernels = &__pdisasm_kernels_avx2;
+    }
+
+    z_info("probabilistic disassembly kernels: %s", kernels->name);
+    return kernels;
+}
+
+#ifdef DEBUG
+#define __PDISASM_KERNEL_CHECK_BEGIN(data, used, n)                      \
+    size_t __used_n = (n) / 64 + 1;                                      \
+    double *__ref_data = z_alloc((n) + 1, sizeof(double));               \
+    uint64_t *__ref_used = z_alloc(__used_n, sizeof(uint64_t));          \
+    memcpy(__ref_data, (data), (n) * sizeof(double));                    \
+    memcpy(__ref_used, (used), __used_n * sizeof(uint64_t));
+
+#define __PDISASM_KERNEL_CHECK_END(kernels, data, used, n)               \
+    if (memcmp(__ref_data, (data), (n) * sizeof(double)) ||              \
+        memcmp(__ref_used, (used), __used_n * sizeof(uint64_t))) {       \
+        EXITME("%s kernel differs from the scalar one", (kernels)->name); \
+    }                                                                    \
+    z_free(__ref_data);                                                  \
+    z_free(__ref_used);
+#else
+#define __PDISASM_KERNEL_CHECK_BEGIN(data, used, n)
+#define __PDISASM_KERNEL_CHECK_END(kernels, data, used, n)
+#endif
+
+Z_PRIVATE void __pdisasm_kernels_spread(const PDisasmKernels *kernels,
+                                        logprob_t *D, uint64_t *D_used,
+                                        const logprob_t *RH,
+                                        const uint64_t *RH_used,
+                                        const uint32_t *sccid, size_t n) {
+    __PDISASM_KERNEL_CHECK_BEGIN(D, D_used, n);
+#ifdef DEBUG
+    __pdisasm_kernel_spread_scalar(__ref_data, __ref_used, RH, RH_used, sccid,
+                                   n);
+#endif
+
+    (*kernels->spread)(D, D_used, RH, RH_used, sccid, n);
+
+    __PDISASM_KERNEL_CHECK_END(kernels, D, D_used, n);
+}
+
+Z_PRIVATE void __pdisasm_kernels_reassign(const PDisasmKernels *kernels,
+                                          double *T, uint64_t *T_used,
+                                          const double *scc_T,
+                                          const uint32_t *sccid, size_t n) {
+    __PDISASM_KERNEL_CHECK_BEGIN(T, T_used, n);
+#ifdef DEBUG
+    __pdisasm_kernel_reassign_scalar(__ref_data, __ref_used, scc_T, sccid, n);
+#endif
+
+    (*kernels->reassign)(T, T_used, scc_T, sccid, n);
+
+    __PDISASM_KERNEL_CHECK_END(kernels, T, T_used, n);
+}
+
+Z_PRIVATE void __pdisasm_kernels_classify(const PDisasmKernels *kernels,
+                                          uint64_t *printable, uint64_t *nul,
+                                          const uint8_t *code, size_t n) {
+    (*kernels->classify)(printable, nul, code, n);
+
+#ifdef DEBUG
+    size_t word_n = (n + 63) / 64;
+    uint64_t *ref_printable = z_alloc(word_n + 1, sizeof(uint64_t));
+    uint64_t *ref_nul = z_alloc(word_n + 1, sizeof(uint64_t));
+    __pdisasm_kernel_classify_scalar(ref_printable, ref_nul, code, n);
+    if (memcmp(ref_printable, printable, word_n * sizeof(uint64_t)) ||
+        memcmp(ref_nul, nul, word_n * sizeof(uint64_t))) {
+        EXITME("%s kernel differs from the scalar one", kernels->name);
+    }
+    z_free(ref_printable);
+    z_free(ref_nul);
+#endif
+}
+
+Z_PRIVATE void __pdisasm_kernels_match(const PDisasmKernels *kernels,
+                                       uint64_t *matched, const uint8_t *code,
+                                       size_t B, bool count_zero,
+                                       uint64_t max_diff, size_t n) {
+    // max_diff * 2 should not wrap around in the value size
+    assert(B <= 3);
+    assert(B == 3 || max_diff * 2 < (1UL << (8 << B)));
+
+    (*kernels->match)(matched, code, B, count_zero, max_diff, n);
+
+#ifdef DEBUG
+    size_t word_n = (n + 63) / 64;
+    uint64_t *ref_matched = z_alloc(word_n + 1, sizeof(uint64_t));
+    __pdisasm_kernel_match_scalar(ref_matched, code, B, count_zero, max_diff,
+                                  n);
+    if (memcmp(ref_matched, matched, word_n * sizeof(uint64_t))) {
+        EXITME("%s kernel differs from the scalar one", kernels->name);
+    }
+    z_free(ref_matched);
+#endif
+}
+
+#undef __PDISASM_KERNEL_CHECK_BEGIN
+#undef __PDISASM_KERNEL_CHECK_END
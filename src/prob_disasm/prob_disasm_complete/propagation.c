@@ -16,27 +16,142 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+// XXX: each task of step [4] owns whole words of the RH bitmap
+#define PROPAGATE_RH_CHUNK (64 * 0x400)
+
+/*
+ * Check whether an SCC is invalid, which means its likelihood of being
+ * instructions is quite small
+ */
+Z_PRIVATE bool __prob_disassembler_is_invalid_scc(ProbDisassembler *pd,
+                                                  uint32_t scc_id);
+
+/*
+ * Get the instruction hint of addr which is aggregated into its SCC
+ */
+Z_PRIVATE bool __prob_disassembler_get_source_hint(ProbDisassembler *pd,
+                                                   addr_t addr,
+                                                   logprob_t *hint);
+
+/*
+ * Pull hints from predecessors of an SCC into its own hint
+ */
+Z_PRIVATE void __prob_disassembler_pull_hints(ProbDisassembler *pd,
+                                              uint32_t scc_id);
+
+/*
+ * Parallel task of pulling hints (task_id indexes pd->level_sccs). SCCs are
+ * processed level by level, so that an SCC only reads hints of its
+ * predecessors (which are in lower levels) and writes its own hint.
+ */
+Z_PRIVATE void __prob_disassembler_pull_scc_hints(void *ctx, size_t task_id);
+
+/*
+ * Apply SCC hints into RH for a chunk of addresses
+ */
+Z_PRIVATE void __prob_disassembler_apply_scc_hints(void *ctx, size_t task_id);
+
 /*
  * Propogate instruction hints
  */
 Z_PRIVATE void __prob_disassembler_propogate_inst_hints(ProbDisassembler *pd);
 
+Z_PRIVATE bool __prob_disassembler_is_invalid_scc(ProbDisassembler *pd,
+                                                  uint32_t scc_id) {
+    return z_addr_dict_exist(pd->dag_P, scc_id) &&
+           z_addr_dict_get(pd->dag_P, scc_id) < PROPAGATE_P;
+}
+
+Z_PRIVATE bool __prob_disassembler_get_source_hint(ProbDisassembler *pd,
+                                                   addr_t addr,
+                                                   logprob_t *hint) {
+    // we do not use hints of very rare instructions
+    // TODO: get a instruction distribution to weaken the hints instead of
+    // directly disabling it.
+    const SInst *inst = z_disassembler_get_superset_inst(pd->base, addr);
+    if (z_sinst_is(inst, RARE)) {
+        return false;
+    }
+
+    return __prob_disassembler_get_H(pd, addr, hint);
+}
+
+Z_PRIVATE void __prob_disassembler_pull_hints(ProbDisassembler *pd,
+                                              uint32_t scc_id) {
+    logprob_t scc_hint = pd->scc_hints[scc_id];
+    bool has_hint = pd->scc_has_hints[scc_id];
+
+    for (uint32_t i = pd->dag_pred_offs[scc_id];
+         i < pd->dag_pred_offs[scc_id + 1]; i++) {
+        uint32_t pred_scc_id = pd->dag_preds[i];
+
+        // check pred scc without any hint
+        if (!pd->scc_has_hints[pred_scc_id]) {
+            continue;
+        }
+
+        // check invalid pred scc, which stops propagation
+        if (pd->scc_invalid[pred_scc_id]) {
+            continue;
+        }
+
+        if (has_hint) {
+            scc_hint += pd->scc_hints[pred_scc_id];
+        } else {
+            scc_hint = pd->scc_hints[pred_scc_id];
+            has_hint = true;
+        }
+    }
+
+    pd->scc_hints[scc_id] = scc_hint;
+    pd->scc_has_hints[scc_id] = has_hint;
+}
+
+Z_PRIVATE void __prob_disassembler_pull_scc_hints(void *ctx, size_t task_id) {
+    ProbDisassembler *pd = (ProbDisassembler *)ctx;
+    __prob_disassembler_pull_hints(pd, pd->level_sccs[task_id]);
+}
+
+Z_PRIVATE void __prob_disassembler_apply_scc_hints(void *ctx, size_t task_id) {
+    ProbDisassembler *pd = (ProbDisassembler *)ctx;
+
+    addr_t start_addr = pd->text_addr + task_id * PROPAGATE_RH_CHUNK;
+    addr_t end_addr = start_addr + PROPAGATE_RH_CHUNK;
+    if (end_addr > pd->text_addr + pd->text_size) {
+        end_addr = pd->text_addr + pd->text_size;
+    }
+
+    for (addr_t addr = start_addr; addr < end_addr; addr++) {
+        // ignore invalid instruction
+        uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);
+        if (!scc_id) {
+            continue;
+        }
+
+        if (!pd->scc_has_hints[scc_id]) {
+            continue;
+        }
+
+        __prob_disassembler_update_RH(pd, addr, pd->scc_hints[scc_id]);
+    }
+}
+
 Z_PRIVATE void __prob_disassembler_propogate_inst_hints(ProbDisassembler *pd) {
     // step [0]. basic information
-    Disassembler *d = pd->base;
     addr_t text_addr = pd->text_addr;
     size_t text_size = pd->text_size;
 
     // step [1]. aggregate all hints within a SCC
-    AddrDict(double128_t, dag_hints);
-    z_addr_dict_init(dag_hints, 0, pd->scc_n);
+    // XXX: per-SCC hints are kept in pd, so that incremental rounds can reuse
+    // them (refer to prob_disasm_complete/incremental.c)
+    memset(pd->scc_hints, 0, pd->scc_n * sizeof(logprob_t));
+    memset(pd->scc_has_hints, 0, pd->scc_n * sizeof(bool));
 
-    // XXX: invalid_sccs means those SCCs whose likelihook of being instructions
+    // XXX: scc_invalid means those SCCs whose likelihook of being instructions
     // is quite small. Hence, we stop propogation when reaching them. Note that
     // it is different from those SCCs in pd->dag_dead which are 100% not
     // instruction boundaries.
-    AddrDictFast(bool, invalid_sccs);
-    z_addr_dict_init(invalid_sccs, 0, pd->scc_n);
+    memset(pd->scc_invalid, 0, pd->scc_n * sizeof(bool));
 
     for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
         // check addr is valid
@@ -46,33 +161,25 @@ Z_PRIVATE void __prob_disassembler_propogate_inst_hints(ProbDisassembler *pd) {
         }
 
         // check invalid_scc
-        if (z_addr_dict_exist(pd->dag_P, scc_id) &&
-            z_addr_dict_get(pd->dag_P, scc_id) < PROPAGATE_P) {
-            if (!z_addr_dict_exist(invalid_sccs, scc_id)) {
-                z_addr_dict_set(invalid_sccs, scc_id, true);
-                z_addr_dict_set(dag_hints, scc_id, 1.0);
+        if (__prob_disassembler_is_invalid_scc(pd, scc_id)) {
+            if (!pd->scc_invalid[scc_id]) {
+                pd->scc_invalid[scc_id] = true;
+                pd->scc_hints[scc_id] = 0.0;  // log(1.0)
+                pd->scc_has_hints[scc_id] = true;
             }
 
             continue;
         }
 
-        // we do not use hints of very rare instructions
-        // TODO: get a instruction distribution to weaken the hints instead of
-        // directly disabling it.
-        cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
-        if (z_capstone_is_rare(inst)) {
-            continue;
-        }
-
         // update aggragated hints
-        double128_t addr_hint = NAN;
-        if (__prob_disassembler_get_H(pd, addr, &addr_hint)) {
-            if (!z_addr_dict_exist(dag_hints, scc_id)) {
+        logprob_t addr_hint = NAN;
+        if (__prob_disassembler_get_source_hint(pd, addr, &addr_hint)) {
+            if (!pd->scc_has_hints[scc_id]) {
                 // new hints
-                z_addr_dict_set(dag_hints, scc_id, addr_hint);
+                pd->scc_hints[scc_id] = addr_hint;
+                pd->scc_has_hints[scc_id] = true;
             } else {
-                z_addr_dict_set(dag_hints, scc_id,
-                                z_addr_dict_get(dag_hints, scc_id) * addr_hint);
+                pd->scc_hints[scc_id] += addr_hint;
             }
         }
     }
@@ -89,80 +196,38 @@ Z_PRIVATE void __prob_disassembler_propogate_inst_hints(ProbDisassembler *pd) {
         while (!g_queue_is_empty(queue)) {
             uint32_t scc_id = (uint32_t)g_queue_pop_head(queue);
 
-            // update dag_hints and invalid_sccs
+            // update hints and invalid sccs
             z_addr_dict_set(pd->dag_dead, scc_id, true);
-            z_addr_dict_set(invalid_sccs, scc_id, true);
-            z_addr_dict_set(dag_hints, scc_id, 1.0);
+            pd->scc_invalid[scc_id] = true;
+            pd->scc_hints[scc_id] = 0.0;  // log(1.0)
+            pd->scc_has_hints[scc_id] = true;
 
             // find predecessors
-            GHashTable *dag_preds = z_addr_dict_get(pd->dag_preds, scc_id);
-            GList *list_dag_preds = g_hash_table_get_keys(dag_preds);
-            for (GList *l = list_dag_preds; l != NULL; l = l->next) {
-                uint32_t pred_scc_id = (uint32_t)l->data;
+            for (uint32_t i = pd->dag_pred_offs[scc_id];
+                 i < pd->dag_pred_offs[scc_id + 1]; i++) {
+                uint32_t pred_scc_id = pd->dag_preds[i];
                 if (z_addr_dict_exist(seen, pred_scc_id)) {
                     continue;
                 }
                 z_addr_dict_set(seen, pred_scc_id, true);
                 g_queue_push_tail(queue, GSIZE_TO_POINTER(pred_scc_id));
             }
-            g_list_free(list_dag_preds);
         }
 
         g_queue_free(queue);
         z_addr_dict_destroy(seen);
     }
 
-    // step [3]. propogate hints
-    for (GList *l = pd->topo->head; l != NULL; l = l->next) {
-        uint32_t scc_id = (uint32_t)l->data;
-
-        // check scc without any hint
-        if (!z_addr_dict_exist(dag_hints, scc_id)) {
-            continue;
-        }
-
-        // check invalid scc. If so, stop propagation.
-        if (z_addr_dict_exist(invalid_sccs, scc_id)) {
-            continue;
-        }
-
-        // get hints
-        double128_t scc_hint = z_addr_dict_get(dag_hints, scc_id);
-
-        // propogate hints
-        GHashTable *dag_succs = z_addr_dict_get(pd->dag_succs, scc_id);
-
-        GList *list_dag_succs = g_hash_table_get_keys(dag_succs);
-        for (GList *ll = list_dag_succs; ll != NULL; ll = ll->next) {
-            uint32_t succ_scc_id = (uint32_t)ll->data;
-
-            if (!z_addr_dict_exist(dag_hints, succ_scc_id)) {
-                z_addr_dict_set(dag_hints, succ_scc_id, scc_hint);
-            } else {
-                z_addr_dict_set(
-                    dag_hints, succ_scc_id,
-                    z_addr_dict_get(dag_hints, succ_scc_id) * scc_hint);
-            }
-        }
-        g_list_free(list_dag_succs);
-    }
-    z_addr_dict_destroy(invalid_sccs);
+    // step [3]. propogate hints level by level
+    // XXX: hints are pulled from predecessors instead of pushed into
+    // successors, so that SCCs of the same level can be handled in parallel
+    // without any race.
+    z_parallel_run_levels(pd->level_n, pd->level_offs,
+                          &__prob_disassembler_pull_scc_hints, pd);
 
     // step [4]. update RH for each address
-    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        // ignore invalid instruction
-        uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);
-        if (!scc_id) {
-            continue;
-        }
-
-        if (!z_addr_dict_exist(dag_hints, scc_id)) {
-            continue;
-        }
-
-        double128_t scc_hint = z_addr_dict_get(dag_hints, scc_id);
-
-        __prob_disassembler_update_RH(pd, addr, scc_hint);
-    }
-    z_addr_dict_destroy(dag_hints);
+    z_parallel_run((text_size + PROPAGATE_RH_CHUNK - 1) / PROPAGATE_RH_CHUNK,
+                   &__prob_disassembler_apply_scc_hints, pd);
 }
+
+#undef PROPAGATE_RH_CHUNK
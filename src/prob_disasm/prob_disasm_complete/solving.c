@@ -31,136 +31,177 @@ Z_PRIVATE void __prob_disassembler_restrain_prob(ProbDisassembler *pd);
  */
 Z_PRIVATE void __prob_disassembler_spread_hints(ProbDisassembler *pd);
 
-#define __DECLARE_RESTRAIN(T, op)                                              \
-    Z_PRIVATE void __prob_disassembler_restrain_##T(ProbDisassembler *pd) {    \
-        addr_t text_addr = pd->text_addr;                                      \
-        size_t text_size = pd->text_size;                                      \
-                                                                               \
-        /* step [1]. calculate better T for each scc */                        \
-        AddrDict(double128_t, dag_better);                                     \
-        z_addr_dict_init(dag_better, 0, pd->scc_n);                            \
-        for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {  \
-            double128_t T = NAN;                                               \
-            __prob_disassembler_get_##T(pd, addr, &T);                         \
-            assert(!isnan(T));                                                 \
-                                                                               \
-            uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);           \
-                                                                               \
-            if (z_addr_dict_exist(dag_better, scc_id)) {                       \
-                double128_t T##_ = z_addr_dict_get(dag_better, scc_id);        \
-                if (T op T##_) {                                               \
-                    z_addr_dict_set(dag_better, scc_id, T);                    \
-                }                                                              \
-            } else {                                                           \
-                z_addr_dict_set(dag_better, scc_id, T);                        \
-            }                                                                  \
-        }                                                                      \
-                                                                               \
-        /* step [2]. restrain T */                                             \
-        for (GList *l = pd->topo->tail; l != NULL; l = l->prev) {              \
-            uint32_t scc_id = (uint32_t)l->data;                               \
-                                                                               \
-            assert(z_addr_dict_exist(dag_better, scc_id));                     \
-                                                                               \
-            double128_t T = z_addr_dict_get(dag_better, scc_id);               \
-                                                                               \
-            GHashTable *pred_scc_ids = z_addr_dict_get(pd->dag_preds, scc_id); \
-            GList *list_pred_scc_ids = g_hash_table_get_keys(pred_scc_ids);    \
-            for (GList *ll = list_pred_scc_ids; ll != NULL; ll = ll->next) {   \
-                uint32_t pred_scc_id = (uint32_t)ll->data;                     \
-                                                                               \
-                double128_t pred_##T =                                         \
-                    z_addr_dict_get(dag_better, pred_scc_id);                  \
-                                                                               \
-                if (T op pred_##T) {                                           \
-                    z_addr_dict_set(dag_better, pred_scc_id, T);               \
-                }                                                              \
-            }                                                                  \
-            g_list_free(list_pred_scc_ids);                                    \
-        }                                                                      \
-                                                                               \
-        /* step [3]. reassign T for each address */                            \
-        for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {  \
-            uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);           \
-                                                                               \
-            assert(z_addr_dict_exist(dag_better, scc_id));                     \
-                                                                               \
-            __prob_disassembler_reset_##T(                                     \
-                pd, addr, z_addr_dict_get(dag_better, scc_id));                \
-        }                                                                      \
-                                                                               \
-        z_addr_dict_destroy(dag_better);                                       \
+/*
+ * Calculate the normalized probability of addr, based on D of addr and its
+ * occluded instructions
+ */
+Z_PRIVATE double __prob_disassembler_normalize_addr(ProbDisassembler *pd,
+                                                    addr_t addr);
+
+/*
+ * Get level offsets of the reversed pd->level_sccs, where the task_id of an
+ * SCC is (scc_n - 1 - its index in pd->level_sccs)
+ */
+Z_PRIVATE size_t *__prob_disassembler_reverse_levels(ProbDisassembler *pd);
+
+Z_PRIVATE size_t *__prob_disassembler_reverse_levels(ProbDisassembler *pd) {
+    size_t *rev_offs = z_alloc(pd->level_n + 1, sizeof(size_t));
+    for (size_t l = 0; l <= pd->level_n; l++) {
+        rev_offs[l] = pd->scc_n - pd->level_offs[pd->level_n - l];
+    }
+    return rev_offs;
+}
+
+// XXX: restraint is pulled from successors level by level (in the reversed
+// order), so that SCCs of the same level can be handled in parallel. Note that
+// it is exactly the same as pushing into predecessors in the reversed
+// topological order, as min/max is order-insensitive.
+#define __DECLARE_RESTRAIN(T, type, op)                                       \
+    STRUCT(__RestrainCtx_##T, {                                               \
+        ProbDisassembler *pd;                                                 \
+        type *dag_better;                                                     \
+    });                                                                       \
+                                                                              \
+    Z_PRIVATE void __prob_disassembler_pull_better_##T(void *ctx_,            \
+                                                       size_t task_id) {      \
+        __RestrainCtx_##T *ctx = (__RestrainCtx_##T *)ctx_;                   \
+        ProbDisassembler *pd = ctx->pd;                                       \
+                                                                              \
+        uint32_t scc_id = pd->level_sccs[pd->scc_n - 1 - task_id];            \
+        type T = ctx->dag_better[scc_id];                                     \
+                                                                              \
+        for (uint32_t i = pd->dag_succ_offs[scc_id];                          \
+             i < pd->dag_succ_offs[scc_id + 1]; i++) {                        \
+            type succ_##T = ctx->dag_better[pd->dag_succs[i]];                \
+            if (succ_##T op T) {                                              \
+                T = succ_##T;                                                 \
+            }                                                                 \
+        }                                                                     \
+                                                                              \
+        ctx->dag_better[scc_id] = T;                                          \
+    }                                                                         \
+                                                                              \
+    Z_PRIVATE void __prob_disassembler_restrain_##T(ProbDisassembler *pd) {   \
+        addr_t text_addr = pd->text_addr;                                     \
+        size_t text_size = pd->text_size;                                     \
+                                                                              \
+        /* step [1]. calculate better T for each scc */                       \
+        AddrDict(type, dag_better);                                           \
+        z_addr_dict_init(dag_better, 0, pd->scc_n);                           \
+        for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) { \
+            type T = NAN;                                                     \
+            __prob_disassembler_get_##T(pd, addr, &T);                        \
+            assert(!isnan(T));                                                \
+                                                                              \
+            uint32_t scc_id = z_addr_dict_get(pd->addr2sccid, addr);          \
+                                                                              \
+            if (z_addr_dict_exist(dag_better, scc_id)) {                      \
+                type T##_ = z_addr_dict_get(dag_better, scc_id);              \
+                if (T op T##_) {                                              \
+                    z_addr_dict_set(dag_better, scc_id, T);                   \
+                }                                                             \
+            } else {                                                          \
+                z_addr_dict_set(dag_better, scc_id, T);                       \
+            }                                                                 \
+        }                                                                     \
+                                                                              \
+        memcpy(pd->dag_local_##T, z_addr_dict_get_data(dag_better),           \
+               pd->scc_n * sizeof(type));                                     \
+                                                                              \
+        /* step [2]. restrain T */                                            \
+        size_t *rev_offs = __prob_disassembler_reverse_levels(pd);            \
+        __RestrainCtx_##T ctx = {                                             \
+            .pd = pd,                                                         \
+            .dag_better = z_addr_dict_get_data(dag_better),                   \
+        };                                                                    \
+        z_parallel_run_levels(pd->level_n, rev_offs,                          \
+                              &__prob_disassembler_pull_better_##T, &ctx);    \
+        z_free(rev_offs);                                                     \
+        memcpy(pd->dag_better_##T, z_addr_dict_get_data(dag_better),          \
+               pd->scc_n * sizeof(type));                                     \
+                                                                              \
+        /* step [3]. reassign T for each address (refer to kernels.c) */      \
+        __pdisasm_kernels_reassign(                                           \
+            pd->kernels, z_addr_dict_get_data(pd->T),                         \
+            z_addr_dict_get_used(pd->T), z_addr_dict_get_data(dag_better),    \
+            z_addr_dict_get_data(pd->addr2sccid), text_size);                 \
+                                                                              \
+        z_addr_dict_destroy(dag_better);                                      \
     }
 
-__DECLARE_RESTRAIN(D, >);
-__DECLARE_RESTRAIN(P, <);
+// XXX: log is monotonic, so D can be directly restrained in the log domain
+__DECLARE_RESTRAIN(D, logprob_t, >);
+__DECLARE_RESTRAIN(P, double, <);
 
 #undef __DECLARE_RESTRAIN
 
-Z_PRIVATE void __prob_disassembler_normalize_prob(ProbDisassembler *pd) {
+Z_PRIVATE double __prob_disassembler_normalize_addr(ProbDisassembler *pd,
+                                                    addr_t addr) {
     Disassembler *d = pd->base;
     addr_t text_addr = pd->text_addr;
-    size_t text_size = pd->text_size;
 
-    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        double128_t D = NAN;
-        __prob_disassembler_get_D(pd, addr, &D);
-        assert(!isnan(D));
-
-        // check P first to make sure a 100% data is still data
-        double128_t P = NAN;
-        if (__prob_disassembler_get_P(pd, addr, &P)) {
-            if (__double128_equal(P, 0.0)) {
-                continue;
-            }
-        }
+    logprob_t D = NAN;
+    __prob_disassembler_get_D(pd, addr, &D);
+    assert(!isnan(D));
 
-        if (__double128_equal(D, 1.0)) {
-            __prob_disassembler_reset_P(pd, addr, 0.0);
-            continue;
+    // check P first to make sure a 100% data is still data
+    double P = NAN;
+    if (__prob_disassembler_get_P(pd, addr, &P)) {
+        if (__double_equal(P, 0.0)) {
+            return P;
         }
+    }
 
-        if (__double128_equal(D, 0.0)) {
-            __prob_disassembler_reset_P(pd, addr, 1.0);
-            continue;
-        }
+    if (__logprob_is_one(D)) {
+        return 0.0;
+    }
 
-        double128_t s = 1.0 / D;
+    if (__logprob_is_zero(D)) {
+        return 1.0;
+    }
 
-        if (isinf(s)) {
-            __prob_disassembler_reset_P(pd, addr, 1.0);
-            continue;
-        }
+    // XXX: s = 1 / D + sum(1 / occ_D), which is calculated in the log
+    // domain. Note that 1 / D can no longer overflow here.
+    logprob_t s = -D;
 
-        Iter(addr_t, occ_addrs);
-        z_iter_init_from_buf(occ_addrs,
-                             z_disassembler_get_occluded_addrs(d, addr));
+    const uint32_t *occ_offs = NULL;
+    size_t occ_n = 0;
+    z_disassembler_get_occluded_addrs(d, addr, &occ_offs, &occ_n);
 
-        while (!z_iter_is_empty(occ_addrs)) {
-            addr_t occ_addr = *(z_iter_next(occ_addrs));
+    for (size_t i = 0; i < occ_n; i++) {
+        addr_t occ_addr = text_addr + occ_offs[i];
 
-            double128_t occ_D = NAN;
-            __prob_disassembler_get_D(pd, occ_addr, &occ_D);
-            assert(!isnan(occ_D));
+        logprob_t occ_D = NAN;
+        __prob_disassembler_get_D(pd, occ_addr, &occ_D);
+        assert(!isnan(occ_D));
 
-            if (__double128_equal(occ_D, 0.0)) {
-                s = +INFINITY;
-            } else {
-                s += 1.0 / occ_D;
-            }
+        if (__logprob_is_zero(occ_D)) {
+            s = +INFINITY;
+        } else {
+            s = __logprob_add(s, -occ_D);
         }
-        assert(!isnan(s));
+    }
+    assert(!isnan(s));
 
-        double128_t final_P = (1.0 / D) / s;
-        assert(!isnan(final_P));
-        if (!isnan(P)) {
-            size_t n = pd->round_n;
-            assert(n);
+    double final_P = exp(-D - s);
+    assert(!isnan(final_P));
+    if (!isnan(P)) {
+        size_t n = pd->round_n;
+        assert(n);
 
-            final_P = (final_P / (n + 1)) * n + P / (n + 1);
-        }
+        final_P = (final_P / (n + 1)) * n + P / (n + 1);
+    }
+
+    return final_P;
+}
+
+Z_PRIVATE void __prob_disassembler_normalize_prob(ProbDisassembler *pd) {
+    addr_t text_addr = pd->text_addr;
+    size_t text_size = pd->text_size;
 
-        __prob_disassembler_reset_P(pd, addr, final_P);
+    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
+        __prob_disassembler_reset_P(
+            pd, addr, __prob_disassembler_normalize_addr(pd, addr));
     }
 
     __prob_disassembler_restrain_P(pd);
@@ -176,47 +217,34 @@ Z_PRIVATE void __prob_disassembler_spread_hints(ProbDisassembler *pd) {
     size_t text_size = pd->text_size;
 
     // step [1]. use RH to update D, and reset any D bigger than 1.0 as 1.0
-    for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        double128_t RH = NAN;
-        if (__prob_disassembler_get_RH(pd, addr, &RH)) {
-            __prob_disassembler_update_D(pd, addr, RH);
-        }
-
-        cs_insn *inst = z_disassembler_get_superset_disasm(d, addr);
-        if (!inst) {
-            assert(isnan(RH) || isinf(RH));  // we may update inst_lost as +inf
-            __prob_disassembler_reset_D(pd, addr, 1.0);
-        }
-
-        double128_t D = NAN;
-        if (__prob_disassembler_get_D(pd, addr, &D)) {
-            // XXX: when D is nan or inf, it means addr has a very strong data
-            // hint and a strong inst hint. As we are trying to avoid false
-            // postive, in this case, we will set it as data.
-            if (isnan(D) || isinf(D) || D > 1.0) {
-                __prob_disassembler_reset_D(pd, addr, 1.0);
-            }
-        }
-    }
+    // (refer to kernels.c). Note that an invalid instruction (whose SCC id is
+    // 0) is always data.
+    // XXX: when D is nan or inf, it means addr has a very strong data hint and
+    // a strong inst hint. As we are trying to avoid false postive, in this
+    // case, we will set it as data.
+    __pdisasm_kernels_spread(
+        pd->kernels, z_addr_dict_get_data(pd->D), z_addr_dict_get_used(pd->D),
+        z_addr_dict_get_data(pd->RH), z_addr_dict_get_used(pd->RH),
+        z_addr_dict_get_data(pd->addr2sccid), text_size);
 
     // step [2]. spread D into occluded instructions
     for (addr_t addr = text_addr; addr < text_addr + text_size; addr++) {
-        double128_t min_D = NAN;
+        logprob_t min_D = NAN;
 
         // ignore the ones already with D value
         if (__prob_disassembler_get_D(pd, addr, &min_D)) {
             continue;
         }
 
-        assert(z_disassembler_get_occluded_addrs(d, addr));
-
-        Iter(addr_t, occ_addrs);
-        z_iter_init_from_buf(occ_addrs,
-                             z_disassembler_get_occluded_addrs(d, addr));
+        const uint32_t *occ_offs = NULL;
+        size_t occ_n = 0;
+        if (!z_disassembler_get_occluded_addrs(d, addr, &occ_offs, &occ_n)) {
+            EXITME("invalid instruction without D: %#lx", addr);
+        }
 
-        while (!z_iter_is_empty(occ_addrs)) {
-            addr_t occ_addr = *(z_iter_next(occ_addrs));
-            double128_t D = NAN;
+        for (size_t i = 0; i < occ_n; i++) {
+            addr_t occ_addr = text_addr + occ_offs[i];
+            logprob_t D = NAN;
 
             if (__prob_disassembler_get_D(pd, occ_addr, &D)) {
                 if (isnan(min_D) || D < min_D) {
@@ -229,10 +257,11 @@ Z_PRIVATE void __prob_disassembler_spread_hints(ProbDisassembler *pd) {
         // it are 100% data, it should be data. (the threshold 1.0 can be
         // changed in the future -- maybe)
         // TODO: the logic here is weird.
-        if (isnan(min_D) || __double128_equal(min_D, 1.0)) {
-            __prob_disassembler_reset_D(pd, addr, 1.0);
+        if (isnan(min_D) || __logprob_is_one(min_D)) {
+            __prob_disassembler_reset_D(pd, addr, 0.0);  // log(1.0)
         } else {
-            __prob_disassembler_reset_D(pd, addr, 1.0 - min_D);
+            // log(1.0 - D)
+            __prob_disassembler_reset_D(pd, addr, log1p(-exp(min_D)));
         }
     }
 }
@@ -33,6 +33,9 @@ FILE *__debug_file = NULL;
 #endif
 
 #define ASMLINE_FMT_SIZE 0x100
+#define REWRITER_CS_ARENA_CHUNK_SIZE 0x10000
+#define REWRITER_HOLE_CHUNK_SIZE 0x100
+#define REWRITER_PARALLEL_MIN_HOLE_N 0x1000
 
 static char asmline_fmt[ASMLINE_FMT_SIZE];
 
@@ -69,6 +72,13 @@ Z_RESERVED Z_PRIVATE addr_t __rewriter_calculate_utp_addr(Rewriter *r,
  */
 Z_RESERVED Z_PRIVATE bool __rewriter_patch_utp(Rewriter *r, addr_t ori_addr);
 
+/*
+ * Relocate the disp32 of a rip-related inst to shadow_addr, without changing
+ * its size (return NULL if the new displacement overflows)
+ */
+Z_PRIVATE cs_insn *__rewriter_relocate_rip_inst(cs_insn *inst, addr_t ori_addr,
+                                                addr_t shadow_addr);
+
 /*
  * Translate inst into shadow address
  */
@@ -89,7 +99,7 @@ Z_PRIVATE void __rewriter_generate_shadow_block(
     cs_insn *(*disasm_func)(Disassembler *, addr_t));
 
 /*
- * Fill in shadow holes
+ * Fill in shadow holes (in parallel when there are many of them)
  */
 Z_PRIVATE void __rewriter_fillin_shadow_hole(Rewriter *r, GHashTable *holes);
 
@@ -118,10 +128,13 @@ Z_PRIVATE void __rewriter_count_conflicted_ids(Rewriter *r) {
 
     GHashTable *id_2_bb =
         g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
-    GList *bbs = g_hash_table_get_keys(r->rewritten_bbs);
 
-    for (GList *l = bbs; l != NULL; l = l->next) {
-        addr_t bb_addr = (addr_t)(l->data);
+    for (size_t i = 0; i < z_addr_map_get_cap(r->rewritten_bbs); i++) {
+        if (!z_addr_map_slot_used(r->rewritten_bbs, i)) {
+            continue;
+        }
+
+        addr_t bb_addr = z_addr_map_slot_key(r->rewritten_bbs, i);
         size_t bb_id = AFL_BB_ID(bb_addr);
 
         addr_t old_bb =
@@ -136,7 +149,6 @@ Z_PRIVATE void __rewriter_count_conflicted_ids(Rewriter *r) {
     }
 
     g_hash_table_destroy(id_2_bb);
-    g_list_free(bbs);
 
     z_info("number of conflicted block IDs : %ld", conflicts);
 }
@@ -407,17 +419,37 @@ Z_PRIVATE void __rewriter_emit_trampoline(Rewriter *r, addr_t addr) {
 #endif
 }
 
-Z_PRIVATE void __rewriter_fillin_shadow_hole(Rewriter *r, GHashTable *holes) {
-    GList *shadow_addrs = g_hash_table_get_keys(holes);
-    ELF *e = z_binary_get_elf(r->binary);
+/*
+ * Context of parallel hole filling. Holes never overlap with each other, and
+ * the shadow code only grows when rewriting. Hence, each task patches its own
+ * holes through a raw pointer of the shadow code without any synchronization.
+ */
+STRUCT(__RewriterHoleCtx, {
+    Rewriter *r;
+    addr_t *hole_addrs;    // shadow addresses of holes
+    addr_t *target_addrs;  // original addresses of transfer targets
+    size_t hole_n;
+    addr_t shadow_base;   // the lowest hole
+    uint8_t *shadow_buf;  // raw pointer of shadow_base
+});
+
+Z_PRIVATE void __rewriter_fillin_shadow_hole_chunk(void *ctx_,
+                                                   size_t task_id) {
+    __RewriterHoleCtx *ctx = (__RewriterHoleCtx *)ctx_;
+    Rewriter *r = ctx->r;
+
+    size_t i = task_id * REWRITER_HOLE_CHUNK_SIZE;
+    size_t end_i = i + REWRITER_HOLE_CHUNK_SIZE;
+    if (end_i > ctx->hole_n) {
+        end_i = ctx->hole_n;
+    }
 
-    for (GList *l = shadow_addrs; l != NULL; l = l->next) {
-        addr_t shadow_inst_addr = (addr_t)(l->data);
-        addr_t ori_tar_addr = (addr_t)g_hash_table_lookup(
-            holes, GSIZE_TO_POINTER(shadow_inst_addr));
+    for (; i < end_i; i++) {
+        addr_t shadow_inst_addr = ctx->hole_addrs[i];
+        addr_t ori_tar_addr = ctx->target_addrs[i];
+        uint8_t *hole = ctx->shadow_buf + (shadow_inst_addr - ctx->shadow_base);
 
-        addr_t shadow_tar_addr = (addr_t)g_hash_table_lookup(
-            r->rewritten_bbs, GSIZE_TO_POINTER(ori_tar_addr));
+        addr_t shadow_tar_addr = z_addr_map_get(r->rewritten_bbs, ori_tar_addr);
         if (shadow_tar_addr == 0) {
             // XXX: ignore invalid hole as it may be false instruction
             z_warn("an invalid hole: %#lx <- %#lx", ori_tar_addr,
@@ -427,8 +459,7 @@ Z_PRIVATE void __rewriter_fillin_shadow_hole(Rewriter *r, GHashTable *holes) {
 
         // get id and hole size
         uint32_t inst_id;
-        z_elf_read(e, shadow_inst_addr, sizeof(uint32_t),
-                   (uint8_t *)(&inst_id));
+        memcpy(&inst_id, hole, sizeof(uint32_t));
 
 #ifndef NSINGLE_SUCC_OPT
         // check whether we need to do optimization
@@ -436,8 +467,7 @@ Z_PRIVATE void __rewriter_fillin_shadow_hole(Rewriter *r, GHashTable *holes) {
             if ((int32_t)inst_id < 0) {
                 // it is a trampoline-free transfer
                 inst_id = (~inst_id) + 1;
-                shadow_tar_addr = (addr_t)g_hash_table_lookup(
-                    r->shadow_code, GSIZE_TO_POINTER(ori_tar_addr));
+                shadow_tar_addr = z_addr_map_get(r->shadow_code, ori_tar_addr);
             }
         } else {
             assert((int32_t)inst_id >= 0);
@@ -446,20 +476,160 @@ Z_PRIVATE void __rewriter_fillin_shadow_hole(Rewriter *r, GHashTable *holes) {
 
         size_t hole_size = __rewriter_get_hole_len(inst_id);
 
-        // generate code
-        KS_ASM(shadow_inst_addr, "%s %#lx", cs_insn_name(cs, inst_id),
-               shadow_tar_addr);
-        z_elf_write(e, shadow_inst_addr, ks_size, ks_encode);
+        // generate code (KS_ASM_BRANCH is not reentrant)
+        uint8_t buf[0x10];
+        size_t size =
+            z_x64_gen_branch(buf, shadow_inst_addr, shadow_tar_addr, inst_id);
 
         // padding hole
-        assert(ks_size <= hole_size);
-        if (ks_size < hole_size) {
-            z_elf_write(e, shadow_inst_addr + ks_size, hole_size - ks_size,
-                        z_x64_gen_nop(hole_size - ks_size));
+        assert(size <= hole_size);
+        if (size < hole_size) {
+            memcpy(buf + size, z_x64_gen_nop(hole_size - size),
+                   hole_size - size);
+        }
+
+        memcpy(hole, buf, hole_size);
+    }
+}
+
+Z_PRIVATE void __rewriter_fillin_shadow_hole(Rewriter *r, GHashTable *holes) {
+    size_t hole_n = g_hash_table_size(holes);
+    if (!hole_n) {
+        return;
+    }
+
+    // step [1]. collect holes
+    addr_t *hole_addrs = z_alloc(hole_n, sizeof(addr_t));
+    addr_t *target_addrs = z_alloc(hole_n, sizeof(addr_t));
+    addr_t shadow_base = ADDR_MAX;
+    {
+        GHashTableIter iter;
+        gpointer key, value;
+        size_t i = 0;
+
+        g_hash_table_iter_init(&iter, holes);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            hole_addrs[i] = (addr_t)key;
+            target_addrs[i] = (addr_t)value;
+            if (hole_addrs[i] < shadow_base) {
+                shadow_base = hole_addrs[i];
+            }
+            i++;
         }
+        assert(i == hole_n);
     }
 
-    g_list_free(shadow_addrs);
+    // step [2]. get the raw pointer of shadow code, which covers all holes as
+    // all of them are in the currently written shadow code
+    size_t shadow_size = z_binary_get_shadow_code_addr(r->binary) - shadow_base;
+    Rptr *shadow_ptr = NULL;
+    uint8_t *shadow_buf =
+        z_binary_get_staged_shadow_code(r->binary, shadow_base, shadow_size);
+    if (!shadow_buf) {
+        // holes are already written into the ELF
+        ELF *e = z_binary_get_elf(r->binary);
+        shadow_ptr = z_elf_vaddr2ptr(e, shadow_base);
+        if (z_rptr_is_null(shadow_ptr) ||
+            z_rptr_get_size(shadow_ptr) < shadow_size) {
+            EXITME("invalid shadow code for holes starting at %#lx",
+                   shadow_base);
+        }
+        shadow_buf = shadow_ptr->raw_ptr;
+    }
+
+    // step [3]. fill in holes, in parallel only when it pays off
+    __RewriterHoleCtx ctx = {
+        .r = r,
+        .hole_addrs = hole_addrs,
+        .target_addrs = target_addrs,
+        .hole_n = hole_n,
+        .shadow_base = shadow_base,
+        .shadow_buf = shadow_buf,
+    };
+    size_t task_n =
+        (hole_n + REWRITER_HOLE_CHUNK_SIZE - 1) / REWRITER_HOLE_CHUNK_SIZE;
+    if (hole_n < REWRITER_PARALLEL_MIN_HOLE_N) {
+        for (size_t i = 0; i < task_n; i++) {
+            __rewriter_fillin_shadow_hole_chunk(&ctx, i);
+        }
+    } else {
+        z_parallel_run(task_n, &__rewriter_fillin_shadow_hole_chunk, &ctx);
+    }
+
+    if (shadow_ptr) {
+        z_rptr_destroy(shadow_ptr);
+    }
+    z_free(hole_addrs);
+    z_free(target_addrs);
+}
+
+Z_PRIVATE cs_insn *__rewriter_relocate_rip_inst(cs_insn *inst, addr_t ori_addr,
+                                                addr_t shadow_addr) {
+    cs_detail *detail = inst->detail;
+
+    // step [1]. locate the rip-relative operand and its disp32
+    int32_t op_idx = -1;
+    for (int32_t i = 0; i < detail->x86.op_count; i++) {
+        cs_x86_op *op = &(detail->x86.operands[i]);
+        if (op->type == X86_OP_MEM && op->mem.base == X86_REG_RIP) {
+            assert(op->mem.index == X86_REG_INVALID);
+            op_idx = i;
+            break;
+        }
+    }
+    if (op_idx < 0) {
+        return NULL;
+    }
+
+    int64_t ori_disp = detail->x86.operands[op_idx].mem.disp;
+    if (ori_disp != (int32_t)ori_disp) {
+        return NULL;
+    }
+    size_t disp_offset =
+        z_x64_get_rip_disp_offset(inst->bytes, inst->size, (int32_t)ori_disp);
+    if (!disp_offset) {
+        return NULL;
+    }
+
+    // step [2]. the instruction size is unchanged, so the target is kept as
+    // long as (shadow_addr + disp) equals to (ori_addr + ori_disp)
+    int64_t disp = ori_disp + ori_addr - shadow_addr;
+    if (disp != (int32_t)disp) {
+        return NULL;
+    }
+    int32_t disp32 = (int32_t)disp;
+
+    // step [3]. copy inst and patch the displacement
+    cs_insn *new_inst = cs_malloc(cs);
+    cs_detail *new_detail = new_inst->detail;
+    memcpy(new_inst, inst, sizeof(cs_insn));
+    memcpy(new_detail, detail, sizeof(cs_detail));
+    new_inst->detail = new_detail;
+    new_inst->address = shadow_addr;
+    memcpy(new_inst->bytes + disp_offset, &disp32, sizeof(disp32));
+    new_detail->x86.operands[op_idx].mem.disp = disp;
+    new_detail->x86.disp = disp;
+
+    // step [4]. update op_str, which handlers may pass to keystone
+    char *rip_str = z_strstr(new_inst->op_str, "rip");
+    assert(rip_str);
+    char *tail_str = z_strchr(rip_str, ']');
+    assert(tail_str);
+    char tail_buf[sizeof(new_inst->op_str)];
+    z_strcpy(tail_buf, tail_str);
+    z_snprintf(rip_str, sizeof(new_inst->op_str) - (rip_str - new_inst->op_str),
+               "rip %c %#lx%s", (disp < 0 ? '-' : '+'),
+               (disp < 0 ? -disp : disp), tail_buf);
+
+    // step [5]. hand new_inst over to cs_inst, the same as CS_DISASM_RAW
+    assert(inst != cs_inst);
+    if (cs_inst != NULL) {
+        cs_free((cs_insn *)cs_inst, cs_count);
+    }
+    cs_inst = new_inst;
+    cs_count = 1;
+
+    return new_inst;
 }
 
 Z_PRIVATE cs_insn *__rewriter_translate_shadow_inst(Rewriter *r, cs_insn *inst,
@@ -490,6 +660,15 @@ TRANSLATE_RIP_INS:
         pc_regname = "eip";
     } else {
         pc_regname = "rip";
+
+        // step [0]. directly relocate the displacement if possible, which
+        // avoids the round trips of keystone and capstone
+        cs_insn *new_inst = __rewriter_relocate_rip_inst(
+            inst, ori_addr, z_binary_get_shadow_code_addr(r->binary));
+        if (new_inst) {
+            return new_inst;
+        }
+        z_trace("re-encode rip-related instruction " CS_SHOW_INST(inst));
     }
 
     // step [1]. generate asmline fmt (FMTSTR ATTACK!!!)
@@ -652,10 +831,8 @@ Z_PRIVATE void __rewriter_generate_shadow_inst(Rewriter *r, GHashTable *holes,
     if (bb_entry) {
         size_t shadow_addr = z_binary_get_shadow_code_addr(r->binary);
         // step [1.1]. update rewritten_bbs
-        if (!g_hash_table_lookup(r->rewritten_bbs,
-                                 GSIZE_TO_POINTER(ori_addr))) {
-            g_hash_table_insert(r->rewritten_bbs, GSIZE_TO_POINTER(ori_addr),
-                                GSIZE_TO_POINTER(shadow_addr));
+        if (!z_addr_map_exist(r->rewritten_bbs, ori_addr)) {
+            z_addr_map_set(r->rewritten_bbs, ori_addr, shadow_addr);
         }
 
         // step [1.2] insert trampolines based on optimization
@@ -663,11 +840,10 @@ Z_PRIVATE void __rewriter_generate_shadow_inst(Rewriter *r, GHashTable *holes,
     }
 
     // step [2]. update shadow code
-    if (!g_hash_table_lookup(r->shadow_code, GSIZE_TO_POINTER(ori_addr))) {
+    if (!z_addr_map_exist(r->shadow_code, ori_addr)) {
         size_t shadow_addr = z_binary_get_shadow_code_addr(r->binary);
         // we store the first apperance of each instruction
-        g_hash_table_insert(r->shadow_code, GSIZE_TO_POINTER(ori_addr),
-                            GSIZE_TO_POINTER(shadow_addr));
+        z_addr_map_set(r->shadow_code, ori_addr, shadow_addr);
         z_binary_update_lookup_table(r->binary, ori_addr, shadow_addr);
     }
 
@@ -694,6 +870,15 @@ Z_PRIVATE void __rewriter_generate_shadow_inst(Rewriter *r, GHashTable *holes,
 #endif
 
     // step [4]. check handlers
+    // step [4.1]. pre-defined handlers are dispatched by instruction id
+    RHandlerFcn predefined_fcn = __rewriter_dispatch_predefined_handler(inst);
+    if (predefined_fcn) {
+        // XXX: note that the inst->address is incorrect here
+        (*predefined_fcn)(r, holes, inst, ori_addr, ori_next_addr);
+        return;
+    }
+
+    // step [4.2]. additional handlers registered at runtime
     RHandler **handlers = (RHandler **)z_buffer_get_raw_buf(r->handlers);
     size_t n = z_buffer_get_size(r->handlers) / sizeof(RHandler *);
     for (size_t i = 0; i < n; i++) {
@@ -767,7 +952,7 @@ Z_PRIVATE void __rewriter_generate_shadow_block(
     bool bb_entry = true;  // whether next instrution is a BB entrypoint
 
     // step [2]. check whether this block is handled
-    if (g_hash_table_lookup(r->rewritten_bbs, GSIZE_TO_POINTER(bb_addr))) {
+    if (z_addr_map_exist(r->rewritten_bbs, bb_addr)) {
         // we already rewrite this basic block
         return;
     }
@@ -785,11 +970,9 @@ Z_PRIVATE void __rewriter_generate_shadow_block(
             // crash detection.
 
             // step [3.1.1]. update shadow code
-            if (!g_hash_table_lookup(r->shadow_code,
-                                     GSIZE_TO_POINTER(ori_addr))) {
+            if (!z_addr_map_exist(r->shadow_code, ori_addr)) {
                 size_t shadow_addr = z_binary_get_shadow_code_addr(r->binary);
-                g_hash_table_insert(r->shadow_code, GSIZE_TO_POINTER(ori_addr),
-                                    GSIZE_TO_POINTER(shadow_addr));
+                z_addr_map_set(r->shadow_code, ori_addr, shadow_addr);
                 z_binary_update_lookup_table(r->binary, ori_addr, shadow_addr);
             }
 
@@ -801,8 +984,7 @@ Z_PRIVATE void __rewriter_generate_shadow_block(
         // XXX: instructions was used to build bridges by Rewriter, which is
         // no longer supported currently.
         if (instructions) {
-            if (!g_hash_table_lookup(r->shadow_code,
-                                     GSIZE_TO_POINTER(ori_addr))) {
+            if (!z_addr_map_exist(r->shadow_code, ori_addr)) {
                 g_queue_push_tail(instructions, GSIZE_TO_POINTER(ori_addr));
             }
         }
@@ -810,12 +992,9 @@ Z_PRIVATE void __rewriter_generate_shadow_block(
 #ifdef BINARY_SEARCH_DEBUG_REWRITER
         if (ori_addr <= BINARY_SEARCH_DEBUG_REWRITER) {
             if (bb_entry) {
-                g_hash_table_insert(r->rewritten_bbs,
-                                    GSIZE_TO_POINTER(ori_addr),
-                                    GSIZE_TO_POINTER(ori_addr));
+                z_addr_map_set(r->rewritten_bbs, ori_addr, ori_addr);
             }
-            g_hash_table_insert(r->shadow_code, GSIZE_TO_POINTER(ori_addr),
-                                GSIZE_TO_POINTER(ori_addr));
+            z_addr_map_set(r->shadow_code, ori_addr, ori_addr);
             z_binary_update_lookup_table(r->binary, ori_addr, ori_addr);
             z_elf_write(r->binary->elf, ori_addr, inst->size, inst->bytes);
         } else
@@ -935,16 +1114,15 @@ Z_API Rewriter *z_rewriter_create(Disassembler *d, SysOptArgs *opts) {
     r->binary = z_disassembler_get_binary(d);
 
     // init basic information
-    r->shadow_code =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
-    r->rewritten_bbs =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    z_addr_map_init(r->shadow_code);
+    z_addr_map_init(r->rewritten_bbs);
 
     // init potential returen address info
-    r->potential_retaddrs =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
-    r->unpatched_retaddrs = g_hash_table_new_full(
-        g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)&z_buffer_destroy);
+    z_addr_map_init(r->potential_retaddrs);
+    z_addr_map_init(r->unpatched_retaddrs);
+
+    // init arena for transient instructions
+    r->cs_arena = z_capstone_arena_create(REWRITER_CS_ARENA_CHUNK_SIZE);
 
     // init statistical data
     r->patched_safe_bg_count = 0;
@@ -986,9 +1164,10 @@ Z_RESERVED Z_API void z_rewriter_heuristics_rewrite(Rewriter *r) {
 
     g_queue_sort(new_bbs, (GCompareDataFunc)__rewriter_compare_address, NULL);
 
-    // step [2]. prepare cf_related hole
+    // step [2]. prepare cf_related hole and stage shadow code
     GHashTable *cf_related_holes =
         g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    z_binary_stage_shadow_code(r->binary);
 
     // step [3]. rewrite all new basci blocks
     while (!g_queue_is_empty(new_bbs)) {
@@ -999,8 +1178,9 @@ Z_RESERVED Z_API void z_rewriter_heuristics_rewrite(Rewriter *r) {
                                          &z_disassembler_get_linear_disasm);
     }
 
-    // step [4]. fill in all cf_related holes
+    // step [4]. fill in all cf_related holes and publish shadow code
     __rewriter_fillin_shadow_hole(r, cf_related_holes);
+    z_binary_publish_shadow_code(r->binary);
 
     // step [5]. destroy structure to avoid memleak
     g_hash_table_destroy(cf_related_holes);
@@ -1018,11 +1198,13 @@ Z_API void z_rewriter_destroy(Rewriter *r) {
         z_rhandler_destroy(handlers[i]);
     z_buffer_destroy(r->handlers);
 
-    g_hash_table_destroy(r->shadow_code);
-    g_hash_table_destroy(r->rewritten_bbs);
+    z_addr_map_destroy(r->shadow_code);
+    z_addr_map_destroy(r->rewritten_bbs);
+
+    z_addr_map_destroy(r->potential_retaddrs);
+    z_addr_map_destroy(r->unpatched_retaddrs, &z_buffer_destroy);
 
-    g_hash_table_destroy(r->potential_retaddrs);
-    g_hash_table_destroy(r->unpatched_retaddrs);
+    z_capstone_arena_destroy(r->cs_arena);
 
     z_free(r);
 
@@ -1042,6 +1224,9 @@ Z_API void z_rewriter_rewrite(Rewriter *r, addr_t new_addr) {
 
     z_trace("rewrite new target: %#lx", new_addr);
 
+    // step [0]. decode transient instructions into the arena
+    CSArena *prev_arena = z_capstone_arena_switch(r->cs_arena);
+
     // step [1]. request disassembler to recursive disassemble code
     // XXX: it is important that we have to rewrite those new basic blocks each
     // time we call z_disassembler_recursive_disasm. Or in other words,
@@ -1052,9 +1237,10 @@ Z_API void z_rewriter_rewrite(Rewriter *r, addr_t new_addr) {
 
     g_queue_sort(new_bbs, (GCompareDataFunc)__rewriter_compare_address, NULL);
 
-    // step [2]. prepare cf_related hole
+    // step [2]. prepare cf_related hole and stage shadow code
     GHashTable *cf_related_holes =
         g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    z_binary_stage_shadow_code(r->binary);
 
     // step [3]. rewrite all new basci blocks
     while (!g_queue_is_empty(new_bbs)) {
@@ -1065,19 +1251,29 @@ Z_API void z_rewriter_rewrite(Rewriter *r, addr_t new_addr) {
                                          &z_disassembler_get_recursive_disasm);
     }
 
-    // step [4]. fill in all cf_related holes
+    // step [4]. fill in all cf_related holes and publish shadow code
     __rewriter_fillin_shadow_hole(r, cf_related_holes);
+    z_binary_publish_shadow_code(r->binary);
 
     // step [5]. destroy structure to avoid memleak
     g_hash_table_destroy(cf_related_holes);
     g_queue_free(new_bbs);
 
+    // step [6]. release all transient instructions at once
+    if (cs_inst != NULL) {
+        cs_free((cs_insn *)cs_inst, cs_count);
+        cs_inst = NULL;
+    }
+    z_capstone_arena_switch(prev_arena);
+    z_capstone_arena_reset(r->cs_arena);
+
     if (r->opts->count_conflict) {
         __rewriter_count_conflicted_ids(r);
     }
 }
 
 Z_API void z_rewriter_optimization_stats(Rewriter *r) {
+    // XXX: trampolines without FLG savings are those avoiding context_save
     z_info("number of optimized FLG savings: %6d / %d", r->optimized_flg_count,
            r->afl_trampoline_count);
     z_info("number of optimized GPR savings: %6d / %d", r->optimized_gpr_count,
@@ -1087,12 +1283,10 @@ Z_API void z_rewriter_optimization_stats(Rewriter *r) {
 }
 
 Z_API addr_t z_rewriter_get_shadow_addr(Rewriter *r, addr_t addr) {
-    addr_t shadow_addr =
-        (addr_t)g_hash_table_lookup(r->rewritten_bbs, GSIZE_TO_POINTER(addr));
+    addr_t shadow_addr = z_addr_map_get(r->rewritten_bbs, addr);
 
     if (!shadow_addr) {
-        shadow_addr =
-            (addr_t)g_hash_table_lookup(r->shadow_code, GSIZE_TO_POINTER(addr));
+        shadow_addr = z_addr_map_get(r->shadow_code, addr);
     }
 
     if (shadow_addr) {
@@ -1103,15 +1297,14 @@ Z_API addr_t z_rewriter_get_shadow_addr(Rewriter *r, addr_t addr) {
 }
 
 Z_API bool z_rewriter_check_retaddr_crashpoint(Rewriter *r, addr_t addr) {
-    return !!g_hash_table_lookup(r->potential_retaddrs, GSIZE_TO_POINTER(addr));
+    return z_addr_map_exist(r->potential_retaddrs, addr);
 }
 
 // XXX: every time we find a new retaddr, we will return all the unpatched
 // retaddrs which share the same callee with this given retaddr.
 Z_API Buffer *z_rewriter_new_validate_retaddr(Rewriter *r, addr_t retaddr) {
     // step (1). find corresponding callee
-    addr_t callee = (addr_t)g_hash_table_lookup(r->potential_retaddrs,
-                                                GSIZE_TO_POINTER(retaddr));
+    addr_t callee = z_addr_map_get(r->potential_retaddrs, retaddr);
     if (!callee) {
         // XXX: theoretically this branch cannot be reached, but when we have
         // different rewriting order than last execution, the logged crashpoints
@@ -1120,10 +1313,9 @@ Z_API Buffer *z_rewriter_new_validate_retaddr(Rewriter *r, addr_t retaddr) {
     }
 
     // step (2). get all retaddrs and remove the entity
-    Buffer *buf = (Buffer *)g_hash_table_lookup(r->unpatched_retaddrs,
-                                                GSIZE_TO_POINTER(callee));
+    Buffer *buf = z_addr_map_get(r->unpatched_retaddrs, callee);
     assert(buf);
-    g_hash_table_steal(r->unpatched_retaddrs, GSIZE_TO_POINTER(callee));
+    z_addr_map_remove(r->unpatched_retaddrs, callee);
 
     return buf;
 }
@@ -19,6 +19,7 @@
 #ifndef __REWRITER_H
 #define __REWRITER_H
 
+#include "address_map.h"
 #include "binary.h"
 #include "buffer.h"
 #include "config.h"
@@ -34,12 +35,12 @@ STRUCT(Rewriter, {
     // Disassembler
     Disassembler *disassembler;
 
-    // Handlers
+    // Handlers registered at runtime (pre-defined ones are dispatched by id)
     Buffer *handlers;
 
     // Basic information
-    GHashTable *shadow_code;
-    GHashTable *rewritten_bbs;
+    AddrMap(addr_t, shadow_code);
+    AddrMap(addr_t, rewritten_bbs);
 
     /*
      * meta-info for CP_RETADDR
@@ -49,9 +50,9 @@ STRUCT(Rewriter, {
     // it is not for those internal calls or white-listed library calls.
 
     // patched retaddr, which is potential to be crashpoint
-    GHashTable *potential_retaddrs;
+    AddrMap(addr_t, potential_retaddrs);
     // for a given callee, all unpatched retaddr crashpoints associated with it
-    GHashTable *unpatched_retaddrs;  // callee -> retaddrs
+    AddrMap(Buffer *, unpatched_retaddrs);  // callee -> retaddrs
 
     // Statistical data
     size_t patched_safe_bg_count;
@@ -63,6 +64,7 @@ STRUCT(Rewriter, {
 
     // Internal data
     bool __main_rewritten;
+    CSArena *cs_arena;  // transient cs_insn during each rewriting
 
     // system optargs
     SysOptArgs *opts;
@@ -104,7 +106,8 @@ Z_API Rewriter *z_rewriter_create(Disassembler *d, SysOptArgs *opts);
 Z_API void z_rewriter_destroy(Rewriter *r);
 
 /*
- * Register a handler for rewriter
+ * Register an additional handler for rewriter, which is checked only when no
+ * pre-defined handler (rewriter_handlers/) matches the instruction
  */
 Z_API void z_rewriter_register_handler(Rewriter *r, REvent event,
                                        RHandlerFcn fcn);
@@ -4,6 +4,7 @@ import re
 
 event_re = re.compile(r"\s*#define\s*REVENT\s*(?P<event>\S*)\s*")
 handler_re = re.compile(r"\s*#define\s*RHANDLER\s*(?P<handler>\S*)\s*")
+insts_re = re.compile(r"\s*#define\s*RINSTS\s*(?P<insts>([^\n]*\\\n)*[^\n]*)")
 
 
 def extract_c_file(c_file):
@@ -26,28 +27,65 @@ def extract_c_file(c_file):
         exit(-1)
     meta_info["handler"] = captured_handler.group("handler")
 
+    captured_insts = insts_re.search(data)
+    if captured_insts is None:
+        print("generate.py: invalid format of handler plugin [no RINSTS defined]")
+        exit(-1)
+    insts = captured_insts.group("insts").replace("\\", " ").split(",")
+    meta_info["insts"] = [i.strip() for i in insts if i.strip()]
+
     print("generate.py: find %s" % meta_info)
     return meta_info
 
 
 def extend_buffer(buffer, handlers):
-    register_fcns = ""
+    table_entries = ""
+    check_fcns = ""
+    claimed = {}
     for h in handlers:
         buffer += '#include "%s"\n' % h["c_file"]
         buffer += "#undef REVENT\n"
         buffer += "#undef RHANDLER\n"
-        register_fcns += "    z_rewriter_register_handler(r, %s, %s);\n" % (
-            h["event"],
-            h["handler"],
+        buffer += "#undef RINSTS\n"
+        for inst in h["insts"]:
+            if inst in claimed:
+                print(
+                    "generate.py: %s is claimed by both %s and %s"
+                    % (inst, claimed[inst], h["handler"])
+                )
+                exit(-1)
+            claimed[inst] = h["handler"]
+            table_entries += "    [%s] = &%s,\n" % (inst, h["handler"])
+        check_fcns += (
+            "        assert(%s(&inst) == (__rewriter_handler_table[id] == &%s));\n"
+            % (h["event"], h["handler"])
         )
 
-    buffer += (
-        """
+    buffer += """
+/*
+ * Dispatch table of pre-defined handlers, indexed by capstone instruction id.
+ */
+static const RHandlerFcn __rewriter_handler_table[X86_INS_ENDING] = {
+%s};
+
+Z_PRIVATE RHandlerFcn __rewriter_dispatch_predefined_handler(
+    const cs_insn *inst) {
+    assert(inst->id < X86_INS_ENDING);
+    return __rewriter_handler_table[inst->id];
+}
+
 Z_PRIVATE void __rewriter_init_predefined_handler(Rewriter *r) {
-    %s
+#ifdef DEBUG
+    // XXX: make sure RINSTS of each handler is consistent with its REVENT
+    cs_insn inst = {0};
+    for (uint32_t id = 0; id < X86_INS_ENDING; id++) {
+        inst.id = id;
+%s    }
+#endif
 }
-        """
-        % register_fcns.strip()
+""" % (
+        table_entries,
+        check_fcns,
     )
 
     return buffer
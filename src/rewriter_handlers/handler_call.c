@@ -18,6 +18,7 @@
 
 #define REVENT z_capstone_is_call
 #define RHANDLER __rewriter_call_handler
+#define RINSTS X86_INS_CALL, X86_INS_LCALL
 
 /*
  * Rewriter handler for call instruction for non-pie programs.
@@ -141,29 +142,22 @@ Z_PRIVATE void __rewriter_call_handler_for_non_pie(Rewriter *r,
                 KS_ASM_CALL(shadow_addr, callee_addr);
                 z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
             } else {
-                KS_ASM(shadow_addr,
-                       "push %#lx;\n"
-                       "jmp %#lx;\n",
-                       ori_next_addr, callee_addr);
+                KS_ASM_PUSH_JMP(shadow_addr, ori_next_addr, callee_addr);
                 z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
 
                 // update retaddr information
                 if (lf_info->cfg_info != LCFG_TERM &&
-                    !g_hash_table_lookup(r->potential_retaddrs,
-                                         GSIZE_TO_POINTER(ori_next_addr))) {
+                    !z_addr_map_exist(r->potential_retaddrs, ori_next_addr)) {
                     // we do not known whether this callee will return. Hence,
                     // it is a potential CP_RETADDR. Additionaly, it is the
                     // first time that we find this retaddr.
-                    g_hash_table_insert(r->potential_retaddrs,
-                                        GSIZE_TO_POINTER(ori_next_addr),
-                                        GSIZE_TO_POINTER(callee_addr));
-                    Buffer *buf = (Buffer *)g_hash_table_lookup(
-                        r->unpatched_retaddrs, GSIZE_TO_POINTER(callee_addr));
+                    z_addr_map_set(r->potential_retaddrs, ori_next_addr,
+                                   callee_addr);
+                    Buffer *buf =
+                        z_addr_map_get(r->unpatched_retaddrs, callee_addr);
                     if (!buf) {
                         buf = z_buffer_create(NULL, 0);
-                        g_hash_table_insert(r->unpatched_retaddrs,
-                                            GSIZE_TO_POINTER(callee_addr),
-                                            (gpointer)buf);
+                        z_addr_map_set(r->unpatched_retaddrs, callee_addr, buf);
                     }
                     z_buffer_append_raw(buf, (uint8_t *)&ori_next_addr,
                                         sizeof(ori_next_addr));
@@ -187,7 +181,7 @@ Z_PRIVATE void __rewriter_call_handler_for_non_pie(Rewriter *r,
                 z_binary_insert_shadow_code(r->binary, inst->bytes, inst->size);
             } else {
                 // we first push the retaddr
-                KS_ASM(shadow_addr, "push %#lx", ori_next_addr);
+                KS_ASM_PUSH(ori_next_addr);
                 z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
                 shadow_addr += ks_size;
 
@@ -199,11 +193,7 @@ Z_PRIVATE void __rewriter_call_handler_for_non_pie(Rewriter *r,
                     }
 
                     int32_t off = got_addr - (shadow_addr + inst->size);
-                    KS_ASM(shadow_addr, "jmp qword ptr [rip + %+d]", off);
-                    if (ks_size != 6) {
-                        EXITME("invalid pc-related ucall");
-                    }
-
+                    KS_ASM_JMP_RIP(off);
                     z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
                 } else {
                     // jmp qword ptr [xxx]
@@ -228,7 +218,7 @@ Z_PRIVATE void __rewriter_call_handler_for_non_pie(Rewriter *r,
         /*
          * step [1]. first check callee_addr is inside .text
          */
-        if (!z_disassembler_get_superset_disasm(r->disassembler, callee_addr)) {
+        if (!z_disassembler_get_superset_inst(r->disassembler, callee_addr)) {
             if (r->opts->safe_ret) {
                 // directly write
                 KS_ASM_CALL(shadow_addr, callee_addr);
@@ -236,10 +226,7 @@ Z_PRIVATE void __rewriter_call_handler_for_non_pie(Rewriter *r,
                 z_binary_new_retaddr_entity(r->binary, shadow_addr + ks_size,
                                             ori_next_addr);
             } else {
-                KS_ASM(shadow_addr,
-                       "push %#lx;\n"
-                       "jmp %#lx;\n",
-                       ori_next_addr, callee_addr);
+                KS_ASM_PUSH_JMP(shadow_addr, ori_next_addr, callee_addr);
                 z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
             }
             return;
@@ -252,20 +239,18 @@ Z_PRIVATE void __rewriter_call_handler_for_non_pie(Rewriter *r,
 #ifndef NSINGLE_SUCC_OPT
         addr_t shadow_callee_addr;
         if (r->opts->disable_opt) {
-            shadow_callee_addr = (addr_t)g_hash_table_lookup(
-                r->rewritten_bbs, GSIZE_TO_POINTER(callee_addr));
+            shadow_callee_addr = z_addr_map_get(r->rewritten_bbs, callee_addr);
             hole_buf = (uint64_t)X86_INS_JMP;
         } else {
-            shadow_callee_addr = (addr_t)g_hash_table_lookup(
-                r->shadow_code, GSIZE_TO_POINTER(callee_addr));
+            shadow_callee_addr = z_addr_map_get(r->shadow_code, callee_addr);
             hole_buf = (uint64_t)(-(int64_t)X86_INS_JMP);
             assert((int64_t)hole_buf < 0);
 
             r->optimized_single_succ += 1;
         }
 #else
-        addr_t shadow_callee_addr = (addr_t)g_hash_table_lookup(
-            r->rewritten_bbs, GSIZE_TO_POINTER(callee_addr));
+        addr_t shadow_callee_addr =
+            z_addr_map_get(r->rewritten_bbs, callee_addr);
 #endif
 
         /*
@@ -278,10 +263,7 @@ Z_PRIVATE void __rewriter_call_handler_for_non_pie(Rewriter *r,
                 z_binary_new_retaddr_entity(r->binary, shadow_addr + ks_size,
                                             ori_next_addr);
             } else {
-                KS_ASM(shadow_addr,
-                       "push %#lx;\n"
-                       "jmp %#lx;\n",
-                       ori_next_addr, shadow_callee_addr);
+                KS_ASM_PUSH_JMP(shadow_addr, ori_next_addr, shadow_callee_addr);
                 z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
             }
         } else {
@@ -296,7 +278,7 @@ Z_PRIVATE void __rewriter_call_handler_for_non_pie(Rewriter *r,
                     r->binary, shadow_addr + __rewriter_get_hole_len(hole_buf),
                     ori_next_addr);
             } else {
-                KS_ASM(shadow_addr, "push %#lx;\n", ori_next_addr);
+                KS_ASM_PUSH(ori_next_addr);
                 z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
                 shadow_addr += ks_size;
 
@@ -352,66 +334,21 @@ Z_PRIVATE void __rewriter_call_handler_for_non_pie(Rewriter *r,
          */
         z_debug("rewrite ucall " CS_SHOW_INST(inst));
         // XXX: call may not care about eflags
-        KS_ASM(shadow_addr,
-               "  mov [rsp - 128], rcx;\n"
-               // "  mov [rsp - 120], rax;\n"
-               // "  lahf;\n"
-               // "  seto al;\n"
-               "  pop rcx;\n"
-               "  mov [rsp - 144], rcx;\n"
-               /*
-                * for addresses outside .text, directly go through
-                */
-               "  cmp rcx, %#lx;\n" // compare upper bound of .text
-               "  jae hug;\n"
-               "  sub rcx, %#lx;\n" // sub .text base and compare
-               "  jb hug;\n"
-               /*
-                * update bitmap and prev_id
-                */
-               "  mov [rsp - 152], rdx;\n"
-               "  mov [rsp - 160], rdi;\n"
-               "  xor rdx, rdx;\n" // hug keystone (issue #295)
-               "  mov rdi, qword ptr [" STRING(AFL_PREV_ID_PTR) " + rdx];\n"
-               "  mov rdx, rcx;\n"
-               "  shr rdx, " STRING(AFL_MAP_SIZE_POW2) ";\n"
-               "  xor rdx, rcx;\n"
-               "  and rdx, " STRING(AFL_MAP_SIZE_MASK) ";\n"
-               "  xor rdi, rdx;\n"
-               "  inc BYTE PTR [" STRING(AFL_MAP_ADDR) " + rdi];\n"
-               "  xor rdi, rdi;\n" // hug keystone (issue #295)
-               "  shr rdx, 1;\n"
-               "  mov qword ptr [" STRING(AFL_PREV_ID_PTR) " + rdi], rdx;\n"
-               "  mov rdi, [rsp - 160];\n"
-               "  mov rdx, [rsp - 152];\n"
-               /*
-                * lookup target shadow address
-                */
-               "  shl rcx, " STRING(LOOKUP_TABLE_CELL_SIZE_POW2) ";\n"
-               "  movsxd rcx, dword ptr [" STRING(LOOKUP_TABLE_ADDR) " + rcx];\n"
-               "  mov [rsp - 144], rcx;\n"
-               /*
-                * go to target
-                */
-               "hug:\n"
-               // "  add al, 127;\n"
-               // "  sahf;\n"
-               // "  mov rax, [rsp - 120 - 8];\n"
-               "  mov rcx, [rsp - 128 - 8];\n",
-               text_addr + text_size, text_addr);
-        z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
+        TP_EMIT(ucall, text_addr, text_size);
+        z_binary_insert_shadow_code(r->binary, tp_code, tp_size);
 
         // XXX: the below assembly is following the previous one
-        shadow_addr += ks_size;
+        shadow_addr += tp_size;
         if (r->opts->safe_ret) {
-            KS_ASM(shadow_addr, "call qword ptr [rsp - 144]");
+            // call qword ptr [rsp - 144]
+            KS_ASM_RAW("\xff\x94\x24\x70\xff\xff\xff");
             z_binary_new_retaddr_entity(r->binary, shadow_addr + ks_size,
                                         ori_next_addr);
         } else {
-            KS_ASM(shadow_addr,
-                   "push %#lx;\n"
-                   "jmp qword ptr [rsp - 144 + 8];\n",
-                   ori_next_addr);
+            // push ori_next_addr; jmp qword ptr [rsp - 144 + 8]
+            KS_ASM_PUSH(ori_next_addr);
+            z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
+            KS_ASM_RAW("\xff\xa4\x24\x78\xff\xff\xff");
         }
         z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
     }
@@ -18,6 +18,11 @@
 
 #define REVENT z_capstone_is_cjmp
 #define RHANDLER __rewriter_cjmp_handler
+#define RINSTS                                                           \
+    X86_INS_JAE, X86_INS_JA, X86_INS_JBE, X86_INS_JB, X86_INS_JCXZ,      \
+        X86_INS_JECXZ, X86_INS_JE, X86_INS_JGE, X86_INS_JG, X86_INS_JLE, \
+        X86_INS_JL, X86_INS_JNE, X86_INS_JNO, X86_INS_JNP, X86_INS_JNS,  \
+        X86_INS_JO, X86_INS_JP, X86_INS_JRCXZ, X86_INS_JS
 
 /*
  * Rewriter handler for cjmp instruction.
@@ -48,10 +53,8 @@ Z_PRIVATE void __rewriter_cjmp_handler_for_rcx(Rewriter *r, GHashTable *holes,
     addr_t true_branch_addr = op->imm;
     addr_t false_branch_addr = ori_next_addr;
 
-    if (!z_disassembler_get_superset_disasm(r->disassembler,
-                                            true_branch_addr) ||
-        !z_disassembler_get_superset_disasm(r->disassembler,
-                                            false_branch_addr)) {
+    if (!z_disassembler_get_superset_inst(r->disassembler, true_branch_addr) ||
+        !z_disassembler_get_superset_inst(r->disassembler, false_branch_addr)) {
         // j*cxz can only do short jump, if this happend, it means we are
         // writing a false instruction
         z_warn("false instruction detected " CS_SHOW_INST(inst));
@@ -83,28 +86,26 @@ Z_PRIVATE void __rewriter_cjmp_handler_for_rcx(Rewriter *r, GHashTable *holes,
             EXITME("invalid opcode " CS_SHOW_INST(inst));
     }
 
-#define __GENERATE_SHADOW_JMP(tar_addr)                                  \
-    do {                                                                 \
-        addr_t shadow_addr = z_binary_get_shadow_code_addr(r->binary);   \
-        addr_t shadow_tar_addr = (addr_t)g_hash_table_lookup(            \
-            r->rewritten_bbs, GSIZE_TO_POINTER(tar_addr));               \
-        if (shadow_tar_addr) {                                           \
-            KS_ASM(shadow_addr, "jmp %#lx", shadow_tar_addr);            \
-            z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);  \
-            if (ks_size < 5) {                                           \
-                z_binary_insert_shadow_code(                             \
-                    r->binary, z_x64_gen_nop(5 - ks_size), 5 - ks_size); \
-            }                                                            \
-        } else {                                                         \
-            uint64_t hole_buf = X86_INS_JMP;                             \
-            shadow_addr = z_binary_insert_shadow_code(                   \
-                r->binary, (uint8_t *)(&hole_buf),                       \
-                __rewriter_get_hole_len(hole_buf));                      \
-            g_hash_table_insert(holes, GSIZE_TO_POINTER(shadow_addr),    \
-                                GSIZE_TO_POINTER(tar_addr));             \
-        }                                                                \
+#define __GENERATE_SHADOW_JMP(tar_addr)                                 \
+    do {                                                                \
+        addr_t shadow_addr = z_binary_get_shadow_code_addr(r->binary);  \
+        addr_t shadow_tar_addr =                                        \
+            z_addr_map_get(r->rewritten_bbs, tar_addr);                 \
+        if (shadow_tar_addr) {                                          \
+            KS_ASM_JMP(shadow_addr, shadow_tar_addr);                   \
+            z_binary_insert_shadow_code(r->binary, ks_encode, ks_size); \
+        } else {                                                        \
+            uint64_t hole_buf = X86_INS_JMP;                            \
+            shadow_addr = z_binary_insert_shadow_code(                  \
+                r->binary, (uint8_t *)(&hole_buf),                      \
+                __rewriter_get_hole_len(hole_buf));                     \
+            g_hash_table_insert(holes, GSIZE_TO_POINTER(shadow_addr),   \
+                                GSIZE_TO_POINTER(tar_addr));            \
+        }                                                               \
     } while (0)
 
+    // XXX: KS_ASM_JMP (instead of KS_ASM_JMP_SHORT) keeps the false branch in
+    // 5 bytes, which `j*cxz $+5` skips
     __GENERATE_SHADOW_JMP(false_branch_addr);
     __GENERATE_SHADOW_JMP(true_branch_addr);
 #undef __GENERATE_SHADOW_JMP
@@ -131,19 +132,17 @@ Z_PRIVATE void __rewriter_cjmp_handler(Rewriter *r, GHashTable *holes,
     addr_t cjmp_addr = op->imm;
 
     // first check cjmp_addr is inside .text
-    if (!z_disassembler_get_superset_disasm(r->disassembler, cjmp_addr)) {
+    if (!z_disassembler_get_superset_inst(r->disassembler, cjmp_addr)) {
         // directly write
-        KS_ASM(shadow_addr, "%s %#lx", cs_insn_name(cs, inst->id), cjmp_addr);
+        KS_ASM_JCC(shadow_addr, cjmp_addr, inst->id);
         z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
         return;
     }
 
-    addr_t shadow_cjmp_addr = (addr_t)g_hash_table_lookup(
-        r->rewritten_bbs, GSIZE_TO_POINTER(cjmp_addr));
+    addr_t shadow_cjmp_addr = z_addr_map_get(r->rewritten_bbs, cjmp_addr);
 
     if (shadow_cjmp_addr) {
-        KS_ASM(shadow_addr, "%s %#lx", cs_insn_name(cs, inst->id),
-               shadow_cjmp_addr);
+        KS_ASM_JCC(shadow_addr, shadow_cjmp_addr, inst->id);
         z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
     } else {
         // cjmp ??? (HOLE)
@@ -18,6 +18,7 @@
 
 #define REVENT z_capstone_is_jmp
 #define RHANDLER __rewriter_jmp_handler
+#define RINSTS X86_INS_JMP, X86_INS_LJMP
 
 /*
  * Rewriter handler for jmp instruction.
@@ -42,9 +43,9 @@ Z_PRIVATE void __rewriter_jmp_handler(Rewriter *r, GHashTable *holes,
         addr_t jmp_addr = op->imm;
 
         // first check jmp_addr is inside .text
-        if (!z_disassembler_get_superset_disasm(r->disassembler, jmp_addr)) {
+        if (!z_disassembler_get_superset_inst(r->disassembler, jmp_addr)) {
             // directly write
-            KS_ASM_JMP(shadow_addr, jmp_addr);
+            KS_ASM_JMP_SHORT(shadow_addr, jmp_addr);
             z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
             return;
         }
@@ -53,12 +54,10 @@ Z_PRIVATE void __rewriter_jmp_handler(Rewriter *r, GHashTable *holes,
         uint64_t hole_buf = 0;
         addr_t shadow_jmp_addr;
         if (r->opts->disable_opt) {
-            shadow_jmp_addr = (addr_t)g_hash_table_lookup(
-                r->rewritten_bbs, GSIZE_TO_POINTER(jmp_addr));
+            shadow_jmp_addr = z_addr_map_get(r->rewritten_bbs, jmp_addr);
             hole_buf = (uint64_t)X86_INS_JMP;
         } else {
-            shadow_jmp_addr = (addr_t)g_hash_table_lookup(
-                r->shadow_code, GSIZE_TO_POINTER(jmp_addr));
+            shadow_jmp_addr = z_addr_map_get(r->shadow_code, jmp_addr);
             hole_buf = (uint64_t)(-(int64_t)X86_INS_JMP);
             assert((int64_t)hole_buf < 0);
 
@@ -66,12 +65,11 @@ Z_PRIVATE void __rewriter_jmp_handler(Rewriter *r, GHashTable *holes,
         }
 #else
         uint64_t hole_buf = X86_INS_JMP;
-        addr_t shadow_jmp_addr = (addr_t)g_hash_table_lookup(
-            r->rewritten_bbs, GSIZE_TO_POINTER(jmp_addr));
+        addr_t shadow_jmp_addr = z_addr_map_get(r->rewritten_bbs, jmp_addr);
 #endif
 
         if (shadow_jmp_addr) {
-            KS_ASM_JMP(shadow_addr, shadow_jmp_addr);
+            KS_ASM_JMP_SHORT(shadow_addr, shadow_jmp_addr);
             z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
         } else {
             shadow_addr =
@@ -91,13 +89,11 @@ Z_PRIVATE void __rewriter_jmp_handler(Rewriter *r, GHashTable *holes,
         // record the original shadow_addr for inst
         addr_t ori_shadow_addr = INVALID_ADDR;
 
-        // store rcx value
+        // store rcx value (mov [rsp - 128], rcx)
         {
-            addr_t shadow_addr = ori_shadow_addr =
-                z_binary_get_shadow_code_addr(r->binary);
-            KS_ASM(shadow_addr, "mov [rsp - 128], rcx;\n");
+            ori_shadow_addr = z_binary_get_shadow_code_addr(r->binary);
+            KS_ASM_RAW("\x48\x89\x4c\x24\x80");
             z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
-            shadow_addr += ks_size;
         }
 
         // translate jump instruction into mov instruction
@@ -108,30 +104,23 @@ Z_PRIVATE void __rewriter_jmp_handler(Rewriter *r, GHashTable *holes,
         if (strstr(inst->op_str, "rip")) {
             assert(ori_shadow_addr != INVALID_ADDR);
 
-            // step [1]. get new instruction
-            KS_ASM(INVALID_ADDR, "mov rcx, %s", inst->op_str);
-            cs_inst = NULL;  // avoid double free inst
-            CS_DISASM_RAW(ks_encode, ks_size, INVALID_ADDR, 1);
-            cs_insn *new_inst = (cs_insn *)cs_inst;
-            cs_inst = NULL;  // avoid double free new_inst
-
-            // step [2]. calculate a possible starting address for the new mov
-            // instruction, so that we can guarantee correctness:
-            // new_shadow_addr + new_inst->size == ori_shadow_addr + inst->size
-            addr_t new_shadow_addr =
-                ori_shadow_addr + inst->size - new_inst->size;
-
-            // step [3]. translate the instruction, so that:
-            cs_insn *translated_inst =
-                __rewriter_translate_shadow_inst(r, new_inst, new_shadow_addr);
-
-            // step [4]. rewrite
-            z_binary_insert_shadow_code(r->binary, translated_inst->bytes,
-                                        translated_inst->size);
-
-            // step [5]. free inst and new_inst
-            cs_free(inst, 1);
-            cs_free(new_inst, 1);
+            // step [1]. get the memory operand of the translated jmp, whose
+            // next pc is (ori_shadow_addr + inst->size)
+            assert(op->type == X86_OP_MEM && op->mem.base == X86_REG_RIP);
+            addr_t mem_addr = ori_shadow_addr + inst->size + op->mem.disp;
+
+            // step [2]. relocate it into `mov rcx, qword ptr [rip + disp32]`
+            uint8_t mov_buf[7] = {0x48, 0x8b, 0x0d};
+            addr_t shadow_addr = z_binary_get_shadow_code_addr(r->binary);
+            int64_t disp = mem_addr - (shadow_addr + sizeof(mov_buf));
+            if (disp != (int32_t)disp) {
+                EXITME("too far rip-related ujmp " CS_SHOW_INST(inst));
+            }
+            int32_t disp32 = (int32_t)disp;
+            memcpy(mov_buf + 3, &disp32, sizeof(disp32));
+
+            // step [3]. rewrite
+            z_binary_insert_shadow_code(r->binary, mov_buf, sizeof(mov_buf));
         } else {
             addr_t shadow_addr = z_binary_get_shadow_code_addr(r->binary);
             KS_ASM(shadow_addr, "mov rcx, %s", inst->op_str);
@@ -139,61 +128,7 @@ Z_PRIVATE void __rewriter_jmp_handler(Rewriter *r, GHashTable *holes,
         }
 
         // do the addrss translation
-        {
-            addr_t shadow_addr = z_binary_get_shadow_code_addr(r->binary);
-            KS_ASM(shadow_addr,
-                   /*
-                    * store rcx
-                    */
-                   "  mov [rsp - 112], rcx;"
-                   /*
-                    * store EFLAGS
-                    */
-                   "  mov [rsp - 120], rax;\n"
-                   "  lahf;\n"
-                   "  seto al;\n"
-                   /*
-                    * for addresses outside .text, directly go through
-                    */
-                   "  cmp rcx, %#lx;\n" // compare upper bound of .text
-                   "  jae hug;\n"
-                   "  sub rcx, %#lx;\n" // sub .text base
-                   "  jb hug;\n"
-                   /*
-                    * update bitmap and prev_id
-                    */
-                   "  mov [rsp - 136], rdx;\n"
-                   "  mov [rsp - 144], rdi;\n"
-                   "  xor rdx, rdx;\n" // hug keystone (issue #295)
-                   "  mov rdi, qword ptr [" STRING(AFL_PREV_ID_PTR) " + rdx];\n"
-                   "  mov rdx, rcx;\n"
-                   "  shr rdx, " STRING(AFL_MAP_SIZE_POW2) ";\n"
-                   "  xor rdx, rcx;\n"
-                   "  and rdx, " STRING(AFL_MAP_SIZE_MASK) ";\n"
-                   "  xor rdi, rdx;\n"
-                   "  inc BYTE PTR [" STRING(AFL_MAP_ADDR) " + rdi];\n"
-                   "  xor rdi, rdi;\n" // hug keystone (issue #295)
-                   "  shr rdx, 1;\n"
-                   "  mov qword ptr [" STRING(AFL_PREV_ID_PTR) " + rdi], rdx;\n"
-                   "  mov rdi, [rsp - 144];\n"
-                   "  mov rdx, [rsp - 136];\n"
-                   /*
-                    * lookup target shadow address
-                    */
-                   "  shl rcx, " STRING(LOOKUP_TABLE_CELL_SIZE_POW2)  " ;\n"
-                   "  movsxd rcx, dword ptr [" STRING(LOOKUP_TABLE_ADDR) " + rcx];\n"
-                   "  mov [rsp - 112], rcx;\n"
-                   /*
-                    * go to target
-                    */
-                   "hug:\n"
-                   "  add al, 127;\n"
-                   "  sahf;\n"
-                   "  mov rax, [rsp - 120];\n"
-                   "  mov rcx, [rsp - 128];\n"
-                   "  jmp qword ptr [rsp - 112];\n",
-                   text_addr + text_size, text_addr);
-            z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
-        }
+        TP_EMIT(ujmp, text_addr, text_size);
+        z_binary_insert_shadow_code(r->binary, tp_code, tp_size);
     }
 }
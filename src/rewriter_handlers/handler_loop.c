@@ -18,6 +18,7 @@
 
 #define REVENT z_capstone_is_loop
 #define RHANDLER __rewriter_loop_handler
+#define RINSTS X86_INS_LOOP, X86_INS_LOOPE, X86_INS_LOOPNE
 
 /*
  * Rewriter handler for loop instruction.
@@ -59,26 +60,28 @@ Z_PRIVATE void __rewriter_loop_handler(Rewriter *r, GHashTable *holes,
            "out2:\n");
     z_binary_insert_shadow_code(r->binary, ks_encode, ks_size);
 
-    ELF *e = z_binary_get_elf(r->binary);
     if (inst->id == X86_INS_LOOP) {
         // jmp ???
         hole_buf = (uint64_t)X86_INS_JMP;
-        z_elf_write(e, shadow_addr + 0x16, __rewriter_get_hole_len(hole_buf),
-                    (uint8_t *)(&hole_buf));
+        z_binary_write_shadow_code(r->binary, shadow_addr + 0x16,
+                                   (uint8_t *)(&hole_buf),
+                                   __rewriter_get_hole_len(hole_buf));
         g_hash_table_insert(holes, GSIZE_TO_POINTER(shadow_addr + 0x16),
                             GSIZE_TO_POINTER(loop_addr));
     } else if (inst->id == X86_INS_LOOPE) {
         // je ???
         hole_buf = (uint64_t)X86_INS_JE;
-        z_elf_write(e, shadow_addr + 0x16, __rewriter_get_hole_len(hole_buf),
-                    (uint8_t *)(&hole_buf));
+        z_binary_write_shadow_code(r->binary, shadow_addr + 0x16,
+                                   (uint8_t *)(&hole_buf),
+                                   __rewriter_get_hole_len(hole_buf));
         g_hash_table_insert(holes, GSIZE_TO_POINTER(shadow_addr + 0x16),
                             GSIZE_TO_POINTER(loop_addr));
     } else if (inst->id == X86_INS_LOOPNE) {
         // jne ???
         hole_buf = (uint64_t)X86_INS_JNE;
-        z_elf_write(e, shadow_addr + 0x16, __rewriter_get_hole_len(hole_buf),
-                    (uint8_t *)(&hole_buf));
+        z_binary_write_shadow_code(r->binary, shadow_addr + 0x16,
+                                   (uint8_t *)(&hole_buf),
+                                   __rewriter_get_hole_len(hole_buf));
         g_hash_table_insert(holes, GSIZE_TO_POINTER(shadow_addr + 0x16),
                             GSIZE_TO_POINTER(loop_addr));
     }
@@ -32,4 +32,6 @@ SysOptArgs sys_optargs = {
     .log_level = LOG_INFO,
     .timeout = SYS_TIMEOUT,
     .check_execs = SYS_CHECK_EXECS,
+    .pdisasm_rounds = SYS_PDISASM_ROUNDS,
+    .pdisasm_tolerance = SYS_PDISASM_TOLERANCE,
 };
@@ -26,6 +26,8 @@
  */
 #define SYS_TIMEOUT 2000UL
 #define SYS_CHECK_EXECS 200000
+#define SYS_PDISASM_ROUNDS 8
+#define SYS_PDISASM_TOLERANCE 1e-3
 
 /*
  * System mode
@@ -56,6 +58,10 @@ typedef struct system_optargs_t {
     uint64_t timeout;
 
     uint32_t check_execs;
+
+    // convergence settings of probabilistic disassembly
+    uint32_t pdisasm_rounds;
+    double pdisasm_tolerance;
 } SysOptArgs;
 
 extern SysOptArgs sys_optargs;
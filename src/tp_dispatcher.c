@@ -64,6 +64,18 @@ Z_PRIVATE void __tp_code_append_raw(TPCode *tpc, const uint8_t *buf,
 Z_PRIVATE void __tp_code_locate_holes(TPCode *tpc, uint16_t id_hole,
                                       uint16_t shr_id_hole);
 
+/*
+ * Create/destroy a TPStub from pre-assembled indirect branch stubs
+ */
+Z_PRIVATE TPStub *__tp_stub_create(const uint8_t *code, size_t len);
+Z_PRIVATE void __tp_stub_destroy(TPStub *tps);
+
+/*
+ * Fill .text range into TPStub
+ */
+Z_PRIVATE const uint8_t *__tp_stub_emit(TPStub *tps, addr_t text_addr,
+                                        size_t text_size, size_t *size_ptr);
+
 Z_PRIVATE void __tp_code_destroy(TPCode *tpc) {
     z_free(tpc->code);
     z_free(tpc);
@@ -104,6 +116,46 @@ Z_PRIVATE const uint8_t *__tp_code_emit(TPCode *tpc, uint16_t id,
     return tpc->code;
 }
 
+Z_PRIVATE TPStub *__tp_stub_create(const uint8_t *code, size_t len) {
+    TPStub *tps = z_alloc(1, sizeof(TPStub));
+    tps->code = z_alloc(len, sizeof(uint8_t));
+    memcpy(tps->code, code, len);
+    tps->len = len;
+
+    tps->text_end_hole = (uint32_t *)TPD_LOCATE_HOLE(
+        tps->code, tps->len, &ibranch_text_end_hole,
+        sizeof(ibranch_text_end_hole), "missing text end hole");
+    tps->text_base_hole = (uint32_t *)TPD_LOCATE_HOLE(
+        tps->code, tps->len, &ibranch_text_base_hole,
+        sizeof(ibranch_text_base_hole), "missing text base hole");
+
+    // the lookup table never moves
+    uint32_t *lookup_table_hole = (uint32_t *)TPD_LOCATE_HOLE(
+        tps->code, tps->len, &ibranch_lookup_table_hole,
+        sizeof(ibranch_lookup_table_hole), "missing lookup table hole");
+    *lookup_table_hole = (uint32_t)LOOKUP_TABLE_ADDR;
+
+    return tps;
+}
+
+Z_PRIVATE void __tp_stub_destroy(TPStub *tps) {
+    z_free(tps->code);
+    z_free(tps);
+}
+
+Z_PRIVATE const uint8_t *__tp_stub_emit(TPStub *tps, addr_t text_addr,
+                                        size_t text_size, size_t *size_ptr) {
+    // XXX: both are sign-extended 32-bit immediates
+    if (text_addr + text_size > INT32_MAX) {
+        EXITME("too large .text for indirect branch stubs: %#lx",
+               text_addr + text_size);
+    }
+    *(tps->text_end_hole) = (uint32_t)(text_addr + text_size);
+    *(tps->text_base_hole) = (uint32_t)text_addr;
+    *(size_ptr) = tps->len;
+    return tps->code;
+}
+
 Z_API void z_tp_dispatcher_destroy(TPDispatcher *tpd) {
     __tp_code_destroy(tpd->bitmap);
 
@@ -111,6 +163,10 @@ Z_API void z_tp_dispatcher_destroy(TPDispatcher *tpd) {
     CAPSTONE_FORALL_GPR(__DESTROY_TPCODE_FOR_REG);
 #undef __DESTROY_TPCODE_FOR_REG
 
+    __tp_stub_destroy(tpd->ujmp);
+    __tp_stub_destroy(tpd->ucall);
+    __tp_stub_destroy(tpd->uret);
+
     z_free(tpd);
 }
 
@@ -150,18 +206,34 @@ Z_API TPDispatcher *z_tp_dispatcher_create() {
      * Bitmap (w/ push and pop GPR): we choose RDI here
      */
     tpd->bitmap = __tp_code_create(tpd->bitmap_RDI->len + 0x10);
-    // 'push rdi'
-    KS_ASM(INVALID_ADDR, "mov [rsp - 152], rdi");
+    // 'push rdi' (mov [rsp - 152], rdi)
+    KS_ASM_RAW("\x48\x89\xbc\x24\x68\xff\xff\xff");
     __tp_code_append_raw(tpd->bitmap, ks_encode, ks_size);
     // rdi bitmap
     __tp_code_append_raw(tpd->bitmap, tpd->bitmap_RDI->code,
                          tpd->bitmap_RDI->len);
-    // 'pop rdi'
-    KS_ASM(INVALID_ADDR, "mov rdi, [rsp - 152]");
+    // 'pop rdi' (mov rdi, [rsp - 152])
+    KS_ASM_RAW("\x48\x8b\xbc\x24\x68\xff\xff\xff");
     __tp_code_append_raw(tpd->bitmap, ks_encode, ks_size);
     // find holes
     __tp_code_locate_holes(tpd->bitmap, bitmap_id_hole, bitmap_shr_id_hole);
 
+    /*
+     * Address translation stubs of indirect branches
+     */
+#define __CREATE_TPSTUB(NAME, name)                                  \
+    do {                                                             \
+        tpd->name = __tp_stub_create(ibranch_bin + __IBRANCH_##NAME, \
+                                     __IBRANCH_##NAME##_END -        \
+                                         __IBRANCH_##NAME);          \
+    } while (0)
+
+    __CREATE_TPSTUB(UJMP, ujmp);
+    __CREATE_TPSTUB(UCALL, ucall);
+    __CREATE_TPSTUB(URET, uret);
+
+#undef __CREATE_TPSTUB
+
     return tpd;
 }
 
@@ -193,3 +265,21 @@ Z_API const uint8_t *z_tp_dispatcher_emit_bitmap(TPDispatcher *tpd,
 
     return __tp_code_emit(tpd->bitmap, AFL_BB_ID(addr), size);
 }
+
+Z_API const uint8_t *z_tp_dispatcher_emit_ujmp(TPDispatcher *tpd, size_t *size,
+                                               addr_t text_addr,
+                                               size_t text_size) {
+    return __tp_stub_emit(tpd->ujmp, text_addr, text_size, size);
+}
+
+Z_API const uint8_t *z_tp_dispatcher_emit_ucall(TPDispatcher *tpd,
+                                                size_t *size, addr_t text_addr,
+                                                size_t text_size) {
+    return __tp_stub_emit(tpd->ucall, text_addr, text_size, size);
+}
+
+Z_API const uint8_t *z_tp_dispatcher_emit_uret(TPDispatcher *tpd, size_t *size,
+                                               addr_t text_addr,
+                                               size_t text_size) {
+    return __tp_stub_emit(tpd->uret, text_addr, text_size, size);
+}
@@ -32,6 +32,15 @@ typedef struct tp_code_t {
     uint16_t *shr_id_hole;
 } TPCode;
 
+// XXX: address translation stub of indirect branches, whose holes of .text
+// range are filled at each emitting
+typedef struct tp_stub_t {
+    uint8_t *code;
+    size_t len;
+    uint32_t *text_end_hole;
+    uint32_t *text_base_hole;
+} TPStub;
+
 STRUCT(TPDispatcher, {
     uint8_t *context_save;
     size_t context_save_len;
@@ -56,6 +65,10 @@ STRUCT(TPDispatcher, {
     TPCode *bitmap_R13;
     TPCode *bitmap_R14;
     TPCode *bitmap_R15;
+
+    TPStub *ujmp;
+    TPStub *ucall;
+    TPStub *uret;
 });
 
 /*
@@ -87,4 +100,27 @@ Z_API const uint8_t *z_tp_dispatcher_emit_bitmap(TPDispatcher *tpd,
                                                  size_t *size, addr_t addr,
                                                  GPRState state);
 
+/*
+ * Emit an address translation stub for indirect jumps (the original rcx is
+ * stored at [rsp - 128] and the target is in rcx)
+ */
+Z_API const uint8_t *z_tp_dispatcher_emit_ujmp(TPDispatcher *tpd, size_t *size,
+                                               addr_t text_addr,
+                                               size_t text_size);
+
+/*
+ * Emit an address translation stub for indirect calls (the target is pushed
+ * onto the stack, and the translated one is left at [rsp - 144])
+ */
+Z_API const uint8_t *z_tp_dispatcher_emit_ucall(TPDispatcher *tpd,
+                                                size_t *size, addr_t text_addr,
+                                                size_t text_size);
+
+/*
+ * Emit an address translation stub for returns
+ */
+Z_API const uint8_t *z_tp_dispatcher_emit_uret(TPDispatcher *tpd, size_t *size,
+                                               addr_t text_addr,
+                                               size_t text_size);
+
 #endif
@@ -0,0 +1,127 @@
+/*
+ * ibranch.c
+ * Copyright (C) 2021 Zhuo Zhang, Xiangyu Zhang
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../afl_config.h"
+
+/*
+ * Address translation stubs for indirect branches (ujmp, ucall, and ret).
+ *
+ * The upper bound of .text, the base of .text, and the address of the lookup
+ * table are holes (0x7EADDEAD, 0x7EEFBEEF, and 0x7ACEBA5E respectively), which
+ * are filled by tp_dispatcher.
+ */
+#define __IBRANCH_BEGIN(NAME)              \
+    ".globl __IBRANCH_" #NAME "\n"         \
+    ".type __IBRANCH_" #NAME ",@function\n" \
+    "__IBRANCH_" #NAME ":\n"
+
+#define __IBRANCH_END(NAME)                    \
+    ".globl __IBRANCH_" #NAME "_END\n"         \
+    ".type __IBRANCH_" #NAME "_END,@function\n" \
+    "__IBRANCH_" #NAME "_END:\n"
+
+// XXX: rcx is the target, and prev_id/bitmap are updated via rdx and rdi
+#define __IBRANCH_UPDATE_BITMAP(RDX_SLOT, RDI_SLOT)                    \
+    "\tmov [rsp - " #RDX_SLOT "], rdx;\n"                              \
+    "\tmov [rsp - " #RDI_SLOT "], rdi;\n"                              \
+    "\tmov rdi, qword ptr [" STRING(AFL_PREV_ID_PTR) "];\n"            \
+    "\tmov rdx, rcx;\n"                                                \
+    "\tshr rdx, " STRING(AFL_MAP_SIZE_POW2) ";\n"                      \
+    "\txor rdx, rcx;\n"                                                \
+    "\tand rdx, " STRING(AFL_MAP_SIZE_MASK) ";\n"                      \
+    "\txor rdi, rdx;\n"                                                \
+    "\tinc byte ptr [" STRING(AFL_MAP_ADDR) " + rdi];\n"               \
+    "\tshr rdx, 1;\n"                                                  \
+    "\tmov qword ptr [" STRING(AFL_PREV_ID_PTR) "], rdx;\n"            \
+    "\tmov rdi, [rsp - " #RDI_SLOT "];\n"                              \
+    "\tmov rdx, [rsp - " #RDX_SLOT "];\n"
+
+// XXX: rcx is the target, and it becomes an offset of .text if the target is
+// inside .text
+#define __IBRANCH_CHECK_TEXT      \
+    "\tcmp rcx, 0x7EADDEAD;\n"    \
+    "\tjae 1f;\n"                 \
+    "\tsub rcx, 0x7EEFBEEF;\n"    \
+    "\tjb 1f;\n"
+
+#define __IBRANCH_LOOKUP                                            \
+    "\tshl rcx, " STRING(LOOKUP_TABLE_CELL_SIZE_POW2) ";\n"         \
+    "\tmovsxd rcx, dword ptr [rcx + 0x7ACEBA5E];\n"
+
+asm(".intel_syntax noprefix\n"
+    ".globl _entry\n"
+    ".type _entry,@function\n"
+    "_entry:\n"
+
+    /*
+     * ujmp: the original rcx is at [rsp - 128] and the target is in rcx
+     */
+    __IBRANCH_BEGIN(UJMP)
+    "\tmov [rsp - 112], rcx;\n"
+    // store EFLAGS
+    "\tmov [rsp - 120], rax;\n"
+    "\tlahf;\n"
+    "\tseto al;\n"
+    __IBRANCH_CHECK_TEXT
+    __IBRANCH_UPDATE_BITMAP(136, 144)
+    __IBRANCH_LOOKUP
+    "\tmov [rsp - 112], rcx;\n"
+    "1:\n"
+    "\tadd al, 127;\n"
+    "\tsahf;\n"
+    "\tmov rax, [rsp - 120];\n"
+    "\tmov rcx, [rsp - 128];\n"
+    "\tjmp qword ptr [rsp - 112];\n"
+    __IBRANCH_END(UJMP)
+
+    /*
+     * ucall: the target is on the top of stack, and the translated target is
+     * left at [rsp - 144] (call may not care about eflags)
+     */
+    __IBRANCH_BEGIN(UCALL)
+    "\tmov [rsp - 128], rcx;\n"
+    "\tpop rcx;\n"
+    "\tmov [rsp - 144], rcx;\n"
+    __IBRANCH_CHECK_TEXT
+    __IBRANCH_UPDATE_BITMAP(152, 160)
+    __IBRANCH_LOOKUP
+    "\tmov [rsp - 144], rcx;\n"
+    "1:\n"
+    "\tmov rcx, [rsp - 136];\n"
+    __IBRANCH_END(UCALL)
+
+    /*
+     * ret: the return address is on the top of stack
+     */
+    __IBRANCH_BEGIN(URET)
+    "\tmov [rsp - 128], rcx;\n"
+    "\tmov rcx, [rsp];\n"
+    __IBRANCH_CHECK_TEXT
+    __IBRANCH_LOOKUP
+    "\tmov [rsp], rcx;\n"
+    "1:\n"
+    "\tmov rcx, [rsp - 128];\n"
+    "\tret;\n"
+    __IBRANCH_END(URET)
+);
+
+#undef __IBRANCH_LOOKUP
+#undef __IBRANCH_CHECK_TEXT
+#undef __IBRANCH_UPDATE_BITMAP
+#undef __IBRANCH_END
+#undef __IBRANCH_BEGIN
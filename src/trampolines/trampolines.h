@@ -22,6 +22,7 @@
 #include "bitmap_bin.c"
 #include "context_restore_bin.c"
 #include "context_save_bin.c"
+#include "ibranch_bin.c"
 
 #define BITMAP_REG X86_INS_RDI
 
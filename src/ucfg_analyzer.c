@@ -31,15 +31,62 @@ typedef enum ucfg_edge_t {
     INTRA_UEDGE = (1 << 1),
 } UEdge;
 
-#define __UCFG_ANALYZER_GHASHTABLE_GET_BUFFER(t, k)        \
-    ({                                                     \
-        Buffer *buf = (Buffer *)g_hash_table_lookup(t, k); \
-        if (!buf) {                                        \
-            buf = z_buffer_create(NULL, 0);                \
-            g_hash_table_insert(t, k, (gpointer)buf);      \
-        }                                                  \
-        buf;                                               \
-    })
+// XXX: UCFG_Analyzer does not keep cs_insn, instead, it only stores a packed
+// information of each instruction (i.e., size and type) into a->insts
+#define __UCFG_INST_CALL (1UL << 8)
+#define __UCFG_INST_RET (1UL << 9)
+#define __UCFG_INST_PACK(inst)                                          \
+    ((size_t)(inst)->size |                                             \
+     (z_capstone_is_call(inst) ? __UCFG_INST_CALL : 0) |                \
+     (z_capstone_is_ret(inst) ? __UCFG_INST_RET : 0))
+#define __UCFG_INST_SIZE(info) ((size_t)(info)&0xff)
+
+// XXX: in the analysis cache, per-instruction states are stored as their dense
+// arrays, and each list of edges is stored as [addr, n, addr_0, ...,
+// addr_{n-1}]
+// (all fields are 64-bit)
+#define __UCFG_ANALYZER_FORALL_ARRAYS(STATEMENT) \
+    do {                                         \
+        STATEMENT(insts, INSTS);                 \
+        STATEMENT(reg_states, REG_STATES);       \
+        STATEMENT(live, LIVE);                   \
+    } while (0)
+
+#define __UCFG_ANALYZER_FORALL_EDGE_LISTS(STATEMENT) \
+    do {                                             \
+        STATEMENT(direct_preds, DIRECT_PREDS);       \
+        STATEMENT(direct_succs, DIRECT_SUCCS);       \
+        STATEMENT(intra_preds, INTRA_PREDS);         \
+        STATEMENT(intra_succs, INTRA_SUCCS);         \
+        STATEMENT(all_preds, ALL_PREDS);             \
+        STATEMENT(all_succs, ALL_SUCCS);             \
+    } while (0)
+
+#define __UCFG_ANALYZER_IN_TEXT(a, addr) \
+    ((addr) >= (a)->text_addr && (addr) < (a)->text_addr + (a)->text_size)
+
+// XXX: per-instruction states are always zero out of .text, as instructions
+// are only added from .text
+#define __UCFG_ANALYZER_GET(a, name, addr)                          \
+    (__UCFG_ANALYZER_IN_TEXT(a, addr)                               \
+         ? z_addr_dict_get_data((a)->name)[(addr) - (a)->text_addr] \
+         : 0)
+
+#define __UCFG_ANALYZER_SET(a, name, addr, val) \
+    z_addr_dict_set((a)->name, addr, val)
+
+// XXX: register liveness is a backward may-analysis over direct UCFG edges,
+// whose lattice value packs live-in GPRs, eflags, and XMMs into 64 bits. Hence
+// all registers are propagated together by bitwise operations.
+#define __UCFG_LIVE_GPR_SHIFT 0
+#define __UCFG_LIVE_FLG_SHIFT 16
+#define __UCFG_LIVE_XMM_SHIFT 32
+#define __UCFG_LIVE_PACK(gpr, flg, xmm)           \
+    (((uint64_t)(gpr) << __UCFG_LIVE_GPR_SHIFT) | \
+     ((uint64_t)(flg) << __UCFG_LIVE_FLG_SHIFT) | \
+     ((uint64_t)(xmm) << __UCFG_LIVE_XMM_SHIFT))
+#define __UCFG_LIVE_FLG_MASK __UCFG_LIVE_PACK(0, FLGSTATE_ALL, 0)
+#define __UCFG_LIVE_ALL __UCFG_LIVE_PACK(GPRSTATE_ALL, FLGSTATE_ALL, 0xffff)
 
 /*
  * Initial analysis for each instruction (calculate direct successors and
@@ -55,16 +102,16 @@ Z_PRIVATE void __ucfg_analyzer_advance_analyze(UCFG_Analyzer *a, addr_t addr,
                                                const cs_insn *inst);
 
 /*
- * Use-def analysis for eflag reigster
+ * Transfer function of register liveness: live-in of the inst at addr based on
+ * the current live-in of its direct successors
  */
-Z_PRIVATE void __ucfg_analyzer_analyze_flg(UCFG_Analyzer *a, addr_t addr,
-                                           const cs_insn *inst);
+Z_PRIVATE uint64_t __ucfg_analyzer_transfer_live(UCFG_Analyzer *a,
+                                                 addr_t addr);
 
 /*
- * Use-def analysis for general purpose register
+ * Solve register liveness for all instructions added since the last solving
  */
-Z_PRIVATE void __ucfg_analyzer_analyze_gpr(UCFG_Analyzer *a, addr_t addr,
-                                           const cs_insn *inst);
+Z_PRIVATE void __ucfg_analyzer_solve_live(UCFG_Analyzer *a);
 
 /*
  * Returning / non-returning functions analysis: whether a given inst (at addr)
@@ -87,6 +134,122 @@ Z_PRIVATE void __ucfg_analyzer_new_pred_and_succ(UCFG_Analyzer *a,
 Z_PRIVATE bool __ucfg_analyzer_check_consistent(const cs_insn *inst_alice,
                                                 const cs_insn *inst_bob);
 
+/*
+ * Get the list of edges of addr, and create an empty one if it does not exist
+ */
+Z_PRIVATE Buffer *__ucfg_analyzer_get_edge_list(UCFG_Analyzer *a,
+                                                UEdgeLists *lists,
+                                                addr_t addr);
+
+/*
+ * Peek the list of edges of addr, without creating it
+ */
+Z_PRIVATE UEdgeSpan __ucfg_analyzer_peek_edge_list(UCFG_Analyzer *a,
+                                                   UEdgeLists *lists,
+                                                   addr_t addr);
+
+/*
+ * Init and fini lists of edges
+ */
+Z_PRIVATE void __ucfg_analyzer_init_edge_lists(UCFG_Analyzer *a,
+                                               UEdgeLists *lists);
+Z_PRIVATE void __ucfg_analyzer_fini_edge_lists(UCFG_Analyzer *a,
+                                               UEdgeLists *lists);
+
+/*
+ * Check and set whether an inst can reach a RET inst
+ */
+Z_PRIVATE bool __ucfg_analyzer_can_ret(UCFG_Analyzer *a, addr_t addr);
+Z_PRIVATE void __ucfg_analyzer_set_can_ret(UCFG_Analyzer *a, addr_t addr);
+
+/*
+ * Serialize lists of edges for the analysis cache
+ */
+Z_PRIVATE Buffer *__ucfg_analyzer_dump_edge_lists(UCFG_Analyzer *a,
+                                                  UEdgeLists *lists);
+
+/*
+ * Restore lists of edges from the analysis cache
+ */
+Z_PRIVATE bool __ucfg_analyzer_restore_edge_lists(UCFG_Analyzer *a,
+                                                  UEdgeLists *lists,
+                                                  const uint8_t *ptr,
+                                                  size_t size);
+
+Z_PRIVATE Buffer *__ucfg_analyzer_get_edge_list(UCFG_Analyzer *a,
+                                                UEdgeLists *lists,
+                                                addr_t addr) {
+    if (__UCFG_ANALYZER_IN_TEXT(a, addr)) {
+        Buffer **slot = lists->inner + (addr - a->text_addr);
+        if (!*slot) {
+            *slot = z_buffer_create(NULL, 0);
+        }
+        return *slot;
+    }
+
+    Buffer *buf =
+        (Buffer *)g_hash_table_lookup(lists->outer, GSIZE_TO_POINTER(addr));
+    if (!buf) {
+        buf = z_buffer_create(NULL, 0);
+        g_hash_table_insert(lists->outer, GSIZE_TO_POINTER(addr),
+                            (gpointer)buf);
+    }
+    return buf;
+}
+
+Z_PRIVATE UEdgeSpan __ucfg_analyzer_peek_edge_list(UCFG_Analyzer *a,
+                                                   UEdgeLists *lists,
+                                                   addr_t addr) {
+    Buffer *buf = NULL;
+    if (__UCFG_ANALYZER_IN_TEXT(a, addr)) {
+        buf = lists->inner[addr - a->text_addr];
+    } else {
+        buf = (Buffer *)g_hash_table_lookup(lists->outer,
+                                            GSIZE_TO_POINTER(addr));
+    }
+
+    if (!buf) {
+        return (UEdgeSpan){.ptr = NULL, .n = 0};
+    }
+    return (UEdgeSpan){
+        .ptr = (const addr_t *)z_buffer_get_raw_buf(buf),
+        .n = z_buffer_get_size(buf) / sizeof(addr_t),
+    };
+}
+
+Z_PRIVATE void __ucfg_analyzer_init_edge_lists(UCFG_Analyzer *a,
+                                               UEdgeLists *lists) {
+    lists->inner = z_alloc(a->text_size, sizeof(Buffer *));
+    lists->outer =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                              (GDestroyNotify)(&z_buffer_destroy));
+}
+
+Z_PRIVATE void __ucfg_analyzer_fini_edge_lists(UCFG_Analyzer *a,
+                                               UEdgeLists *lists) {
+    for (size_t i = 0; i < a->text_size; i++) {
+        if (lists->inner[i]) {
+            z_buffer_destroy(lists->inner[i]);
+        }
+    }
+    z_free(lists->inner);
+    g_hash_table_destroy(lists->outer);
+}
+
+Z_PRIVATE bool __ucfg_analyzer_can_ret(UCFG_Analyzer *a, addr_t addr) {
+    if (!__UCFG_ANALYZER_IN_TEXT(a, addr)) {
+        return false;
+    }
+    size_t off = addr - a->text_addr;
+    return !!(a->can_ret[off / 64] & (1UL << (off % 64)));
+}
+
+Z_PRIVATE void __ucfg_analyzer_set_can_ret(UCFG_Analyzer *a, addr_t addr) {
+    assert(__UCFG_ANALYZER_IN_TEXT(a, addr));
+    size_t off = addr - a->text_addr;
+    a->can_ret[off / 64] |= (1UL << (off % 64));
+}
+
 Z_PRIVATE void __ucfg_analyzer_analyze_ret(UCFG_Analyzer *a, addr_t addr,
                                            const cs_insn *inst) {
     if (a->opts->disable_callthrough) {
@@ -94,7 +257,7 @@ Z_PRIVATE void __ucfg_analyzer_analyze_ret(UCFG_Analyzer *a, addr_t addr,
     }
 
     // this addr cannot be in a->can_ret now
-    assert(!g_hash_table_lookup(a->can_ret, GSIZE_TO_POINTER(addr)));
+    assert(!__ucfg_analyzer_can_ret(a, addr));
 
     // step (1). add intra-procedure edges if inst is calling a returning
     // function
@@ -109,8 +272,7 @@ Z_PRIVATE void __ucfg_analyzer_analyze_ret(UCFG_Analyzer *a, addr_t addr,
                 (detail->x86.operands[0].type == X86_OP_IMM)) {
                 addr_t callee_addr = detail->x86.operands[0].imm;
                 if (callee_addr != addr + inst->size &&
-                    g_hash_table_lookup(a->can_ret,
-                                        GSIZE_TO_POINTER(callee_addr))) {
+                    __ucfg_analyzer_can_ret(a, callee_addr)) {
                     // XXX: avoid duplicated edges
                     z_trace("call-fallthrough: %#lx -> %#lx", addr,
                             addr + inst->size);
@@ -130,20 +292,19 @@ Z_PRIVATE void __ucfg_analyzer_analyze_ret(UCFG_Analyzer *a, addr_t addr,
     {
         if (z_capstone_is_ret(inst)) {
             // it is a RET instruction
-            g_hash_table_add(a->can_ret, GSIZE_TO_POINTER(addr));
+            __ucfg_analyzer_set_can_ret(a, addr);
             g_queue_push_tail(queue, GSIZE_TO_POINTER(addr));
         } else {
             // this is all intra-procedure success
             Iter(addr_t, intra_succs);
-            z_iter_init_from_buf(intra_succs,
-                                 z_ucfg_analyzer_get_intra_successors(a, addr));
+            z_iter_init_from_span(
+                intra_succs, z_ucfg_analyzer_peek_intra_successors(a, addr));
 
             // other instructions
             while (!z_iter_is_empty(intra_succs)) {
                 addr_t succ_addr = *(z_iter_next(intra_succs));
-                if (g_hash_table_lookup(a->can_ret,
-                                        GSIZE_TO_POINTER(succ_addr))) {
-                    g_hash_table_add(a->can_ret, GSIZE_TO_POINTER(addr));
+                if (__ucfg_analyzer_can_ret(a, succ_addr)) {
+                    __ucfg_analyzer_set_can_ret(a, addr);
                     g_queue_push_tail(queue, GSIZE_TO_POINTER(addr));
                     break;
                 }
@@ -156,25 +317,25 @@ Z_PRIVATE void __ucfg_analyzer_analyze_ret(UCFG_Analyzer *a, addr_t addr,
     while (!g_queue_is_empty(queue)) {
         addr_t cur_addr = (addr_t)g_queue_pop_head(queue);
         z_trace("find returanable address: %#lx", cur_addr);
-        assert(g_hash_table_lookup(a->can_ret, GSIZE_TO_POINTER(cur_addr)));
+        assert(__ucfg_analyzer_can_ret(a, cur_addr));
 
         // step (3.1). first update calls if cur_addr is a function entrypoint
         Iter(addr_t, direct_preds);
-        z_iter_init_from_buf(
-            direct_preds, z_ucfg_analyzer_get_direct_predecessors(a, cur_addr));
+        z_iter_init_from_span(
+            direct_preds,
+            z_ucfg_analyzer_peek_direct_predecessors(a, cur_addr));
         while (!z_iter_is_empty(direct_preds)) {
             addr_t pred_addr = *(z_iter_next(direct_preds));
-            const cs_insn *pred_inst = (const cs_insn *)g_hash_table_lookup(
-                a->insts, GSIZE_TO_POINTER(pred_addr));
-            // pred_inst cannot be NULL
-            assert(pred_inst);
+            size_t pred_info = __UCFG_ANALYZER_GET(a, insts, pred_addr);
+            // pred_info cannot be 0
+            assert(pred_info);
 
-            if (!z_capstone_is_call(pred_inst)) {
+            if (!(pred_info & __UCFG_INST_CALL)) {
                 continue;
             }
 
             addr_t call_addr = pred_addr;
-            addr_t fallthrough_addr = call_addr + pred_inst->size;
+            addr_t fallthrough_addr = call_addr + __UCFG_INST_SIZE(pred_info);
 
             if (fallthrough_addr == cur_addr) {
                 // XXX: avoid duplicated edges
@@ -188,11 +349,10 @@ Z_PRIVATE void __ucfg_analyzer_analyze_ret(UCFG_Analyzer *a, addr_t addr,
 
             __ucfg_analyzer_new_pred_and_succ(a, call_addr, fallthrough_addr,
                                               INTRA_UEDGE);
-            if (g_hash_table_lookup(a->can_ret,
-                                    GSIZE_TO_POINTER(fallthrough_addr))) {
+            if (__ucfg_analyzer_can_ret(a, fallthrough_addr)) {
                 z_trace("call-fallthrough: %#lx -> %#lx", call_addr,
                         fallthrough_addr);
-                g_hash_table_add(a->can_ret, GSIZE_TO_POINTER(call_addr));
+                __ucfg_analyzer_set_can_ret(a, call_addr);
                 g_queue_push_tail(queue, GSIZE_TO_POINTER(call_addr));
             }
         }
@@ -200,12 +360,12 @@ Z_PRIVATE void __ucfg_analyzer_analyze_ret(UCFG_Analyzer *a, addr_t addr,
 
         // step (3.2) update all intra-procedure predecessors
         Iter(addr_t, intra_preds);
-        z_iter_init_from_buf(
-            intra_preds, z_ucfg_analyzer_get_intra_predecessors(a, cur_addr));
+        z_iter_init_from_span(
+            intra_preds, z_ucfg_analyzer_peek_intra_predecessors(a, cur_addr));
         while (!z_iter_is_empty(intra_preds)) {
             addr_t pred_addr = *(z_iter_next(intra_preds));
-            if (!g_hash_table_lookup(a->can_ret, GSIZE_TO_POINTER(pred_addr))) {
-                g_hash_table_add(a->can_ret, GSIZE_TO_POINTER(pred_addr));
+            if (!__ucfg_analyzer_can_ret(a, pred_addr)) {
+                __ucfg_analyzer_set_can_ret(a, pred_addr);
                 g_queue_push_tail(queue, GSIZE_TO_POINTER(pred_addr));
             }
         }
@@ -216,277 +376,155 @@ Z_PRIVATE void __ucfg_analyzer_analyze_ret(UCFG_Analyzer *a, addr_t addr,
     g_queue_free(queue);
 }
 
-Z_PRIVATE void __ucfg_analyzer_analyze_gpr(UCFG_Analyzer *a, addr_t addr,
-                                           const cs_insn *inst) {
-    if (a->opts->disable_opt) {
-        return;
-    }
-
-    // step (0). check whether addr is analyzed
-    if (g_hash_table_lookup(a->gpr_can_write, GSIZE_TO_POINTER(addr))) {
-        return;
-    }
-
-    // step (1). update gpr_analyzed_succs
-    {
-        // check addr's succs
-        Buffer *succs = z_ucfg_analyzer_get_direct_successors(a, addr);
-        assert(succs != NULL);
-        size_t succ_n = z_buffer_get_size(succs) / sizeof(addr_t);
-        addr_t *succs_array = (addr_t *)z_buffer_get_raw_buf(succs);
-
-        size_t analyzed_succ_n = 0;
-        for (int i = 0; i < succ_n; i++) {
-            if (g_hash_table_lookup(a->gpr_can_write,
-                                    GSIZE_TO_POINTER(succs_array[i]))) {
-                analyzed_succ_n += 1;
-            }
-        }
-        g_hash_table_insert(a->gpr_analyzed_succs, GSIZE_TO_POINTER(addr),
-                            GSIZE_TO_POINTER(analyzed_succ_n));
-
-        // update addr's direct preds
-        Buffer *preds = z_ucfg_analyzer_get_direct_predecessors(a, addr);
-        assert(preds != NULL);
-        size_t pred_n = z_buffer_get_size(preds) / sizeof(addr_t);
-        addr_t *preds_array = (addr_t *)z_buffer_get_raw_buf(preds);
-        for (int i = 0; i < pred_n; i++) {
-            addr_t pred = preds_array[i];
-            size_t pred_analyzed_succs = (size_t)g_hash_table_lookup(
-                a->gpr_analyzed_succs, GSIZE_TO_POINTER(pred));
-            g_hash_table_insert(a->gpr_analyzed_succs, GSIZE_TO_POINTER(pred),
-                                GSIZE_TO_POINTER(pred_analyzed_succs + 1));
+Z_PRIVATE uint64_t __ucfg_analyzer_transfer_live(UCFG_Analyzer *a,
+                                                 addr_t addr) {
+    size_t info = __UCFG_ANALYZER_GET(a, insts, addr);
+    assert(info);
+
+    const PackedRegState *rs =
+        z_addr_dict_get_data(a->reg_states) + (addr - a->text_addr);
+    const uint64_t *live = z_addr_dict_get_data(a->live);
+
+    // step (1). live-out is the union of live-in of all direct successors.
+    // Note that everything is live if any successor is unknown (e.g., a PLT
+    // entry) or there is no successor at all.
+    UEdgeSpan succs = z_ucfg_analyzer_peek_direct_successors(a, addr);
+
+    uint64_t live_out = (succs.n ? 0 : __UCFG_LIVE_ALL);
+    for (size_t i = 0; i < succs.n; i++) {
+        addr_t succ_addr = succs.ptr[i];
+        if (!__UCFG_ANALYZER_GET(a, insts, succ_addr)) {
+            live_out = __UCFG_LIVE_ALL;
+            break;
         }
+        live_out |= live[succ_addr - a->text_addr];
     }
 
-    // step (2). push addr into analysis queue
-    GQueue *queue = g_queue_new();
-    g_queue_push_tail(queue, GSIZE_TO_POINTER(addr));
-
-    // step (3). do analysis and propogate the result
-    while (!g_queue_is_empty(queue)) {
-        // step (3.1). pop from queue and get basic information
-        addr_t cur_addr = (addr_t)g_queue_pop_head(queue);
-
-        Buffer *preds = z_ucfg_analyzer_get_direct_predecessors(a, cur_addr);
-        assert(preds != NULL);
-        size_t pred_n = z_buffer_get_size(preds) / sizeof(addr_t);
-
-        Buffer *succs = z_ucfg_analyzer_get_direct_successors(a, cur_addr);
-        assert(succs != NULL);
-        size_t succ_n = z_buffer_get_size(succs) / sizeof(addr_t);
-
-        RegState *rs = (RegState *)g_hash_table_lookup(
-            a->reg_states, GSIZE_TO_POINTER(cur_addr));
-        // XXX: a good observation is that for a given address, its known
-        // successors must be added before it. And according to the logic of
-        // z_ucfg_analyzer_add_inst, any instruction will be analyzed once it is
-        // added into analyzer. Hence, we can sure any instruction in the queue
-        // is already analyzed (except addr itself).
-        assert(rs != NULL);
-
-        // step (3.2). calculate succs_can_write
-        size_t analyzed_succ_n = (size_t)g_hash_table_lookup(
-            a->gpr_analyzed_succs, GSIZE_TO_POINTER(cur_addr));
-        assert(succ_n >= analyzed_succ_n);
-
-        GPRState succs_can_write = GPRSTATE_ALL + 1;
-
-        if (succ_n != 0 && succ_n == analyzed_succ_n) {
-            // assume succs_can_write all registers
-            succs_can_write |= GPRSTATE_ALL;
-
-            // all succs are analyzed
-            addr_t *succs_array = (addr_t *)z_buffer_get_raw_buf(succs);
-            for (int i = 0; i < succ_n; i++) {
-                GPRState succ_can_write = 0;
-                if (cur_addr == succs_array[i]) {
-                    // handle self-loop!
-                    succ_can_write = GPRSTATE_ALL + 1;
-                } else {
-                    succ_can_write = (GPRState)g_hash_table_lookup(
-                        a->gpr_can_write, GSIZE_TO_POINTER(succs_array[i]));
-                }
-                assert(succ_can_write);
-                succs_can_write &= succ_can_write;
-            }
-        }
-
-        // step (3.3). calcualte can_write for cur_addr.
-        // According to datalog disassembly
-        // (https://www.usenix.org/conference/usenixsecurity20/presentation/flores-montoya)
-        // section 5.1, the x64 architecture zeroes the upper part of 64 bits
-        // registers whenever the corresponding 32 bits register is written.
-        GPRState can_write = GPRSTATE_ALL + 1;
-        can_write |= rs->gpr_write_32_64 | succs_can_write;
-        can_write &= (~rs->gpr_read);
-
-        // step (3.4). update predecessors
-        GPRState ori_can_write = (GPRState)g_hash_table_lookup(
-            a->gpr_can_write, GSIZE_TO_POINTER(cur_addr));
-        if (ori_can_write != can_write) {
-            assert((uint64_t)can_write > (uint64_t)ori_can_write);
-            addr_t *preds_array = (addr_t *)z_buffer_get_raw_buf(preds);
-            for (int i = 0; i < pred_n; i++) {
-                g_queue_push_tail(queue, GSIZE_TO_POINTER(preds_array[i]));
-            }
-            // update can_write
-            g_hash_table_insert(a->gpr_can_write, GSIZE_TO_POINTER(cur_addr),
-                                GSIZE_TO_POINTER(can_write));
-        }
+    // step (2). eflags are never live across call & ret, as we are trying to
+    // do an intra-procedure analysis
+    if (info & (__UCFG_INST_CALL | __UCFG_INST_RET)) {
+        live_out &= ~__UCFG_LIVE_FLG_MASK;
     }
 
-    g_queue_free(queue);
-
-    return;
+    // step (3). live-in = use | (live-out - def).
+    // According to datalog disassembly
+    // (https://www.usenix.org/conference/usenixsecurity20/presentation/flores-montoya)
+    // section 5.1, the x64 architecture zeroes the upper part of 64 bits
+    // registers whenever the corresponding 32 bits register is written.
+    uint64_t use = __UCFG_LIVE_PACK(rs->gpr_read, rs->flg_read, rs->xmm_read);
+    uint64_t def =
+        __UCFG_LIVE_PACK(rs->gpr_write_32_64, rs->flg_write, rs->xmm_write);
+    return use | (live_out & ~def);
 }
 
-Z_PRIVATE void __ucfg_analyzer_analyze_flg(UCFG_Analyzer *a, addr_t addr,
-                                           const cs_insn *inst) {
-    if (a->opts->disable_opt) {
+Z_PRIVATE void __ucfg_analyzer_solve_live(UCFG_Analyzer *a) {
+    size_t region_n = z_buffer_get_size(a->live_pending) / sizeof(uint32_t);
+    if (!region_n) {
         return;
     }
 
-    // step (0). check whether addr is analyzed
-    if (g_hash_table_lookup(a->flg_need_write, GSIZE_TO_POINTER(addr))) {
-        return;
+    uint64_t *live = z_addr_dict_get_data(a->live);
+    uint64_t *queued = a->live_queued;
+    size_t visit_n = 0;
+
+#define __IS_QUEUED(off) (!!(queued[(off) / 64] & (1UL << ((off) % 64))))
+#define __SET_QUEUED(off) (queued[(off) / 64] |= (1UL << ((off) % 64)))
+#define __CLR_QUEUED(off) (queued[(off) / 64] &= ~(1UL << ((off) % 64)))
+
+    // step (1). collect the region to re-solve: new instructions and all
+    // instructions which can reach them, as their results were based on the
+    // assumption that the new ones are unknown. The pending list is extended
+    // in place, and every instruction in the region is reset to bottom.
+    for (size_t i = 0; i < region_n; i++) {
+        uint32_t off = ((uint32_t *)z_buffer_get_raw_buf(a->live_pending))[i];
+        assert(!__IS_QUEUED(off));
+        __SET_QUEUED(off);
     }
-    GQueue *queue = g_queue_new();
-
-    // step (1). check whether it is ready to analyze
-    {
-        Buffer *succs = z_ucfg_analyzer_get_direct_successors(a, addr);
-        assert(succs != NULL);
-        size_t succ_n = z_buffer_get_size(succs) / sizeof(addr_t);
-        addr_t *succs_array = (addr_t *)z_buffer_get_raw_buf(succs);
-
-        // step (1.1). update flg_finished succs
-        size_t finished_succ_n = 0;
-        for (int i = 0; i < succ_n; i++) {
-            if (g_hash_table_lookup(a->flg_need_write,
-                                    GSIZE_TO_POINTER(succs_array[i]))) {
-                finished_succ_n += 1;
+    for (size_t i = 0; i < region_n; i++) {
+        uint32_t off = ((uint32_t *)z_buffer_get_raw_buf(a->live_pending))[i];
+        live[off] = 0;
+
+        UEdgeSpan preds =
+            z_ucfg_analyzer_peek_direct_predecessors(a, a->text_addr + off);
+        for (size_t j = 0; j < preds.n; j++) {
+            // predecessors are always instructions in .text
+            uint32_t pred_off = (uint32_t)(preds.ptr[j] - a->text_addr);
+            if (__IS_QUEUED(pred_off)) {
+                continue;
             }
-        }
-        g_hash_table_insert(a->flg_finished_succs, GSIZE_TO_POINTER(addr),
-                            GSIZE_TO_POINTER(finished_succ_n));
-
-        RegState *rs = (RegState *)g_hash_table_lookup(a->reg_states,
-                                                       GSIZE_TO_POINTER(addr));
-        assert(rs != NULL);
-
-        // step (1.2). check whether it is ready
-        if (rs->flg_write == FLGSTATE_ALL || rs->flg_read == FLGSTATE_ALL) {
-            // case A: writing/reading all means it is ready to analyze
-            g_queue_push_tail(queue, GSIZE_TO_POINTER(addr));
-        } else if (z_capstone_is_call(inst) || z_capstone_is_ret(inst)) {
-            // case B: we are trying to do an intra-procedure analysis
-            g_queue_push_tail(queue, GSIZE_TO_POINTER(addr));
-        } else if (succ_n == 0) {
-            // case C: for instruction without successors, it is ready to
-            // analyze
-            g_queue_push_tail(queue, GSIZE_TO_POINTER(addr));
-        } else if (succ_n == finished_succ_n) {
-            // case D: all successors are done with analysis (it actually can be
-            // mergied into case C, but for clarity we set it as an individual
-            // case)
-            g_queue_push_tail(queue, GSIZE_TO_POINTER(addr));
+            __SET_QUEUED(pred_off);
+            z_buffer_append_raw(a->live_pending, (uint8_t *)&pred_off,
+                                sizeof(pred_off));
+            region_n++;
         }
     }
 
-    // step (2). do analysis and propagate the result
-    while (!g_queue_is_empty(queue)) {
-        // step (2.1). pop from queue and set a flag on result (distinguished
-        // from non-existed key)
-        addr_t cur_addr = (addr_t)g_queue_pop_head(queue);
-        const cs_insn *cur_inst = (const cs_insn *)g_hash_table_lookup(
-            a->insts, GSIZE_TO_POINTER(cur_addr));
-        assert(cur_inst);
-
-        FLGState need_write = FLGSTATE_ALL + 1;
-        assert(!g_hash_table_lookup(a->flg_need_write,
-                                    GSIZE_TO_POINTER(cur_addr)));
-
-        // step (2.2). basic infomration
-        Buffer *preds = z_ucfg_analyzer_get_direct_predecessors(a, cur_addr);
-        assert(preds != NULL);
-        size_t pred_n = z_buffer_get_size(preds) / sizeof(addr_t);
-
-        Buffer *succs = z_ucfg_analyzer_get_direct_successors(a, cur_addr);
-        assert(succs != NULL);
-        size_t succ_n = z_buffer_get_size(succs) / sizeof(addr_t);
-
-        RegState *rs = (RegState *)g_hash_table_lookup(
-            a->reg_states, GSIZE_TO_POINTER(cur_addr));
-        assert(rs != NULL);
-
-        // step (2.3). calculate need to write
-        if (rs->flg_write == FLGSTATE_ALL) {
-            // case A.1: write all
-            need_write |= 0;
-        } else if (rs->flg_read == FLGSTATE_ALL) {
-            // case A.2: read all
-            need_write |= FLGSTATE_ALL;
-        } else if (z_capstone_is_call(cur_inst) ||
-                   z_capstone_is_ret(cur_inst)) {
-            // case B: call & ret
-            need_write |= 0;
-        } else if (succ_n == 0) {
-            // case C: no successors
-            need_write |= FLGSTATE_ALL;
-        } else if (succ_n ==
-                   (size_t)g_hash_table_lookup(a->flg_finished_succs,
-                                               GSIZE_TO_POINTER(cur_addr))) {
-            FLGState post_need_write = 0;
-            addr_t *succs_array = (addr_t *)z_buffer_get_raw_buf(succs);
-            for (int i = 0; i < succ_n; i++) {
-                FLGState succ_need_write = (FLGState)g_hash_table_lookup(
-                    a->flg_need_write, GSIZE_TO_POINTER(succs_array[i]));
-                assert(succ_need_write);
-                post_need_write |= succ_need_write;
-            }
-            need_write |= post_need_write & (FLGSTATE_ALL ^ rs->flg_write);
-        } else {
-            EXITME("incomplete address in analysis: %#lx", cur_addr);
+    // step (2). iterate to the least fixpoint with a worklist, where every
+    // instruction is in the worklist at most once
+    Buffer *worklist = z_buffer_dup(a->live_pending);
+    size_t worklist_n = region_n;
+    while (worklist_n) {
+        worklist_n--;
+        uint32_t off = ((uint32_t *)z_buffer_get_raw_buf(worklist))[worklist_n];
+        z_buffer_truncate(worklist, worklist_n * sizeof(uint32_t));
+        assert(__IS_QUEUED(off));
+        __CLR_QUEUED(off);
+        visit_n++;
+
+        uint64_t new_live =
+            __ucfg_analyzer_transfer_live(a, a->text_addr + off);
+        if (new_live == live[off]) {
+            continue;
         }
-
-        // step (2.4). do not forget flag read by it self
-        need_write |= rs->flg_read;
-
-        // step (2.5). update need_write
-        g_hash_table_insert(a->flg_need_write, GSIZE_TO_POINTER(cur_addr),
-                            GSIZE_TO_POINTER(need_write));
-
-        // step (2.6). update predecessors' information
-        addr_t *preds_array = (addr_t *)z_buffer_get_raw_buf(preds);
-        for (int i = 0; i < pred_n; i++) {
-            addr_t pred = preds_array[i];
-            // it is very important to check whether pred is analyzed
-            if (g_hash_table_lookup(a->flg_need_write,
-                                    GSIZE_TO_POINTER(pred))) {
+        // the transfer function is monotone, so the result only grows
+        assert((new_live & live[off]) == live[off]);
+        live[off] = new_live;
+
+        UEdgeSpan preds =
+            z_ucfg_analyzer_peek_direct_predecessors(a, a->text_addr + off);
+        for (size_t j = 0; j < preds.n; j++) {
+            uint32_t pred_off = (uint32_t)(preds.ptr[j] - a->text_addr);
+            if (__IS_QUEUED(pred_off)) {
                 continue;
             }
-            size_t pred_finish_succs = (size_t)g_hash_table_lookup(
-                a->flg_finished_succs, GSIZE_TO_POINTER(pred));
-            pred_finish_succs += 1;
-            g_hash_table_insert(a->flg_finished_succs, GSIZE_TO_POINTER(pred),
-                                GSIZE_TO_POINTER(pred_finish_succs));
-            if (pred_finish_succs ==
-                (size_t)(z_buffer_get_size(
-                             z_ucfg_analyzer_get_direct_successors(a, pred)) /
-                         sizeof(addr_t))) {
-                g_queue_push_tail(queue, GSIZE_TO_POINTER(pred));
-            }
+            __SET_QUEUED(pred_off);
+            z_buffer_append_raw(worklist, (uint8_t *)&pred_off,
+                                sizeof(pred_off));
+            worklist_n++;
         }
     }
+    z_buffer_destroy(worklist);
+
+#undef __CLR_QUEUED
+#undef __SET_QUEUED
+#undef __IS_QUEUED
+
+    // step (3). trace how many instructions in the region get the cheap
+    // trampolines (i.e., without saving eflags or with a free GPR), as the
+    // analysis is solved lazily on queries and it may happen very often
+    size_t dead_flg_n = 0, free_gpr_n = 0;
+    const uint32_t *region = (uint32_t *)z_buffer_get_raw_buf(a->live_pending);
+    for (size_t i = 0; i < region_n; i++) {
+        uint64_t l = live[region[i]];
+        dead_flg_n += !(l & __UCFG_LIVE_FLG_MASK);
+        free_gpr_n += !!(~l & __UCFG_LIVE_PACK(GPRSTATE_ALL, 0, 0));
+    }
+    z_trace(
+        "register liveness: %lu instructions solved with %lu visits (dead "
+        "eflags: %lu, free GPRs: %lu)",
+        region_n, visit_n, dead_flg_n, free_gpr_n);
 
-    g_queue_free(queue);
+    z_buffer_truncate(a->live_pending, 0);
 }
 
 Z_PRIVATE void __ucfg_analyzer_advance_analyze(UCFG_Analyzer *a, addr_t addr,
                                                const cs_insn *inst) {
-    __ucfg_analyzer_analyze_flg(a, addr, inst);
-    __ucfg_analyzer_analyze_gpr(a, addr, inst);
+    // XXX: liveness is not solved here, as the successors of addr are usually
+    // added after it (i.e., in ascending order of superset disassembly)
+    if (!a->opts->disable_opt) {
+        uint32_t off = (uint32_t)(addr - a->text_addr);
+        z_buffer_append_raw(a->live_pending, (uint8_t *)&off, sizeof(off));
+    }
     __ucfg_analyzer_analyze_ret(a, addr, inst);
 }
 
@@ -568,13 +606,8 @@ Z_PRIVATE void __ucfg_analyzer_new_pred_and_succ(UCFG_Analyzer *a,
 
 #define __NEW_RELATION(relation, from_addr, to_addr)                         \
     do {                                                                     \
-        Buffer *buf = NULL;                                                  \
-        if (!(buf = g_hash_table_lookup(a->relation,                         \
-                                        GSIZE_TO_POINTER(from_addr)))) {     \
-            buf = z_buffer_create(NULL, 0);                                  \
-            g_hash_table_insert(a->relation, GSIZE_TO_POINTER(from_addr),    \
-                                (gpointer)buf);                              \
-        }                                                                    \
+        Buffer *buf =                                                        \
+            __ucfg_analyzer_get_edge_list(a, &a->relation, from_addr);       \
                                                                              \
         addr_t *targets = (addr_t *)z_buffer_get_raw_buf(buf);               \
         size_t n = z_buffer_get_size(buf) / sizeof(addr_t);                  \
@@ -592,13 +625,8 @@ Z_PRIVATE void __ucfg_analyzer_new_pred_and_succ(UCFG_Analyzer *a,
 
 #define __NEW_RELATION(relation, from_addr, to_addr)                      \
     do {                                                                  \
-        Buffer *buf = NULL;                                               \
-        if (!(buf = g_hash_table_lookup(a->relation,                      \
-                                        GSIZE_TO_POINTER(from_addr)))) {  \
-            buf = z_buffer_create(NULL, 0);                               \
-            g_hash_table_insert(a->relation, GSIZE_TO_POINTER(from_addr), \
-                                (gpointer)buf);                           \
-        }                                                                 \
+        Buffer *buf =                                                     \
+            __ucfg_analyzer_get_edge_list(a, &a->relation, from_addr);    \
         z_buffer_append_raw(buf, (uint8_t *)&(to_addr), sizeof(to_addr)); \
     } while (0)
 
@@ -689,6 +717,78 @@ Z_PRIVATE void __ucfg_analyzer_init_analyze(UCFG_Analyzer *a, addr_t addr,
     }
 }
 
+Z_PRIVATE Buffer *__ucfg_analyzer_dump_edge_lists(UCFG_Analyzer *a,
+                                                  UEdgeLists *lists) {
+    Buffer *buf = z_buffer_create(NULL, 0);
+
+#define __DUMP_LIST(addr, list)                                \
+    do {                                                       \
+        uint64_t k = (uint64_t)(addr);                         \
+        uint64_t n = z_buffer_get_size(list) / sizeof(addr_t); \
+        if (!n) {                                              \
+            break;                                             \
+        }                                                      \
+        z_buffer_append_raw(buf, (uint8_t *)&k, sizeof(k));    \
+        z_buffer_append_raw(buf, (uint8_t *)&n, sizeof(n));    \
+        z_buffer_append_raw(buf, z_buffer_get_raw_buf(list),   \
+                            n * sizeof(addr_t));               \
+    } while (0)
+
+    for (size_t i = 0; i < a->text_size; i++) {
+        if (lists->inner[i]) {
+            __DUMP_LIST(a->text_addr + i, lists->inner[i]);
+        }
+    }
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, lists->outer);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        __DUMP_LIST(key, (Buffer *)value);
+    }
+
+#undef __DUMP_LIST
+
+    return buf;
+}
+
+Z_PRIVATE bool __ucfg_analyzer_restore_edge_lists(UCFG_Analyzer *a,
+                                                  UEdgeLists *lists,
+                                                  const uint8_t *ptr,
+                                                  size_t size) {
+    const uint8_t *end = ptr + size;
+
+#define __READ(dst, n)                   \
+    do {                                 \
+        if ((size_t)(end - ptr) < (n)) { \
+            return false;                \
+        }                                \
+        memcpy((dst), ptr, (n));         \
+        ptr += (n);                      \
+    } while (0)
+
+    while (ptr < end) {
+        uint64_t k = 0, n = 0;
+        __READ(&k, sizeof(k));
+        __READ(&n, sizeof(n));
+        if (n > (size_t)(end - ptr) / sizeof(addr_t)) {
+            return false;
+        }
+
+        Buffer *list = __ucfg_analyzer_get_edge_list(a, lists, (addr_t)k);
+        if (z_buffer_get_size(list)) {
+            // duplicated list
+            return false;
+        }
+        z_buffer_append_raw(list, ptr, n * sizeof(addr_t));
+        ptr += n * sizeof(addr_t);
+    }
+
+#undef __READ
+
+    return true;
+}
+
 Z_API UCFG_Analyzer *z_ucfg_analyzer_create(Binary *binary, SysOptArgs *opts) {
     UCFG_Analyzer *a = STRUCT_ALLOC(UCFG_Analyzer);
 
@@ -696,85 +796,174 @@ Z_API UCFG_Analyzer *z_ucfg_analyzer_create(Binary *binary, SysOptArgs *opts) {
 
     a->opts = opts;
 
-    a->insts = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    Elf64_Shdr *text = z_elf_get_shdr_text(z_binary_get_elf(binary));
+    a->text_addr = text->sh_addr;
+    a->text_size = text->sh_size;
 
-    a->reg_states = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
-                                          (GDestroyNotify)(&z_free));
+    a->inst_n = 0;
+    z_addr_dict_init(a->insts, a->text_addr, a->text_size);
+    z_addr_dict_init(a->reg_states, a->text_addr, a->text_size);
 
-    a->direct_preds =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
-                              (GDestroyNotify)(&z_buffer_destroy));
-    a->direct_succs =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
-                              (GDestroyNotify)(&z_buffer_destroy));
-    a->intra_preds = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
-                                           (GDestroyNotify)(&z_buffer_destroy));
-    a->intra_succs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
-                                           (GDestroyNotify)(&z_buffer_destroy));
-    a->all_preds = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
-                                         (GDestroyNotify)(&z_buffer_destroy));
-    a->all_succs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
-                                         (GDestroyNotify)(&z_buffer_destroy));
-
-    a->flg_finished_succs =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
-    a->flg_need_write =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
-
-    a->gpr_analyzed_succs =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
-    a->gpr_can_write =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
-
-    a->can_ret =
-        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    __ucfg_analyzer_init_edge_lists(a, &a->direct_preds);
+    __ucfg_analyzer_init_edge_lists(a, &a->direct_succs);
+    __ucfg_analyzer_init_edge_lists(a, &a->intra_preds);
+    __ucfg_analyzer_init_edge_lists(a, &a->intra_succs);
+    __ucfg_analyzer_init_edge_lists(a, &a->all_preds);
+    __ucfg_analyzer_init_edge_lists(a, &a->all_succs);
+
+    z_addr_dict_init(a->live, a->text_addr, a->text_size);
+    a->live_pending = z_buffer_create(NULL, 0);
+    a->live_queued = z_alloc(a->text_size / 64 + 1, sizeof(uint64_t));
+
+    a->can_ret = z_alloc(a->text_size / 64 + 1, sizeof(uint64_t));
 
     return a;
 }
 
 Z_API void z_ucfg_analyzer_destroy(UCFG_Analyzer *a) {
-    g_hash_table_destroy(a->insts);
-    g_hash_table_destroy(a->reg_states);
-    g_hash_table_destroy(a->direct_preds);
-    g_hash_table_destroy(a->direct_succs);
-    g_hash_table_destroy(a->intra_preds);
-    g_hash_table_destroy(a->intra_succs);
-    g_hash_table_destroy(a->all_preds);
-    g_hash_table_destroy(a->all_succs);
-    g_hash_table_destroy(a->flg_finished_succs);
-    g_hash_table_destroy(a->flg_need_write);
-    g_hash_table_destroy(a->gpr_analyzed_succs);
-    g_hash_table_destroy(a->gpr_can_write);
-    g_hash_table_destroy(a->can_ret);
+    z_addr_dict_destroy(a->insts);
+    z_addr_dict_destroy(a->reg_states);
+    __ucfg_analyzer_fini_edge_lists(a, &a->direct_preds);
+    __ucfg_analyzer_fini_edge_lists(a, &a->direct_succs);
+    __ucfg_analyzer_fini_edge_lists(a, &a->intra_preds);
+    __ucfg_analyzer_fini_edge_lists(a, &a->intra_succs);
+    __ucfg_analyzer_fini_edge_lists(a, &a->all_preds);
+    __ucfg_analyzer_fini_edge_lists(a, &a->all_succs);
+    z_addr_dict_destroy(a->live);
+    z_buffer_destroy(a->live_pending);
+    z_free(a->live_queued);
+    z_free(a->can_ret);
 
     z_free(a);
 }
 
+Z_API void z_ucfg_analyzer_store_cache(UCFG_Analyzer *a, AnalysisCache *c) {
+    assert(a != NULL && c != NULL);
+
+#define __STORE_ARRAY(name, tag)                             \
+    z_analysis_cache_add_section(                            \
+        c, ACACHE_UCFG_##tag, z_addr_dict_get_data(a->name), \
+        a->text_size * sizeof(*z_addr_dict_get_data(a->name)))
+#define __STORE_EDGE_LISTS(name, tag) \
+    z_analysis_cache_add_buffer(      \
+        c, ACACHE_UCFG_##tag, __ucfg_analyzer_dump_edge_lists(a, &a->name))
+
+    // liveness must be up-to-date before it is stored
+    __ucfg_analyzer_solve_live(a);
+
+    __UCFG_ANALYZER_FORALL_ARRAYS(__STORE_ARRAY);
+    __UCFG_ANALYZER_FORALL_EDGE_LISTS(__STORE_EDGE_LISTS);
+    z_analysis_cache_add_section(c, ACACHE_UCFG_CAN_RET, a->can_ret,
+                                 (a->text_size / 64 + 1) * sizeof(uint64_t));
+
+#undef __STORE_EDGE_LISTS
+#undef __STORE_ARRAY
+}
+
+Z_API bool z_ucfg_analyzer_load_cache(UCFG_Analyzer *a, AnalysisCache *c) {
+    assert(a != NULL && c != NULL);
+
+    if (a->inst_n) {
+        EXITME("load analysis cache into a non-empty UCFG_Analyzer");
+    }
+
+#define __LOAD_ARRAY(name, tag)                                              \
+    do {                                                                     \
+        size_t size = 0;                                                     \
+        const void *ptr =                                                    \
+            z_analysis_cache_get_section(c, ACACHE_UCFG_##tag, &size);       \
+        if (!ptr ||                                                          \
+            size != a->text_size * sizeof(*z_addr_dict_get_data(a->name))) { \
+            z_info("incomplete UCFG analysis cache: " #name);                \
+            return false;                                                    \
+        }                                                                    \
+        memcpy(z_addr_dict_get_data(a->name), ptr, size);                    \
+    } while (0)
+
+#define __LOAD_EDGE_LISTS(name, tag)                                        \
+    do {                                                                    \
+        size_t size = 0;                                                    \
+        const uint8_t *ptr = (const uint8_t *)z_analysis_cache_get_section( \
+            c, ACACHE_UCFG_##tag, &size);                                   \
+        if (!ptr ||                                                         \
+            !__ucfg_analyzer_restore_edge_lists(a, &a->name, ptr, size)) {  \
+            z_info("incomplete UCFG analysis cache: " #name);               \
+            return false;                                                   \
+        }                                                                   \
+    } while (0)
+
+    __UCFG_ANALYZER_FORALL_ARRAYS(__LOAD_ARRAY);
+    __UCFG_ANALYZER_FORALL_EDGE_LISTS(__LOAD_EDGE_LISTS);
+
+#undef __LOAD_EDGE_LISTS
+#undef __LOAD_ARRAY
+
+    {
+        size_t size = 0;
+        const void *ptr =
+            z_analysis_cache_get_section(c, ACACHE_UCFG_CAN_RET, &size);
+        if (!ptr || size != (a->text_size / 64 + 1) * sizeof(uint64_t)) {
+            z_info("incomplete UCFG analysis cache: can_ret");
+            return false;
+        }
+        memcpy(a->can_ret, ptr, size);
+    }
+
+    const uint16_t *insts = z_addr_dict_get_data(a->insts);
+    for (size_t i = 0; i < a->text_size; i++) {
+        if (insts[i]) {
+            a->inst_n++;
+        }
+    }
+
+    return true;
+}
+
 Z_API void z_ucfg_analyzer_add_inst(UCFG_Analyzer *a, addr_t addr,
                                     const cs_insn *inst,
-                                    bool maybe_duplicated) {
+                                    const cs_insn *ori_inst) {
     assert(a != NULL);
 
-    if (maybe_duplicated) {
-        cs_insn *ori_inst =
-            (cs_insn *)g_hash_table_lookup(a->insts, GSIZE_TO_POINTER(addr));
-        if (ori_inst) {
-            if (!__ucfg_analyzer_check_consistent(ori_inst, inst)) {
-                EXITME("inconsistent instruction update " CS_SHOW_INST(inst));
-            }
-            g_hash_table_insert(a->insts, GSIZE_TO_POINTER(addr),
-                                (gpointer)inst);
-            return;
+    if (!__UCFG_ANALYZER_IN_TEXT(a, addr)) {
+        EXITME("add an instruction out of .text " CS_SHOW_INST(inst));
+    }
+
+    if (__UCFG_ANALYZER_GET(a, insts, addr)) {
+        if (!ori_inst) {
+            EXITME("duplicated instruction " CS_SHOW_INST(inst));
         }
+        if (!__ucfg_analyzer_check_consistent(ori_inst, inst)) {
+            EXITME("inconsistent instruction update " CS_SHOW_INST(inst));
+        }
+        __UCFG_ANALYZER_SET(a, insts, addr, __UCFG_INST_PACK(inst));
+        return;
     }
 
     // update insts
-    assert(!g_hash_table_lookup(a->insts, GSIZE_TO_POINTER(addr)));
-    g_hash_table_insert(a->insts, GSIZE_TO_POINTER(addr), (gpointer)inst);
+    __UCFG_ANALYZER_SET(a, insts, addr, __UCFG_INST_PACK(inst));
+    a->inst_n++;
 
     // update register states
-    RegState *rs = z_capstone_get_register_state(inst);
-    g_hash_table_insert(a->reg_states, GSIZE_TO_POINTER(addr), (gpointer)rs);
+    {
+        RegState *rs = z_capstone_get_register_state(inst);
+        PackedRegState *packed =
+            z_addr_dict_get_data(a->reg_states) + (addr - a->text_addr);
+#define __PACK_REG_STATE(field) packed->field = (uint16_t)(rs->field)
+        __PACK_REG_STATE(gpr_read);
+        __PACK_REG_STATE(gpr_read_32_64);
+        __PACK_REG_STATE(gpr_write);
+        __PACK_REG_STATE(gpr_write_32_64);
+        __PACK_REG_STATE(flg_read);
+        __PACK_REG_STATE(flg_write);
+        __PACK_REG_STATE(xmm_read);
+        __PACK_REG_STATE(xmm_write);
+        __PACK_REG_STATE(ymm_read);
+        __PACK_REG_STATE(ymm_write);
+        __PACK_REG_STATE(zmm_read);
+        __PACK_REG_STATE(zmm_write);
+#undef __PACK_REG_STATE
+        z_free(rs);
+    }
 
     /*
      * XXX: it is important that following analysis happens in order and
@@ -789,68 +978,110 @@ Z_API void z_ucfg_analyzer_add_inst(UCFG_Analyzer *a, addr_t addr,
 Z_API Buffer *z_ucfg_analyzer_get_direct_successors(UCFG_Analyzer *a,
                                                     addr_t addr) {
     assert(a != NULL);
-    return __UCFG_ANALYZER_GHASHTABLE_GET_BUFFER(a->direct_succs,
-                                                 GSIZE_TO_POINTER(addr));
+    return __ucfg_analyzer_get_edge_list(a, &a->direct_succs, addr);
 }
 
 Z_API Buffer *z_ucfg_analyzer_get_direct_predecessors(UCFG_Analyzer *a,
                                                       addr_t addr) {
     assert(a != NULL);
-    return __UCFG_ANALYZER_GHASHTABLE_GET_BUFFER(a->direct_preds,
-                                                 GSIZE_TO_POINTER(addr));
+    return __ucfg_analyzer_get_edge_list(a, &a->direct_preds, addr);
 }
 
 Z_API Buffer *z_ucfg_analyzer_get_intra_successors(UCFG_Analyzer *a,
                                                    addr_t addr) {
     assert(a != NULL);
-    return __UCFG_ANALYZER_GHASHTABLE_GET_BUFFER(a->intra_succs,
-                                                 GSIZE_TO_POINTER(addr));
+    return __ucfg_analyzer_get_edge_list(a, &a->intra_succs, addr);
 }
 
 Z_API Buffer *z_ucfg_analyzer_get_intra_predecessors(UCFG_Analyzer *a,
                                                      addr_t addr) {
     assert(a != NULL);
-    return __UCFG_ANALYZER_GHASHTABLE_GET_BUFFER(a->intra_preds,
-                                                 GSIZE_TO_POINTER(addr));
+    return __ucfg_analyzer_get_edge_list(a, &a->intra_preds, addr);
 }
 
 Z_API Buffer *z_ucfg_analyzer_get_all_successors(UCFG_Analyzer *a,
                                                  addr_t addr) {
     assert(a != NULL);
-    return __UCFG_ANALYZER_GHASHTABLE_GET_BUFFER(a->all_succs,
-                                                 GSIZE_TO_POINTER(addr));
+    return __ucfg_analyzer_get_edge_list(a, &a->all_succs, addr);
 }
 
 Z_API Buffer *z_ucfg_analyzer_get_all_predecessors(UCFG_Analyzer *a,
                                                    addr_t addr) {
     assert(a != NULL);
-    return __UCFG_ANALYZER_GHASHTABLE_GET_BUFFER(a->all_preds,
-                                                 GSIZE_TO_POINTER(addr));
+    return __ucfg_analyzer_get_edge_list(a, &a->all_preds, addr);
 }
 
+#define __UCFG_ANALYZER_DECLARE_PEEK(etype, rtype, lists)                    \
+    Z_API UEdgeSpan z_ucfg_analyzer_peek_##etype##_##rtype(UCFG_Analyzer *a, \
+                                                           addr_t addr) {    \
+        assert(a != NULL);                                                   \
+        return __ucfg_analyzer_peek_edge_list(a, &a->lists, addr);           \
+    }
+
+__UCFG_ANALYZER_DECLARE_PEEK(direct, predecessors, direct_preds);
+__UCFG_ANALYZER_DECLARE_PEEK(direct, successors, direct_succs);
+__UCFG_ANALYZER_DECLARE_PEEK(intra, predecessors, intra_preds);
+__UCFG_ANALYZER_DECLARE_PEEK(intra, successors, intra_succs);
+__UCFG_ANALYZER_DECLARE_PEEK(all, predecessors, all_preds);
+__UCFG_ANALYZER_DECLARE_PEEK(all, successors, all_succs);
+
+#undef __UCFG_ANALYZER_DECLARE_PEEK
+
 Z_API FLGState z_ucfg_analyzer_get_flg_need_write(UCFG_Analyzer *a,
                                                   addr_t addr) {
-    FLGState state = (FLGState)g_hash_table_lookup(a->flg_need_write,
-                                                   GSIZE_TO_POINTER(addr));
-    if (!state) {
+    if (a->opts->disable_opt || !__UCFG_ANALYZER_GET(a, insts, addr)) {
         // there is not enough infomration to analyze this address
         return FLGSTATE_ALL;
-    } else {
-        return state & FLGSTATE_ALL;
     }
+
+    __ucfg_analyzer_solve_live(a);
+    uint64_t live = __UCFG_ANALYZER_GET(a, live, addr);
+    return (FLGState)((live >> __UCFG_LIVE_FLG_SHIFT) & FLGSTATE_ALL);
 }
 
 Z_API GPRState z_ucfg_analyzer_get_gpr_can_write(UCFG_Analyzer *a,
                                                  addr_t addr) {
-    GPRState state =
-        (GPRState)g_hash_table_lookup(a->gpr_can_write, GSIZE_TO_POINTER(addr));
-    return state & GPRSTATE_ALL;
+    if (a->opts->disable_opt || !__UCFG_ANALYZER_GET(a, insts, addr)) {
+        return 0;
+    }
+
+    __ucfg_analyzer_solve_live(a);
+    uint64_t live = __UCFG_ANALYZER_GET(a, live, addr);
+    return (GPRState)((~live >> __UCFG_LIVE_GPR_SHIFT) & GPRSTATE_ALL);
 }
 
-Z_API RegState *z_ucfg_analyzer_get_register_state(UCFG_Analyzer *a,
-                                                   addr_t addr) {
-    return (RegState *)g_hash_table_lookup(a->reg_states,
-                                           GSIZE_TO_POINTER(addr));
+Z_API bool z_ucfg_analyzer_get_register_state(UCFG_Analyzer *a, addr_t addr,
+                                              RegState *rs) {
+    if (!__UCFG_ANALYZER_GET(a, insts, addr)) {
+        return false;
+    }
+
+    const PackedRegState *packed =
+        z_addr_dict_get_data(a->reg_states) + (addr - a->text_addr);
+#define __UNPACK_REG_STATE(field, type) rs->field = (type)(packed->field)
+    __UNPACK_REG_STATE(gpr_read, GPRState);
+    __UNPACK_REG_STATE(gpr_read_32_64, GPRState);
+    __UNPACK_REG_STATE(gpr_write, GPRState);
+    __UNPACK_REG_STATE(gpr_write_32_64, GPRState);
+    __UNPACK_REG_STATE(flg_read, FLGState);
+    __UNPACK_REG_STATE(flg_write, FLGState);
+    __UNPACK_REG_STATE(xmm_read, XMMState);
+    __UNPACK_REG_STATE(xmm_write, XMMState);
+    __UNPACK_REG_STATE(ymm_read, YMMState);
+    __UNPACK_REG_STATE(ymm_write, YMMState);
+    __UNPACK_REG_STATE(zmm_read, ZMMState);
+    __UNPACK_REG_STATE(zmm_write, ZMMState);
+#undef __UNPACK_REG_STATE
+
+    return true;
 }
 
-#undef __UCFG_ANALYZER_GHASHTABLE_GET_BUFFER
+#undef __UCFG_LIVE_ALL
+#undef __UCFG_LIVE_FLG_MASK
+#undef __UCFG_LIVE_PACK
+#undef __UCFG_LIVE_XMM_SHIFT
+#undef __UCFG_LIVE_FLG_SHIFT
+#undef __UCFG_LIVE_GPR_SHIFT
+#undef __UCFG_ANALYZER_SET
+#undef __UCFG_ANALYZER_GET
+#undef __UCFG_ANALYZER_IN_TEXT
@@ -19,6 +19,8 @@
 #ifndef __UCFG_ANALYZER_H
 #define __UCFG_ANALYZER_H
 
+#include "address_dictionary.h"
+#include "analysis_cache.h"
 #include "binary.h"
 #include "buffer.h"
 #include "capstone_.h"
@@ -28,16 +30,61 @@
 #include <capstone/capstone.h>
 #include <gmodule.h>
 
+/*
+ * RegState packed into 16-bit masks (every mask in capstone_.h fits)
+ */
+typedef struct ucfg_packed_reg_state_t {
+    uint16_t gpr_read;
+    uint16_t gpr_read_32_64;
+    uint16_t gpr_write;
+    uint16_t gpr_write_32_64;
+    uint16_t flg_read;
+    uint16_t flg_write;
+    uint16_t xmm_read;
+    uint16_t xmm_write;
+    uint16_t ymm_read;
+    uint16_t ymm_write;
+    uint16_t zmm_read;
+    uint16_t zmm_write;
+} PackedRegState;
+
+/*
+ * Lists of UCFG edges. The list of an address in .text is kept in a dense array
+ * indexed by (addr - text_addr), and the others (e.g., predecessors of a PLT
+ * entry) are kept in a hash table.
+ */
+typedef struct ucfg_edge_lists_t {
+    Buffer **inner;
+    GHashTable *outer;
+} UEdgeLists;
+
+/*
+ * Borrowed view of a list of UCFG edges, which is only valid until the next
+ * instruction is added into the analyzer.
+ */
+typedef struct ucfg_edge_span_t {
+    const addr_t *ptr;
+    size_t n;
+} UEdgeSpan;
+
 /*
  * Light-weight instruction-level analyzer, which aims at analyzing conservative
  * use-def relation on the Universal CFG (UCFG).
+ *
+ * All per-instruction states are dense arrays indexed by (addr - text_addr), as
+ * instructions are only added from .text.
  */
 STRUCT(UCFG_Analyzer, {
-    // basic instruction information
-    GHashTable *insts;
+    // .text info
+    addr_t text_addr;
+    size_t text_size;
+
+    // basic instruction information (packed size and type, no cs_insn kept)
+    size_t inst_n;
+    AddrDictFast(uint16_t, insts);
 
-    // register state for each instruction
-    GHashTable *reg_states;
+    // register state for each instruction (packed 16-bit masks)
+    AddrDictFast(PackedRegState, reg_states);
 
     /*
      * successors and predecessor
@@ -48,25 +95,25 @@ STRUCT(UCFG_Analyzer, {
      * all_succs = direct_succs U intra_succs
      */
     // direct/explict successors and predecessors without call-fallthrough edges
-    GHashTable *direct_preds;
-    GHashTable *direct_succs;
+    UEdgeLists direct_preds;
+    UEdgeLists direct_succs;
     // intra-procedure successsors and predecessors
-    GHashTable *intra_preds;
-    GHashTable *intra_succs;
+    UEdgeLists intra_preds;
+    UEdgeLists intra_succs;
     // successors and predecessors with call-fallthrough edges
-    GHashTable *all_preds;
-    GHashTable *all_succs;
-
-    // eflags register analysis
-    GHashTable *flg_finished_succs;
-    GHashTable *flg_need_write;
+    UEdgeLists all_preds;
+    UEdgeLists all_succs;
 
-    // general register analysis
-    GHashTable *gpr_analyzed_succs;
-    GHashTable *gpr_can_write;
+    // register liveness (live-in GPRs, eflags, and XMMs packed into 64 bits),
+    // which is solved lazily when any result is queried
+    AddrDictFast(uint64_t, live);
+    // offsets of instructions added since the last solving (uint32_t)
+    Buffer *live_pending;
+    // whether an inst is in the worklist of liveness solving (bitmap)
+    uint64_t *live_queued;
 
-    // whether an inst can reach a RET inst via intra-procedure edges
-    GHashTable *can_ret;
+    // whether an inst can reach a RET inst via intra-procedure edges (bitmap)
+    uint64_t *can_ret;
 
     // system optargs
     SysOptArgs *opts;
@@ -85,13 +132,28 @@ Z_API UCFG_Analyzer *z_ucfg_analyzer_create(Binary *binary, SysOptArgs *opts);
 Z_API void z_ucfg_analyzer_destroy(UCFG_Analyzer *a);
 
 /*
- * Add a new instruction into analyzing buffer, *maybe_duplicated* means it is
- * possible that UCFG_Analyzer already analyzes this address
+ * Store the whole analysis state of an ucfg_analyzer into an analysis cache.
+ */
+Z_API void z_ucfg_analyzer_store_cache(UCFG_Analyzer *a, AnalysisCache *c);
+
+/*
+ * Restore the analysis state of an empty ucfg_analyzer from a loaded analysis
+ * cache, return false if the cache is incomplete.
+ */
+Z_API bool z_ucfg_analyzer_load_cache(UCFG_Analyzer *a, AnalysisCache *c);
+
+/*
+ * Add a new instruction into analyzing buffer. If UCFG_Analyzer already
+ * analyzes this address, *ori_inst* must be the original instruction, which is
+ * used to check whether the update is consistent.
  */
 // XXX: note that it is ok if the predecessors of addr is unknown, which means
 // it is safe to use this function even the superset disassembly is incomplete.
+// XXX: UCFG_Analyzer does not take the ownership of inst, and it will not
+// access inst after this function returns.
 Z_API void z_ucfg_analyzer_add_inst(UCFG_Analyzer *a, addr_t addr,
-                                    const cs_insn *inst, bool maybe_duplicated);
+                                    const cs_insn *inst,
+                                    const cs_insn *ori_inst);
 
 /*
  * Get succerrors without the call-fallthrough edges (return value will never be
@@ -131,20 +193,39 @@ Z_API Buffer *z_ucfg_analyzer_get_all_predecessors(UCFG_Analyzer *a,
                                                    addr_t addr);
 
 /*
- * Get *need-write* information for flag registers
+ * Peek successors/predecessors without any allocation or copy (an empty span is
+ * returned if there is no such edge). Note that, different from the getters
+ * above, they never create lists, so it is safe to call them concurrently.
+ */
+#define __UCFG_ANALYZER_DEFINE_PEEK(etype, rtype)                            \
+    Z_API UEdgeSpan z_ucfg_analyzer_peek_##etype##_##rtype(UCFG_Analyzer *a, \
+                                                           addr_t addr)
+
+__UCFG_ANALYZER_DEFINE_PEEK(direct, predecessors);
+__UCFG_ANALYZER_DEFINE_PEEK(direct, successors);
+__UCFG_ANALYZER_DEFINE_PEEK(intra, predecessors);
+__UCFG_ANALYZER_DEFINE_PEEK(intra, successors);
+__UCFG_ANALYZER_DEFINE_PEEK(all, predecessors);
+__UCFG_ANALYZER_DEFINE_PEEK(all, successors);
+
+#undef __UCFG_ANALYZER_DEFINE_PEEK
+
+/*
+ * Get *need-write* information for flag registers (i.e., live-in eflags)
  */
 Z_API FLGState z_ucfg_analyzer_get_flg_need_write(UCFG_Analyzer *a,
                                                   addr_t addr);
 
 /*
- * Get *can_write* information for general purpose registers
+ * Get *can_write* information for general purpose registers (i.e., dead GPRs)
  */
 Z_API GPRState z_ucfg_analyzer_get_gpr_can_write(UCFG_Analyzer *a, addr_t addr);
 
 /*
- * Get register state for a given addr
+ * Get register state for a given addr into *rs, return false if there is no
+ * instruction at addr
  */
-Z_API RegState *z_ucfg_analyzer_get_register_state(UCFG_Analyzer *a,
-                                                   addr_t addr);
+Z_API bool z_ucfg_analyzer_get_register_state(UCFG_Analyzer *a, addr_t addr,
+                                              RegState *rs);
 
 #endif
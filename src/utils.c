@@ -19,6 +19,7 @@
 #include "utils.h"
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <time.h>
 
@@ -99,6 +100,205 @@ Z_API int z_rand() {
 
 Z_API void z_exit(int status) { exit(status); }
 
+/*
+ * Parallel jobs
+ */
+#define __PARALLEL_MAX_WORKER_N 64
+
+STRUCT(__ParallelJob, {
+    PTaskFcn fcn;
+    void *ctx;
+    size_t task_n;
+    size_t next_task;  // accessed atomically
+});
+
+static size_t __parallel_worker_n = 0;
+
+Z_PRIVATE void *__parallel_worker(void *arg) {
+    __ParallelJob *job = (__ParallelJob *)arg;
+
+    while (true) {
+        size_t task_id = __atomic_fetch_add(&job->next_task, 1, __ATOMIC_RELAXED);
+        if (task_id >= job->task_n) {
+            break;
+        }
+        (*job->fcn)(job->ctx, task_id);
+    }
+
+    return NULL;
+}
+
+Z_API size_t z_parallel_get_worker_n() {
+    if (!__parallel_worker_n) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        if (n <= 0) {
+            n = 1;
+        }
+        if (n > __PARALLEL_MAX_WORKER_N) {
+            n = __PARALLEL_MAX_WORKER_N;
+        }
+        __parallel_worker_n = (size_t)n;
+    }
+    return __parallel_worker_n;
+}
+
+Z_API void z_parallel_run(size_t task_n, PTaskFcn fcn, void *ctx) {
+    if (!task_n) {
+        return;
+    }
+
+    __ParallelJob job = {
+        .fcn = fcn,
+        .ctx = ctx,
+        .task_n = task_n,
+        .next_task = 0,
+    };
+
+    size_t worker_n = z_parallel_get_worker_n();
+    if (worker_n > task_n) {
+        worker_n = task_n;
+    }
+
+    // the current thread is also a worker
+    pthread_t threads[__PARALLEL_MAX_WORKER_N];
+    size_t thread_n = 0;
+    for (; thread_n + 1 < worker_n; thread_n++) {
+        if (pthread_create(&threads[thread_n], NULL, &__parallel_worker,
+                           &job)) {
+            z_warn("fail on pthread_create, fall back to fewer workers");
+            break;
+        }
+    }
+
+    __parallel_worker(&job);
+
+    for (size_t i = 0; i < thread_n; i++) {
+        if (pthread_join(threads[i], NULL)) {
+            EXITME("fail on pthread_join");
+        }
+    }
+}
+
+/*
+ * Level-synchronous parallel jobs
+ */
+#define __PARALLEL_LEVEL_BATCH 0x40
+#define __PARALLEL_LEVEL_MIN_TASK_N 0x1000
+
+STRUCT(__ParallelLevelJob, {
+    PTaskFcn fcn;
+    void *ctx;
+    size_t level_n;
+    const size_t *level_offs;
+    size_t *next_tasks;  // for each level, accessed atomically
+
+    // workers are held until the barrier is ready
+    bool started;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_barrier_t barrier;
+});
+
+Z_PRIVATE void *__parallel_level_worker(void *arg) {
+    __ParallelLevelJob *job = (__ParallelLevelJob *)arg;
+
+    pthread_mutex_lock(&job->lock);
+    while (!job->started) {
+        pthread_cond_wait(&job->cond, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    for (size_t l = 0; l < job->level_n; l++) {
+        size_t end = job->level_offs[l + 1];
+        while (true) {
+            size_t task_id =
+                job->level_offs[l] +
+                __atomic_fetch_add(&job->next_tasks[l], __PARALLEL_LEVEL_BATCH,
+                                   __ATOMIC_RELAXED);
+            if (task_id >= end) {
+                break;
+            }
+
+            size_t batch_end = task_id + __PARALLEL_LEVEL_BATCH;
+            if (batch_end > end) {
+                batch_end = end;
+            }
+            for (; task_id < batch_end; task_id++) {
+                (*job->fcn)(job->ctx, task_id);
+            }
+        }
+
+        pthread_barrier_wait(&job->barrier);
+    }
+
+    return NULL;
+}
+
+Z_API void z_parallel_run_levels(size_t level_n, const size_t *level_offs,
+                                 PTaskFcn fcn, void *ctx) {
+    if (!level_n) {
+        return;
+    }
+
+    size_t task_n = level_offs[level_n] - level_offs[0];
+    size_t worker_n = z_parallel_get_worker_n();
+
+    // XXX: synchronizing levels is not free, so small jobs are run serially
+    if (worker_n == 1 || task_n < __PARALLEL_LEVEL_MIN_TASK_N) {
+        for (size_t i = level_offs[0]; i < level_offs[level_n]; i++) {
+            (*fcn)(ctx, i);
+        }
+        return;
+    }
+
+    __ParallelLevelJob job = {
+        .fcn = fcn,
+        .ctx = ctx,
+        .level_n = level_n,
+        .level_offs = level_offs,
+        .next_tasks = z_alloc(level_n, sizeof(size_t)),
+        .started = false,
+    };
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+
+    // the current thread is also a worker
+    pthread_t threads[__PARALLEL_MAX_WORKER_N];
+    size_t thread_n = 0;
+    for (; thread_n + 1 < worker_n; thread_n++) {
+        if (pthread_create(&threads[thread_n], NULL, &__parallel_level_worker,
+                           &job)) {
+            z_warn("fail on pthread_create, fall back to fewer workers");
+            break;
+        }
+    }
+
+    // the barrier can only be initialized after we know how many workers
+    // there are
+    pthread_barrier_init(&job.barrier, NULL, thread_n + 1);
+    pthread_mutex_lock(&job.lock);
+    job.started = true;
+    pthread_cond_broadcast(&job.cond);
+    pthread_mutex_unlock(&job.lock);
+
+    __parallel_level_worker(&job);
+
+    for (size_t i = 0; i < thread_n; i++) {
+        if (pthread_join(threads[i], NULL)) {
+            EXITME("fail on pthread_join");
+        }
+    }
+
+    pthread_barrier_destroy(&job.barrier);
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+    z_free(job.next_tasks);
+}
+
+#undef __PARALLEL_LEVEL_BATCH
+#undef __PARALLEL_LEVEL_MIN_TASK_N
+#undef __PARALLEL_MAX_WORKER_N
+
 Z_API FILE *z_fopen(const char *pathname, const char *mode) {
     FILE *out = fopen(pathname, mode);
     if (out == NULL) {
@@ -201,6 +401,34 @@ size_t ks_size = 0;
 const unsigned char *ks_encode = NULL;
 unsigned char ks_encode_fast[0x10];
 
+#ifdef DEBUG
+Z_API void z_ks_check_fast_encoding(addr_t addr, const char *fmt, ...) {
+    char code[KS_BUFMAX];
+    va_list ap;
+    va_start(ap, fmt);
+    if (vsnprintf(code, KS_BUFMAX, fmt, ap) >= KS_BUFMAX) {
+        EXITME("assembly code is too long:\n%s", code);
+    }
+    va_end(ap);
+
+    KS_INIT;
+    unsigned char *encode = NULL;
+    size_t size = 0, count = 0;
+    if (ks_asm(ks, code, addr, &encode, &size, &count) != KS_ERR_OK) {
+        EXITME("fail on ks_asm:\n%s", code);
+    }
+
+    // the quick encoding picks the same (shortest) forms as keystone does
+    if (count != ks_count || size != ks_size ||
+        memcmp(encode, ks_encode, size)) {
+        EXITME("quick encoding (%ld bytes) mismatches keystone (%ld bytes): %s",
+               ks_size, size, code);
+    }
+
+    ks_free(encode);
+}
+#endif
+
 /*
  * Capstone
  */
@@ -140,6 +140,26 @@ Z_API char *z_strchr(const char *s, int c);
 #define z_likely(x) __builtin_expect(!!(x), 1)
 #define z_unlikely(x) __builtin_expect(!!(x), 0)
 
+/*
+ * Parallel jobs
+ */
+// task function: ctx is shared by all tasks, task_id is in [0, task_n)
+typedef void (*PTaskFcn)(void *ctx, size_t task_id);
+
+// get the number of worker threads we are going to use (at least 1)
+Z_API size_t z_parallel_get_worker_n();
+
+// run task_n tasks on at most z_parallel_get_worker_n() threads, and return
+// after all tasks finish. Note that tasks are picked up dynamically, so the
+// execution order of tasks is NOT guaranteed.
+Z_API void z_parallel_run(size_t task_n, PTaskFcn fcn, void *ctx);
+
+// run tasks level by level, where the tasks of level l are [level_offs[l],
+// level_offs[l + 1]). Tasks of the same level run in parallel, and a level
+// starts only after all tasks of previous levels finish.
+Z_API void z_parallel_run_levels(size_t level_n, const size_t *level_offs,
+                                 PTaskFcn fcn, void *ctx);
+
 /*
  * Keystone
  */
@@ -170,6 +190,15 @@ extern unsigned char ks_encode_fast[0x10];
 
 #define KS_BUFMAX 0x300
 
+// in DEBUG mode, cross-check the quick encoding (i.e., ks_encode_fast) with the
+// one keystone generates for the assembly code
+#ifdef DEBUG
+Z_API void z_ks_check_fast_encoding(addr_t addr, const char *fmt, ...);
+#define KS_CHECK_FAST(addr, ...) z_ks_check_fast_encoding(addr, __VA_ARGS__)
+#else
+#define KS_CHECK_FAST(addr, ...)
+#endif
+
 // for quick assembly
 #define KS_ASM_CALL(cur_addr, tar_addr)                           \
     do {                                                          \
@@ -183,6 +212,8 @@ extern unsigned char ks_encode_fast[0x10];
         ks_encode = ks_encode_fast;                               \
     } while (0)
 
+// XXX: KS_ASM_JMP is always encoded with rel32 (5 bytes), which the bridges in
+// the original code and the `j*cxz $+5` in shadow code rely on
 #define KS_ASM_JMP(cur_addr, tar_addr)                            \
     do {                                                          \
         ks_encode_fast[0] = '\xe9';                               \
@@ -195,6 +226,25 @@ extern unsigned char ks_encode_fast[0x10];
         ks_encode = ks_encode_fast;                               \
     } while (0)
 
+// jmp tar_addr, with rel8 if it fits (as keystone does)
+#define KS_ASM_JMP_SHORT(cur_addr, tar_addr)                        \
+    do {                                                            \
+        long rel8_ = (long)(tar_addr) - (long)(cur_addr)-2;         \
+        if (rel8_ >= -128 && rel8_ <= 127) {                        \
+            if (ks_encode != NULL && ks_encode != ks_encode_fast) { \
+                ks_free((unsigned char *)ks_encode);                \
+            }                                                       \
+            ks_encode_fast[0] = '\xeb';                             \
+            ks_encode_fast[1] = (unsigned char)rel8_;               \
+            ks_size = 2;                                            \
+            ks_count = 1;                                           \
+            ks_encode = ks_encode_fast;                             \
+        } else {                                                    \
+            KS_ASM_JMP(cur_addr, tar_addr);                         \
+        }                                                           \
+        KS_CHECK_FAST(cur_addr, "jmp %#lx", (addr_t)(tar_addr));    \
+    } while (0)
+
 // XXX: note that  KS_ASM_CONST_MOV can only mov to an address smaller than
 // 0x7fffffff, and can only store a value smaller than 0x7fffffff
 #define KS_ASM_CONST_MOV(mem, val)                                            \
@@ -216,6 +266,120 @@ extern unsigned char ks_encode_fast[0x10];
         ks_encode = ks_encode_fast;                                           \
     } while (0)
 
+// XXX: conditional jumps are encoded with rel8 (7x) if it fits, otherwise with
+// rel32 (0F 8x), and the caller has to include x64_utils.c
+#define KS_ASM_JCC(cur_addr, tar_addr, inst_id)                       \
+    do {                                                              \
+        if (ks_encode != NULL && ks_encode != ks_encode_fast) {       \
+            ks_free((unsigned char *)ks_encode);                      \
+        }                                                             \
+        uint8_t opcode_ = z_x64_get_jcc_opcode(inst_id);              \
+        long rel8_ = (long)(tar_addr) - (long)(cur_addr)-2;           \
+        if (rel8_ >= -128 && rel8_ <= 127) {                          \
+            ks_encode_fast[0] = opcode_ - 0x10;                       \
+            ks_encode_fast[1] = (unsigned char)rel8_;                 \
+            ks_size = 2;                                              \
+        } else {                                                      \
+            ks_encode_fast[0] = '\x0f';                               \
+            ks_encode_fast[1] = opcode_;                              \
+            *(int *)(ks_encode_fast + 2) = (tar_addr) - (cur_addr)-6; \
+            ks_size = 6;                                              \
+        }                                                             \
+        ks_count = 1;                                                 \
+        ks_encode = ks_encode_fast;                                   \
+        KS_CHECK_FAST(cur_addr, "%s %#lx", cs_insn_name(cs, inst_id), \
+                      (addr_t)(tar_addr));                            \
+    } while (0)
+
+#define KS_ASM_BRANCH(cur_addr, tar_addr, inst_id)                    \
+    do {                                                              \
+        if ((inst_id) == X86_INS_CALL) {                              \
+            KS_ASM_CALL(cur_addr, tar_addr);                          \
+            KS_CHECK_FAST(cur_addr, "call %#lx", (addr_t)(tar_addr)); \
+        } else if ((inst_id) == X86_INS_JMP) {                        \
+            KS_ASM_JMP_SHORT(cur_addr, tar_addr);                     \
+        } else {                                                      \
+            KS_ASM_JCC(cur_addr, tar_addr, inst_id);                  \
+        }                                                             \
+    } while (0)
+
+// XXX: note that KS_ASM_PUSH can only push a value smaller than 0x7fffffff,
+// and a value smaller than 0x80 is pushed with imm8 (6A)
+#define KS_ASM_PUSH(val)                                            \
+    do {                                                            \
+        if (ks_encode != NULL && ks_encode != ks_encode_fast) {     \
+            ks_free((unsigned char *)ks_encode);                    \
+        }                                                           \
+        long val_ = (val);                                          \
+        if (val_ < 0 || val_ > 0x7FFFFFFF) {                        \
+            EXITME("KS_ASM_PUSH pushes a large value: %#lx", val_); \
+        }                                                           \
+        if (val_ <= 0x7F) {                                         \
+            ks_encode_fast[0] = '\x6a';                             \
+            ks_encode_fast[1] = (unsigned char)val_;                \
+            ks_size = 2;                                            \
+        } else {                                                    \
+            ks_encode_fast[0] = '\x68';                             \
+            memcpy(ks_encode_fast + 1, &(val_), 4);                 \
+            ks_size = 5;                                            \
+        }                                                           \
+        ks_count = 1;                                               \
+        ks_encode = ks_encode_fast;                                 \
+    } while (0)
+
+// push val; jmp tar_addr (both in their shortest forms)
+#define KS_ASM_PUSH_JMP(cur_addr, val, tar_addr)                         \
+    do {                                                                 \
+        KS_ASM_PUSH(val);                                                \
+        long push_size_ = (long)ks_size;                                 \
+        long rel8_ = (long)(tar_addr) - (long)(cur_addr)-push_size_ - 2; \
+        if (rel8_ >= -128 && rel8_ <= 127) {                             \
+            ks_encode_fast[push_size_] = '\xeb';                         \
+            ks_encode_fast[push_size_ + 1] = (unsigned char)rel8_;       \
+            ks_size = push_size_ + 2;                                    \
+        } else {                                                         \
+            ks_encode_fast[push_size_] = '\xe9';                         \
+            *(int *)(ks_encode_fast + push_size_ + 1) =                  \
+                (tar_addr) - (cur_addr)-push_size_ - 5;                  \
+            ks_size = push_size_ + 5;                                    \
+        }                                                                \
+        ks_count = 2;                                                    \
+        KS_CHECK_FAST(cur_addr, "push %#lx; jmp %#lx", (long)(val),      \
+                      (addr_t)(tar_addr));                               \
+    } while (0)
+
+// jmp qword ptr [rip + disp]
+#define KS_ASM_JMP_RIP(disp)                                             \
+    do {                                                                 \
+        if (ks_encode != NULL && ks_encode != ks_encode_fast) {          \
+            ks_free((unsigned char *)ks_encode);                         \
+        }                                                                \
+        int disp_ = (disp);                                              \
+        memcpy(ks_encode_fast, "\xff\x25", 2);                           \
+        memcpy(ks_encode_fast + 2, &(disp_), 4);                         \
+        ks_size = 6;                                                     \
+        ks_count = 1;                                                    \
+        ks_encode = ks_encode_fast;                                      \
+        KS_CHECK_FAST(0, "jmp qword ptr [rip %c %#x]",                   \
+                      (disp_ < 0 ? '-' : '+'),                           \
+                      (disp_ < 0 ? -(unsigned)disp_ : (unsigned)disp_)); \
+    } while (0)
+
+// XXX: code must be a string literal of pre-assembled, position-independent
+// instructions (count is always 1 for simplicity)
+#define KS_ASM_RAW(code)                                           \
+    do {                                                           \
+        _Static_assert(sizeof(code) - 1 <= sizeof(ks_encode_fast), \
+                       "too long raw code");                       \
+        if (ks_encode != NULL && ks_encode != ks_encode_fast) {    \
+            ks_free((unsigned char *)ks_encode);                   \
+        }                                                          \
+        memcpy(ks_encode_fast, code, sizeof(code) - 1);            \
+        ks_size = sizeof(code) - 1;                                \
+        ks_count = 1;                                              \
+        ks_encode = ks_encode_fast;                                \
+    } while (0)
+
 #define KS_ASM(addr, ...)                                                    \
     do {                                                                     \
         char code[KS_BUFMAX];                                                \
@@ -259,6 +423,7 @@ extern const cs_insn *cs_inst;
 #define CS_INIT                                                       \
     do {                                                              \
         if (cs == CS_INVALID_CSH) {                                   \
+            z_capstone_install_mem_hooks();                           \
             if (cs_open(CS_ARCH_X86, CS_MODE_64, &cs) != CS_ERR_OK) { \
                 EXITME("fail on cs_open()");                          \
             }                                                         \
@@ -60,4 +60,130 @@ Z_PRIVATE const uint8_t *z_x64_gen_invalid(size_t n) {
     }
 }
 
+// XXX: return the second opcode byte of `0F 8x rel32`
+Z_PRIVATE uint8_t z_x64_get_jcc_opcode(uint32_t inst_id) {
+    switch (inst_id) {
+        case X86_INS_JO:
+            return 0x80;
+        case X86_INS_JNO:
+            return 0x81;
+        case X86_INS_JB:
+            return 0x82;
+        case X86_INS_JAE:
+            return 0x83;
+        case X86_INS_JE:
+            return 0x84;
+        case X86_INS_JNE:
+            return 0x85;
+        case X86_INS_JBE:
+            return 0x86;
+        case X86_INS_JA:
+            return 0x87;
+        case X86_INS_JS:
+            return 0x88;
+        case X86_INS_JNS:
+            return 0x89;
+        case X86_INS_JP:
+            return 0x8A;
+        case X86_INS_JNP:
+            return 0x8B;
+        case X86_INS_JL:
+            return 0x8C;
+        case X86_INS_JGE:
+            return 0x8D;
+        case X86_INS_JLE:
+            return 0x8E;
+        case X86_INS_JG:
+            return 0x8F;
+        default:
+            EXITME("invalid conditional jump: %d", inst_id);
+            return 0;
+    }
+}
+
+// XXX: a reentrant version of KS_ASM_BRANCH, which encodes the rel32 form of
+// call/jmp/jcc into buf (at least 6 bytes) and returns the size
+Z_PRIVATE size_t z_x64_gen_branch(uint8_t *buf, addr_t cur_addr,
+                                  addr_t tar_addr, uint32_t inst_id) {
+    int32_t rel = 0;
+    size_t size = 0;
+
+    if (inst_id == X86_INS_CALL || inst_id == X86_INS_JMP) {
+        buf[0] = (inst_id == X86_INS_CALL) ? 0xe8 : 0xe9;
+        size = 5;
+    } else {
+        buf[0] = 0x0f;
+        buf[1] = z_x64_get_jcc_opcode(inst_id);
+        size = 6;
+    }
+
+    rel = (int32_t)(tar_addr - cur_addr - size);
+    memcpy(buf + size - 4, &rel, sizeof(rel));
+
+    return size;
+}
+
+// get the offset of the disp32 of a rip-relative instruction (whose original
+// displacement is disp), or 0 if it cannot be located. Note that capstone 4
+// does not expose the offset (cs_x86_encoding comes with capstone 5).
+Z_PRIVATE size_t z_x64_get_rip_disp_offset(const uint8_t *code, size_t size,
+                                           int32_t disp) {
+    size_t cur = 0;
+
+    // step (1). legacy prefixes and REX
+    while (cur < size) {
+        uint8_t b = code[cur];
+        if (b == 0x26 || b == 0x2e || b == 0x36 || b == 0x3e || b == 0x64 ||
+            b == 0x65 || b == 0x66 || b == 0x67 || b == 0xf0 || b == 0xf2 ||
+            b == 0xf3) {
+            cur++;
+        } else {
+            break;
+        }
+    }
+    if (cur < size && (code[cur] & 0xf0) == 0x40) {
+        cur++;
+    }
+    if (cur + 1 >= size) {
+        return 0;
+    }
+
+    // step (2). opcode (note that 0x62/0xc4/0xc5 are always EVEX/VEX in 64-bit
+    // mode), which is always followed by ModRM for a memory operand
+    uint8_t opcode = code[cur];
+    if (opcode == 0xc5) {
+        cur += 3;
+    } else if (opcode == 0xc4) {
+        cur += 4;
+    } else if (opcode == 0x62) {
+        cur += 5;
+    } else if (opcode == 0x8f && (code[cur + 1] & 0x38)) {
+        // XOP
+        cur += 4;
+    } else if (opcode == 0x0f) {
+        uint8_t opcode2 = code[cur + 1];
+        cur += ((opcode2 == 0x38 || opcode2 == 0x3a) ? 3 : 2);
+    } else {
+        cur += 1;
+    }
+
+    // step (3). rip-relative addressing is ModRM.mod = 00 and ModRM.rm = 101
+    // (without SIB), which is directly followed by the disp32. We double check
+    // the disp32 with the displacement capstone decodes, so that any mistake
+    // above only makes the caller fall back to re-encoding.
+    if (cur + 1 + sizeof(int32_t) > size) {
+        return 0;
+    }
+    if ((code[cur] & 0xc7) != 0x05) {
+        return 0;
+    }
+    int32_t cur_disp = 0;
+    memcpy(&cur_disp, code + cur + 1, sizeof(cur_disp));
+    if (cur_disp != disp) {
+        return 0;
+    }
+
+    return cur + 1;
+}
+
 #endif